@@ -0,0 +1,115 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file bench_census.cpp
+ * @brief How long census() takes over many sealed generations, walked by one
+ *        thread and by several, incrementally and sampled.
+ *
+ * A report rather than a nanobench case, for the reason bench_startup.cpp is:
+ * what is timed is a whole walk of a directory, and it is long enough that one
+ * run per row is a measurement. The figure is the median of three.
+ *
+ * The database is class 0 rotated into sealed generations, so every task is one
+ * file of the same size and the rows differ only in how many are read at once.
+ * On a warm page cache the walk is reading entries and the threads divide it;
+ * on a cold one it is also the disk, and the gain is whatever the device gives
+ * to several readers over one.
+ *
+ * The last row is an incremental census of the same state, after one that left
+ * its records: every sealed generation is counted from its record and only the
+ * active one is read, so it is the floor the nightly case approaches.
+ *
+ * The sampled rows read 1% and 10% of each generation on one thread, and say
+ * how wide the payload interval came out, as a share of the estimate. Every
+ * value here is the same size, so the sample has no variance and the interval
+ * is the point: the rows measure what sampling saves, not how well it estimates.
+ */
+
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <utxoz/census.hpp>
+
+namespace bench {
+
+namespace {
+
+double median_census(utxoz::db& db, unsigned threads, size_t runs, bool incremental = false,
+                     double sample_fraction = 0.0) {
+    utxoz::census_options options;
+    options.threads = threads;
+    options.incremental = incremental;
+    options.sample_fraction = sample_fraction;
+    std::vector<double> samples;
+    for (size_t r = 0; r < runs; ++r) {
+        auto const start = std::chrono::steady_clock::now();
+        auto const report = db.census(options);
+        auto const finished = std::chrono::steady_clock::now();
+        if ( ! report) throw std::runtime_error("census failed");
+        samples.push_back(std::chrono::duration<double>(finished - start).count());
+    }
+    std::ranges::sort(samples);
+    return samples[samples.size() / 2];
+}
+
+} // anonymous namespace
+
+void run_census_report() {
+    fmt::println("\n{:=^80}", " Census ");
+    fmt::println("  Class 0 rotated into sealed generations. Median of three walks per row.\n");
+
+    constexpr size_t runs = 3;
+    constexpr size_t per_generation = 20'000;
+    unsigned const hardware = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (size_t const generations : {8, 32}) {
+        BenchFixture f;
+        auto const value = make_test_value(43);
+        uint32_t id = 0;
+        for (size_t g = 0; g < generations; ++g) {
+            for (size_t i = 0; i < per_generation; ++i) {
+                (void) f.db->insert(make_test_key(id++, 0), value, 100);
+            }
+            if (g + 1 < generations) {
+                utxoz::detail::failpoints::force_rotations.store(1, std::memory_order_relaxed);
+            }
+        }
+
+        fmt::println("--- {} generations x {} entries ---", generations, per_generation);
+        auto const sequential = median_census(*f.db, 1, runs);
+        for (unsigned const threads : {1u, 2u, 4u, hardware}) {
+            if (threads > 1 && threads > hardware) continue;
+            auto const seconds = threads == 1 ? sequential : median_census(*f.db, threads, runs);
+            fmt::println("  {:>3} threads  {:>9.2f} ms  {:>5.2f}x", threads, seconds * 1000.0,
+                         sequential / seconds);
+        }
+        // One incremental walk to leave the records, then walks that find every
+        // sealed generation unchanged and read only the active one.
+        if ( ! f.db->census({.incremental = true})) throw std::runtime_error("census failed");
+        auto const reused = median_census(*f.db, 1, runs, true);
+        fmt::println("  incremental  {:>9.2f} ms  {:>5.2f}x  (1 thread, nothing changed)",
+                     reused * 1000.0, sequential / reused);
+        for (double const fraction : {0.01, 0.1}) {
+            auto const seconds = median_census(*f.db, 1, runs, false, fraction);
+            auto const report = f.db->census({.sample_fraction = fraction});
+            if ( ! report) throw std::runtime_error("census failed");
+            auto const& interval = report->entry_payload_interval;
+            double const spread = report->entry_payload_bytes == 0 ? 0.0
+                : 100.0 * double(interval.high - interval.low) / 2.0
+                      / double(report->entry_payload_bytes);
+            fmt::println("  sampled {:>3.0f}%  {:>9.2f} ms  {:>5.2f}x  (1 thread, payload ±{:.2f}%)",
+                         fraction * 100.0, seconds * 1000.0, sequential / seconds, spread);
+        }
+        fmt::println("");
+    }
+
+    fmt::println("{:=^80}\n", "");
+}
+
+} // namespace bench
@@ -132,6 +132,18 @@ void register_storage_benchmarks(ankerl::nanobench::Bench& bench);
 /// The read-path counters. Run from a build with statistics and from one
 /// without; the difference between the two runs is what they cost.
 void register_lookup_telemetry_benchmarks(ankerl::nanobench::Bench& bench);
+/// The same workloads at every level set_statistics_level() can select. Its
+/// `running=off` against an `off` build is what the switch costs.
+void register_statistics_switch_benchmarks(ankerl::nanobench::Bench& bench);
+/// The span sites a node reaches every block, with tracing off and on.
+void register_trace_benchmarks(ankerl::nanobench::Bench& bench);
 void run_storage_overhead_report();
+/// Merge throughput with the entries placed in target order and in source order.
+void run_compaction_throughput_report();
+/// open() on a database with sealed generations, with the manifest and scanning.
+void run_startup_report();
+/// census() over sealed generations, on one thread, on several, incrementally
+/// and sampled.
+void run_census_report();
 
 } // namespace bench
@@ -2,10 +2,42 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+/**
+ * @file bench_erase.cpp
+ * @brief apply_deletes(), hit and miss, one key and in batches.
+ *
+ * The last case is the one that shows what the statistics cost on the erase
+ * path. Like bench_lookup_telemetry.cpp it compares two builds rather than two
+ * paths in one binary — configure once with `-DUTXOZ_STATISTICS_LEVEL=off` and
+ * once with the default, run both, and the difference in ns/op is the
+ * bookkeeping. The case name carries the level it was built with so that the two
+ * result files cannot be confused.
+ *
+ * Its spends are spread over many creation heights and many spending heights on
+ * purpose: every spend has a new age and most land in a new height range, which
+ * is the shape that made the old per-age and per-range hash maps grow and rehash.
+ * With every key spent at one height from one height, as in the cases above, the
+ * maps held a single entry and their cost did not show.
+ */
+
 #include "bench_common.hpp"
 
+#include <utxoz/config.hpp>
+
 namespace bench {
 
+namespace {
+
+#if UTXOZ_STATISTICS_LEVEL >= 2
+constexpr char const* statistics_level = "lookup";
+#elif UTXOZ_STATISTICS_LEVEL >= 1
+constexpr char const* statistics_level = "basic";
+#else
+constexpr char const* statistics_level = "off";
+#endif
+
+} // anonymous namespace
+
 void register_erase_benchmarks(ankerl::nanobench::Bench& bench) {
     // One-key batch, hit (pre-populated with enough entries for many iterations)
     {
@@ -58,6 +90,22 @@ void register_erase_benchmarks(ankerl::nanobench::Bench& bench) {
             ankerl::nanobench::doNotOptimizeAway(f.db->apply_deletes(batch));
         });
     }
+
+    // One-key batch, hit, every spend at a different age and height. Run under
+    // both statistics levels; see the top of this file.
+    {
+        BenchFixture f;
+        f.populate_chain_mix(200'000);
+        uint32_t id = 0;
+        std::vector<utxoz::deferred_deletion_entry> one(1, {make_test_key(0, 0), 200});
+        bench.run(fmt::format("apply_deletes hit, ages spread (statistics={})", statistics_level), [&] {
+            // Created at id / 100 by populate_chain_mix; spent a prime stride of
+            // heights later, so no two spends share an age.
+            uint32_t const spent_at = id / 100 + 1 + id * 37;
+            one[0] = utxoz::deferred_deletion_entry{make_test_key(id++, 0), spent_at};
+            ankerl::nanobench::doNotOptimizeAway(f.db->apply_deletes(one));
+        });
+    }
 }
 
 } // namespace bench
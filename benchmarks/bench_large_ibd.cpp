@@ -12,6 +12,8 @@
 
 #include <fmt/format.h>
 
+#include <utxoz/sharded.hpp>
+
 namespace fs = std::filesystem;
 
 namespace bench_large {
@@ -218,4 +220,91 @@ void run_ibd_simulation() {
     fs::remove_all(path);
 }
 
+void run_sharded_scaling() {
+    fmt::println("{:=^80}", " IBD Simulation, Sharded (scaling with shard count) ");
+
+    // Smaller than the single-database run: the point is the ratio between the
+    // rows, and every row pays for its own full set of production-sized files.
+    constexpr size_t total_inserts = 8'000'000;
+    constexpr size_t block_outputs = 4'000;     // one insert_batch per block
+    constexpr size_t block_spends  = 2'400;     // 60% of a block's worth, a block later
+
+    auto value_43  = bench::make_test_value(43);
+    auto value_41  = bench::make_test_value(41);
+    auto value_123 = bench::make_test_value(123);
+    auto value_89  = bench::make_test_value(89);
+
+    double baseline_insert = 0;
+    double baseline_erase = 0;
+
+    fmt::println("  {:>6}  {:>14}  {:>8}  {:>14}  {:>8}", "shards", "inserts/sec", "speedup",
+                 "erases/sec", "speedup");
+
+    for (size_t const shards : {size_t{1}, size_t{2}, size_t{4}, size_t{8}}) {
+        auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        auto unique_id = bench::bench_counter.fetch_add(1);
+        auto path = fmt::format("./bench_large_sharded_{}_{}_{}", getpid(), ts, unique_id);
+
+        auto opened = utxoz::sharded_db::open(path, shards, true);
+        if ( ! opened) {
+            fmt::println("could not open a set of {} shards at {}", shards, path);
+            return;
+        }
+        auto db = std::move(*opened);
+
+        // The same blocks in every row, so the rows differ only in the count.
+        std::mt19937 rng(42);
+        std::vector<utxoz::insert_request> outputs;
+        std::vector<utxoz::deferred_deletion_entry> spends;
+        outputs.reserve(block_outputs);
+        spends.reserve(block_spends);
+
+        double insert_s = 0;
+        double erase_s = 0;
+        size_t erased = 0;
+        for (size_t first = 0; first < total_inserts; first += block_outputs) {
+            auto const height = static_cast<uint32_t>(first / block_outputs);
+
+            outputs.clear();
+            for (size_t i = first; i < first + block_outputs; ++i) {
+                uint32_t r = rng() % 100;
+                utxoz::output_data_span value;
+                if (r < 82) value = value_43;
+                else if (r < 95) value = value_41;
+                else if (r < 99) value = value_123;
+                else value = value_89;
+                outputs.push_back({bench::make_test_key(static_cast<uint32_t>(i), 0), value, height});
+            }
+            timer t;
+            (void)db.insert_batch(outputs);
+            insert_s += t.elapsed_s();
+
+            // Spends of the previous block's outputs.
+            if (first == 0) continue;
+            spends.clear();
+            auto const previous = first - block_outputs;
+            for (size_t k = 0; k < block_spends; ++k) {
+                auto const i = previous + (k * 2654435761u) % block_outputs;
+                spends.emplace_back(bench::make_test_key(static_cast<uint32_t>(i), 0), height);
+            }
+            t.reset();
+            erased += db.apply_deletes(spends).erased.size();
+            erase_s += t.elapsed_s();
+        }
+
+        double const insert_rate = total_inserts / insert_s;
+        double const erase_rate = erased / erase_s;
+        if (shards == 1) {
+            baseline_insert = insert_rate;
+            baseline_erase = erase_rate;
+        }
+        fmt::println("  {:>6}  {:>14.0f}  {:>7.2f}x  {:>14.0f}  {:>7.2f}x", shards, insert_rate,
+                     insert_rate / baseline_insert, erase_rate, erase_rate / baseline_erase);
+
+        db.close();
+        fs::remove_all(path);
+    }
+    fmt::println("{:=^80}\n", "");
+}
+
 } // namespace bench_large
@@ -13,6 +13,7 @@
 
 namespace bench_large {
 void run_ibd_simulation();
+void run_sharded_scaling();
 void run_large_ops(ankerl::nanobench::Bench& bench);
 } // namespace bench_large
 
@@ -22,6 +23,7 @@ int main() {
     fmt::println("Estimated time: 5-10 minutes depending on hardware\n");
 
     bench_large::run_ibd_simulation();
+    bench_large::run_sharded_scaling();
 
     ankerl::nanobench::Bench bench;
     bench.title("utxo-z large-scale ops")
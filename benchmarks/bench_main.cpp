@@ -24,6 +24,8 @@ int main() {
     bench::register_mixed_workload_benchmarks(bench);
     bench::register_storage_benchmarks(bench);
     bench::register_lookup_telemetry_benchmarks(bench);
+    bench::register_statistics_switch_benchmarks(bench);
+    bench::register_trace_benchmarks(bench);
 
     std::ofstream json_file("benchmark_results.json");
     bench.render(ankerl::nanobench::templates::json(), json_file);
@@ -31,6 +33,9 @@ int main() {
     fmt::println("Benchmark results written to benchmark_results.json");
 
     bench::run_storage_overhead_report();
+    bench::run_compaction_throughput_report();
+    bench::run_startup_report();
+    bench::run_census_report();
 
     return 0;
 }
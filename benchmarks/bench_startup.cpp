@@ -0,0 +1,115 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file bench_startup.cpp
+ * @brief How long open() takes on a database with sealed generations, with the
+ *        manifest and without it, and how long until the first insert lands.
+ *
+ * A report rather than a nanobench case, because what is timed is a whole open
+ * of a directory, closed between runs, and each close writes the manifest the
+ * next open reads. The database is built once per shape and reopened; the
+ * figure is the median of the reopens.
+ *
+ * Both rows come from one binary through `failpoints::ignore_manifest`, which is
+ * every open before manifest_io.hpp: the directory listed for merge recovery and
+ * for the catalogue, every sealed generation mapped to be counted and checked,
+ * every metadata file read. The segment count beside each row is what the
+ * difference is made of. On a warm page cache the time is mostly the mappings;
+ * on a cold one it is also the first page of every sealed file, which the
+ * manifest row does not touch.
+ *
+ * The scan row reads its sealed generations on a few threads; see
+ * scan_sealed_generations(). Time to first insert is the open plus one insert
+ * into the active generation, which is what a node waiting on its store to
+ * start actually waits for.
+ */
+
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+struct startup {
+    double seconds;
+    double first_insert_seconds;
+    uint64_t segments;
+};
+
+/// Keys no build of the fixture used, one per reopen.
+uint32_t next_fresh_key = 0x80000000u;
+
+/// One reopen of `path` and one insert, closed again before returning.
+startup time_one_open(std::string const& path) {
+    auto const mapped_before = utxoz::detail::failpoints::segments_mapped.load(
+        std::memory_order_relaxed);
+    auto const start = std::chrono::steady_clock::now();
+    auto opened = utxoz::db::open_for_testing(path, false);
+    auto const opened_at = std::chrono::steady_clock::now();
+    if ( ! opened) throw std::runtime_error("reopen failed");
+    auto const segments = utxoz::detail::failpoints::segments_mapped.load(std::memory_order_relaxed)
+        - mapped_before;
+
+    auto const inserted = opened->insert(make_test_key(next_fresh_key++, 0), make_test_value(43), 100);
+    auto const first_insert_at = std::chrono::steady_clock::now();
+    if ( ! inserted || ! *inserted) throw std::runtime_error("first insert failed");
+
+    opened->close();
+    return {std::chrono::duration<double>(opened_at - start).count(),
+            std::chrono::duration<double>(first_insert_at - start).count(), segments};
+}
+
+startup median_open(std::string const& path, size_t runs) {
+    std::vector<startup> samples;
+    for (size_t r = 0; r < runs; ++r) samples.push_back(time_one_open(path));
+    std::ranges::sort(samples, {}, &startup::seconds);
+    return samples[samples.size() / 2];
+}
+
+} // anonymous namespace
+
+void run_startup_report() {
+    fmt::println("\n{:=^80}", " Startup ");
+    fmt::println("  Class 0 rotated into sealed generations. Median of five reopens per row.\n");
+
+    constexpr size_t runs = 5;
+    constexpr size_t per_generation = 5'000;
+
+    for (size_t const generations : {8, 32, 128}) {
+        BenchFixture f;
+        auto const value = make_test_value(43);
+        uint32_t id = 0;
+        for (size_t g = 0; g < generations; ++g) {
+            for (size_t i = 0; i < per_generation; ++i) {
+                (void) f.db->insert(make_test_key(id++, 0), value, 100);
+            }
+            if (g + 1 < generations) {
+                utxoz::detail::failpoints::force_rotations.store(1, std::memory_order_relaxed);
+            }
+        }
+        f.db->close();
+
+        auto const trusted = median_open(f.path, runs);
+        utxoz::detail::failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
+        auto const scanned = median_open(f.path, runs);
+        utxoz::detail::failpoints::ignore_manifest.store(false, std::memory_order_relaxed);
+
+        fmt::println("--- {} generations x {} entries ---", generations, per_generation);
+        for (auto const& [label, row] : {std::pair{"Manifest:", trusted}, std::pair{"Scan:", scanned}}) {
+            fmt::println("  {:<10} open {:>9.2f} ms  first insert {:>9.2f} ms  {:>5} segments mapped",
+                         label, row.seconds * 1000.0, row.first_insert_seconds * 1000.0,
+                         row.segments);
+        }
+        fmt::println("");
+    }
+
+    fmt::println("{:=^80}\n", "");
+}
+
+} // namespace bench
@@ -0,0 +1,117 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file bench_statistics_switch.cpp
+ * @brief What the statistics cost when switched off at run time.
+ *
+ * Each workload runs once per level this build carries, switched with
+ * set_statistics_level() and named `built=<build>, running=<level>`. The number
+ * the switch is judged by is `running=off` from a `lookup` build against the
+ * same name from an `off` build: the first still loads the level and branches on
+ * it, once per find() or insert() and once per batch, and the second has nothing
+ * compiled in to branch on. Within one build, `running=off` against `running=
+ * lookup` is what switching on costs, which bench_lookup_telemetry.cpp already
+ * breaks down by workload.
+ *
+ * The workloads are the per-key ones, where a load and a branch are the largest
+ * share of the call, and one of each batch shape, where they are spread over
+ * the batch. A difference inside nanobench's reported error between the two
+ * builds' `running=off` is the result this file exists to show.
+ */
+
+#include "bench_common.hpp"
+
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <utxoz/statistics.hpp>
+
+namespace bench {
+
+namespace {
+
+/// The levels worth running here: everything up to what the build carries.
+std::vector<utxoz::statistics_level> runnable_levels() {
+    std::vector<utxoz::statistics_level> levels{utxoz::statistics_level::off};
+    if (utxoz::compiled_statistics_level >= utxoz::statistics_level::basic) {
+        levels.push_back(utxoz::statistics_level::basic);
+    }
+    if (utxoz::compiled_statistics_level >= utxoz::statistics_level::lookup) {
+        levels.push_back(utxoz::statistics_level::lookup);
+    }
+    return levels;
+}
+
+std::string name_of(char const* workload, utxoz::statistics_level running) {
+    return fmt::format("switch: {} (built={}, running={})", workload,
+                       utxoz::to_string(utxoz::compiled_statistics_level),
+                       utxoz::to_string(running));
+}
+
+} // namespace
+
+void register_statistics_switch_benchmarks(ankerl::nanobench::Bench& bench) {
+    for (auto const running : runnable_levels()) {
+        // The cheapest find there is, so the load and the branch are the
+        // largest share of it that they will ever be.
+        {
+            BenchFixture f;
+            f.populate(10'000);
+            f.db->set_statistics_level(running);
+            uint32_t id = 0;
+            bench.run(name_of("find, active hit", running), [&] {
+                auto key = make_test_key(id++ % 10'000, 0);
+                ankerl::nanobench::doNotOptimizeAway(f.db->find(key, 200));
+            });
+        }
+
+        // Every class asked and none answers: the most counters a find() can
+        // skip.
+        {
+            BenchFixture f;
+            f.populate(10'000);
+            f.db->set_statistics_level(running);
+            uint32_t id = 500'000;
+            bench.run(name_of("find, miss", running), [&] {
+                auto key = make_test_key(id++, 0);
+                ankerl::nanobench::doNotOptimizeAway(f.db->find(key, 200));
+            });
+        }
+
+        // Per key on the write side: the container counters and the sampled
+        // clock, read from the level insert() took as it started.
+        {
+            BenchFixture f;
+            f.db->set_statistics_level(running);
+            auto const value = make_test_value(43);
+            uint32_t id = 0;
+            bench.run(name_of("insert", running), [&] {
+                ankerl::nanobench::doNotOptimizeAway(f.db->insert(make_test_key(id++, 0), value, 100));
+            });
+        }
+
+        // A batch of deletions: one reading for the batch, spread over 256
+        // keys, and the lifetime and per-class counters skipped for each.
+        // Populated for many iterations, as bench_erase.cpp is.
+        {
+            BenchFixture f;
+            f.populate(200'000);
+            f.db->set_statistics_level(running);
+            std::vector<utxoz::deferred_deletion_entry> batch;
+            batch.reserve(256);
+            uint32_t next = 0;
+            bench.run(name_of("apply_deletes of 256 active keys", running), [&] {
+                batch.clear();
+                for (size_t i = 0; i < 256; ++i) {
+                    batch.emplace_back(make_test_key(next++, 0), 150);
+                }
+                ankerl::nanobench::doNotOptimizeAway(f.db->apply_deletes(batch));
+            });
+        }
+    }
+}
+
+} // namespace bench
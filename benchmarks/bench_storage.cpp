@@ -40,6 +40,59 @@ void register_storage_benchmarks(ankerl::nanobench::Bench& bench) {
             f.db.emplace(std::move(*r));
         });
     }
+
+    // =========================================================================
+    // Per-block sync
+    // =========================================================================
+    // One block's worth of writes — inserts at the chain mix, and deletes of
+    // half as many older entries — then sync(). What a node pays at every block
+    // it connects. The page barrier covers the pages the block wrote, so this
+    // should follow the block size, not the size of the files.
+    //
+    // Each size runs twice: through the I/O engine the build has, and through
+    // the POSIX path with one `fsync` per file. The two differ only in a build
+    // with UTXOZ_IO_URING, and there only on a device with a queue to fill —
+    // NVMe, not tmpfs.
+
+    struct BlockSyncCase {
+        char const* name;
+        size_t block_outputs;
+        bool posix;
+    };
+
+    BlockSyncCase const bs_cases[] = {
+        {"block + sync (2K outputs)",          2'000, false},
+        {"block + sync (8K outputs)",          8'000, false},
+        {"block + sync (32K outputs)",        32'000, false},
+        {"block + sync (8K outputs, posix)",   8'000, true},
+        {"block + sync (32K outputs, posix)", 32'000, true},
+    };
+
+    for (auto const& c : bs_cases) {
+        // Read when the first sync sets up the engine, which is in the loop.
+        utxoz::detail::failpoints::force_posix_io.store(c.posix, std::memory_order_relaxed);
+        BenchFixture f;
+        f.populate_chain_mix(200'000);
+        auto const value = make_test_value(43);
+        uint32_t next = 200'000;
+        uint32_t spent = 0;
+        uint32_t height = 3'000;
+        std::vector<utxoz::deferred_deletion_entry> batch;
+
+        bench.minEpochIterations(5).run(c.name, [&] {
+            ++height;
+            for (size_t i = 0; i < c.block_outputs; ++i) {
+                (void)f.db->insert(make_test_key(next++, 0), value, height);
+            }
+            batch.clear();
+            for (size_t i = 0; i < c.block_outputs / 2; ++i) {
+                batch.emplace_back(make_test_key(spent++, 0), height);
+            }
+            ankerl::nanobench::doNotOptimizeAway(f.db->apply_deletes(batch));
+            if ( ! f.db->sync()) throw std::runtime_error("sync failed");
+        });
+    }
+    utxoz::detail::failpoints::force_posix_io.store(false, std::memory_order_relaxed);
 }
 
 } // namespace bench
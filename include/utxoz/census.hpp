@@ -47,6 +47,9 @@
  *    are taken out. It is a subtraction, so it is where every modelling error
  *    lands. It is reported as a residual and never described as the segment
  *    manager's own overhead, which would be a claim about bytes nobody counted.
+ *  - **estimated** — only in a sampled census (`census_options::sample_fraction`):
+ *    the payload figures and the histogram of a generation that was not read
+ *    whole, computed from the entries that were, each with its interval.
  *
  * ## Concurrency and exclusivity
  *
@@ -80,12 +83,24 @@ enum class metric_status : uint8_t {
     measured,        ///< the number is the answer
     not_applicable,  ///< the question does not arise here (reference has no payload sizes)
     unavailable,     ///< it applies, and this platform or this call could not answer it
+    /// Computed from a sample of the entries: the number is the point estimate
+    /// and the interval beside it is where the answer lies, at the confidence
+    /// the report states. Only a sampled census produces it.
+    estimated,
 };
 
 [[nodiscard]] char const* to_string(metric_status) noexcept;
 
+/// Where an estimated figure lies: the confidence interval, narrowed to what
+/// the entries that were read make certain. Both ends inclusive.
+struct estimate_interval {
+    uint64_t low = 0;
+    uint64_t high = 0;
+};
+
 /// A byte count that may not exist. `bytes` is meaningless unless `status` is
-/// `measured`, and the JSON writes it as null rather than as 0 in that case.
+/// `measured` or `estimated`, and the JSON writes it as null rather than as 0 in
+/// the other cases. An estimated one has its interval in a field beside it.
 struct optional_bytes {
     uint64_t bytes = 0;
     metric_status status = metric_status::unavailable;
@@ -118,10 +133,16 @@ struct generation_census {
     uint64_t entries = 0;                    ///< map.size()
     uint64_t bucket_count = 0;               ///< map.bucket_count()
     uint64_t entry_payload_bytes = 0;        ///< full: Σ actual_size. reference: entries × sizeof(reference_value)
+    /// `estimated` when a sampled census did not read every entry, and then
+    /// `entry_payload_bytes` is the point estimate and this the interval.
+    metric_status entry_payload_status = metric_status::measured;
+    estimate_interval entry_payload_interval;
     /// full: Σ (capacity − actual_size). `not_applicable` in reference mode,
     /// where an entry is a fixed record and there is no capacity to leave unused
-    /// — which is a different statement from leaving none.
+    /// — which is a different statement from leaving none. `estimated` beside
+    /// an estimated payload, with its interval below.
     optional_bytes unused_payload_capacity;
+    estimate_interval unused_payload_capacity_interval;
     uint64_t object_padding_bytes = 0;       ///< what `sizeof` adds to a class beyond its named fields
     uint64_t segment_size_bytes = 0;         ///< managed_mapped_file::get_size()
     uint64_t segment_free_bytes = 0;         ///< get_free_memory(): never handed out by the allocator
@@ -140,6 +161,10 @@ struct generation_census {
 
     // --- platform ----------------------------------------------------------
     optional_bytes physical_allocated_bytes;
+    /// Bytes of the file in the page cache when the census reached it, before
+    /// it read them. A property of the machine at that moment, not of the
+    /// database: the next resolve, or the next census, can change it.
+    optional_bytes resident_bytes;
 
     /// Set when the modelled components came to more than the allocated bytes.
     /// Nothing is silently clamped: the flag says the decomposition does not
@@ -151,10 +176,13 @@ struct generation_census {
     }
 };
 
-/// One (payload size, count) pair. Only sizes that occur are carried.
+/// One (payload size, count) pair. Only sizes that occur are carried — in a
+/// sampled census, only sizes the sample met.
 struct payload_bucket {
     uint32_t payload_size = 0;
     uint64_t entries = 0;
+    /// Meaningful only when the histogram is `estimated`.
+    estimate_interval interval;
 };
 
 /**
@@ -177,7 +205,10 @@ struct class_census {
 
     // Sums over the generations below, in the same three kinds.
     uint64_t entry_payload_bytes = 0;
+    metric_status entry_payload_status = metric_status::measured;
+    estimate_interval entry_payload_interval;
     optional_bytes unused_payload_capacity;
+    estimate_interval unused_payload_capacity_interval;   ///< when that is `estimated`
     uint64_t object_padding_bytes = 0;
     uint64_t segment_size_bytes = 0;
     uint64_t segment_free_bytes = 0;
@@ -187,8 +218,10 @@ struct class_census {
     uint64_t estimated_group_metadata_bytes = 0;
     optional_bytes unattributed_allocated_bytes;
     optional_bytes physical_allocated_bytes;
+    optional_bytes resident_bytes;
 
-    /// Sizes that actually occur, ascending. `not_applicable` in reference mode.
+    /// Sizes that actually occur, ascending. `not_applicable` in reference mode;
+    /// `estimated` when any generation of the class was sampled.
     metric_status payload_histogram_status = metric_status::measured;
     std::vector<payload_bucket> payload_histogram;
 
@@ -231,11 +264,52 @@ struct census_options {
     bool measure_physical_blocks = true;
     /// Include the per-generation detail. The per-class sums are always there.
     bool per_generation_detail = true;
+    /// Ask the page cache how much of each file it holds: a mapping and a
+    /// `mincore()` per file, nothing read. Off by default, because it is the one
+    /// figure that differs between two censuses of the same state — the first
+    /// walk makes resident what the second then finds — and the report is
+    /// otherwise reproducible.
+    bool measure_residency = false;
+    /// Threads the walk spreads over, the calling one among them; 0 for one
+    /// per hardware thread. Each takes a whole generation at a time, so more
+    /// threads than generations is the same as as many. The report does not
+    /// depend on it: the generations are folded in walk order afterwards.
+    unsigned threads = 0;
+    /// Reuse what an earlier census found in a sealed generation whose headers
+    /// say it has not changed since, and leave a record for the next census to
+    /// reuse. Only the active generations, and the sealed ones that lost entries,
+    /// are read. Off by default: a reused generation is not re-read, so damage
+    /// done to its bytes outside the store would go unseen until it changes.
+    /// The report is the same either way, apart from `generations_reused`.
+    bool incremental = false;
+    /// Read only this fraction of each generation's entries, at least
+    /// `sample_min_entries` of them, and estimate the payload figures and the
+    /// histogram from what was read; 0 reads every entry. Entry and bucket
+    /// counts are still exact: they are in the headers. See doc/census.md.
+    double sample_fraction = 0.0;
+    /// A generation with no more entries than this is read whole, and its
+    /// figures stay `measured`.
+    uint64_t sample_min_entries = 1024;
     /// Declare that this directory is a copy taken from somewhere else. Recorded
     /// in the report as a declaration; nothing verifies it and nothing can.
     bool declared_external_snapshot = false;
 };
 
+/// How a sampled census sampled. `fraction` 0 means it did not — the option
+/// was 0 or 1, or the store is in reference mode, where there are no payload
+/// sizes to sample — and then the rest is zero.
+struct census_sampling {
+    double fraction = 0.0;
+    uint64_t min_entries = 0;
+    /// The coverage the intervals are computed for.
+    double confidence = 0.0;
+    /// Entries whose payload sizes this census read: all of a generation read
+    /// whole, the sample of one that was not, none of one whose figures came
+    /// from an incremental record — which makes it, like `generations_reused`,
+    /// a figure about the walk.
+    uint64_t entries_read = 0;
+};
+
 /**
  * @brief The whole answer, versioned so that a consumer can tell what it is
  *        reading.
@@ -256,10 +330,16 @@ struct census_report {
     uint32_t map_layout_epoch = 0;
     uint32_t hash_epoch = 0;
     uint32_t platform_abi_id = 0;
-    bool statistics_enabled = false;
+    bool statistics_enabled = false;   ///< at `basic` or above when read; see set_statistics_level()
 
     uint64_t duration_ms = 0;
     uint64_t files_examined = 0;
+    /// Of those, the ones whose entries were not read because an `incremental`
+    /// census found an earlier record that still described them. How the walk
+    /// went rather than what it found, so left out of the promise that the same
+    /// state gives the same report, like `duration_ms`.
+    uint64_t generations_reused = 0;
+    census_sampling sampling;
     uint64_t entries_examined = 0;
     allocation_method physical_measurement = allocation_method::none;
 
@@ -268,7 +348,10 @@ struct census_report {
     // Totals, summed from the classes rather than counted a second time.
     uint64_t entries = 0;
     uint64_t entry_payload_bytes = 0;
+    metric_status entry_payload_status = metric_status::measured;
+    estimate_interval entry_payload_interval;
     optional_bytes unused_payload_capacity;
+    estimate_interval unused_payload_capacity_interval;   ///< when that is `estimated`
     uint64_t object_padding_bytes = 0;
     uint64_t segment_size_bytes = 0;
     uint64_t segment_free_bytes = 0;
@@ -278,11 +361,13 @@ struct census_report {
     uint64_t estimated_group_metadata_bytes = 0;
     optional_bytes unattributed_allocated_bytes;
     optional_bytes physical_allocated_bytes;
+    optional_bytes resident_bytes;
 };
 
 /// Machine-readable. Deterministic for one state: the same database censused
-/// twice produces the same bytes, apart from `duration_ms`, which is stated to
-/// be excluded from that promise rather than quietly varying.
+/// twice produces the same bytes, apart from `duration_ms` and
+/// `generations_reused`, which are stated to be excluded from that promise
+/// rather than quietly varying.
 [[nodiscard]] std::string to_json(census_report const&);
 
 /// The same structure for a person. Generated from the report, never assembled
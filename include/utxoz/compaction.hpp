@@ -0,0 +1,246 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file compaction.hpp
+ * @brief Which generations are worth merging, and what merging them costs.
+ *
+ * `compact_all()` merges the largest run of generations that fits in one target,
+ * whatever is in them. That is the right answer when the point is the fewest
+ * files, and the wrong one on a disk that pays for every byte: a generation that
+ * is ninety per cent full has almost nothing to give up, and rewriting it moves
+ * the whole of its slot array to reclaim one file's worth of directory entry.
+ *
+ * A plan is the other way of asking. Every generation is described by what the
+ * store already knows about it — its live entries against the entries its bucket
+ * count can take without growing, which is its fill; the slot array an iteration
+ * has to walk, which is what reading it costs; and, when the lookup telemetry is
+ * compiled in, how many historical lookups had to probe it. A strategy groups
+ * the generations that are worth it, every group is priced, and the groups are
+ * taken best value first until the budget is spent.
+ *
+ * ## Estimates, and what they are estimates of
+ *
+ * Nothing here reads a file. The figures are derived from the catalogue and the
+ * capacity policy, so a plan costs nothing to produce, and they are modelled in
+ * the sense census.hpp uses the word:
+ *
+ *  - **bytes read** — the slot array and group metadata of every source. A flat
+ *    map is iterated by walking its groups, and entries are spread by their hash,
+ *    so any generation not close to empty is read in full.
+ *  - **bytes written** — the same for the target, for the same reason.
+ *  - **bytes reclaimed** — the files retired less the one published, which is
+ *    sized to the entries it will hold. This is what a merge gives back to the
+ *    filesystem.
+ *  - **probes saved** — historical probes the merged generations took over the
+ *    recorded window, less the ones the single target would have taken. Needs the
+ *    lookup telemetry; without it the figure is `unavailable`, never zero.
+ *
+ * ## What `compact()` executes
+ *
+ * Exactly the groups in the plan, through the same crash-atomic merge
+ * `compact_all()` uses, and it returns the groups it actually merged. A group
+ * the filesystem has no room for is left out of the result and the rest carry
+ * on; anything else stops the operation the way it stops `compact_all()`.
+ *
+ * `compaction_strategy::greedy` is `compact_all()`, planned. It executes through
+ * the unchanged greedy walk, and its plan is a prediction of that walk.
+ *
+ * ## Classes at once
+ *
+ * The merges of two classes share no file, no catalogue and no sidecar, so
+ * nothing orders them but the loop that used to run them one after the other.
+ * `compaction_concurrency` lets them overlap: each class is still closed, merged
+ * and reopened exactly as before, and inside a class the merges stay in order.
+ * What the classes do share is the disk, and each target is claimed against the
+ * free space before it is created, so two targets that fit only one at a time
+ * are not both started.
+ *
+ * ## Sized to fit
+ *
+ * A merge target is created at the smallest bucket step that takes all of its
+ * entries without growing, in a file scaled to that step, rather than at the
+ * size its class is configured for — unless the group takes in the active
+ * generation. Its target is then the new active generation and goes on being
+ * inserted into, so it gets the configured segment. The figures above price
+ * both.
+ *
+ * A target takes the next version number, so one fitted from sealed
+ * generations outranks the active generation. The active generation is then
+ * rewritten on its own, at the configured size, to the version after it: it
+ * stays the highest, and stays the one inserts go to. That rewrite is not a
+ * group of the plan and is not in its figures. A generation that was full when
+ * it rotated and has since been drained keeps the file it was sealed with;
+ * `refit_below` lets a plan rewrite such a generation on its own, as a group of
+ * one, into a file sized to what is left in it.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <utxoz/census.hpp>
+#include <utxoz/types.hpp>
+
+namespace utxoz {
+
+/**
+ * @brief How the generations of one class are grouped into merges.
+ *
+ * The names are borrowed from log-structured stores and mean here what they can
+ * mean for a store whose generations are fixed-size hash tables: nothing is
+ * sorted, so what differs between them is only which generations go together.
+ */
+enum class compaction_strategy : uint8_t {
+    /// The largest run that fits, whatever its fill. What `compact_all()` does.
+    greedy,
+    /// Consecutive generations below the fill threshold, cut wherever the next
+    /// one would not fit. Each generation is rewritten at most once.
+    tiered,
+    /// The fullest eligible generation first, and the emptiest ones folded into
+    /// it while they fit. Fewest and fullest targets.
+    leveled,
+    /// Smallest first, and a generation joins a group only while it is no larger
+    /// than `size_ratio` times what the group already holds. Bounds how much a
+    /// small generation can cost to absorb.
+    size_ratio,
+};
+
+[[nodiscard]] char const* to_string(compaction_strategy) noexcept;
+
+/**
+ * @brief How many classes may be merged at once, and how much they may write.
+ *
+ * The default is one thread, which is the sequential walk every earlier build
+ * ran. More threads help when several classes have something to merge; the wall
+ * time approaches that of the largest class, which is scheduled first, and never
+ * goes below it — one class is always merged by one thread.
+ *
+ * The log callback, if one is installed, is called from the worker threads when
+ * `threads` is above one.
+ */
+struct compaction_concurrency {
+    /// Classes merged at the same time. Zero is taken as one.
+    size_t threads = 1;
+
+    /// The most the merge targets in flight may occupy together, in bytes. A
+    /// target counts from its creation until it is written and synced. A merge
+    /// that would exceed the budget waits for another target to be written
+    /// rather than failing; a target larger than the whole budget runs alone.
+    /// Zero is no budget beyond the free space, which is always checked.
+    uint64_t max_bytes_in_flight = 0;
+};
+
+/// What to plan for. A struct, so that a new knob does not change call sites.
+struct compaction_options {
+    compaction_strategy strategy = compaction_strategy::tiered;
+
+    /// A generation fuller than this is never a source. Fill is live entries over
+    /// the entries its bucket count takes without growing. Ignored by `greedy`.
+    double max_source_fill = 0.80;
+
+    /// Used by `size_ratio` only.
+    double size_ratio = 2.0;
+
+    /// The most the plan may write, summed over its groups. Zero is no budget.
+    /// Groups are taken best value first, so a budget drops the worst ones.
+    uint64_t max_bytes_written = 0;
+
+    /// What one saved historical probe is worth, in bytes of merge I/O. One page
+    /// by default: a probe into a generation that is not resident is a fault.
+    uint64_t probe_weight_bytes = 4096;
+
+    /// A generation no group takes, at or below this fill, is rewritten on its
+    /// own when the file that would replace it is smaller. Never the active
+    /// generation. Zero, the default, rewrites nothing alone. Ignored by `greedy`.
+    double refit_below = 0.0;
+
+    /// How `compact()` runs the classes it has groups for. Ignored by the dry run.
+    compaction_concurrency concurrency;
+};
+
+/// One merge: which generations, and what it is expected to cost and return.
+struct compaction_group {
+    /// The class, or `reference_class` in reference mode.
+    uint64_t container_class = 0;
+    std::vector<uint64_t> sources;      ///< generations, ascending; one is a refit
+
+    uint64_t entries = 0;               ///< what the target will hold
+    double source_fill = 0.0;           ///< mean fill of the sources
+    double target_fill = 0.0;           ///< fill of the target
+
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t bytes_reclaimed = 0;
+
+    uint64_t probes_saved = 0;
+    metric_status probes_saved_status = metric_status::unavailable;
+
+    /// (reclaimed + probe_weight × probes saved) / (read + written). What the
+    /// groups are ranked by; comparable across classes.
+    double score = 0.0;
+};
+
+/**
+ * @brief The groups, in the order they would be merged, and their totals.
+ *
+ * Produced by `plan_compaction()` without touching a file, and returned by
+ * `compact()` describing what was merged.
+ */
+struct compaction_plan {
+    compaction_strategy strategy = compaction_strategy::tiered;
+    std::vector<compaction_group> groups;
+
+    uint64_t generations_considered = 0;
+    uint64_t generations_too_full = 0;     ///< above `max_source_fill`
+    uint64_t generations_unknown = 0;      ///< no metadata, so no fill: never a source
+    uint64_t groups_over_budget = 0;       ///< planned, then dropped by the budget
+
+    // Summed from `groups`.
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t bytes_reclaimed = 0;
+    uint64_t files_removed = 0;
+};
+
+/// Machine-readable, in the same register as the census report.
+[[nodiscard]] std::string to_json(compaction_plan const&);
+
+/**
+ * @brief When an active generation is worth rebuilding.
+ *
+ * A merge reads the generations below the active one. The active one is only
+ * replaced when it rotates, and on a workload that erases about as much as it
+ * inserts that can take a long time — while every erase that left an overflow
+ * bit behind lowers the point at which Boost would grow the map, which is how
+ * it keeps probe sequences from lengthening. The distance that point has
+ * moved is the drift: the share of the map's probe budget spent on entries that
+ * are no longer there. A rebuild rehashes the survivors into a new generation at
+ * the configured size, which starts with no drift.
+ */
+struct rebuild_options {
+    /// Rebuild a class whose drift is at least this fraction of its growth
+    /// point. Zero rebuilds every class; one or more rebuilds none.
+    double min_drift = 0.10;
+};
+
+/// One class's active generation, as `rebuild_active()` found it.
+struct active_rebuild {
+    /// The class, or `reference_class` in reference mode.
+    uint64_t container_class = 0;
+    uint64_t version = 0;           ///< the active generation it found
+    uint64_t rebuilt_as = 0;        ///< the generation that replaced it, if rebuilt
+
+    uint64_t entries = 0;
+    uint64_t bucket_count = 0;
+    uint64_t growth_point = 0;      ///< where a fresh map of this size grows
+    uint64_t live_max_load = 0;     ///< where this one grows now
+    double drift = 0.0;             ///< (growth_point − live_max_load) / growth_point
+
+    bool rebuilt = false;
+};
+
+} // namespace utxoz
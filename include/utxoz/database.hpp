@@ -10,6 +10,7 @@
 #pragma once
 
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <optional>
 #include <string_view>
@@ -17,8 +18,10 @@
 
 #include <utxoz/aliases.hpp>
 #include <utxoz/census.hpp>
+#include <utxoz/compaction.hpp>
 #include <utxoz/uniqueness.hpp>
 #include <utxoz/statistics.hpp>
+#include <utxoz/trace.hpp>
 #include <utxoz/types.hpp>
 
 namespace utxoz {
@@ -27,6 +30,8 @@ namespace detail {
 struct database_impl;
 } // namespace detail
 
+class full_snapshot;
+
 /**
  * @page utxoz_path_contract Database paths
  *
@@ -158,6 +163,47 @@ struct deletion_progress {
     std::optional<error_code> error;                  ///< Why, when something stopped it
 };
 
+/**
+ * @brief One insert a caller wants made, as part of a batch.
+ *
+ * `value` is borrowed, like the span `insert()` takes: it has to stay valid for
+ * the duration of the call, and nothing holds it afterwards — including an entry
+ * handed back in `insertion_progress::unapplied`, which points at the caller's
+ * bytes, not at a copy.
+ */
+struct insert_request {
+    raw_outpoint key;        ///< UTXO key to store
+    output_data_span value;  ///< The output's bytes; borrowed
+    uint32_t height;         ///< Block height where the output was created
+};
+
+/**
+ * @brief What a batch of inserts actually did.
+ *
+ * Every request lands in exactly one of three places, and they are separate for
+ * the same reason as `deletion_progress`'s lists: a batch is applied in parts
+ * that run side by side and stop independently — the size classes of one
+ * database, or the shards of a `sharded_db` — so a failure in one part leaves
+ * the others' inserts made, and a `result<>` would hide those behind the error.
+ *
+ *  - `inserted`   — how many requests stored a new entry.
+ *  - `duplicates` — requests whose key was already stored, which `insert()`
+ *                   answers with `false`. Nothing was written for them.
+ *  - `unapplied`  — requests that failed, and the ones after them that the same
+ *                   part never attempted. The only category that may be resent.
+ *
+ * Unlike deletions, the batch is not deduplicated: a key named twice is one
+ * insert and one duplicate, exactly as two calls to `insert()` would be. Both
+ * lists are in the order of the span, so a caller resending `unapplied` resends
+ * it in the order it was first asked for.
+ */
+struct insertion_progress {
+    size_t inserted = 0;                     ///< New entries stored during this call
+    std::vector<insert_request> duplicates;  ///< Already stored; nothing written
+    std::vector<insert_request> unapplied;   ///< Not completed; resend these
+    std::optional<error_code> error;         ///< Why, when something stopped a part
+};
+
 /**
  * @brief Base class with methods common to both storage modes.
  *
@@ -165,8 +211,16 @@ struct deletion_progress {
  *
  * @par Threading
  * A database instance supports ONE mutating operation at a time, with no other
- * operation of any kind in flight. Mutating means insert(), apply_deletes(),
- * compact_all() and close(). Serialising those is the caller's job.
+ * operation in flight but the reads listed below. Mutating means insert(),
+ * insert_batch(), apply_deletes(), compact_all(), snapshot() and close().
+ * Serialising those is the caller's job.
+ *
+ * One operation can still use several threads. insert_batch(), and the
+ * active-version phase of apply_deletes(), run each size class on a thread of
+ * the library's: the classes share no map, segment or catalogue, and what they
+ * do share — the entry count, the record of files owing a barrier — is atomic
+ * or locked. That is parallelism inside the operation, not a relaxation of the
+ * rule above; the call returns only once every class is done.
  *
  * The read path is different, and only the read path:
  *
@@ -184,28 +238,54 @@ struct deletion_progress {
  *   the active containers, which are separate mappings. Demonstrated rather than
  *   assumed — see the ThreadSanitizer cases in tests/test_lookup_ownership.cpp,
  *   which run both pairings with no lock of the caller's.
+ * - **find() may run alongside insert(), insert_batch() and apply_deletes().**
+ *   An emplace or an erase takes no lock: it bumps its class's write counter
+ *   before and after, and find() copies the entry out and keeps the copy only
+ *   if the counter did not move, reading again if it did. So the writer never
+ *   waits for a lookup, and a lookup waits for an entry, never for a block. The
+ *   one lock is the library's, around the active map pointers: find() holds it
+ *   shared, and a rotation takes it to retire a map and unmaps it only once no
+ *   reader is inside. A find() that lands between the two generations answers
+ *   `not_resolved`, as it would have a moment later. The caller's writer still
+ *   has to be one thread: this admits readers, not a second writer. The class
+ *   threads of a batch are not a second writer either — each writes a different
+ *   map under a different counter.
+ * - **A full_snapshot may be read alongside anything.** It reads generations
+ *   it mapped itself, which nothing but a deletion still writes to, and that
+ *   deletion takes the snapshot's lock for one entry. See snapshot.hpp. Taking
+ *   one is not on this list: full_db::snapshot() rotates, and is an operation.
+ *
+ * apply_deletes() is a writer like insert(), and find() is the only read it
+ * admits. Its erases from the active containers are covered the way an
+ * insert's emplaces are, but it also writes through the cache's mappings into
+ * older versions, so it still needs exclusion from resolve(), compaction and
+ * close(). The resolve lock does not extend to it — that lock serialises
+ * resolutions against each other and knows nothing about a deletion writing
+ * through the same segments.
+ *
+ * That is the whole of it. The locks and counters cover resolve-vs-resolve and
+ * find-vs-write; they do not make the database thread-safe. Nothing above
+ * permits running resolve() concurrently with insert(), a deletion,
+ * compaction, close(), or anything else that mutates the maps or writes through
+ * the cache's mappings — apply_deletes() writes through the very mappings a
+ * resolution reads — nor find() with compaction or close().
+ *
+ * sync_async() is an operation like sync(), made from the caller's thread under
+ * the same rule. The flusher it starts owns a thread of its own, but it is handed
+ * paths, not mappings, and touches nothing the caller's operations do; waiting
+ * on its futures is safe from any thread.
  *
- * apply_deletes() is on neither list. It mutates: it erases from the active
- * containers and writes through the cache's mappings, so it needs exclusion from
- * resolve(), find(), insert(), compaction and close() alike. The resolve lock
- * does not extend to it — that lock serialises resolutions against each other
- * and knows nothing about a deletion writing through the same segments.
- *
- * That is the whole of it. The lock covers resolve-vs-resolve; it does not make
- * the database thread-safe. Nothing above permits running either read
- * concurrently with insert(), a deletion, compaction, close(), or anything else
- * that mutates the active maps or writes through the cache's mappings — a
- * rotation inside insert() unmaps the active segment outright, and
- * apply_deletes() writes through the very mappings a resolution reads.
- *
- * Statistics are operations too, not free reads. get_statistics() is not const
- * — it recomputes the fragmentation counters as it goes — and
- * reset_search_stats() / reset_all_statistics() write by definition; the const
- * accessors read plain counters that insert() and apply_deletes() write. All of them
- * may overlap with find(), which writes nothing they look at beyond its own
- * sharded counters, but not with any mutation, and get_statistics() and the
- * reset calls not with each other either. A summary taken while find() is
- * recording is also not consistent across fields; see probe_stats.
+ * Statistics are operations too, not free reads, with the exceptions below.
+ * reset_search_stats() / reset_all_statistics() write by definition; the other
+ * accessors read plain counters that insert() and apply_deletes() write. All of
+ * them may overlap with find(), which writes nothing they look at beyond its own
+ * sharded counters, but not with any mutation, and not with the reset calls
+ * either. A summary taken while find() is recording is also not consistent
+ * across fields; see probe_stats. The exceptions are get_stats_snapshot() and
+ * get_latency_snapshot(), which read only what is published for other threads
+ * and may be called from any thread at any time, set_statistics_level() /
+ * get_statistics_level(), which touch one atomic and nothing else, and the
+ * tracing calls, which touch the trace ring and its lock and nothing else.
  *
  * The restriction on everything else is structural, not incidental:
  * - The LRU file cache has no synchronisation of its own, and it owns the memory
@@ -217,10 +297,10 @@ struct deletion_progress {
  *   exclude.
  * - The entry count, the per-container statistics and the file metadata are
  *   plain members mutated without atomics.
- * - A rotation (triggered from inside insert()) unmaps the whole active segment
- *   and briefly leaves the container pointer null. A concurrent find() would be
- *   reading unmapped memory — which is why "no mutation in flight" is a
- *   condition of the exception above, not a nicety.
+ * - Compaction and close() unmap and replace the active segments as part of a
+ *   sequence the locks do not span: the files under a map change, not only the
+ *   pointer to it. The locks cover what insert() and apply_deletes() do to the
+ *   active maps, the rotation included, and nothing else.
  *
  * @par Ownership
  * Neither lookups nor deletions have an ownership rule any more, because neither
@@ -279,12 +359,24 @@ struct db_base {
      * why progress is returned rather than an error: the applied part is
      * enumerated in `erased`, exactly, including on the failure path.
      *
+     * In full mode, a batch of at least `min_parallel_batch` distinct keys has
+     * the active versions searched by one thread per size class: a deletion
+     * names a key and not its class, so every class looks for every key, and the
+     * classes share nothing they write. The older versions are still walked on
+     * the calling thread — they are reached through the file cache, which every
+     * class shares and which unmaps what it evicts.
+     *
      * @param requests The caller's batch; borrowed for the duration of the call
      * @return What was applied, what is proven absent, and what is still owed
      */
     [[nodiscard]]
     deletion_progress apply_deletes(std::span<deferred_deletion_entry const> requests);
 
+    /// The smallest batch full_db::insert_batch() and apply_deletes() spread
+    /// over the size classes. Smaller ones run on the calling thread: below
+    /// this, starting the threads costs more than they save.
+    static constexpr size_t min_parallel_batch = 1024;
+
     /**
      * @brief Compact all containers
      */
@@ -308,10 +400,61 @@ struct db_base {
      * positions. Do not assume the files run 0..n, and do not derive a file
      * count from the highest version.
      *
+     * @note With `concurrency.threads` above one, the classes are merged on that
+     * many threads, largest first. Each class is still merged as it would be on
+     * its own; a failure in one stops any class not yet started, and the result
+     * is the failure of the lowest-numbered class that failed. See
+     * compaction_concurrency.
+     *
      * @return empty on success, error otherwise
      */
     [[nodiscard]]
-    result<> compact_all();
+    result<> compact_all(compaction_concurrency const& concurrency = {});
+
+    /**
+     * @brief Which generations a compaction would merge, and what it would cost.
+     *
+     * The dry run. Groups the generations of every class by `options.strategy`,
+     * prices each group in bytes read, written and reclaimed and in historical
+     * probes saved, and ranks them — without opening, reading or creating a file.
+     * See compaction.hpp for what each figure is an estimate of.
+     *
+     * Refused on an instance that is latched or opened for inspection, like
+     * `compact_all()`: a plan is only worth having for a database that could
+     * execute it.
+     */
+    [[nodiscard]]
+    result<compaction_plan> plan_compaction(compaction_options const& options = {}) const;
+
+    /**
+     * @brief Merges the groups `plan_compaction(options)` would choose.
+     *
+     * The same crash-atomic merge `compact_all()` uses, the same refusals, and the
+     * same treatment of a duplicate key. A planned group the filesystem has no room
+     * for is skipped and the rest are merged; the result lists only the groups
+     * that were.
+     *
+     * With `compaction_strategy::greedy` this is `compact_all()`, and the result is
+     * the plan it was predicted to follow.
+     */
+    [[nodiscard]]
+    result<compaction_plan> compact(compaction_options const& options = {});
+
+    /**
+     * @brief Rehashes each active generation whose growth point has drifted,
+     *        into a fresh one at the configured size.
+     *
+     * The active generation is closed, its entries are written into a new
+     * generation through the same crash-atomic merge compaction uses, and the
+     * new one is opened as the active generation in its place. Classes below
+     * `options.min_drift` are described and left alone. See rebuild_options.
+     *
+     * The result has one record per class, in class order, whether it was
+     * rebuilt or not. Refused like `compact_all()`, and a failure in one class
+     * stops the classes after it.
+     */
+    [[nodiscard]]
+    result<std::vector<active_rebuild>> rebuild_active(rebuild_options const& options = {});
 
     /**
      * @brief Puts everything written so far on stable storage.
@@ -336,6 +479,15 @@ struct db_base {
      * handles — so a barrier per record would buy nothing usable. What this
      * promises is that the entries are there.
      *
+     * @par Cost
+     * Proportional to what was written since the last successful sync, not to
+     * the size of the files. Where the file barrier reaches the pages of a
+     * mapping, as it does on Linux, the page barrier is asked for over the
+     * pages the writer noted and nothing else. Everywhere else it still covers
+     * each active mapping whole. The file barriers are handed over as one batch;
+     * built with `UTXOZ_IO_URING` on a kernel that allows it, they are submitted
+     * to the device together rather than one `fsync` at a time.
+     *
      * @par Retrying
      * A failure discharges nothing: every barrier this call owed is still owed
      * afterwards, so calling again is well defined and attempts all of them —
@@ -373,6 +525,31 @@ struct db_base {
     [[nodiscard]]
     result<> sync();
 
+    /**
+     * @brief Asks for what sync() does, without waiting for it.
+     *
+     * The files owed are taken now, on this thread, and a background flusher
+     * crosses their barriers; the future completes with what sync() would have
+     * returned for them. Writes made after this call are not covered by it.
+     *
+     * Requests that arrive while the flusher is busy are served together by its
+     * next round — one barrier per file and one for the directory, however many
+     * requests it answers — so a caller asking once per block pays for as many
+     * rounds as the device can keep up with, not one per block. How well that is
+     * going is in `database_statistics::group_commit`.
+     *
+     * The obligations are those of sync(). A round that fails discharges
+     * nothing, and every request it answered gets the failure; the next sync()
+     * or sync_async() attempts all of it again. Where the file barrier does not
+     * reach a mapping's pages (see sync()), the page barrier is crossed before
+     * this returns, and its failure is the future's.
+     *
+     * close() waits for every request already made. A closed database returns a
+     * future that is already complete, with error_code::closed.
+     */
+    [[nodiscard]]
+    std::shared_future<result<>> sync_async();
+
     /**
      * @brief Iterate over all keys in the database
      *
@@ -391,8 +568,11 @@ struct db_base {
      *
      * Not a statistic: the counters in `get_statistics()` describe what this
      * process did since it opened the database, and this describes what is in it.
-     * The cost is a full pass over every generation of every class, and the
-     * report says how long it took and how much it read.
+     * The cost is a full pass over every generation of every class, spread
+     * over `census_options::threads` a generation at a time, and the report
+     * says how long it took and how much it read. An `incremental` census reads
+     * only the generations that changed since the last one, and a sampled one
+     * only part of each and estimates the payload figures; see doc/census.md.
      *
      * `const` is a statement about this object and not about safety. It requires
      * the exclusive directory claim and no concurrent mutation. See census.hpp.
@@ -430,13 +610,100 @@ struct db_base {
         verify_options const& options = {}) const;
 
     // Statistics
-    [[nodiscard]] database_statistics get_statistics();
+    [[nodiscard]] database_statistics get_statistics() const;
     void print_statistics();
     [[nodiscard]] sizing_report get_sizing_report() const;
     void print_sizing_report() const;
     void print_height_range_stats() const;
     void reset_all_statistics();
     void reset_search_stats();  ///< Clears the probe and resolution counters
+
+    /**
+     * How much is counted from the next operation on, up to what the build
+     * carries: `lookup` in a `basic` build runs at `basic`, and everything in
+     * an `off` build runs at `off`. Returns the level now running. An instance
+     * starts at compiled_statistics_level.
+     *
+     * Safe from any thread at any time, like get_statistics_level(). An
+     * operation reads the level once as it starts — a batch once for the whole
+     * batch, a find() or insert() once for its key — and finishes at that level,
+     * so switching during a block splits nothing. Switched down, the counters
+     * keep what they hold and stop moving; switched back up, they carry on from
+     * there, and what happened in between is in none of them. Sizes are not
+     * events and are kept at every level: get_stats_snapshot() and the
+     * `current_size` of each class stay exact. Reset the counters after
+     * switching up for figures that cover one uninterrupted stretch.
+     *
+     * Off at run time costs a relaxed load and a branch that always goes the
+     * same way per call or per batch; benchmarks/bench_statistics_switch.cpp
+     * measures that against the build with statistics compiled out.
+     */
+    statistics_level set_statistics_level(statistics_level level) noexcept;
+    [[nodiscard]] statistics_level get_statistics_level() const noexcept;
+
+    /**
+     * Latency per operation and per class, copied out: insert, find, resolve,
+     * apply_deletes, rotation and merge, as log-bucketed histograms. `insert`
+     * and `find` are sampled one call in `latency_sample_interval`; the rest are
+     * timed every time. See latency_stats.
+     *
+     * Cheap — a pass over fixed storage, no allocation beyond the result — and,
+     * unlike get_statistics(), safe alongside any operation, because every
+     * bucket is an atomic and nothing else is read. Empty with statistics off.
+     * `to_json()` writes it out.
+     */
+    [[nodiscard]] latency_snapshot get_latency_snapshot() const;
+    void reset_latency_stats();  ///< Clears the latency histograms; reset_all_statistics() does too
+
+    /**
+     * The sizes of every class, as the last completed operation left them:
+     * entries and bytes of the active generation, sealed generations and their
+     * bytes, and inserts, deletes and rotations since open. See stats_snapshot.
+     *
+     * Constant time, and safe from any thread at any time — during an insert,
+     * during apply_deletes() — because the writer publishes these at the end of
+     * each operation and this reads only what was published, retrying if it
+     * lands on a publication. Counted in every build. A closed database keeps
+     * returning what it last published; one never opened returns zeros.
+     */
+    [[nodiscard]] stats_snapshot get_stats_snapshot() const;
+
+    /**
+     * The counters of get_statistics() without the copies it makes: no
+     * value-size and depth distributions and no cached file list, which are
+     * left empty. Everything else is as get_statistics() has it, sizes and fill
+     * included, which both take from get_stats_snapshot().
+     *
+     * Const, and under the same rule as the other const accessors: it may
+     * overlap find(), not a mutation.
+     */
+    [[nodiscard]] database_statistics get_counter_statistics() const;
+
+    /**
+     * Starts recording spans for rotations, merges and their phases, syncs and
+     * their barriers, group commit rounds, version files mapped and unmapped,
+     * and resolutions of at least `options.resolve_threshold` keys. See
+     * trace.hpp for what each carries.
+     *
+     * Starting again starts over, with the new options, dropping what was not
+     * drained. The merge recovery the open ran, before there was a handle to
+     * call this on, is kept until then and is the first event recorded.
+     *
+     * Off, the default, costs a relaxed load at each of those sites and nothing
+     * else; on, two clock reads and an uncontended lock per span. Safe from any
+     * thread at any time, as stop_tracing() and drain_trace() are. Independent
+     * of the statistics level.
+     */
+    void start_tracing(trace_options const& options = {});
+    /// Stops recording; what is held stays for drain_trace().
+    void stop_tracing() noexcept;
+    /// Everything recorded since the previous drain, oldest first, and how many
+    /// events a full ring overwrote. `to_chrome_trace()` writes it out.
+    [[nodiscard]] trace_capture drain_trace();
+
+    /// get_counter_statistics() and get_latency_snapshot() as OpenMetrics text.
+    /// Cheap enough for a scrape every few seconds. See utxoz::to_openmetrics().
+    [[nodiscard]] std::string to_openmetrics() const;
     [[nodiscard]] float get_cache_hit_rate() const;
     [[nodiscard]] std::vector<std::pair<size_t, size_t>> get_cached_file_info() const;
 
@@ -530,6 +797,28 @@ struct full_db : db_base {
     [[nodiscard]]
     result<bool> insert(raw_outpoint const& key, output_data_span value, uint32_t height);
 
+    /**
+     * @brief Many inserts, every size class's share applied on its own thread.
+     *
+     * A value's size decides its class, and the classes share no map, segment,
+     * catalogue or counter an insert writes — so a batch is split by class and
+     * the classes are filled side by side, rotations included. Inside a class the
+     * requests are made in the order of the span, which makes the outcome for any
+     * one key — inserted, or a duplicate — the one the same requests made through
+     * insert() one at a time would have had.
+     *
+     * A class stops at its first failure and the others carry on; see
+     * insertion_progress for how that is reported. A value too large for any
+     * class fails on its own, as insert() would, and stops nothing.
+     *
+     * A batch smaller than `min_parallel_batch` is applied on the calling thread.
+     *
+     * This is one mutating operation, under the rule on db_base: nothing else
+     * may run alongside it but find(). The threads are the library's own.
+     */
+    [[nodiscard]]
+    insertion_progress insert_batch(std::span<insert_request const> requests);
+
     /**
      * @brief Find a UTXO by key, in the active versions only
      *
@@ -648,6 +937,26 @@ struct full_db : db_base {
     [[nodiscard]]
     result<full_resolution> resolve(std::span<lookup_request const> requests) const;
 
+    /**
+     * @brief A fixed view of everything stored now, readable while writes go on.
+     *
+     * Seals the active generation of every class that holds anything and pins
+     * every sealed generation until the handle is dropped: compaction leaves
+     * them alone, and a deletion that reaches one copies the entry into the
+     * snapshot first. See snapshot.hpp, which defines the handle.
+     *
+     * A mutating operation under the rule above, made from the writer's thread
+     * — the seal is a rotation, and one that cannot make its file latches the
+     * instance as any rotation does. The handle it returns may be read from any
+     * thread while the writer carries on.
+     *
+     * @return The snapshot; `version_unreadable` when a generation to pin could
+     *         not be mapped, in which case nothing is pinned; the refusals of
+     *         every operation on a closed, latched or inspection-only instance.
+     */
+    [[nodiscard]]
+    result<full_snapshot> snapshot();
+
     /**
      * @brief Iterate over all entries (key + value) in the database
      *
@@ -0,0 +1,144 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file reader.hpp
+ * @brief Read-only access to a full-mode database another process is writing.
+ *
+ * A database admits one instance, and that instance claims the directory: an
+ * indexer or a wallet server running beside the node cannot open the set at all
+ * while the node has it, and the usual answer is a second copy kept up to date
+ * by hand. A `full_reader` is the other answer. It opens the same directory
+ * without the claim, maps its files read-only, and answers lookups while the
+ * writer carries on.
+ *
+ * ## What it follows
+ *
+ * A full-mode writer keeps `utxoz_readers.dat` beside the data: the generation
+ * files of every class, republished each time the set of files changes — a
+ * rotation, a merge, an open — and a counter per class that moves around each
+ * change to a map. A reader maps whatever the list names, drops what it no
+ * longer names, and keeps an answer only if the class's counter did not move
+ * while it was being read. See the internal reader_board.hpp for the protocol.
+ *
+ * So an answer is always one the writer's own state gave at some instant during
+ * the call. Two calls may see two different instants, and a resolve() of many
+ * keys is many instants, one per key: a reader is a live view, not a
+ * full_snapshot.
+ *
+ * ## Who waits for whom
+ *
+ * Nobody waits for a reader. The writer stores two integers around each emplace
+ * and erase whether or not one is open, and holds nothing a reader could hold
+ * up. A reader that lands on a change retries; one that keeps landing on an
+ * unfinished change for a second reports `reader_stalled`, which is a writer
+ * that died inside one — the next writer to open clears it.
+ *
+ * A reader can be opened while no writer is running, and keeps working after
+ * the writer closes: the files it maps stay as the writer left them.
+ *
+ * ## Limits
+ *
+ * Full mode only. The directory has to have been opened by a writer from a
+ * build that publishes the board; until then there is nothing to follow, and
+ * open() says `database_not_found`. A class with more generations than the
+ * board can list is refused with `catalog_unreadable` until compaction brings
+ * it back under.
+ *
+ * @par Threading
+ * One thread at a time per reader: a call may remap files. Open one per thread
+ * that reads; they share nothing and cost one mapping of each generation each.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include <utxoz/database.hpp>
+#include <utxoz/types.hpp>
+
+namespace utxoz {
+
+namespace detail {
+struct reader_impl;
+} // namespace detail
+
+/**
+ * @brief Read-only, claim-free view of a full-mode database.
+ *
+ * Create via full_reader::open().
+ */
+class full_reader {
+public:
+    ~full_reader();
+
+    full_reader(full_reader const&) = delete;
+    full_reader& operator=(full_reader const&) = delete;
+    full_reader(full_reader&&) noexcept;
+    full_reader& operator=(full_reader&&) noexcept;
+
+    /**
+     * @brief Opens `path` for reading, alongside whatever instance owns it.
+     *
+     * Creates nothing and takes no claim. The config is read and held to this
+     * build as an ordinary open holds it, so a reader refuses what the writer
+     * would refuse.
+     *
+     * @return The reader; `database_not_found` for a directory with no database,
+     *         or none a writer has published a board for; `storage_mode_mismatch`
+     *         for a reference-mode database; or what reading the config or
+     *         mapping a listed generation failed with.
+     */
+    [[nodiscard]]
+    static result<full_reader> open(std::filesystem::path path);
+
+    /// Unmaps everything. Every later call answers `closed`.
+    void close();
+
+    /**
+     * @brief A key, looked up in every generation the writer currently lists.
+     *
+     * The whole answer, like full_snapshot::find(): `not_found` is proven
+     * absence as of the instant it was read. Follows the writer's latest layout
+     * first, so a key it has just rotated or merged is found where it now is.
+     */
+    [[nodiscard]]
+    result<full_find_result> find(raw_outpoint const& key);
+
+    /**
+     * @brief full_db::resolve()'s contract, answered key by key.
+     *
+     * Duplicate keys collapse keeping the first occurrence. Any error stops the
+     * call and is returned alone, with no lists.
+     */
+    [[nodiscard]]
+    result<full_resolution> resolve(std::span<lookup_request const> requests);
+
+    /**
+     * @brief Follows the writer's latest layout now.
+     *
+     * find() and resolve() do this themselves; it is here for a caller that
+     * would rather pay for the mapping before its first lookup than during it.
+     */
+    [[nodiscard]]
+    result<> refresh();
+
+    /// Generations mapped, across every class.
+    [[nodiscard]] size_t generations() const noexcept;
+
+    /// The writer's layout counter, as of the layout last followed. Moves by two
+    /// for every publication.
+    [[nodiscard]] uint64_t layout() const noexcept;
+
+private:
+    full_reader();
+
+    std::unique_ptr<detail::reader_impl> impl_;
+};
+
+} // namespace utxoz
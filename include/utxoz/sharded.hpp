@@ -0,0 +1,207 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file sharded.hpp
+ * @brief Several independent full-mode databases behind one, partitioned by key.
+ *
+ * One database admits one mutating operation at a time, so everything an
+ * initial block download asks of it — the block's new outputs, then its spends —
+ * runs on one core however many the machine has. The constraint is the
+ * instance's, not the data's: two outpoints that never meet in a map, a
+ * generation or a catalogue have no reason to wait for each other.
+ *
+ * `sharded_db` gives every outpoint one home out of N, chosen by a fixed
+ * function of its bytes, and keeps N complete databases — each with its own
+ * directory, claim, catalogues and active segments. A batch is split by shard,
+ * each part goes to its own database on its own thread, and the answers are put
+ * back together under the same contracts a single database gives. Nothing about
+ * any one shard is new: it is a `full_db`, opened the usual way, and every
+ * guarantee on `full_db` holds for it.
+ *
+ * ## Layout
+ *
+ * ```
+ * <root>/.utxoz.lock        the claim on the whole set
+ * <root>/utxoz_shards.dat   the shard count, fixed at creation
+ * <root>/shard_00/          a full_db
+ * <root>/shard_01/          a full_db
+ * ...
+ * ```
+ *
+ * The count is recorded before the first shard is created and is never
+ * rewritten. A reopen that names a different count is refused with
+ * `shard_count_mismatch` rather than followed: under another count every key
+ * hashes somewhere else, and a lookup in the wrong shard does not fail — it
+ * answers "absent", which is worse.
+ *
+ * ## What the partition costs
+ *
+ * A batch is read once to split it, and the split is copied: a `resolve()` or
+ * `apply_deletes()` handed N keys builds N requests' worth of per-shard lists
+ * before any shard sees one. Threads are started per batch, one fewer than the
+ * shards that have work — the calling thread is one of them — so a batch of a
+ * handful of keys pays a thread start it cannot earn back, and belongs on the
+ * single-key calls instead.
+ *
+ * The shards share the disk. Scaling is what the cores can give until the
+ * device is the limit; past that, more shards are more files for the same
+ * bandwidth.
+ *
+ * ## Full mode only
+ *
+ * There is no sharded reference mode. Its values are twelve bytes, an insert is
+ * a hash and a store, and the work a shard would take off the writer's thread
+ * is smaller than what it costs to hand it over.
+ *
+ * @par Threading
+ * The same rule as one database, applied to the set: one mutating operation at
+ * a time, made by the caller. What the set adds is inside each operation, and
+ * every shard still sees exactly one thread at a time.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <utxoz/compaction.hpp>
+#include <utxoz/database.hpp>
+#include <utxoz/types.hpp>
+
+namespace utxoz {
+
+namespace detail {
+struct sharded_impl;
+} // namespace detail
+
+/**
+ * @brief Full-mode UTXO database partitioned across independent shards.
+ *
+ * Create via sharded_db::open() or sharded_db::open_for_testing().
+ */
+class sharded_db {
+public:
+    /// The most shards a set can have. The directory names have two digits,
+    /// and far more shards than cores buys nothing.
+    static constexpr size_t max_shards = 64;
+
+    ~sharded_db();
+
+    sharded_db(sharded_db const&) = delete;
+    sharded_db& operator=(sharded_db const&) = delete;
+    sharded_db(sharded_db&&) noexcept;
+    sharded_db& operator=(sharded_db&&) noexcept;
+
+    /**
+     * @brief Open or create a sharded database.
+     *
+     * @param path Root directory of the set. See @ref utxoz_path_contract.
+     * @param shards How many shards, 1 through max_shards. Fixed at creation;
+     *        a reopen has to name the same number.
+     * @param remove_existing If true, remove everything under the root first.
+     * @return The set, or `shard_count_mismatch` for a count it was not created
+     *         with or cannot have, `database_in_use` when another instance holds
+     *         it, or whatever opening one of the shards failed with.
+     */
+    [[nodiscard]]
+    static result<sharded_db> open(std::filesystem::path path, size_t shards,
+                                   bool remove_existing = false);
+
+    /// open(), with every shard opened for testing — the small file sizes.
+    [[nodiscard]]
+    static result<sharded_db> open_for_testing(std::filesystem::path path, size_t shards,
+                                               bool remove_existing = false);
+
+    /**
+     * @brief The shard `key` lives in, out of `shards`.
+     *
+     * Part of the on-disk format: a set's contents are only findable under the
+     * function that placed them. It reads txid bytes 8 to 15 and the output
+     * index, not the first eight bytes the maps hash, so the partition and the
+     * placement inside a shard's map do not draw on the same bits.
+     */
+    [[nodiscard]]
+    static size_t shard_of(raw_outpoint const& key, size_t shards) noexcept;
+
+    [[nodiscard]] size_t shard_count() const noexcept;
+
+    /// One shard, for what the set does not forward: statistics, a census, a
+    /// compaction plan. Mutating it directly is allowed and is the caller's to
+    /// serialise with the set's own operations.
+    [[nodiscard]] full_db& shard(size_t index);
+    [[nodiscard]] full_db const& shard(size_t index) const;
+
+    /// Closes every shard and releases the claim on the set.
+    void close();
+
+    /// Entries across every shard.
+    [[nodiscard]] size_t size() const;
+
+    /// full_db::insert(), in the key's shard.
+    [[nodiscard]]
+    result<bool> insert(raw_outpoint const& key, output_data_span value, uint32_t height);
+
+    /**
+     * @brief Many inserts, every shard's share applied on its own thread.
+     *
+     * Inside a shard the requests are made in the order of the span, so the
+     * outcome for any one key — inserted, or a duplicate — is the one the same
+     * requests made one at a time would have had. A shard stops at its first
+     * failure; the others carry on.
+     */
+    [[nodiscard]]
+    insertion_progress insert_batch(std::span<insert_request const> requests);
+
+    /// full_db::find(), in the key's shard. The same warning applies:
+    /// `not_resolved` is not absence.
+    [[nodiscard]]
+    result<full_find_result> find(raw_outpoint const& key, uint32_t height) const;
+
+    /**
+     * @brief full_db::resolve(), every shard's share on its own thread.
+     *
+     * The same contract, over the whole set. A key lives in one shard, so each
+     * distinct key is answered once; and if any shard could not cover its share
+     * the call returns that shard's error and no lists at all — the lowest
+     * numbered one, when several fail.
+     */
+    [[nodiscard]]
+    result<full_resolution> resolve(std::span<lookup_request const> requests) const;
+
+    /**
+     * @brief full_db::apply_deletes(), every shard's share on its own thread.
+     *
+     * The lists are each shard's put together, so the partition over distinct
+     * keys holds for the set exactly as it does for one database. `error` is the
+     * lowest numbered failing shard's; the other shards' deletions are applied
+     * and reported all the same.
+     */
+    [[nodiscard]]
+    deletion_progress apply_deletes(std::span<deferred_deletion_entry const> requests);
+
+    /// full_db::sync() on every shard at once. The file barriers of different
+    /// shards wait on the device independently, so they overlap. Fails with the
+    /// lowest numbered failing shard's error; every shard is asked regardless.
+    [[nodiscard]]
+    result<> sync();
+
+    /// full_db::compact_all() on each shard in turn. Each one already spreads its
+    /// classes over `concurrency.threads`, so running shards side by side as well
+    /// would only multiply what is in flight against one disk.
+    [[nodiscard]]
+    result<> compact_all(compaction_concurrency const& concurrency = {});
+
+private:
+    sharded_db();
+
+    std::unique_ptr<detail::sharded_impl> impl_;
+};
+
+} // namespace utxoz
@@ -0,0 +1,155 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file snapshot.hpp
+ * @brief A fixed view of a full-mode database, readable while it keeps changing.
+ *
+ * `for_each_entry()` and `census()` read the files the writer is changing, so
+ * both require that nothing mutates while they run — and a scan of a mainnet
+ * set takes minutes a node does not want to stop for. A snapshot is the set as
+ * it stood at one moment, and it stays that way while blocks are connected.
+ *
+ * ## How it is made
+ *
+ * `full_db::snapshot()` seals the active generation of every class that holds
+ * anything — a rotation, counted under `rotation_causes::snapshot` — so that
+ * everything stored is in a sealed generation, and maps each of them for the
+ * snapshot, or shares the mapping a live snapshot already holds. Sealed
+ * generations take no inserts. The two things that could still change one are
+ * held off for as long as the snapshot lives:
+ *
+ *  - **compaction** leaves a pinned generation out of every group it merges, and
+ *    out of the plan that chooses them;
+ *  - **a deletion** that reaches a pinned generation copies the entry into every
+ *    snapshot that sees it before it erases. The snapshot answers from the copy.
+ *
+ * The rotation is the cost of taking one: up to five new generations, which
+ * compaction folds back in once the snapshot is gone. A snapshot taken while a
+ * class is empty does not rotate it, so one taken with nothing inserted since
+ * the last rotates nothing and maps nothing new.
+ *
+ * ## What it costs to hold
+ *
+ * Each pinned generation stays on disk, and mapped, until the snapshot is
+ * dropped, and every deletion from one costs a copy of its entry for each
+ * snapshot that pins it. Both grow with the snapshot's age, not with its use:
+ * take one for a scan and drop it when the scan is done.
+ *
+ * ## Threading
+ *
+ * Taking a snapshot is a mutating operation under the rule on db_base — it
+ * rotates — so it is made from the writer's thread, between its other
+ * operations. What it returns is not bound to that thread. `find()`,
+ * `resolve()`, `size()` and `for_each_entry()` may be called from any thread,
+ * concurrently with each other and with everything the writer does, and need
+ * nothing from the caller to be safe.
+ *
+ * They are not free of locks. Each class has a reader-writer lock that snapshot
+ * reads hold shared; the writer takes it exclusively for the length of one
+ * erase from a pinned generation, and never otherwise. `for_each_entry()` holds
+ * it for one chunk of a generation at a time and calls the callback with it
+ * released, so a slow callback does not stall a spend. Two walks of one snapshot
+ * take turns; a lookup does not wait for a walk.
+ *
+ * ## Lifetime
+ *
+ * Dropping the handle releases the pins. A snapshot that outlives `close()` of
+ * its database answers `closed` from then on: the claim on the directory is
+ * gone, and the next instance to open it owes this one nothing.
+ *
+ * Full mode only. A reference-mode scan is a pass over twelve-byte values, and
+ * the same rule that keeps sharded_db to full mode applies here.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+#include <utxoz/database.hpp>
+#include <utxoz/types.hpp>
+
+namespace utxoz {
+
+namespace detail {
+struct database_impl;
+struct snapshot_state;
+} // namespace detail
+
+/**
+ * @brief The entries of a full_db at the moment full_db::snapshot() was called.
+ *
+ * Move-only. Dropping it releases what it pins.
+ */
+class full_snapshot {
+public:
+    ~full_snapshot();
+
+    full_snapshot(full_snapshot const&) = delete;
+    full_snapshot& operator=(full_snapshot const&) = delete;
+    full_snapshot(full_snapshot&&) noexcept;
+    full_snapshot& operator=(full_snapshot&&) noexcept;
+
+    /// Entries in the snapshot. Counted from the maps it pins rather than
+    /// remembered, so it is exact.
+    [[nodiscard]] size_t size() const;
+
+    /// Generations pinned, across every class.
+    [[nodiscard]] size_t generations() const noexcept;
+
+    /**
+     * @brief A key, looked up in everything the snapshot holds.
+     *
+     * Unlike full_db::find(), the whole answer: every generation is consulted,
+     * so an error is `not_found` — proven absent — or `closed`. Nothing here is
+     * `not_resolved`.
+     *
+     * Costs one probe per pinned generation of each class, at worst. A caller
+     * with many keys wants resolve(), which takes each class's lock once.
+     */
+    [[nodiscard]]
+    result<full_find_result> find(raw_outpoint const& key) const;
+
+    /**
+     * @brief full_db::resolve(), against the snapshot.
+     *
+     * The same contract: the span is borrowed, duplicate keys collapse keeping
+     * the first occurrence, and `found` and `absent` hold one entry per distinct
+     * key. A snapshot has every generation mapped already, so nothing can be
+     * unreadable; the only error is `closed`.
+     */
+    [[nodiscard]]
+    result<full_resolution> resolve(std::span<lookup_request const> requests) const;
+
+    /**
+     * @brief Every entry of the snapshot, once each.
+     *
+     * Class by class, generation by generation, and then the entries deletions
+     * have taken out of the files since — in no order a caller should rely on.
+     *
+     * @param f Callable with signature void(raw_outpoint const&, uint32_t block_height, std::span<uint8_t const> data)
+     */
+    template<typename F>
+    [[nodiscard]]
+    result<> for_each_entry(F&& f) const {
+        return for_each_entry_impl([](void* ctx, raw_outpoint const& key, uint32_t height, std::span<uint8_t const> data) {
+            (*static_cast<std::remove_reference_t<F>*>(ctx))(key, height, data);
+        }, &f);
+    }
+
+private:
+    friend struct detail::database_impl;
+    explicit full_snapshot(std::unique_ptr<detail::snapshot_state> state) noexcept;
+
+    [[nodiscard]]
+    result<> for_each_entry_impl(void(*cb)(void*, raw_outpoint const&, uint32_t, std::span<uint8_t const>), void* ctx) const;
+
+    std::unique_ptr<detail::snapshot_state> impl_;
+};
+
+} // namespace utxoz
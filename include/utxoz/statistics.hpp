@@ -9,9 +9,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -23,6 +26,44 @@
 
 namespace utxoz {
 
+/**
+ * @brief How much is counted: the three levels `UTXOZ_STATISTICS_LEVEL` names,
+ *        in the same order and cumulative for the same reason.
+ *
+ * Two settings use it. The build's is the ceiling: below it the counters are
+ * not skipped, they are absent, and nothing at run time brings them back. The
+ * running one, db_base::set_statistics_level(), chooses how much of what was
+ * compiled in is fed, and can be changed while the database works — a node
+ * that carries the lookup telemetry need not pay for it until someone asks.
+ */
+enum class statistics_level : uint8_t { off, basic, lookup };
+
+/// What this build carries, and so the most set_statistics_level() selects.
+inline constexpr statistics_level compiled_statistics_level =
+    static_cast<statistics_level>(UTXOZ_STATISTICS_LEVEL);
+
+/// "off", "basic" or "lookup": the spelling of every report.
+[[nodiscard]] constexpr char const* to_string(statistics_level level) noexcept {
+    switch (level) {
+        case statistics_level::off:    return "off";
+        case statistics_level::basic:  return "basic";
+        case statistics_level::lookup: return "lookup";
+    }
+    return "unknown";
+}
+
+/**
+ * Whether this platform counts page faults per thread, which is what the fault
+ * figures in resolution_summary and deferred_stats are made of. Where it does
+ * not, those stay zero and the zeros are not an answer; a report leaves them
+ * out rather than present them.
+ */
+#if defined(__linux__)
+inline constexpr bool page_faults_counted = true;
+#else
+inline constexpr bool page_faults_counted = false;
+#endif
+
 /**
  * @brief What probes saw.
  *
@@ -73,6 +114,12 @@ struct resolution_summary {
     size_t cache_hits = 0;        ///< of those, served by the file cache
     double avg_depth = 0.0;       ///< versions back from the active one, over resolved
     double cache_hit_rate = 0.0;  ///< cache_hits / files_visited
+    /// Page faults the calling thread took inside completed resolutions: a
+    /// major one is a page read from disk, a minor one a page the cache already
+    /// held. Published with the rest, so a failed attempt adds neither. See
+    /// page_faults_counted.
+    size_t major_faults = 0;
+    size_t minor_faults = 0;
 };
 
 /// One class's share of the read path. Every field is a count of one specific
@@ -130,11 +177,14 @@ struct lookup_telemetry {
     /// Bumped when a field changes meaning or leaves.
     static constexpr uint32_t schema_version = 1;
 
-    /// What this build carries: "off", "basic" or "lookup". One value rather than
-    /// a pair of booleans, because "statistics are on" was never the same claim
-    /// as "these counters were collected": at `basic` the first is true and the
-    /// second is false, and a reader given only the first would take a page of
-    /// zeros for a database that answered nothing.
+    /// What was being counted when these were read: "off", "basic" or "lookup".
+    /// One value rather than a pair of booleans, because "statistics are on" was
+    /// never the same claim as "these counters were collected": at `basic` the
+    /// first is true and the second is false, and a reader given only the first
+    /// would take a page of zeros for a database that answered nothing.
+    ///
+    /// The running level, not the build's. Lowered by set_statistics_level(),
+    /// the counters keep what they had and stop moving; this is what says so.
     std::string statistics_level = "off";
     storage_mode mode = storage_mode::full;
 
@@ -392,13 +442,17 @@ struct resolution_stats {
     void record_absent(size_t count) noexcept;
     /// A version file a sweep worked against.
     void record_file_visited(bool cache_hit) noexcept;
+    /// The page faults one completed resolution took.
+    void record_faults(uint64_t major, uint64_t minor) noexcept;
 
     void reset() noexcept;
     [[nodiscard]] resolution_summary get_summary() const noexcept;
 
 private:
-    enum field : size_t { f_resolved, f_absent, f_depth_total, f_files, f_cache_hits };
-    static_assert(f_cache_hits < detail::narrow_counters::field_count,
+    enum field : size_t {
+        f_resolved, f_absent, f_depth_total, f_files, f_cache_hits, f_major_faults, f_minor_faults
+    };
+    static_assert(f_minor_faults < detail::narrow_counters::field_count,
                   "resolution_stats has outgrown its counter slots");
 
     detail::narrow_counters counters_;
@@ -407,6 +461,7 @@ private:
     void record_resolved_batch(uint64_t, uint64_t) noexcept {}
     void record_absent(size_t) noexcept {}
     void record_file_visited(bool) noexcept {}
+    void record_faults(uint64_t, uint64_t) noexcept {}
     void reset() noexcept {}
     [[nodiscard]] resolution_summary get_summary() const noexcept { return {}; }
 #endif
@@ -436,7 +491,21 @@ struct deferred_stats {
     size_t failed_to_delete = 0;            ///< Failed deletion attempts
     size_t processing_runs = 0;              ///< Number of processing runs
     std::chrono::milliseconds total_processing_time{0}; ///< Total processing time
-    boost::unordered_flat_map<size_t, size_t> deletions_by_depth; ///< Depth -> deletion count
+    /// Page faults taken applying deletions, counted like the time: every batch,
+    /// finished or not, since what it erased it faulted in to erase. Includes
+    /// the helper threads of a batch that searched the classes side by side.
+    /// See page_faults_counted.
+    size_t major_faults = 0;
+    size_t minor_faults = 0;
+
+    /// The deepest depth counted on its own. A deletion that reached further
+    /// back is counted at this one: the erase path records into a fixed array,
+    /// so that bookkeeping never hashes or allocates there.
+    static constexpr size_t max_recorded_depth = 255;
+
+    /// Depth -> deletion count, depth being how many versions below the active
+    /// one the deleted entry was found. Only depths that were seen are present.
+    boost::unordered_flat_map<size_t, size_t> deletions_by_depth;
 };
 
 /**
@@ -449,14 +518,273 @@ struct not_found_stats {
     boost::unordered_flat_map<size_t, size_t> depth_distribution; ///< Depth -> count
 };
 
+/**
+ * @brief A fixed-size histogram with logarithmic buckets, HDR-style.
+ *
+ * Values below `2^SubBucketBits` each have a bucket of their own. Above that,
+ * every power of two is split into `2^SubBucketBits` equal buckets, so a bucket
+ * is never wider than `1 / 2^SubBucketBits` of the values it holds — 6.25% at
+ * the default of four bits — however large they are. Every `ValueBits`-bit value
+ * has a bucket, and the array is sized for all of them up front.
+ *
+ * That is the point of it. Recording is a shift, a bit scan and an increment
+ * into storage that already exists: no allocation, no hash, no rehash, on paths
+ * that run once per spent output. A hash map keyed by the exact value gave exact
+ * counts and grew with every new age it saw; this gives bounded relative error
+ * and never grows.
+ *
+ * Not synchronised. Whoever records owns it, as with the other counters here.
+ */
+template <unsigned ValueBits, unsigned SubBucketBits = 4>
+struct log_histogram {
+    static_assert(ValueBits <= 64 && SubBucketBits < ValueBits);
+
+    static constexpr size_t sub_buckets = size_t(1) << SubBucketBits;
+    static constexpr size_t bucket_count = sub_buckets * (ValueBits - SubBucketBits + 1);
+
+    std::array<uint64_t, bucket_count> counts{};
+
+    /// The bucket `value` is counted in.
+    [[nodiscard]] static constexpr size_t bucket_of(uint64_t value) noexcept {
+        if (value < sub_buckets) return size_t(value);
+        auto const shift = unsigned(std::bit_width(value)) - 1 - SubBucketBits;
+        return sub_buckets * (shift + 1) + size_t((value >> shift) - sub_buckets);
+    }
+
+    /// The smallest value counted in `bucket`.
+    [[nodiscard]] static constexpr uint64_t bucket_floor(size_t bucket) noexcept {
+        if (bucket < sub_buckets) return bucket;
+        auto const shift = unsigned(bucket / sub_buckets) - 1;
+        return uint64_t(sub_buckets + bucket % sub_buckets) << shift;
+    }
+
+    /// The largest value counted in `bucket`.
+    [[nodiscard]] static constexpr uint64_t bucket_ceiling(size_t bucket) noexcept {
+        if (bucket < sub_buckets) return bucket;
+        auto const shift = unsigned(bucket / sub_buckets) - 1;
+        return bucket_floor(bucket) + ((uint64_t(1) << shift) - 1);
+    }
+
+    void record(uint64_t value) noexcept { ++counts[bucket_of(value)]; }
+
+    void merge(log_histogram const& other) noexcept {
+        for (size_t b = 0; b < bucket_count; ++b) counts[b] += other.counts[b];
+    }
+
+    [[nodiscard]] uint64_t total() const noexcept {
+        uint64_t sum = 0;
+        for (auto const c : counts) sum += c;
+        return sum;
+    }
+
+    /// The ceiling of the bucket the `q` quantile falls in, `q` in [0, 1]: no
+    /// recorded value at that rank is larger. Zero when nothing was recorded.
+    [[nodiscard]] uint64_t percentile(double q) const noexcept {
+        auto const all = total();
+        if (all == 0) return 0;
+        auto const rank = std::clamp<uint64_t>(uint64_t(std::ceil(q * double(all))), 1, all);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < bucket_count; ++b) {
+            seen += counts[b];
+            if (seen >= rank) return bucket_ceiling(b);
+        }
+        return bucket_ceiling(bucket_count - 1);
+    }
+};
+
+/// Ages in blocks. Exact below 16 blocks, within 6.25% above; 464 buckets.
+using age_histogram = log_histogram<32>;
+
 /**
  * @brief UTXO lifetime statistics
+ *
+ * Recording a spend is an increment into `age_distribution`, a comparison and two
+ * additions. The average is not kept running — that was a division per spend —
+ * but derived from `total_age` when the statistics are read.
  */
 struct utxo_lifetime_stats {
-    boost::unordered_flat_map<uint32_t, size_t> age_distribution; ///< Age in blocks -> count
+    age_histogram age_distribution;  ///< Age in blocks, log-bucketed
     uint32_t max_age = 0;            ///< Maximum UTXO age observed
-    double average_age = 0.0;        ///< Average UTXO age
+    double average_age = 0.0;        ///< total_age / total_spent, filled in by get_statistics()
     size_t total_spent = 0;          ///< Total UTXOs spent
+    uint64_t total_age = 0;          ///< Sum of the ages of every spent UTXO
+};
+
+/**
+ * @brief The operations whose latency is recorded.
+ *
+ * `insert` and `find` are per key and sampled, one call in
+ * `latency_sample_interval` per thread; the rest are per batch or rare and every
+ * call is timed. A rotation or a merge is also inside the insert or compaction
+ * that caused it, and has its own series so that its stall is seen whether or
+ * not that insert was the sampled one.
+ */
+enum class latency_op : uint8_t { insert, find, resolve, apply_deletes, rotation, merge };
+inline constexpr size_t latency_op_count = 6;
+
+[[nodiscard]] constexpr char const* to_string(latency_op op) noexcept {
+    switch (op) {
+        case latency_op::insert:        return "insert";
+        case latency_op::find:          return "find";
+        case latency_op::resolve:       return "resolve";
+        case latency_op::apply_deletes: return "apply_deletes";
+        case latency_op::rotation:      return "rotation";
+        case latency_op::merge:         return "merge";
+    }
+    return "unknown";
+}
+
+/// One call in this many of `insert` and `find` is timed, per thread. Two clock
+/// reads on a lookup that takes tens of nanoseconds would double it; one in 64
+/// leaves the quantiles where they were and costs a decrement on the rest.
+inline constexpr uint32_t latency_sample_interval = 64;
+
+/// The calls that sampling leaves out are not the ones a quantile is about, so
+/// the interval is not multiplied back in: a series' `count` is what was timed.
+[[nodiscard]] constexpr uint32_t latency_sample_interval_of(latency_op op) noexcept {
+    return (op == latency_op::insert || op == latency_op::find) ? latency_sample_interval : 1;
+}
+
+/// Nanoseconds. Within 12.5% from 8 ns up, exact below; 272 buckets reaching
+/// 68.7 seconds, past which a call is counted in the last.
+using latency_histogram = log_histogram<36, 3>;
+
+/// The class a series is reported under when it has none: a `find` no active
+/// map answered, and the batch operations, which span every class.
+inline constexpr size_t unattributed_class = static_cast<size_t>(-2);
+
+/**
+ * @brief One operation's latency, in one class.
+ *
+ * Every quantile is the ceiling of the bucket it falls in — no timed call at that
+ * rank took longer — which is the conservative reading for something paged on.
+ */
+struct latency_series {
+    latency_op op = latency_op::insert;
+    /// A class index, `reference_class` in reference mode, or `unattributed_class`.
+    size_t container_class = 0;
+    uint64_t count = 0;         ///< calls timed
+    uint64_t total_ns = 0;      ///< summed over those
+    latency_histogram histogram;
+
+    [[nodiscard]] double mean_ns() const noexcept {
+        return count > 0 ? double(total_ns) / double(count) : 0.0;
+    }
+    [[nodiscard]] uint64_t percentile_ns(double q) const noexcept { return histogram.percentile(q); }
+};
+
+/**
+ * @brief Every latency series, copied out at one moment.
+ *
+ * Taken while other threads record, each series is exact on its own and the set
+ * is not consistent across series, as with the other sharded counters.
+ */
+struct latency_snapshot {
+    /// Bumped when a field changes meaning or leaves.
+    static constexpr uint32_t schema_version = 1;
+
+    /// "off", "basic" or "lookup", as running when copied out. In a build
+    /// without statistics `series` is empty; switched off at run time, it holds
+    /// what was timed before and nothing since.
+    std::string statistics_level = "off";
+    storage_mode mode = storage_mode::full;
+
+    /// Every series this mode can record, in `latency_op` order and class order
+    /// within it, empty ones included: a class that never rotated is a fact.
+    std::vector<latency_series> series;
+};
+
+/// Machine-readable; the counts and quantiles of each series and its non-empty
+/// buckets.
+[[nodiscard]] std::string to_json(latency_snapshot const&);
+
+namespace detail {
+
+/**
+ * @brief A latency_histogram recorded from many threads.
+ *
+ * Sharded like sharded_counters, and for the same reason; `Shards` is a
+ * parameter because only `find` and `resolve` are recorded concurrently; the
+ * writer-side operations are serialised by the caller and one shard is all they
+ * can use. A shard is 272 buckets and a total, 2,304 bytes padded.
+ */
+template <size_t Shards>
+struct sharded_histogram {
+    void record(uint64_t ns) noexcept {
+        auto& s = shards_[Shards == 1 ? 0 : thread_shard_index() % Shards];
+        auto const clamped = std::min<uint64_t>(ns, latency_histogram::bucket_ceiling(
+                                                        latency_histogram::bucket_count - 1));
+        s.buckets[latency_histogram::bucket_of(clamped)].fetch_add(1, std::memory_order_relaxed);
+        s.total.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /// Adds every shard into `into`.
+    void add_to(latency_series& into) const noexcept {
+        for (auto const& s : shards_) {
+            for (size_t b = 0; b < latency_histogram::bucket_count; ++b) {
+                into.histogram.counts[b] += s.buckets[b].load(std::memory_order_relaxed);
+            }
+            into.total_ns += s.total.load(std::memory_order_relaxed);
+        }
+        into.count = into.histogram.total();
+    }
+
+    void reset() noexcept {
+        for (auto& s : shards_) {
+            for (auto& b : s.buckets) b.store(0, std::memory_order_relaxed);
+            s.total.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(128) shard {
+        std::atomic<uint64_t> buckets[latency_histogram::bucket_count]{};
+        std::atomic<uint64_t> total{0};
+    };
+
+    std::array<shard, Shards> shards_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Latency per operation and per class. Safe to record from any number of
+ *        threads.
+ *
+ * Fixed storage, about 100 KiB at `basic`: `find` keeps six series of four
+ * shards (five classes and the misses), `resolve` one of four, and the sixteen
+ * writer-side series one shard each. Figures in doc/statistics-levels.md.
+ */
+struct latency_stats {
+    latency_stats() = default;
+    latency_stats(latency_stats const&) = delete;
+    latency_stats& operator=(latency_stats const&) = delete;
+
+    /// The slot a series without a class is recorded in.
+    static constexpr size_t unattributed = container_count;
+
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    /// `slot` is a class index, or `unattributed` for a find no active map
+    /// answered and for the batch operations, which ignore it.
+    void record(latency_op op, size_t slot, std::chrono::nanoseconds elapsed) noexcept;
+
+    void reset() noexcept;
+    [[nodiscard]] std::vector<latency_series> get_series(storage_mode mode) const;
+
+private:
+    static constexpr size_t reader_shards = 4;
+
+    std::array<detail::sharded_histogram<reader_shards>, container_count + 1> find_;
+    detail::sharded_histogram<reader_shards> resolve_;
+    std::array<detail::sharded_histogram<1>, container_count> insert_;
+    std::array<detail::sharded_histogram<1>, container_count> rotation_;
+    std::array<detail::sharded_histogram<1>, container_count> merge_;
+    detail::sharded_histogram<1> apply_deletes_;
+#else
+    void record(latency_op, size_t, std::chrono::nanoseconds) noexcept {}
+    void reset() noexcept {}
+    [[nodiscard]] std::vector<latency_series> get_series(storage_mode) const { return {}; }
+#endif
 };
 
 /**
@@ -484,6 +812,9 @@ struct rotation_causes {
     uint64_t preventive = 0;
     /// A `bad_alloc` asked for it, the map was intact, and it completed.
     uint64_t capacity_exception = 0;
+    /// full_db::snapshot() sealed the generation so that it could pin it. Not
+    /// a sign of pressure: the generation may have been nearly empty.
+    uint64_t snapshot = 0;
     /// A rotation was asked for and could not be made. **Not** a completed
     /// rotation, and deliberately not added to either of the two above.
     uint64_t failed = 0;
@@ -493,7 +824,39 @@ struct rotation_causes {
 
     /// Completed rotations, by cause. Excludes `failed`, which completed nothing.
     [[nodiscard]] constexpr uint64_t completed() const noexcept {
-        return preventive + capacity_exception;
+        return preventive + capacity_exception + snapshot;
+    }
+};
+
+/**
+ * @brief What the background flusher behind `sync_async()` has done.
+ *
+ * Filled in every build, for the reason rotation_causes is: a round is one per
+ * block at most, so counting it costs nothing anyone could measure, and these
+ * are the figures that say whether a node's durability point is keeping up.
+ *
+ * Latency is per request, from the call to the moment its future completed —
+ * what a caller that waits on it waits. The barrier time is the last round's
+ * alone, which is what the device charged for it.
+ */
+struct group_commit_stats {
+    uint64_t requests = 0;          ///< `sync_async()` calls handed to the flusher
+    uint64_t completed = 0;         ///< of those, answered
+    uint64_t flushes = 0;           ///< rounds of barriers that answered them
+    uint64_t failed_flushes = 0;    ///< rounds that failed; their requests got the error
+    uint64_t files_synced = 0;      ///< file barriers, summed over the rounds
+
+    std::chrono::nanoseconds total_latency{0};
+    std::chrono::nanoseconds max_latency{0};
+    std::chrono::nanoseconds last_barrier_time{0};
+
+    /// Requests answered per round. One means nothing was coalesced.
+    [[nodiscard]] double coalescing_factor() const noexcept {
+        return flushes > 0 ? double(completed) / double(flushes) : 0.0;
+    }
+
+    [[nodiscard]] std::chrono::nanoseconds mean_latency() const noexcept {
+        return completed > 0 ? total_latency / int64_t(completed) : std::chrono::nanoseconds{0};
     }
 };
 
@@ -541,27 +904,123 @@ struct database_statistics {
     /// `rotations_per_container`; `unexpected_post_exception` rotates nothing at
     /// all. See detail/insert_transition.hpp for the transitions that move them.
     std::array<rotation_causes, container_count> rotations_by_cause{};
+
+    /// The flusher behind `sync_async()`. Filled in every build; all zero on an
+    /// instance that never called it.
+    group_commit_stats group_commit;
     
     // Memory usage estimates
     std::array<size_t, container_count> memory_usage_per_container{};
 };
 
+/**
+ * @brief One class as the last completed operation left it.
+ *
+ * Sizes are the files', not the data's: a generation's file is as large as it
+ * was created, however few entries it holds. The sealed figures are captured
+ * when a generation is sealed or merged and summed from then on, so reading
+ * them touches no file.
+ */
+struct class_snapshot {
+    uint64_t active_entries = 0;      ///< entries in the active generation's map
+    uint64_t active_file_bytes = 0;   ///< the active generation's file
+    uint64_t active_used_bytes = 0;   ///< of those, allocated, as of the last insert's guard or batch
+    uint64_t sealed_generations = 0;  ///< generations behind the active one
+    uint64_t sealed_bytes = 0;        ///< their files, added up
+    uint64_t inserts = 0;             ///< entries stored since open
+    uint64_t deletes = 0;             ///< entries erased since open, from any generation
+    uint64_t rotations = 0;           ///< generations sealed since open
+
+    /// active_used_bytes / active_file_bytes, or zero with no active generation.
+    [[nodiscard]] double fill_ratio() const noexcept {
+        return active_file_bytes == 0 ? 0.0 : double(active_used_bytes) / double(active_file_bytes);
+    }
+
+    /// Every file of the class, active and sealed.
+    [[nodiscard]] uint64_t total_bytes() const noexcept { return active_file_bytes + sealed_bytes; }
+};
+
+/**
+ * @brief What db_base::get_stats_snapshot() returns: sizes per class, read in
+ *        constant time from any thread.
+ *
+ * Published by the writer at the end of each operation and read without a
+ * lock, so a monitoring thread may take one in the middle of an insert or an
+ * apply_deletes() and get the state either before or after it, never a mix.
+ * `sequence` moves on every publication: two snapshots with the same sequence
+ * describe the same state.
+ *
+ * Counted in every build, `UTXOZ_STATISTICS_LEVEL` 0 included. These are sizes,
+ * not telemetry; what a build leaves out is how it got there.
+ */
+struct stats_snapshot {
+    storage_mode mode = storage_mode::full;
+    uint64_t sequence = 0;            ///< publications since open
+    uint64_t total_entries = 0;       ///< size(), at the same instant as the classes
+
+    /// Per class. Reference mode's single class is element 0, the rest zero;
+    /// see class_count().
+    std::array<class_snapshot, container_count> classes{};
+
+    [[nodiscard]] size_t class_count() const noexcept {
+        return mode == storage_mode::reference ? 1 : container_count;
+    }
+
+    /// Every file of every class.
+    [[nodiscard]] uint64_t total_bytes() const noexcept {
+        uint64_t total = 0;
+        for (auto const& c : classes) total += c.total_bytes();
+        return total;
+    }
+};
+
+/**
+ * @brief The statistics as OpenMetrics text, ready to serve to a Prometheus
+ *        scrape, `# EOF` included.
+ *
+ * Counters, gauges and histograms under stable `utxoz_` names, with a `class`
+ * label on everything that has one: entries, inserts, deletes and rehashes per
+ * class; rotations by cause; find outcomes, resolution and file cache figures;
+ * the per-class read-path telemetry at `lookup`; deletions, spent ages, the
+ * group commit; file bytes per class and, with statistics on, the active
+ * generation's fill; and `latency` as `utxoz_operation_latency_seconds` when
+ * given.
+ *
+ * The value-size and depth distributions are not exposed: they are maps, and a
+ * scrape every few seconds should not copy them. db_base::to_openmetrics()
+ * renders the counter view, which leaves them out.
+ */
+[[nodiscard]] std::string to_openmetrics(database_statistics const& stats,
+                                         latency_snapshot const& latency = {});
+
 /**
  * @brief Per-height-range statistics for tracking UTXO distribution over time
  *
  * Tracks inserts and deletes per container per height range (default 10,000 blocks).
  * Call db::print_height_range_stats() after a full chain sync to see how the
  * value size distribution evolves across the blockchain.
+ *
+ * Dense: one slot per range, indexed by `height / range_size`, all of them there
+ * from construction, so counting is an index and an increment rather than a
+ * hash lookup that may grow the table. `range_count` ranges reach height
+ * 2,559,999, decades past either chain's tip; a height beyond that is counted in
+ * the last range, which the report labels as open-ended.
  */
 struct height_range_stats {
     static constexpr uint32_t range_size = 10000;
+    static constexpr size_t range_count = 256;
 
     struct range_data {
         std::array<size_t, container_count> inserts{};
         std::array<size_t, container_count> deletes{};
     };
 
-    boost::unordered_flat_map<uint32_t, range_data> ranges; ///< key = height / range_size
+    /// The slot `height` is counted in.
+    [[nodiscard]] static constexpr size_t range_of(uint32_t height) noexcept {
+        return std::min<size_t>(height / range_size, range_count - 1);
+    }
+
+    std::array<range_data, range_count> ranges{}; ///< index = range_of(height)
 };
 
 /**
@@ -0,0 +1,160 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file trace.hpp
+ * @brief Spans for the rare, slow things the store does: when each happened, on
+ *        which thread, for how long and over how many bytes.
+ *
+ * The latency histograms in `statistics.hpp` say how slow a rotation is in
+ * general. They cannot say that the 900 ms stall at 14:02 was a rotation of
+ * class 3 that overlapped a merge of class 1 and a sync waiting on its directory
+ * barrier, because a histogram has no time axis. A trace has nothing else: one
+ * event per span, with its start, its duration, its thread and what it worked
+ * on, laid side by side.
+ *
+ * What is traced is what happens at most a few times per block: rotations, the
+ * phases of a merge, merge recovery at open, the barriers of `sync()` and the
+ * rounds of the group commit, the cache mapping and unmapping version files, and
+ * resolutions of at least `trace_options::resolve_threshold` keys. Never a
+ * single `find()` or `insert()`: a span costs two clock reads and a short lock,
+ * which is noise beside a rotation and the whole cost of a lookup.
+ *
+ * ## Cost
+ *
+ * Tracing is off until `db_base::start_tracing()`, and off it costs one relaxed
+ * load per span site, of which there are a handful per block. On, the spans go
+ * to a fixed ring allocated when tracing starts; a full ring overwrites its
+ * oldest event and counts it in `trace_capture::overwritten`, so a reader that
+ * falls behind loses history, never blocks the store, and is told how much it
+ * lost. That is what makes it cheap enough to leave on.
+ *
+ * Independent of the statistics level: a build with statistics compiled out
+ * still traces, because nothing here is a counter.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <utxoz/statistics.hpp>
+
+namespace utxoz {
+
+/**
+ * @brief What a span covers.
+ *
+ * A merge is a span around three of its phases, and a sync a span around its
+ * three barriers, so a viewer nests them; the phases of one are on its thread
+ * and inside its interval.
+ */
+enum class trace_kind : uint8_t {
+    rotation,        ///< sealing the active generation of a class and opening the next
+    merge,           ///< one merge_versions(), start to metadata
+    merge_build,     ///< copying the sources into the building file and syncing it
+    merge_publish,   ///< sidecar written, target published, directory barrier
+    merge_retire,    ///< sources removed, sidecar removed, their barriers
+    merge_recovery,  ///< recover_pending_merges() at open
+    sync,            ///< one sync(), every barrier
+    sync_pages,      ///< the page barriers of the active segments and the cache
+    sync_files,      ///< the file barriers
+    sync_directory,  ///< the directory barrier
+    group_commit,    ///< one round of the sync_async() flusher
+    file_map,        ///< the cache opening and validating a version file
+    file_unmap,      ///< the cache dropping one
+    resolve,         ///< a resolve() of at least resolve_threshold keys
+};
+inline constexpr size_t trace_kind_count = 14;
+
+[[nodiscard]] constexpr char const* to_string(trace_kind kind) noexcept {
+    switch (kind) {
+        case trace_kind::rotation:       return "rotation";
+        case trace_kind::merge:          return "merge";
+        case trace_kind::merge_build:    return "merge_build";
+        case trace_kind::merge_publish:  return "merge_publish";
+        case trace_kind::merge_retire:   return "merge_retire";
+        case trace_kind::merge_recovery: return "merge_recovery";
+        case trace_kind::sync:           return "sync";
+        case trace_kind::sync_pages:     return "sync_pages";
+        case trace_kind::sync_files:     return "sync_files";
+        case trace_kind::sync_directory: return "sync_directory";
+        case trace_kind::group_commit:   return "group_commit";
+        case trace_kind::file_map:       return "file_map";
+        case trace_kind::file_unmap:     return "file_unmap";
+        case trace_kind::resolve:        return "resolve";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief One span.
+ *
+ * The figures are the ones the kind has; the rest stay zero:
+ *
+ *  - `rotation`: `version` is the generation sealed, `bytes` its segment size,
+ *    `items` the entries in it.
+ *  - `merge` and its phases: `version` is the target, `files` the sources,
+ *    `items` the entries moved. `merge` and `merge_build` also carry the
+ *    target's size in `bytes`.
+ *  - `merge_recovery`: `items` is the merge records and leftovers found.
+ *  - `sync`, `sync_pages`: `bytes` is what the page barriers of the active
+ *    segments covered. `sync`, `sync_files`: `files` is the files barriered.
+ *  - `group_commit`: `files` is the union flushed, `items` the requests served.
+ *  - `file_map`, `file_unmap`: `version` and `bytes` of the segment.
+ *  - `resolve`: `items` is the keys asked, `files` the generations opened.
+ */
+struct trace_event {
+    trace_kind kind = trace_kind::rotation;
+    /// The operation returned an error or threw. Its duration is still real.
+    bool failed = false;
+    /// Numbered per process in the order threads first record, from 1. Stable
+    /// for a thread's life, and small, which is what a viewer's rows want.
+    uint32_t thread = 0;
+    /// A class index, `reference_class` in reference mode, or
+    /// `unattributed_class` for a span over every class.
+    size_t container_class = unattributed_class;
+    uint64_t version = 0;
+    /// Steady clock, nanoseconds since its epoch: comparable within a process,
+    /// not a wall time.
+    uint64_t start_ns = 0;
+    uint64_t duration_ns = 0;
+    uint64_t bytes = 0;
+    uint64_t items = 0;
+    uint64_t files = 0;
+};
+
+/// How tracing runs, fixed from `start_tracing()` to the next.
+struct trace_options {
+    /// Events held before the oldest is overwritten. Allocated once when tracing
+    /// starts, at about 64 bytes each; at least one.
+    size_t capacity = 4096;
+    /// A resolve() of fewer keys than this is not traced. A per-transaction
+    /// resolve is a few keys and there are thousands per block; the block-sized
+    /// ones are what a trace is for.
+    size_t resolve_threshold = 1024;
+};
+
+/// What `drain_trace()` took out of the ring.
+struct trace_capture {
+    /// Oldest first. Order of completion, which is not order of start: a merge
+    /// ends after the phases inside it.
+    std::vector<trace_event> events;
+    /// Events lost to a full ring since the previous drain.
+    uint64_t overwritten = 0;
+};
+
+/**
+ * @brief The events as Chrome trace-event JSON, the "JSON Object Format".
+ *
+ * One complete event (`"ph":"X"`) per span, times in microseconds, the figures
+ * and the class under `args`. Loads in Perfetto and in `chrome://tracing`
+ * as it is. Overwritten events are reported in `otherData`, since a gap that
+ * is not explained reads as idle time.
+ */
+[[nodiscard]] std::string to_chrome_trace(trace_capture const& capture);
+
+} // namespace utxoz
@@ -247,6 +247,17 @@ enum class error_code : uint8_t {
     /// each entry is internally consistent. This one says the file passed all of
     /// that and an entry inside it still cannot be true.
     entry_corrupt,
+    /// A sharded database was asked to open with a different number of shards
+    /// than it was created with, or with a number it cannot have. The shard of
+    /// every key is a function of that number, so opening under another one
+    /// would look for every key in the wrong place — and an empty answer from
+    /// the wrong shard reads exactly like absence.
+    shard_count_mismatch,
+    /// A full_reader found the writer in the middle of one change for longer
+    /// than any change takes. A change is one emplace or one erase; one that
+    /// never finishes is a writer that died inside it. Nothing was read. The
+    /// next writer to open the database clears it.
+    reader_stalled,
 };
 
 /**
@@ -5,11 +5,16 @@
 #pragma once
 
 #include <utxoz/census.hpp>
+#include <utxoz/compaction.hpp>
 #include <utxoz/uniqueness.hpp>
 #include <utxoz/config.hpp>
 #include <utxoz/database.hpp>
 #include <utxoz/logging.hpp>
+#include <utxoz/reader.hpp>
+#include <utxoz/sharded.hpp>
+#include <utxoz/snapshot.hpp>
 #include <utxoz/statistics.hpp>
+#include <utxoz/trace.hpp>
 #include <utxoz/types.hpp>
 #include <utxoz/utils.hpp>
 #include <utxoz/version.hpp>
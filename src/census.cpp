@@ -16,23 +16,29 @@
 
 #include "detail/capacity_policy.hpp"
 #include "detail/census_arithmetic.hpp"
+#include "detail/census_cache_io.hpp"
+#include "detail/census_sampling.hpp"
 #include "detail/database_impl.hpp"
 #include "detail/format_identity.hpp"
 #include "detail/log.hpp"
+#include "detail/page_residency.hpp"
 #include "detail/path_display.hpp"
 #include "detail/physical_size.hpp"
 #include "detail/segment_open.hpp"
 #include "detail/segment_stamp.hpp"
+#include "detail/spread_over_threads.hpp"
 
 #include <utxoz/config.hpp>
 
 #include <algorithm>
 #include <chrono>
+#include <exception>
 #include <limits>
 #include <optional>
 #include <utility>
 #include <cstdint>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <fmt/format.h>
@@ -69,13 +75,18 @@ void set_residual(uint64_t segment_size, uint64_t segment_free, uint64_t modelle
 
 /// Adding two figures that may not exist. Absent plus present is absent: a sum
 /// that quietly skipped the part nobody could measure would be a smaller number
-/// wearing the name of a complete one.
+/// wearing the name of a complete one. Counted plus estimated is estimated; its
+/// interval is the caller's to set, from the spreads.
 void add_optional(optional_bytes& total, optional_bytes const& part, char const* what) {
     if (total.status == metric_status::unavailable) return;
-    if (part.status == metric_status::measured
-            && (total.status == metric_status::measured || total.bytes == 0)) {
+    auto const has_number = [](metric_status s) {
+        return s == metric_status::measured || s == metric_status::estimated;
+    };
+    if (has_number(part.status) && (has_number(total.status) || total.bytes == 0)) {
         total.bytes += part.bytes;
-        total.status = metric_status::measured;
+        total.status = (part.status == metric_status::estimated
+                        || total.status == metric_status::estimated)
+            ? metric_status::estimated : metric_status::measured;
         total.detail = what;
         return;
     }
@@ -96,6 +107,7 @@ char const* to_string(metric_status s) noexcept {
         case metric_status::measured: return "measured";
         case metric_status::not_applicable: return "not_applicable";
         case metric_status::unavailable: return "unavailable";
+        case metric_status::estimated: return "estimated";
     }
     return "unavailable";
 }
@@ -130,10 +142,11 @@ consteval size_t index_of_size(size_t size) {
     throw "no container has this size";
 }
 
-/// One generation of one full-mode class: every entry read, nothing sampled.
+/// What every full-mode generation's figures start from: the counts in the
+/// map's header, checked, and the padding they imply.
 template <size_t Size>
-result<> accumulate_full(uint64_t container_class, utxo_map<Size> const& map,
-                         generation_census& gen, std::vector<uint64_t>& histogram) {
+result<> full_header(uint64_t container_class, utxo_map<Size> const& map,
+                     generation_census& gen) {
     constexpr size_t capacity = utxo_value<Size>{}.data.size();
     // The capacity the geometry publishes and the one the type actually has are
     // the same number, and this is where they would silently stop being it: every
@@ -161,10 +174,44 @@ result<> accumulate_full(uint64_t container_class, utxo_map<Size> const& map,
                    "accounted for without overflow", container_class, gen.generation);
         return std::unexpected(error_code::entry_corrupt);
     }
+    return {};
+}
+
+/// Both payload sums are bounded by entries x capacity, so one check covers them.
+result<> payload_bound(uint64_t container_class, generation_census const& gen,
+                       uint64_t capacity) {
+    uint64_t bound = 0;
+    if ( ! checked_mul(gen.entries, capacity, bound)) {
+        log::error("census: class {} generation {} cannot be summed without overflow",
+                   container_class, gen.generation);
+        return std::unexpected(error_code::entry_corrupt);
+    }
+    return {};
+}
+
+void set_payload(generation_census& gen, uint64_t payload, uint64_t unused) {
+    gen.entry_payload_bytes = payload;
+    gen.unused_payload_capacity = {unused, metric_status::measured,
+                                   "payload capacity of the class minus what each entry uses"};
+}
+
+/// One generation of one full-mode class: the first `limit` entries in table
+/// order read, which is every entry unless the census samples. `read` says how
+/// many were; the payload figures are theirs, and the caller estimates from
+/// them when they are not all.
+template <size_t Size>
+result<> accumulate_full(uint64_t container_class, utxo_map<Size> const& map,
+                         generation_census& gen, std::vector<uint64_t>& histogram,
+                         uint64_t limit, uint64_t& read) {
+    constexpr size_t capacity = utxo_value<Size>{}.data.size();
+    if (auto ok = full_header<Size>(container_class, map, gen); ! ok) return ok;
 
     uint64_t payload = 0;
     uint64_t unused = 0;
+    read = 0;
     for (auto const& entry : map) {
+        if (read == limit) break;
+        ++read;
         uint64_t const size = entry.second.actual_size;
         // `set_data()` clamps on the way in, so a build that wrote this file
         // could not have produced a longer one. Reading it back and taking the
@@ -185,17 +232,31 @@ result<> accumulate_full(uint64_t container_class, utxo_map<Size> const& map,
         ++histogram[size];
     }
 
-    // Both sums are bounded by entries x capacity, so one check covers them.
-    uint64_t bound = 0;
-    if ( ! checked_mul(gen.entries, capacity, bound)) {
-        log::error("census: class {} generation {} cannot be summed without overflow",
-                   container_class, gen.generation);
-        return std::unexpected(error_code::entry_corrupt);
-    }
+    if (auto ok = payload_bound(container_class, gen, capacity); ! ok) return ok;
+    set_payload(gen, payload, unused);
+    return {};
+}
 
-    gen.entry_payload_bytes = payload;
-    gen.unused_payload_capacity = {unused, metric_status::measured,
-                                   "payload capacity of the class minus what each entry uses"};
+/// The same figures from the histogram an earlier census kept, for a
+/// generation whose headers say nothing has left it since. The record has
+/// already been held to the headers and every size to the class, so what is
+/// left to refuse is what the walk would have refused in the counts.
+template <size_t Size>
+result<> accumulate_cached(uint64_t container_class, utxo_map<Size> const& map,
+                           generation_census& gen, std::vector<payload_bucket> const& histogram) {
+    constexpr size_t capacity = utxo_value<Size>{}.data.size();
+    if (auto ok = full_header<Size>(container_class, map, gen); ! ok) return ok;
+    // First here: with it, and every size within the capacity, no product or
+    // sum below can wrap.
+    if (auto ok = payload_bound(container_class, gen, capacity); ! ok) return ok;
+
+    uint64_t payload = 0;
+    uint64_t unused = 0;
+    for (auto const& b : histogram) {
+        payload += uint64_t(b.payload_size) * b.entries;
+        unused += (capacity - b.payload_size) * b.entries;
+    }
+    set_payload(gen, payload, unused);
     return {};
 }
 
@@ -278,12 +339,17 @@ result<> finish_generation(generation_census& gen, uint64_t pair_size) {
     add(cls.empty_slot_bytes, gen.empty_slot_bytes);
     add(cls.estimated_group_metadata_bytes, gen.estimated_group_metadata_bytes);
     if ( ! add.ok) return false;
+    if (gen.entry_payload_status == metric_status::estimated) {
+        cls.entry_payload_status = metric_status::estimated;
+    }
     add_optional(cls.unused_payload_capacity, gen.unused_payload_capacity,
                  "summed over the generations of this class");
     add_optional(cls.unattributed_allocated_bytes, gen.unattributed_allocated_bytes,
                  "summed over the generations of this class");
     add_optional(cls.physical_allocated_bytes, gen.physical_allocated_bytes,
                  "summed over the generations of this class");
+    add_optional(cls.resident_bytes, gen.resident_bytes,
+                 "summed over the generations of this class");
     return true;
 }
 
@@ -299,12 +365,16 @@ result<> finish_generation(generation_census& gen, uint64_t pair_size) {
     add(report.empty_slot_bytes, cls.empty_slot_bytes);
     add(report.estimated_group_metadata_bytes, cls.estimated_group_metadata_bytes);
     if ( ! add.ok) return false;
+    if (cls.entry_payload_status == metric_status::estimated) {
+        report.entry_payload_status = metric_status::estimated;
+    }
     add_optional(report.unused_payload_capacity, cls.unused_payload_capacity,
                  "summed over the classes");
     add_optional(report.unattributed_allocated_bytes, cls.unattributed_allocated_bytes,
                  "summed over the classes");
     add_optional(report.physical_allocated_bytes, cls.physical_allocated_bytes,
                  "summed over the classes");
+    add_optional(report.resident_bytes, cls.resident_bytes, "summed over the classes");
     return true;
 }
 
@@ -314,7 +384,7 @@ result<> finish_generation(generation_census& gen, uint64_t pair_size) {
 std::vector<payload_bucket> compact_histogram(std::vector<uint64_t> const& dense) {
     std::vector<payload_bucket> out;
     for (size_t i = 0; i < dense.size(); ++i) {
-        if (dense[i] != 0) out.push_back({static_cast<uint32_t>(i), dense[i]});
+        if (dense[i] != 0) out.push_back({static_cast<uint32_t>(i), dense[i], {}});
     }
     return out;
 }
@@ -331,11 +401,9 @@ result<census_report> database_impl::census(census_options const& options) const
     report.map_layout_epoch = map_layout_epoch;
     report.hash_epoch = hash_epoch;
     report.platform_abi_id = platform_abi_id;
-#if UTXOZ_STATISTICS_LEVEL >= 1
-    report.statistics_enabled = true;
-#else
-    report.statistics_enabled = false;
-#endif
+    // What is running, not what was built: below `basic` nothing this process
+    // did is being counted, whatever the build carries.
+    report.statistics_enabled = get_statistics_level() >= statistics_level::basic;
     report.physical_measurement = options.measure_physical_blocks
         ? physical_allocation_method() : allocation_method::none;
     report.source.declared_external_snapshot = options.declared_external_snapshot;
@@ -351,6 +419,9 @@ result<census_report> database_impl::census(census_options const& options) const
     report.physical_allocated_bytes = options.measure_physical_blocks
         ? optional_bytes{0, metric_status::measured, "summed over the classes"}
         : optional_bytes{0, metric_status::not_applicable, "not requested"};
+    report.resident_bytes = options.measure_residency
+        ? optional_bytes{0, metric_status::measured, "summed over the classes"}
+        : optional_bytes{0, metric_status::not_applicable, "not requested"};
 
     // Everything below shares this: the file for a generation the catalogue
     // lists, its size, its blocks, and the segment it holds. A generation that
@@ -367,10 +438,304 @@ result<census_report> database_impl::census(census_options const& options) const
         gen.physical_allocated_bytes = options.measure_physical_blocks
             ? physical_allocation_of(path)
             : optional_bytes{0, metric_status::not_applicable, "not requested"};
+        // Here, before the generation is opened: the walk reads every entry,
+        // and asked afterwards the page cache would report the census itself.
+        gen.resident_bytes = options.measure_residency
+            ? resident_bytes_of(path)
+            : optional_bytes{0, metric_status::not_applicable, "not requested"};
         return {};
     };
 
-    if (mode_ == storage_mode::reference) {
+    // One task per generation, listed in the order the walk visits them: class
+    // by class, oldest generation first. The tasks run side by side and are
+    // folded afterwards in that order, so the report is the same byte for byte
+    // whatever the number of threads, and a failure is the one a sequential walk
+    // would have stopped at (see spread_over_threads()).
+    //
+    // Each task opens its own file and writes only its own slot. The active
+    // generation is read in place by the one task that has it; nothing mutates
+    // underneath any of them, which census() already requires.
+    struct generation_task {
+        size_t slot = 0;                        ///< the class; 0 in reference mode
+        generation_census gen;
+        std::vector<payload_bucket> histogram;  ///< the sizes this generation holds
+        bool reused = false;                    ///< from an earlier census's record
+        uint64_t entries_read = 0;              ///< whose sizes were read by this census
+        // What the payload figures are uncertain by; zero unless sampled.
+        bool sampled = false;
+        estimate_spread payload_spread;
+        estimate_spread unused_spread;
+        std::vector<estimate_spread> bucket_spreads;   ///< beside `histogram`, if sampled
+        result<> outcome;
+        std::exception_ptr thrown;
+    };
+    bool const reference = (mode_ == storage_mode::reference);
+    std::vector<generation_task> tasks;
+    auto const add_task = [&](size_t slot, uint64_t version, uint64_t active) {
+        auto& task = tasks.emplace_back();
+        task.slot = slot;
+        task.gen.generation = version;
+        task.gen.active = (version == active);
+    };
+    if (reference) {
+        for (auto const version : reference_catalog_.versions()) {
+            add_task(0, version, reference_current_version_);
+        }
+    } else {
+        for (size_t index = 0; index < container_count; ++index) {
+            for (auto const version : catalogs_[index].versions()) {
+                add_task(index, version, current_versions_[index]);
+            }
+        }
+    }
+
+    auto const walk_reference = [&](generation_task& task) -> result<> {
+        auto& gen = task.gen;
+        auto const path = data_path(reference_sentinel_index, gen.generation);
+        if (auto ok = file_facts(path, gen); ! ok) return ok;
+
+        if (gen.active && reference_container_ != nullptr && reference_segment_) {
+            if (auto ok = accumulate_reference(reference_map(), gen); ! ok) return ok;
+            gen.segment_size_bytes = reference_segment_->get_size();
+            gen.segment_free_bytes = reference_segment_->get_free_memory();
+        } else {
+            auto opened = open_existing_segment(path);
+            if ( ! opened) return std::unexpected(opened.error());
+            // The same check the ordinary open makes, for the same reason: a
+            // mapped segment is not yet a segment of *this* database, and a
+            // file renamed into a name that is not its own would otherwise be
+            // counted as the generation it is pretending to be.
+            if (auto stamped = validate_stamp(
+                    **opened, path,
+                    expected_identity(reference_container_kind, gen.generation)); ! stamped) {
+                return std::unexpected(stamped.error());
+            }
+            auto found = find_single_named<reference_map_t>(**opened, map_object_name, path);
+            if ( ! found) return std::unexpected(found.error());
+            if (auto ok = accumulate_reference(**found, gen); ! ok) return ok;
+            gen.segment_size_bytes = (*opened)->get_size();
+            gen.segment_free_bytes = (*opened)->get_free_memory();
+        }
+        return finish_generation(gen, sizeof(reference_map_t::value_type));
+    };
+
+    // How many entries of a full-mode generation to read, and what its payload
+    // figures are once they have been: counted, if that was all of them, and
+    // otherwise estimated from them (census_sampling.hpp).
+    bool const sampling = ! reference && options.sample_fraction > 0.0
+        && options.sample_fraction < 1.0;
+    auto const read_limit = [&](uint64_t entries) {
+        return sample_limit(entries, options.sample_fraction, options.sample_min_entries);
+    };
+    auto const settle = [](generation_task& task, std::vector<uint64_t> const& dense,
+                           uint64_t read, uint64_t capacity) {
+        auto& gen = task.gen;
+        task.entries_read = read;
+        if (read == gen.entries) {
+            task.histogram = compact_histogram(dense);
+            task.payload_spread = estimate_spread::exact(gen.entry_payload_bytes);
+            task.unused_spread = estimate_spread::exact(gen.unused_payload_capacity.bytes);
+            return;
+        }
+        auto estimate = estimate_from_sample(dense, read, gen.entries, capacity);
+        gen.entry_payload_bytes = estimate.payload;
+        gen.entry_payload_status = metric_status::estimated;
+        gen.entry_payload_interval = interval_of(estimate.payload, estimate.payload_spread);
+        gen.unused_payload_capacity = {estimate.unused, metric_status::estimated,
+                                       "payload capacity of the class minus what each entry "
+                                       "uses, estimated from a sample of the entries"};
+        gen.unused_payload_capacity_interval = interval_of(estimate.unused, estimate.unused_spread);
+        for (size_t i = 0; i < estimate.histogram.size(); ++i) {
+            estimate.histogram[i].interval = interval_of(estimate.histogram[i].entries,
+                                                         estimate.bucket_spreads[i]);
+        }
+        task.histogram = std::move(estimate.histogram);
+        task.bucket_spreads = std::move(estimate.bucket_spreads);
+        task.payload_spread = estimate.payload_spread;
+        task.unused_spread = estimate.unused_spread;
+        task.sampled = true;
+    };
+
+    auto const walk_full = [&]<size_t Index>(std::integral_constant<size_t, Index>,
+                                             generation_task& task) -> result<> {
+        constexpr size_t Size = container_sizes[Index];
+        auto& gen = task.gen;
+        auto const path = data_path(Index, gen.generation);
+        if (auto ok = file_facts(path, gen); ! ok) return ok;
+
+        // Dense while the entries are read, compact once they have been: a task
+        // waiting to be folded holds the sizes it saw, not a counter for every
+        // size the class allows.
+        std::vector<uint64_t> histogram(container_capacities[Index] + 1, 0);
+        uint64_t read = 0;
+        if (gen.active && segments_[Index]) {
+            auto const& map = container<Index>();
+            if (auto ok = accumulate_full<Size>(Index, map, gen, histogram,
+                                                read_limit(map.size()), read); ! ok) {
+                return ok;
+            }
+            gen.segment_size_bytes = segments_[Index]->get_size();
+            gen.segment_free_bytes = segments_[Index]->get_free_memory();
+            settle(task, histogram, read, container_capacities[Index]);
+        } else {
+            auto opened = open_existing_segment(path);
+            if ( ! opened) return std::unexpected(opened.error());
+            // As above: mapped is not the same as ours, and a census that
+            // counted a misplaced file would report a database that does not
+            // exist.
+            if (auto stamped = validate_stamp(
+                    **opened, path,
+                    expected_identity(uint32_t(Index), gen.generation)); ! stamped) {
+                return std::unexpected(stamped.error());
+            }
+            auto found = find_single_named<utxo_map<Size>>(**opened, map_object_name, path);
+            if ( ! found) return std::unexpected(found.error());
+            auto const& map = **found;
+            gen.segment_size_bytes = (*opened)->get_size();
+            gen.segment_free_bytes = (*opened)->get_free_memory();
+
+            // Sealed, so the headers are enough to say whether an earlier
+            // census's record still describes it. Taken after the stamp: the key
+            // names the identity the stamp has just vouched for.
+            census_cache_key const key{expected_identity(uint32_t(Index), gen.generation),
+                                       map.size(), map.bucket_count(),
+                                       gen.segment_size_bytes, gen.segment_free_bytes,
+                                       gen.logical_file_bytes};
+            auto const cache_path = census_cache_path(Index, gen.generation);
+            if (options.incremental) {
+                auto cached = read_census_cache_file(cache_path);
+                bool const fits = cached && cached->key == key
+                    && std::ranges::all_of(cached->histogram, [](payload_bucket const& b) {
+                           return b.payload_size <= container_capacities[Index];
+                       });
+                if (fits) {
+                    if (auto ok = accumulate_cached<Size>(Index, map, gen, cached->histogram); ! ok) {
+                        return ok;
+                    }
+                    task.histogram = std::move(cached->histogram);
+                    task.reused = true;
+                    task.payload_spread = estimate_spread::exact(gen.entry_payload_bytes);
+                    task.unused_spread = estimate_spread::exact(gen.unused_payload_capacity.bytes);
+                } else if ( ! cached && cached.error() != metadata_read_error::absent) {
+                    // Absent or stale is a generation to read and nothing more;
+                    // a record that cannot be believed is worth a line.
+                    log::info("census: the record for class {} generation {} could not be "
+                              "used; reading the generation", Index, gen.generation);
+                }
+            }
+
+            if ( ! task.reused) {
+                if (auto ok = accumulate_full<Size>(Index, map, gen, histogram,
+                                                    read_limit(map.size()), read); ! ok) {
+                    return ok;
+                }
+                settle(task, histogram, read, container_capacities[Index]);
+                // Never from a sample: a record is believed without question by
+                // the next census, which may not be sampling.
+                if (options.incremental && ! task.sampled) {
+                    if (auto const written = write_census_cache_file(
+                            cache_path, {key, task.histogram}); ! written) {
+                        // The next census reads this generation again, and that
+                        // is the whole of the cost.
+                        log::warn("census: could not keep a record for class {} generation {}",
+                                  Index, gen.generation);
+                    }
+                }
+            }
+        }
+        return finish_generation(gen, sizeof(typename utxo_map<Size>::value_type));
+    };
+
+    // The classes are distinct types, so a task finds its own by a fold rather
+    // than by a table. `make_index_variant` would do, but it is defined in
+    // database_impl.cpp and so cannot be called from here.
+    auto const walk = [&](generation_task& task) -> result<> {
+        if (reference) return walk_reference(task);
+        result<> outcome;
+        [&]<size_t... Is>(std::index_sequence<Is...>) {
+            (void)((task.slot == Is
+                    && (outcome = walk_full(std::integral_constant<size_t, Is>{}, task), true))
+                   || ...);
+        }(std::make_index_sequence<container_count>{});
+        return outcome;
+    };
+
+    size_t const threads = options.threads != 0
+        ? options.threads
+        : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    spread_over_threads(tasks.size(), threads, "census", [&](size_t i) {
+        auto& task = tasks[i];
+        // Carried back rather than let loose on a helper thread, where it would
+        // end the process. Rethrown below, on the caller's, in walk order.
+        try {
+            task.outcome = walk(task);
+        } catch (...) {
+            task.thrown = std::current_exception();
+            return false;
+        }
+        return task.outcome.has_value();
+    });
+
+    // Folded on this thread, in walk order. Every task before the first failure
+    // ran, so stopping at it reports what the sequential walk reported.
+    //
+    // A sampled class carries its spreads beside its figures until they are
+    // all in, and takes its intervals from the sums: the samples are
+    // independent, so it is the variances that add, not the intervals.
+    struct class_spreads {
+        bool sampled = false;
+        estimate_spread payload;
+        estimate_spread unused;
+        /// By size, floor and variance only. A size's ceiling is its floor plus
+        /// every unread entry of the class, including those of generations
+        /// whose sample never met the size.
+        std::vector<estimate_spread> buckets;
+        uint64_t unread = 0;
+    };
+    estimate_spread report_payload;
+    estimate_spread report_unused;
+    uint64_t entries_read = 0;
+
+    size_t next = 0;
+    auto const fold_generations = [&](class_census& cls, size_t slot,
+                                      std::vector<uint64_t>* histogram,
+                                      class_spreads& spreads) -> result<> {
+        for (; next < tasks.size() && tasks[next].slot == slot; ++next) {
+            auto& task = tasks[next];
+            if (task.thrown) std::rethrow_exception(task.thrown);
+            if ( ! task.outcome) return task.outcome;
+            ++report.files_examined;
+            if (task.reused) ++report.generations_reused;
+            ++cls.generations;
+            if ( ! checked_add(report.entries_examined, task.gen.entries)
+                    || ! fold_into_class(cls, task.gen)) {
+                return std::unexpected(error_code::entry_corrupt);
+            }
+            // Bounded by the entries just checked, and every size by the class's
+            // capacity, which accumulate_full() refused to see exceeded.
+            if (histogram != nullptr) {
+                for (auto const& b : task.histogram) (*histogram)[b.payload_size] += b.entries;
+                spreads.buckets.resize(histogram->size());
+                for (size_t i = 0; i < task.histogram.size(); ++i) {
+                    auto const size = task.histogram[i].payload_size;
+                    spreads.buckets[size] += task.sampled
+                        ? task.bucket_spreads[i]
+                        : estimate_spread::exact(task.histogram[i].entries);
+                }
+            }
+            entries_read += task.entries_read;
+            spreads.payload += task.payload_spread;
+            spreads.unused += task.unused_spread;
+            if (task.sampled) {
+                spreads.sampled = true;
+                spreads.unread += task.gen.entries - task.entries_read;
+            }
+            if (options.per_generation_detail) cls.generations_detail.push_back(std::move(task.gen));
+        }
+        return {};
+    };
+
+    if (reference) {
         class_census cls;
         cls.container_class = 0;
         cls.container_size = 0;   // not a size class; see census.hpp
@@ -386,63 +751,21 @@ result<census_report> database_impl::census(census_options const& options) const
         cls.physical_allocated_bytes = options.measure_physical_blocks
             ? optional_bytes{0, metric_status::measured, "summed over the generations of this class"}
             : optional_bytes{0, metric_status::not_applicable, "not requested"};
+        cls.resident_bytes = options.measure_residency
+            ? optional_bytes{0, metric_status::measured, "summed over the generations of this class"}
+            : optional_bytes{0, metric_status::not_applicable, "not requested"};
 
-        for (auto const version : reference_catalog_.versions()) {
-            generation_census gen;
-            gen.generation = version;
-            gen.active = (version == reference_current_version_);
-            auto const path = data_path(reference_sentinel_index, version);
-            if (auto ok = file_facts(path, gen); ! ok) return std::unexpected(ok.error());
-
-            if (gen.active && reference_container_ != nullptr && reference_segment_) {
-                if (auto ok = accumulate_reference(reference_map(), gen); ! ok) {
-                    return std::unexpected(ok.error());
-                }
-                gen.segment_size_bytes = reference_segment_->get_size();
-                gen.segment_free_bytes = reference_segment_->get_free_memory();
-            } else {
-                auto opened = open_existing_segment(path);
-                if ( ! opened) return std::unexpected(opened.error());
-                // The same check the ordinary open makes, for the same reason: a
-                // mapped segment is not yet a segment of *this* database, and a
-                // file renamed into a name that is not its own would otherwise be
-                // counted as the generation it is pretending to be.
-                if (auto stamped = validate_stamp(
-                        **opened, path,
-                        expected_identity(reference_container_kind, version)); ! stamped) {
-                    return std::unexpected(stamped.error());
-                }
-                auto found = find_single_named<reference_map_t>(**opened, map_object_name, path);
-                if ( ! found) return std::unexpected(found.error());
-                if (auto ok = accumulate_reference(**found, gen); ! ok) {
-                    return std::unexpected(ok.error());
-                }
-                gen.segment_size_bytes = (*opened)->get_size();
-                gen.segment_free_bytes = (*opened)->get_free_memory();
-            }
-
-            if (auto ok = finish_generation(gen, cls.pair_size); ! ok) {
-                return std::unexpected(ok.error());
-            }
-            ++report.files_examined;
-            ++cls.generations;
-            if ( ! checked_add(report.entries_examined, gen.entries)
-                    || ! fold_into_class(cls, gen)) {
-                return std::unexpected(error_code::entry_corrupt);
-            }
-            if (options.per_generation_detail) cls.generations_detail.push_back(gen);
+        class_spreads spreads;
+        if (auto ok = fold_generations(cls, 0, nullptr, spreads); ! ok) {
+            return std::unexpected(ok.error());
         }
-
         if ( ! fold_into_report(report, cls)) {
             return std::unexpected(error_code::entry_corrupt);
         }
         report.classes.push_back(std::move(cls));
     } else {
-        // The classes are distinct types, so they are visited by a fold rather
-        // than by a loop. `for_each_index` would do, but it is defined in
-        // database_impl.cpp and so cannot be called from here.
         std::optional<error_code> failure;
-        auto const walk_class = [&]<size_t Index>(std::integral_constant<size_t, Index>) {
+        auto const fold_class = [&]<size_t Index>(std::integral_constant<size_t, Index>) {
             if (failure) return;
             constexpr size_t Size = container_sizes[Index];
 
@@ -461,62 +784,49 @@ result<census_report> database_impl::census(census_options const& options) const
                 ? optional_bytes{0, metric_status::measured,
                                  "summed over the generations of this class"}
                 : optional_bytes{0, metric_status::not_applicable, "not requested"};
+            cls.resident_bytes = options.measure_residency
+                ? optional_bytes{0, metric_status::measured,
+                                 "summed over the generations of this class"}
+                : optional_bytes{0, metric_status::not_applicable, "not requested"};
 
             std::vector<uint64_t> histogram(cls.payload_capacity + 1, 0);
-
-            for (auto const version : catalogs_[Index].versions()) {
-                generation_census gen;
-                gen.generation = version;
-                gen.active = (version == current_versions_[Index]);
-                auto const path = data_path(Index, version);
-                if (auto ok = file_facts(path, gen); ! ok) { failure = ok.error(); return; }
-
-                if (gen.active && segments_[Index]) {
-                    auto ok = accumulate_full<Size>(Index, container<Index>(), gen, histogram);
-                    if ( ! ok) { failure = ok.error(); return; }
-                    gen.segment_size_bytes = segments_[Index]->get_size();
-                    gen.segment_free_bytes = segments_[Index]->get_free_memory();
-                } else {
-                    auto opened = open_existing_segment(path);
-                    if ( ! opened) { failure = opened.error(); return; }
-                    // As above: mapped is not the same as ours, and a census that
-                    // counted a misplaced file would report a database that does
-                    // not exist.
-                    if (auto stamped = validate_stamp(
-                            **opened, path,
-                            expected_identity(uint32_t(Index), version)); ! stamped) {
-                        failure = stamped.error(); return;
-                    }
-                    auto found = find_single_named<utxo_map<Size>>(**opened, map_object_name, path);
-                    if ( ! found) { failure = found.error(); return; }
-                    auto ok = accumulate_full<Size>(Index, **found, gen, histogram);
-                    if ( ! ok) { failure = ok.error(); return; }
-                    gen.segment_size_bytes = (*opened)->get_size();
-                    gen.segment_free_bytes = (*opened)->get_free_memory();
-                }
-
-                if (auto ok = finish_generation(gen, cls.pair_size); ! ok) {
-                    failure = ok.error(); return;
-                }
-                ++report.files_examined;
-                ++cls.generations;
-                if ( ! checked_add(report.entries_examined, gen.entries)
-                        || ! fold_into_class(cls, gen)) {
-                    failure = error_code::entry_corrupt; return;
-                }
-                if (options.per_generation_detail) cls.generations_detail.push_back(gen);
+            class_spreads spreads;
+            if (auto ok = fold_generations(cls, Index, &histogram, spreads); ! ok) {
+                failure = ok.error(); return;
             }
-
             cls.payload_histogram = compact_histogram(histogram);
+            if (spreads.sampled) {
+                cls.entry_payload_interval = interval_of(cls.entry_payload_bytes, spreads.payload);
+                cls.unused_payload_capacity_interval =
+                    interval_of(cls.unused_payload_capacity.bytes, spreads.unused);
+                cls.payload_histogram_status = metric_status::estimated;
+                for (auto& b : cls.payload_histogram) {
+                    auto spread = spreads.buckets[b.payload_size];
+                    spread.ceiling = spread.floor + spreads.unread;
+                    b.interval = interval_of(b.entries, spread);
+                }
+            }
+            report_payload += spreads.payload;
+            report_unused += spreads.unused;
             if ( ! fold_into_report(report, cls)) { failure = error_code::entry_corrupt; return; }
             report.classes.push_back(std::move(cls));
         };
         [&]<size_t... Is>(std::index_sequence<Is...>) {
-            (walk_class(std::integral_constant<size_t, Is>{}), ...);
+            (fold_class(std::integral_constant<size_t, Is>{}), ...);
         }(std::make_index_sequence<container_count>{});
         if (failure) return std::unexpected(*failure);
     }
 
+    if (report.entry_payload_status == metric_status::estimated) {
+        report.entry_payload_interval = interval_of(report.entry_payload_bytes, report_payload);
+        report.unused_payload_capacity_interval =
+            interval_of(report.unused_payload_capacity.bytes, report_unused);
+    }
+    if (sampling) {
+        report.sampling = {options.sample_fraction, options.sample_min_entries,
+                           sample_confidence, entries_read};
+    }
+
     report.duration_ms = static_cast<uint64_t>(
         std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - started).count());
@@ -572,18 +882,48 @@ std::string json_optional(optional_bytes const& v) {
                        json_string(v.detail));
 }
 
+std::string json_interval(estimate_interval const& i) {
+    return fmt::format("[{}, {}]", i.low, i.high);
+}
+
+/// An estimate: the point, and the interval it comes with.
+std::string json_estimated(optional_bytes const& v, estimate_interval const& i) {
+    return fmt::format(R"({{"status": {}, "bytes": {}, "interval": {}, "detail": {}}})",
+                       json_string(to_string(v.status)), v.bytes, json_interval(i),
+                       json_string(v.detail));
+}
+
 /// The byte decomposition of one generation or one class, with each figure under
 /// the kind of number it is. The grouping is the point: `exact` was read,
-/// `modelled` was computed from the certified layout, `residual` is what the
-/// subtraction left, and adding across the groups is the reader's decision to
-/// make knowingly.
+/// `estimated` was read in part, `modelled` was computed from the certified
+/// layout, `residual` is what the subtraction left, and adding across the
+/// groups is the reader's decision to make knowingly.
 template <typename T>
 std::string json_bytes(T const& x, bool include_payload_capacity = true) {
-    std::string out = "\"exact\": {";
-    out += fmt::format(R"("entry_payload_bytes": {}, )", x.entry_payload_bytes);
-    if (include_payload_capacity) {
-        out += fmt::format(R"("unused_payload_capacity": {}, )",
-                           json_optional(x.unused_payload_capacity));
+    std::string out;
+    bool const estimated = x.entry_payload_status == metric_status::estimated;
+    if (estimated) {
+        // The two payload figures move here together: they are one sample
+        // read two ways. A sampled census that leaves a figure in `exact` has
+        // read all of it.
+        out += "\"estimated\": {";
+        out += fmt::format(R"("entry_payload_bytes": {{"status": {}, "bytes": {}, "interval": {}}})",
+                           json_string(to_string(x.entry_payload_status)),
+                           x.entry_payload_bytes, json_interval(x.entry_payload_interval));
+        if (include_payload_capacity) {
+            out += fmt::format(R"(, "unused_payload_capacity": {})",
+                               json_estimated(x.unused_payload_capacity,
+                                              x.unused_payload_capacity_interval));
+        }
+        out += "}, ";
+    }
+    out += "\"exact\": {";
+    if ( ! estimated) {
+        out += fmt::format(R"("entry_payload_bytes": {}, )", x.entry_payload_bytes);
+        if (include_payload_capacity) {
+            out += fmt::format(R"("unused_payload_capacity": {}, )",
+                               json_optional(x.unused_payload_capacity));
+        }
     }
     out += fmt::format(R"("object_padding_bytes": {}, )", x.object_padding_bytes);
     out += fmt::format(R"("segment_size_bytes": {}, )", x.segment_size_bytes);
@@ -598,8 +938,8 @@ std::string json_bytes(T const& x, bool include_payload_capacity = true) {
 
     out += fmt::format(R"("residual": {{"unattributed_allocated_bytes": {}}}, )",
                        json_optional(x.unattributed_allocated_bytes));
-    out += fmt::format(R"("platform": {{"physical_allocated_bytes": {}}})",
-                       json_optional(x.physical_allocated_bytes));
+    out += fmt::format(R"("platform": {{"physical_allocated_bytes": {}, "resident_bytes": {}}})",
+                       json_optional(x.physical_allocated_bytes), json_optional(x.resident_bytes));
     return out;
 }
 
@@ -621,9 +961,18 @@ std::string to_json(census_report const& r) {
                        r.source.declared_external_snapshot ? "true" : "false",
                        json_string(to_string(r.source.consistency)));
     out += fmt::format("  \"walk\": {{\"duration_ms\": {}, \"files_examined\": {}, "
-                       "\"entries_examined\": {}, \"physical_measurement_method\": {}}},\n",
-                       r.duration_ms, r.files_examined, r.entries_examined,
+                       "\"generations_reused\": {}, \"entries_examined\": {}, "
+                       "\"physical_measurement_method\": {}}},\n",
+                       r.duration_ms, r.files_examined, r.generations_reused, r.entries_examined,
                        json_string(to_string(r.physical_measurement)));
+    if (r.sampling.fraction > 0.0) {
+        out += fmt::format("  \"sampling\": {{\"fraction\": {}, \"min_entries\": {}, "
+                           "\"confidence\": {}, \"entries_read\": {}}},\n",
+                           r.sampling.fraction, r.sampling.min_entries,
+                           r.sampling.confidence, r.sampling.entries_read);
+    } else {
+        out += "  \"sampling\": null,\n";
+    }
 
     out += fmt::format("  \"totals\": {{\"entries\": {}, {}}},\n", r.entries, json_bytes(r));
 
@@ -640,12 +989,18 @@ std::string to_json(census_report const& r) {
         out += json_bytes(c);
         out += ",\n     \"payload_histogram\": {";
         out += fmt::format(R"("status": {}, )", json_string(to_string(c.payload_histogram_status)));
-        if (c.payload_histogram_status == metric_status::measured) {
+        if (c.payload_histogram_status == metric_status::measured
+                || c.payload_histogram_status == metric_status::estimated) {
+            bool const estimated = c.payload_histogram_status == metric_status::estimated;
             out += "\"buckets\": [";
             for (size_t b = 0; b < c.payload_histogram.size(); ++b) {
-                out += fmt::format(R"({{"payload_size": {}, "entries": {}}}{})",
-                                   c.payload_histogram[b].payload_size,
-                                   c.payload_histogram[b].entries,
+                auto const& bucket = c.payload_histogram[b];
+                out += fmt::format(R"({{"payload_size": {}, "entries": {}{}}}{})",
+                                   bucket.payload_size, bucket.entries,
+                                   estimated
+                                       ? fmt::format(R"(, "interval": {})",
+                                                     json_interval(bucket.interval))
+                                       : std::string(),
                                    b + 1 < c.payload_histogram.size() ? ", " : "");
             }
             out += "]}";
@@ -677,6 +1032,24 @@ std::string human(optional_bytes const& v) {
     return fmt::format("{}", v.bytes);
 }
 
+std::string human(uint64_t point, estimate_interval const& i) {
+    return fmt::format("~{} ({}..{})", point, i.low, i.high);
+}
+
+std::string human_payload(auto const& x) {
+    if (x.entry_payload_status != metric_status::estimated) {
+        return fmt::format("{}", x.entry_payload_bytes);
+    }
+    return human(x.entry_payload_bytes, x.entry_payload_interval);
+}
+
+std::string human_unused(auto const& x) {
+    if (x.unused_payload_capacity.status != metric_status::estimated) {
+        return human(x.unused_payload_capacity);
+    }
+    return human(x.unused_payload_capacity.bytes, x.unused_payload_capacity_interval);
+}
+
 } // namespace
 
 std::string to_text(census_report const& r) {
@@ -686,9 +1059,20 @@ std::string to_text(census_report const& r) {
     out += fmt::format("geometry {}  map layout {}  hash {}  platform abi {}  statistics {}\n",
                        r.geometry_id, r.map_layout_epoch, r.hash_epoch, r.platform_abi_id,
                        r.statistics_enabled ? "on" : "off");
-    out += fmt::format("walked {} files and {} entries in {} ms; physical allocation by {}\n\n",
+    out += fmt::format("walked {} files and {} entries in {} ms; physical allocation by {}\n",
                        r.files_examined, r.entries_examined, r.duration_ms,
                        to_string(r.physical_measurement));
+    if (r.generations_reused > 0) {
+        out += fmt::format("{} of the files unchanged since an earlier census; their entries "
+                           "were counted from its records\n", r.generations_reused);
+    }
+    if (r.sampling.fraction > 0.0) {
+        out += fmt::format("sampled: read {} of those entries, {} of each file and at least {}; "
+                           "figures marked ~ are estimates, with {:g}% intervals\n",
+                           r.sampling.entries_read, r.sampling.fraction,
+                           r.sampling.min_entries, r.sampling.confidence * 100.0);
+    }
+    out += "\n";
 
     out += "Stored entries, not distinct outpoints: a key present in two places is\n"
            "counted in both. The logical state is a separate walk.\n";
@@ -704,9 +1088,10 @@ std::string to_text(census_report const& r) {
                            c.container_class, c.container_size, c.payload_capacity, c.pair_size);
         out += fmt::format("  entries {}  generations {}  active generation {}\n",
                            c.entries, c.generations, c.active_generation);
-        out += "  exact:\n";
-        out += fmt::format("    payload in entries        {}\n", c.entry_payload_bytes);
-        out += fmt::format("    payload capacity unused   {}\n", human(c.unused_payload_capacity));
+        out += c.entry_payload_status == metric_status::estimated
+            ? "  exact, apart from the estimates marked ~:\n" : "  exact:\n";
+        out += fmt::format("    payload in entries        {}\n", human_payload(c));
+        out += fmt::format("    payload capacity unused   {}\n", human_unused(c));
         out += fmt::format("    object padding            {}\n", c.object_padding_bytes);
         out += fmt::format("    segment size              {}\n", c.segment_size_bytes);
         out += fmt::format("    segment free              {}\n", c.segment_free_bytes);
@@ -721,34 +1106,43 @@ std::string to_text(census_report const& r) {
         out += "  platform:\n";
         out += fmt::format("    physically allocated      {}\n",
                            human(c.physical_allocated_bytes));
+        out += fmt::format("    resident in page cache    {}\n", human(c.resident_bytes));
 
         if (c.payload_histogram_status == metric_status::measured) {
             out += fmt::format("  payload sizes present: {}\n", c.payload_histogram.size());
             for (auto const& b : c.payload_histogram) {
                 out += fmt::format("    {:>6} bytes  {:>12} entries\n", b.payload_size, b.entries);
             }
+        } else if (c.payload_histogram_status == metric_status::estimated) {
+            out += fmt::format("  payload sizes the sample met: {}\n", c.payload_histogram.size());
+            for (auto const& b : c.payload_histogram) {
+                out += fmt::format("    {:>6} bytes  {:>12} entries  ({}..{})\n",
+                                   b.payload_size, fmt::format("~{}", b.entries),
+                                   b.interval.low, b.interval.high);
+            }
         } else {
             out += fmt::format("  payload histogram: {}\n", to_string(c.payload_histogram_status));
         }
 
         for (auto const& g : c.generations_detail) {
-            out += fmt::format("  generation {}{}  entries {}  buckets {}  load {:.4f}{}\n",
+            out += fmt::format("  generation {}{}  entries {}  buckets {}  load {:.4f}  resident {}{}\n",
                                g.generation, g.active ? " (active)" : "", g.entries,
-                               g.bucket_count, g.load_factor(),
+                               g.bucket_count, g.load_factor(), human(g.resident_bytes),
                                g.model_inconsistent ? "  MODEL INCONSISTENT" : "");
         }
         out += "\n";
     }
 
     out += fmt::format("totals: entries {}  payload {}  unused capacity {}\n",
-                       r.entries, r.entry_payload_bytes, human(r.unused_payload_capacity));
+                       r.entries, human_payload(r), human_unused(r));
     out += fmt::format("        segment size {}  free {}  logical files {}\n",
                        r.segment_size_bytes, r.segment_free_bytes, r.logical_file_bytes);
     out += fmt::format("        slots occupied {}  empty {}  group metadata {}\n",
                        r.occupied_slot_bytes, r.empty_slot_bytes,
                        r.estimated_group_metadata_bytes);
-    out += fmt::format("        unattributed {}  physically allocated {}\n",
-                       human(r.unattributed_allocated_bytes), human(r.physical_allocated_bytes));
+    out += fmt::format("        unattributed {}  physically allocated {}  resident {}\n",
+                       human(r.unattributed_allocated_bytes), human(r.physical_allocated_bytes),
+                       human(r.resident_bytes));
     return out;
 }
 
@@ -0,0 +1,223 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file compaction.cpp
+ * @brief Describing the generations to the planner, and the plan as JSON.
+ *
+ * The planning itself is in detail/compaction_planner.hpp. What lives here is
+ * the part only the database can do — reading its own catalogue, capacity table
+ * and lookup counters into a `class_profile` per class — and the presentation.
+ * The merging is in database_impl.cpp with the rest of the merge protocol,
+ * because that is where the protocol's templates are instantiated.
+ */
+
+#include <utxoz/compaction.hpp>
+
+#include "detail/census_arithmetic.hpp"
+#include "detail/compaction_planner.hpp"
+#include "detail/database_impl.hpp"
+
+#include <utxoz/config.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace utxoz {
+
+char const* to_string(compaction_strategy s) noexcept {
+    switch (s) {
+        case compaction_strategy::greedy: return "greedy";
+        case compaction_strategy::tiered: return "tiered";
+        case compaction_strategy::leveled: return "leveled";
+        case compaction_strategy::size_ratio: return "size_ratio";
+    }
+    return "greedy";
+}
+
+namespace detail {
+
+namespace {
+
+/// What iterating a map of this many buckets reads: every slot, and the group
+/// metadata in front of them. Saturates rather than wrapping; a figure this
+/// large is already not a plan anybody will execute.
+uint64_t table_bytes_of(uint64_t bucket_count, uint64_t pair_size) noexcept {
+    uint64_t slots = 0;
+    uint64_t groups = 0;
+    if ( ! checked_mul(bucket_count, pair_size, slots)
+            || ! group_metadata_model(bucket_count, groups)
+            || ! checked_add(slots, groups)) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return slots;
+}
+
+/// The file a generation occupies. One `stat`; a file that cannot be sized is
+/// priced at the size the policy creates, which is what it was made with.
+uint64_t file_bytes_of(fs::path const& path, uint64_t fallback) noexcept {
+    std::error_code ec;
+    auto const size = fs::file_size(path, ec);
+    return ec ? fallback : uint64_t(size);
+}
+
+} // namespace
+
+/**
+ * Fills in one profile per class and hands them to the planner.
+ *
+ * The target's bucket count is the one a new map is built with, forced capacity
+ * included, rather than any generation's: a sealed generation may be a fitted
+ * merge target a few steps below it, and planning against that would cap every
+ * group at whatever the last merge happened to leave.
+ *
+ * Each generation is described by its own table, though, since a fitted one
+ * holds as much as its step takes and is read for as long as its table is. The
+ * active one's bucket count is its open map's; a sealed one's is read from the
+ * length of its file (bucket_count_of_file), and is the configured one when
+ * that says nothing.
+ *
+ * Generations a live snapshot pins are left out, as merge_groups() leaves them.
+ */
+compaction_plan database_impl::plan_compaction(compaction_options const& options) const {
+    std::vector<class_profile> classes;
+
+    auto const describe = [&](uint64_t container_class, version_catalog const& catalogue,
+                              size_t active, std::optional<size_t> active_entries,
+                              std::optional<size_t> active_buckets,
+                              size_t bucket_count, uint64_t file_size, uint64_t pair_size,
+                              class_lookup_summary const& lookups, size_t data_index) {
+        class_profile cls;
+        cls.container_class = container_class;
+        cls.target_limit = max_size_without_rehash(bucket_count);
+        cls.target_buckets = bucket_count;
+        cls.target_file_bytes = file_size;
+        cls.target_table_bytes = table_bytes_of(bucket_count, pair_size);
+        capacity_entry const configured{size_t(file_size), bucket_count, bucket_count, false};
+#if UTXOZ_STATISTICS_LEVEL >= 2
+        cls.probes_known = true;
+#endif
+        // Positions below the active generation, nearest first: the order a
+        // sweep probes them, which is what the histogram counts.
+        auto const below = catalogue.below(active);
+        for (auto const version : catalogue.versions()) {
+            // A generation a snapshot pins is not offered, and no group may span
+            // it: the class is handed over as the runs on either side, which
+            // every strategy already keeps apart.
+            if (snapshots_->pinned(data_index, version)) {
+                if ( ! cls.generations.empty()) {
+                    classes.push_back(cls);
+                    cls.generations.clear();
+                }
+                continue;
+            }
+            generation_profile gen;
+            gen.version = version;
+            gen.file_bytes = file_bytes_of(data_path(data_index, version), file_size);
+            gen.active = version == active;
+            size_t const buckets = gen.active && active_buckets
+                ? *active_buckets
+                : bucket_count_of_file(configured, gen.file_bytes, bucket_count);
+            gen.limit = max_size_without_rehash(buckets);
+            gen.table_bytes = table_bytes_of(buckets, pair_size);
+            if (version == active && active_entries) {
+                gen.entries = *active_entries;
+            } else if (auto const* meta = catalogue.find_metadata(version)) {
+                gen.entries = meta->entry_count;
+            }
+            if (auto const pos = std::ranges::find(below, version); pos != below.end()) {
+                gen.probe_reach = probes_reaching(lookups.probe_ordinal_histogram,
+                                                  size_t(pos - below.begin()) + 1);
+            }
+            cls.generations.push_back(gen);
+        }
+        if ( ! cls.generations.empty() || classes.empty()
+             || classes.back().container_class != container_class) {
+            classes.push_back(std::move(cls));
+        }
+    };
+
+    if (mode_ == storage_mode::reference) {
+        bool const open = reference_container_ != nullptr;
+        describe(reference_class, reference_catalog_, reference_current_version_,
+                 open ? std::optional<size_t>(reference_map().size()) : std::nullopt,
+                 open ? std::optional<size_t>(reference_map().bucket_count()) : std::nullopt,
+                 capacity_for_reference(),
+                 reference_capacity_.file_size, sizeof(reference_map_t::value_type),
+                 lookup_stats_[0].get_summary(), reference_sentinel_index);
+    } else {
+        // A fold, for the reason census() gives: for_each_index is defined in
+        // database_impl.cpp and cannot be called from here.
+        [&]<size_t... Is>(std::index_sequence<Is...>) {
+            ([&] {
+                constexpr size_t Index = Is;
+                using map_type = utxo_map<container_sizes[Index]>;
+                bool const open = containers_[Index] != nullptr;
+                describe(Index, catalogs_[Index], current_versions_[Index],
+                         open ? std::optional<size_t>(container<Index>().size()) : std::nullopt,
+                         open ? std::optional<size_t>(container<Index>().bucket_count())
+                              : std::nullopt,
+                         capacity_for(Index),
+                         capacity_[Index].file_size, sizeof(typename map_type::value_type),
+                         lookup_stats_[Index].get_summary(), Index);
+            }(), ...);
+        }(std::make_index_sequence<container_count>{});
+    }
+
+    return detail::plan_compaction(classes, options);
+}
+
+} // namespace detail
+
+// =============================================================================
+// Presentation
+// =============================================================================
+
+std::string to_json(compaction_plan const& p) {
+    std::string out;
+    out += "{\n";
+    out += fmt::format("  \"strategy\": \"{}\",\n", to_string(p.strategy));
+    out += fmt::format("  \"generations\": {{\"considered\": {}, \"too_full\": {}, \"unknown\": {}}},\n",
+                       p.generations_considered, p.generations_too_full, p.generations_unknown);
+    out += fmt::format("  \"totals\": {{\"bytes_read\": {}, \"bytes_written\": {}, "
+                       "\"bytes_reclaimed\": {}, \"files_removed\": {}, \"groups_over_budget\": {}}},\n",
+                       p.bytes_read, p.bytes_written, p.bytes_reclaimed, p.files_removed,
+                       p.groups_over_budget);
+    out += "  \"groups\": [\n";
+    for (size_t i = 0; i < p.groups.size(); ++i) {
+        auto const& g = p.groups[i];
+        std::string sources;
+        for (size_t s = 0; s < g.sources.size(); ++s) {
+            if (s != 0) sources += ", ";
+            sources += fmt::format("{}", g.sources[s]);
+        }
+        // The reference class is not a size class and is written as a string,
+        // never as the sentinel's numeric value.
+        auto const cls = g.container_class == reference_class
+            ? std::string("\"reference\"") : fmt::format("{}", g.container_class);
+        out += fmt::format("    {{\"container_class\": {}, \"sources\": [{}], \"entries\": {}, "
+                           "\"source_fill\": {:.4f}, \"target_fill\": {:.4f}, "
+                           "\"bytes_read\": {}, \"bytes_written\": {}, \"bytes_reclaimed\": {}, "
+                           "\"probes_saved\": {{\"status\": \"{}\", \"count\": {}}}, "
+                           "\"score\": {:.6f}}}{}\n",
+                           cls, sources, g.entries, g.source_fill, g.target_fill,
+                           g.bytes_read, g.bytes_written, g.bytes_reclaimed,
+                           to_string(g.probes_saved_status),
+                           g.probes_saved_status == metric_status::measured
+                               ? fmt::format("{}", g.probes_saved) : std::string("null"),
+                           g.score, i + 1 < p.groups.size() ? "," : "");
+    }
+    out += "  ]\n";
+    out += "}\n";
+    return out;
+}
+
+} // namespace utxoz
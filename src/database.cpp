@@ -8,6 +8,7 @@
  */
 
 #include <utxoz/database.hpp>
+#include <utxoz/snapshot.hpp>
 #include "detail/database_impl.hpp"
 
 namespace utxoz {
@@ -79,11 +80,50 @@ result<> db_base::sync() {
     return impl_->sync();
 }
 
-result<> db_base::compact_all() {
+std::shared_future<result<>> db_base::sync_async() {
+    // The refusals of sync(), and for its reasons, delivered the one way a
+    // future can be.
+    auto const refused = [](error_code code) {
+        std::promise<result<>> promise;
+        promise.set_value(std::unexpected(code));
+        return promise.get_future().share();
+    };
+    if ( ! impl_) return refused(error_code::closed);
+    if (auto const intact = impl_->refuse_if_integrity_latched(); ! intact) {
+        return refused(intact.error());
+    }
+    if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) {
+        return refused(usable.error());
+    }
+    return impl_->sync_async();
+}
+
+result<> db_base::compact_all(compaction_concurrency const& concurrency) {
     if (!impl_) return std::unexpected(error_code::closed);
     if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
     if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) return std::unexpected(usable.error());
-    return impl_->compact_all();
+    return impl_->compact_all(concurrency);
+}
+
+result<compaction_plan> db_base::plan_compaction(compaction_options const& options) const {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
+    if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) return std::unexpected(usable.error());
+    return impl_->plan_compaction(options);
+}
+
+result<compaction_plan> db_base::compact(compaction_options const& options) {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
+    if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) return std::unexpected(usable.error());
+    return impl_->compact(options);
+}
+
+result<std::vector<active_rebuild>> db_base::rebuild_active(rebuild_options const& options) {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
+    if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) return std::unexpected(usable.error());
+    return impl_->rebuild_active(options);
 }
 
 result<> db_base::for_each_key_impl(void(*cb)(void*, raw_outpoint const&), void* ctx) const {
@@ -93,7 +133,7 @@ result<> db_base::for_each_key_impl(void(*cb)(void*, raw_outpoint const&), void*
     return impl_->for_each_key_impl(cb, ctx);
 }
 
-database_statistics db_base::get_statistics() {
+database_statistics db_base::get_statistics() const {
     if (!impl_) return {};
     return impl_->get_statistics();
 }
@@ -159,6 +199,51 @@ void db_base::reset_search_stats() {
     if (impl_) impl_->reset_search_stats();
 }
 
+latency_snapshot db_base::get_latency_snapshot() const {
+    if (!impl_) return {};
+    return impl_->get_latency_snapshot();
+}
+
+void db_base::reset_latency_stats() {
+    if (impl_) impl_->reset_latency_stats();
+}
+
+statistics_level db_base::set_statistics_level(statistics_level level) noexcept {
+    return impl_ ? impl_->set_statistics_level(level) : statistics_level::off;
+}
+
+statistics_level db_base::get_statistics_level() const noexcept {
+    return impl_ ? impl_->get_statistics_level() : statistics_level::off;
+}
+
+void db_base::start_tracing(trace_options const& options) {
+    if (impl_) impl_->start_tracing(options);
+}
+
+void db_base::stop_tracing() noexcept {
+    if (impl_) impl_->stop_tracing();
+}
+
+trace_capture db_base::drain_trace() {
+    if (!impl_) return {};
+    return impl_->drain_trace();
+}
+
+stats_snapshot db_base::get_stats_snapshot() const {
+    if (!impl_) return {};
+    return impl_->get_stats_snapshot();
+}
+
+database_statistics db_base::get_counter_statistics() const {
+    if (!impl_) return {};
+    return impl_->get_counter_statistics();
+}
+
+std::string db_base::to_openmetrics() const {
+    if (!impl_) return utxoz::to_openmetrics(database_statistics{});
+    return utxoz::to_openmetrics(impl_->get_counter_statistics(), impl_->get_latency_snapshot());
+}
+
 float db_base::get_cache_hit_rate() const {
     return impl_ ? impl_->get_cache_hit_rate() : 0.0f;
 }
@@ -215,6 +300,20 @@ result<bool> full_db::insert(raw_outpoint const& key, output_data_span value, ui
     return impl_->insert(key, value, height);
 }
 
+insertion_progress full_db::insert_batch(std::span<insert_request const> requests) {
+    // Refused whole, the way a deletion batch is: every request still owed.
+    auto refuse = [&](error_code why) {
+        insertion_progress refused;
+        refused.unapplied.assign(requests.begin(), requests.end());
+        refused.error = why;
+        return refused;
+    };
+    if ( ! impl_) return refuse(error_code::closed);
+    if (auto const ready = impl_->refuse_if_unusable(); ! ready) return refuse(ready.error());
+    if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) return refuse(usable.error());
+    return impl_->insert_batch(requests);
+}
+
 result<full_find_result> full_db::find(raw_outpoint const& key, uint32_t height) const {
     if (!impl_) return std::unexpected(error_code::closed);
     if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
@@ -233,6 +332,13 @@ result<full_resolution> full_db::resolve(std::span<lookup_request const> request
     return impl_->full_resolve(requests);
 }
 
+result<full_snapshot> full_db::snapshot() {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
+    if (auto const usable = impl_->refuse_if_inspection_only(); ! usable) return std::unexpected(usable.error());
+    return impl_->snapshot();
+}
+
 result<> full_db::for_each_entry_impl(void(*cb)(void*, raw_outpoint const&, uint32_t, std::span<uint8_t const>), void* ctx) const {
     if ( ! impl_) return std::unexpected(error_code::closed);
     if (auto const ready = impl_->refuse_if_unusable(); ! ready) return std::unexpected(ready.error());
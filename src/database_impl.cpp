@@ -11,19 +11,27 @@
 #include "detail/database_impl.hpp"
 
 #include <utxoz/config.hpp>
+#include <utxoz/snapshot.hpp>
 #include <utxoz/utils.hpp>
 
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <numeric>
 #include <ranges>
 #include <optional>
 #include <set>
+#include <string_view>
+#include <system_error>
+#include <thread>
 
 #include <fmt/format.h>
 
+#include "detail/bulk_load.hpp"
 #include "detail/log.hpp"
+#include "detail/page_faults.hpp"
 #include "detail/path_display.hpp"
+#include "detail/spread_over_threads.hpp"
 #include "detail/system_entropy.hpp"
 
 namespace utxoz::detail {
@@ -62,6 +70,16 @@ std::vector<size_t> working_set_of(std::span<Request const> requests) {
     return pending;
 }
 
+/// Threads an open spreads its per-file work over. Each holds one mapping at a
+/// time, and past a handful the directory and the page cache are the limit.
+constexpr size_t max_open_threads = 8;
+
+/// The threads spread_over_threads() is given for `count` pieces of open work.
+size_t open_threads_for(size_t count) {
+    auto const hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    return std::min({count, hardware, max_open_threads});
+}
+
 } // namespace
 
 deletion_progress refuse_deletions(std::span<deferred_deletion_entry const> requests,
@@ -194,9 +212,9 @@ result<> database_impl::open_existing_container(size_t version) {
     if ( ! found) return std::unexpected(found.error());
 
     segments_[Index] = std::move(*opened);
-    containers_[Index] = *found;
+    publish_active_map(Index, *found);
     rehash_watch_[Index].reset((*found)->bucket_count());
-    current_versions_[Index] = version;
+    active_pages_[Index].attach(segments_[Index]->get_address(), segments_[Index]->get_size());
     return {};
 }
 
@@ -260,9 +278,9 @@ result<> database_impl::create_container(size_t version) {
     }
 
     segments_[Index] = std::move(segment);
-    containers_[Index] = map;
+    publish_active_map(Index, map);
     rehash_watch_[Index].reset(map->bucket_count());
-    current_versions_[Index] = version;
+    active_pages_[Index].attach(segments_[Index]->get_address(), segments_[Index]->get_size());
     published = true;
     return {};
 }
@@ -272,8 +290,11 @@ void database_impl::close_container() {
     if (segments_[Index]) {
         save_metadata_to_disk(Index, current_versions_[Index]);
         segments_[Index]->flush();
+        // Retired before it is unmapped, never after: a find() already inside
+        // the map holds the lock this waits for. See active_maps_lock_.
+        publish_active_map(Index, nullptr);
         segments_[Index].reset();
-        containers_[Index] = nullptr;
+        active_pages_[Index].detach();
     }
 }
 
@@ -307,9 +328,15 @@ void database_impl::new_version() {
         throw std::runtime_error(fmt::format("container {} could not rotate to v{}", Index, next));
     }
 
-    catalogs_[Index].add(next);
-    catalogs_[Index].metadata(next) = file_metadata{};
-    log::debug("Container {} rotated to version {}", Index, current_versions_[Index]);
+    // The version becomes current with the catalogue entry that names it, under
+    // the same lock: another class's publication must never see one without
+    // the other. See change_layout().
+    change_layout([&] {
+        catalogs_[Index].add(next);
+        catalogs_[Index].metadata(next) = file_metadata{};
+        current_versions_[Index] = next;
+    });
+    log::debug("Container {} rotated to version {}", Index, next);
 }
 
 // =============================================================================
@@ -457,25 +484,254 @@ void database_impl::save_metadata_to_disk(size_t index, size_t version) noexcept
     }
 }
 
-void database_impl::load_metadata_from_disk(size_t index, size_t version) {
-    auto const path = db_path_ / fmt::format("meta_{}_v{:05}.dat", index, version);
-
-    auto record = read_metadata_file(path);
+void database_impl::adopt_metadata_record(
+    size_t index, size_t version, std::expected<file_metadata, metadata_read_error> const& record) {
+    bool const reference = index == reference_sentinel_index;
     if ( ! record) {
         // Nothing is created for this version: absent and damaged both leave the
         // metadata *unknown*, which every consumer must already handle, and
         // which is the only safe reading of a record we cannot trust. The
         // version file itself is untouched and fully searchable either way.
-        report_metadata_read_error(record.error(), fmt::format("container {}", index), version);
+        report_metadata_read_error(record.error(),
+                                   reference ? std::string("the reference container")
+                                             : fmt::format("container {}", index),
+                                   version);
         return;
     }
 
-    auto& meta = catalogs_[index].metadata(version);
+    auto& meta = (reference ? reference_catalog_ : catalogs_[index]).metadata(version);
     meta = *record;
     meta.container_index = index;
     meta.version = version;
 }
 
+/**
+ * Everything a scanned open reads below the active generations.
+ *
+ * The count cannot be skipped: size() is exact, and it is a running total from
+ * here on — insert() adds to it and apply_deletes() subtracts — so the open is
+ * where every sealed generation has to be mapped once. What can be skipped is
+ * doing it one file at a time. Each generation is its own mapping, its own
+ * stamp and its own metadata record, and reading one has nothing to do with
+ * reading another, so they are spread over a few threads and only the sums and
+ * the catalogue updates are done here, afterwards, on the calling one.
+ *
+ * A manifest the open believed skips all of this; see manifest_io.hpp.
+ *
+ * The generations are handed out class by class, nearest first, which is the
+ * order the loop this replaced read them in, and the error returned is the
+ * first one in that order — the same refusal a database with two damaged files
+ * always gave.
+ */
+result<> database_impl::scan_sealed_generations() {
+    struct generation {
+        size_t index = 0;
+        size_t version = 0;
+        bool sealed = false;
+        size_t entries = 0;
+        result<> outcome;
+        std::expected<file_metadata, metadata_read_error> record =
+            std::unexpected(metadata_read_error::absent);
+    };
+
+    std::vector<generation> work;
+    auto list = [&](size_t index, version_catalog const& catalog) {
+        auto const& versions = catalog.versions();
+        for (auto v = versions.rbegin(); v != versions.rend(); ++v) {
+            auto& g = work.emplace_back();
+            g.index = index;
+            g.version = *v;
+            g.sealed = *v != catalog.active();
+        }
+    };
+    if (mode_ == storage_mode::reference) {
+        list(reference_sentinel_index, reference_catalog_);
+    } else {
+        for (size_t i = 0; i < container_count; ++i) list(i, catalogs_[i]);
+    }
+
+    // The catalogue says this version is here, so being unable to read it is
+    // not a smaller database — it is one this instance cannot describe.
+    // Carrying on would publish a size() short by whatever the file held, and
+    // hand back something that looks healthy until an operation happens to
+    // reach that generation.
+    auto count = [&]<typename Map>(std::type_identity<Map>, generation& g) -> result<> {
+        auto const file_name = data_path(g.index, g.version);
+        auto const kind = g.index == reference_sentinel_index ? reference_container_kind
+                                                              : uint32_t(g.index);
+        auto opened = open_existing_segment(file_name);
+        if ( ! opened) return std::unexpected(opened.error());
+        // The stamp before the map: this is the first thing that reads a
+        // historical version, so it is the first place a file that is not what
+        // the catalogue thinks would be believed.
+        if (auto const stamped = validate_stamp(**opened, file_name,
+                                                expected_identity(kind, g.version));
+            ! stamped) {
+            return std::unexpected(stamped.error());
+        }
+        auto const found = find_single_named<Map>(**opened, map_object_name, file_name);
+        if ( ! found) return std::unexpected(found.error());
+        g.entries = (*found)->size();
+        return {};
+    };
+
+    spread_over_threads(work.size(), open_threads_for(work.size()), "open",
+                        [&](size_t i) {
+        auto& g = work[i];
+        try {
+            if (g.sealed) {
+                g.outcome = g.index == reference_sentinel_index
+                    ? count(std::type_identity<reference_map_t>{}, g)
+                    : std::visit([&](auto I) {
+                          return count(std::type_identity<utxo_map<container_sizes[I]>>{}, g);
+                      }, make_index_variant(g.index));
+            }
+            if (g.outcome) g.record = read_metadata_file(metadata_path(g.index, g.version));
+        } catch (std::exception const& e) {
+            log::error("open: {} v{} could not be read: {}", g.index, g.version, e.what());
+            g.outcome = std::unexpected(error_code::file_open_failed);
+        }
+        return g.outcome.has_value();
+    });
+
+    for (auto const& g : work) {
+        if ( ! g.outcome) return g.outcome;
+    }
+    for (auto const& g : work) {
+        entries_count_ += g.entries;
+        adopt_metadata_record(g.index, g.version, g.record);
+    }
+    return {};
+}
+
+// =============================================================================
+// database_impl - Manifest
+// =============================================================================
+
+manifest database_impl::build_manifest(manifest_state state) const {
+    manifest m;
+    m.state = state;
+    m.mode = mode_;
+    m.database_id = database_id_;
+    m.sequence = manifest_sequence_;
+    bool const closed = state == manifest_state::closed;
+    if (closed) m.entries = entries_count_.load(std::memory_order_relaxed);
+
+    auto describe = [&](version_catalog const& catalog, uint32_t kind) {
+        manifest_class cls;
+        cls.kind = kind;
+        cls.generations.reserve(catalog.size());
+        for (auto const v : catalog.versions()) {
+            manifest_generation g;
+            g.version = v;
+            g.stamp_digest = stamp_digest(expected_identity(kind, v));
+            if (closed) {
+                if (auto const* meta = catalog.find_metadata(v)) g.metadata = *meta;
+            }
+            cls.generations.push_back(std::move(g));
+        }
+        return cls;
+    };
+
+    if (mode_ == storage_mode::reference) {
+        m.classes.push_back(describe(reference_catalog_, reference_container_kind));
+        if (closed && reference_segment_) m.classes[0].active_entries = reference_map().size();
+    } else {
+        for_each_index<container_count>([&](auto I) {
+            m.classes.push_back(describe(catalogs_[I], uint32_t(I.value)));
+            if (closed && segments_[I]) m.classes.back().active_entries = container<I>().size();
+        });
+    }
+    return m;
+}
+
+void database_impl::publish_manifest(manifest_state state) noexcept {
+    // On the rotation and merge paths, which report nothing about derived data;
+    // see save_metadata_to_disk().
+    try {
+        ++manifest_sequence_;
+        if (auto const written = write_manifest_file(db_path_ / manifest_file_name,
+                                                     build_manifest(state));
+            ! written) {
+            log::warn("{}: could not republish the manifest", path_display(db_path_));
+        }
+    } catch (...) {
+    }
+}
+
+result<std::optional<manifest>> database_impl::adopt_manifest() {
+    auto const path = db_path_ / manifest_file_name;
+    auto found = read_manifest_file(path);
+    if ( ! found) {
+        if (found.error() != metadata_read_error::absent) {
+            log::info("{}: the manifest cannot be read; scanning", path_display(db_path_));
+        }
+        return std::nullopt;
+    }
+    // Carried on whatever happens next, so a manifest this instance writes is
+    // always newer than the one it found.
+    manifest_sequence_ = found->sequence;
+
+    auto refuse = [&](std::string_view why) -> result<std::optional<manifest>> {
+        log::info("{}: {}; scanning", path_display(db_path_), why);
+        return std::nullopt;
+    };
+
+    if (found->state != manifest_state::closed) {
+        return refuse("the last writer did not close");
+    }
+    if (found->mode != mode_ || found->database_id != database_id_) {
+        return refuse("the manifest belongs to another database");
+    }
+    for (auto const& cls : found->classes) {
+        for (auto const& g : cls.generations) {
+            if (g.stamp_digest != stamp_digest(expected_identity(cls.kind, g.version))) {
+                return refuse("the manifest was written under another format");
+            }
+        }
+    }
+
+    auto const matches = directory_matches_manifest(db_path_, *found);
+    if ( ! matches) return std::unexpected(matches.error());
+    if ( ! *matches) return refuse("the directory has changed since the manifest");
+
+    return std::optional<manifest>(std::move(*found));
+}
+
+result<> database_impl::claim_manifest() {
+    auto const path = db_path_ / manifest_file_name;
+    ++manifest_sequence_;
+    auto const written = write_manifest_file(path, build_manifest(manifest_state::open),
+                                             metadata_sync::durable);
+    if (written || written.error() == error_code::sync_failed) {
+        // Published either way. Its barrier failing leaves a crash able to bring
+        // back the one it replaced, which is worth saying and not worth
+        // refusing the open for: the ordinary metadata carries the same risk.
+        if ( ! written) {
+            log::warn("{}: the manifest was rewritten without a barrier", path_display(db_path_));
+        }
+        manifest_owned_ = true;
+        return {};
+    }
+
+    // Not replaced, so whatever was there still is — and it may say `closed`.
+    std::error_code ec;
+    fs::remove(path, ec);
+    if (ec && ec != std::errc::no_such_file_or_directory) {
+        log::error("{}: the manifest can be neither rewritten nor removed",
+                   path_display(db_path_));
+        return std::unexpected(error_code::metadata_write_failed);
+    }
+    if (auto const synced = sync_directory(db_path_);
+        ! synced && synced.error() != error_code::sync_unsupported) {
+        return std::unexpected(synced.error());
+    }
+    log::warn("{}: the manifest could not be rewritten and was removed; the next open will scan",
+              path_display(db_path_));
+    manifest_owned_ = true;
+    return {};
+}
+
 // =============================================================================
 // database_impl - Public interface: configure, close, size
 // =============================================================================
@@ -512,6 +768,9 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
                                            storage_mode mode, open_intent intent) {
     db_path_ = std::move(path);
     inspection_only_ = (intent == open_intent::inspection);
+    readers_.reset();
+    manifest_sequence_ = 0;
+    manifest_owned_ = false;
 
     // Every filesystem question here is asked so that "I could not tell" comes
     // back as an error. Asked the throwing way, an unreadable directory raises
@@ -577,7 +836,10 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
 
         auto const end = fs::directory_iterator{};
         while (it != end) {
-            if (it->path().filename() != database_lock::file_name) {
+            // The reader board stays too, for the same reason: a reader holds
+            // its inode. This open rewrites it below.
+            if (it->path().filename() != database_lock::file_name
+                && it->path().filename() != reader_board_file_name) {
                 fs::remove_all(it->path(), ec);
                 if (ec) return std::unexpected(error_code::catalog_unreadable);
             }
@@ -678,14 +940,31 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
     // here still compiles and hands over an empty base path. Every historical
     // version file would then be looked for in the working directory.
     file_cache_ = std::make_unique<file_cache>(db_path_, database_id_);
+    file_cache_->set_trace(&trace_);
 
     entries_count_ = 0;
+    stats_.clear_staged();
+
+    // What the last close knew, if it can be believed; see manifest_io.hpp. A
+    // database just removed has none, and ignoring it is the scan on demand.
+    std::optional<manifest> trusted;
+    if ( ! remove_existing && ! failpoints::ignore_manifest.load(std::memory_order_relaxed)) {
+        auto adopted = adopt_manifest();
+        if ( ! adopted) return std::unexpected(adopted.error());
+        trusted = std::move(*adopted);
+    }
 
     // Before any container is opened, so an intermediate state left by a
     // previous process is never observable. With nothing in flight this costs
-    // one directory listing per container, which open() already does.
-    if (auto const recovered = recover_pending_merges(); ! recovered) {
-        return std::unexpected(recovered.error());
+    // one listing of the directory.
+    //
+    // Not when the manifest was adopted: that took a pass over the directory
+    // that found no merge record, build or stray beside the generations, which
+    // is everything recovery looks for.
+    if ( ! trusted) {
+        if (auto const recovered = recover_pending_merges(); ! recovered) {
+            return std::unexpected(recovered.error());
+        }
     }
 
     if (mode_ == storage_mode::reference) {
@@ -695,11 +974,15 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
         // Build the catalogue before anything is opened. A directory we cannot
         // read is not an empty directory: opening on that assumption would
         // create v0 over a database that already has versions in it.
-        auto listed = enumerate_versions(db_path_, "compact_v");
-        if ( ! listed) return std::unexpected(listed.error());
-
         reference_catalog_.clear();
-        for (auto const v : *listed) reference_catalog_.add(v);
+        if (trusted) {
+            // Already held to the directory; see adopt_manifest().
+            for (auto const& g : trusted->classes[0].generations) reference_catalog_.add(g.version);
+        } else {
+            auto listed = enumerate_versions(db_path_, "compact_v");
+            if ( ! listed) return std::unexpected(listed.error());
+            for (auto const v : *listed) reference_catalog_.add(v);
+        }
 
         // A config with no generations behind it is not a database to open: it is
         // the shape a database has for the instant between its config being
@@ -727,34 +1010,22 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
         reference_catalog_.add(latest_version);   // a fresh database has just created it
         entries_count_ += reference_map().size();
 
-        // Count entries in previous versions (still searchable/deletable)
-        for (auto const v : reference_catalog_.below(latest_version)) {
-            auto file_name = db_path_ / fmt::format(reference_data_file_format, v);
-            // The catalogue says this version is here, so being unable to read
-            // it is not a smaller database — it is one this instance cannot
-            // describe. Carrying on would publish a size() short by whatever the
-            // file held, and hand back something that looks healthy until an
-            // operation happens to reach that generation. The count is also a
-            // running total from here on: insert() adds to it and apply_deletes()
-            // subtracts, so a wrong starting point stays wrong for the life of
-            // the instance.
-            auto opened = open_existing_segment(file_name);
-            if ( ! opened) return std::unexpected(opened.error());
-            // The stamp before the map, here too: this is the first thing that
-            // reads a historical version, so it is the first place a file that
-            // is not what the catalogue thinks would be believed.
-            if (auto const stamped = validate_stamp(
-                    **opened, file_name, expected_identity(reference_container_kind, v));
-                ! stamped) {
-                return std::unexpected(stamped.error());
-            }
-            auto const found = find_single_named<reference_map_t>(**opened, map_object_name, file_name);
-            if ( ! found) return std::unexpected(found.error());
-            entries_count_ += (*found)->size();
+        // The last thing the manifest is held to, now that the map is here to
+        // measure: an active generation written to after the close that
+        // recorded it is a manifest describing some other state.
+        if (trusted && trusted->classes[0].active_entries != reference_map().size()) {
+            log::info("{}: the manifest does not describe the active generation; scanning",
+                      path_display(db_path_));
+            trusted.reset();
         }
 
-        for (auto const v : reference_catalog_.versions()) {
-            reference_load_metadata(v);
+        if (trusted) {
+            entries_count_ = trusted->entries;
+            for (auto const& g : trusted->classes[0].generations) {
+                if (g.metadata) reference_catalog_.metadata(g.version) = *g.metadata;
+            }
+        } else if (auto const scanned = scan_sealed_generations(); ! scanned) {
+            return scanned;
         }
     } else {
         // Full mode: 5 containers
@@ -763,18 +1034,24 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
         // As above: every container's catalogue is read before any of them is
         // opened, and a failure to read one aborts the open rather than being
         // taken for an empty container.
-        result<> catalog_error;
-        for_each_index<container_count>([&](auto I) {
-            if ( ! catalog_error.has_value()) return;
-            auto listed = enumerate_versions(db_path_, fmt::format("cont_{}_v", I.value));
-            if ( ! listed) {
-                catalog_error = std::unexpected(listed.error());
-                return;
+        for (auto& catalog : catalogs_) catalog.clear();
+        if (trusted) {
+            // Already held to the directory; see adopt_manifest().
+            for (size_t i = 0; i < container_count; ++i) {
+                for (auto const& g : trusted->classes[i].generations) catalogs_[i].add(g.version);
             }
-            catalogs_[I].clear();
-            for (auto const v : *listed) catalogs_[I].add(v);
-        });
-        if ( ! catalog_error.has_value()) return catalog_error;
+        } else {
+            // Every class in one pass over the directory.
+            std::vector<version_family> families;
+            for (size_t i = 0; i < container_count; ++i) {
+                families.push_back({fmt::format("cont_{}_v", i)});
+            }
+            auto const listed = enumerate_version_families(db_path_, families);
+            if ( ! listed) return std::unexpected(listed.error());
+            for (size_t i = 0; i < container_count; ++i) {
+                for (auto const v : (*listed)[i]) catalogs_[i].add(v);
+            }
+        }
 
         // See the reference branch. Every class of a database that was created
         // has at least version zero, so all five catalogues empty means the
@@ -797,6 +1074,8 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
 
         // As with the catalogue above, the first container that cannot be
         // described stops the open; the ones after it are not even mapped.
+        // Every active generation first, so the manifest can be held to their
+        // sizes before anything else is read on its word.
         result<> count_error;
         for_each_index<container_count>([&](auto I) {
             if ( ! count_error.has_value()) return;
@@ -825,47 +1104,83 @@ result<> database_impl::configure_internal(fs::path path, bool remove_existing,
                 return;
             }
             catalogs_[I].add(latest_version);   // a fresh database has just created it
+            current_versions_[I] = latest_version;
 
             // Count existing entries in active container
             entries_count_ += container<I>().size();
+        });
+        if ( ! count_error.has_value()) return count_error;
 
-            // Count entries in previous versions (still searchable/deletable)
-            for (auto const v : catalogs_[I].below(latest_version)) {
-                auto file_name = db_path_ / fmt::format(data_file_format, I.value, v);
-                // See the reference branch: a catalogued version this instance
-                // cannot read is not a smaller database.
-                auto opened = open_existing_segment(file_name);
-                if ( ! opened) {
-                    count_error = std::unexpected(opened.error());
-                    return;
-                }
-                // See the reference branch: the stamp is checked before the map.
-                if (auto const stamped = validate_stamp(
-                        **opened, file_name, expected_identity(uint32_t(I.value), v));
-                    ! stamped) {
-                    count_error = std::unexpected(stamped.error());
-                    return;
-                }
-                auto const found = find_single_named<utxo_map<container_sizes[I]>>(
-                    **opened, map_object_name, file_name);
-                if ( ! found) {
-                    count_error = std::unexpected(found.error());
-                    return;
-                }
-                entries_count_ += (*found)->size();
+        // See the reference branch.
+        if (trusted) {
+            bool agrees = true;
+            for_each_index<container_count>([&](auto I) {
+                auto const held = segments_[I] ? container<I>().size() : 0;
+                agrees = agrees && trusted->classes[I].active_entries == held;
+            });
+            if ( ! agrees) {
+                log::info("{}: the manifest does not describe the active generations; scanning",
+                          path_display(db_path_));
+                trusted.reset();
             }
+        }
 
-            for (auto const v : catalogs_[I].versions()) {
-                load_metadata_from_disk(I, v);
-            }
-        });
-        if ( ! count_error.has_value()) return count_error;
+        if (trusted) {
+            entries_count_ = trusted->entries;
+            for_each_index<container_count>([&](auto I) {
+                for (auto const& g : trusted->classes[I].generations) {
+                    if (g.metadata) catalogs_[I].metadata(g.version) = *g.metadata;
+                }
+            });
+        } else if (auto const scanned = scan_sealed_generations(); ! scanned) {
+            return scanned;
+        }
+
+        // Last, once every listed file is there to be mapped. A board that
+        // cannot be kept fails the open: readers would otherwise follow a
+        // layout that has stopped describing the directory.
+        if (intent != open_intent::inspection) {
+            auto board = reader_board_writer::open(db_path_, database_id_);
+            if ( ! board) return std::unexpected(board.error());
+            readers_ = std::move(*board);
+            publish_layout();
+        }
+    }
+
+    // Before this writer can change anything: a `closed` manifest surviving
+    // into the first insert would be believed after a crash.
+    if (intent != open_intent::inspection) {
+        if (auto const claimed = claim_manifest(); ! claimed) return claimed;
     }
 
+    // The sealed files' sizes, once, so that no snapshot after this needs them
+    // again: a stat() each, which reads no page of the file.
+    restage_all_classes();
+
     return {};
 }
 
 void database_impl::close() {
+    // Every request already made is answered before the files are let go.
+    if (group_commit_) group_commit_->stop();
+
+    // A snapshot outlives nothing it relied on: from here it answers `closed`.
+    snapshots_->close();
+
+    // Taken while the active maps are still mapped to be measured, and written
+    // once they are closed. An instance that latched leaves the `open` one: what
+    // it would record is what it stopped trusting.
+    //
+    // Reached from destructors, so nothing may escape building it either.
+    std::optional<manifest> closing;
+    if (manifest_owned_ && ! integrity_latched_) {
+        try {
+            ++manifest_sequence_;
+            closing = build_manifest(manifest_state::closed);
+        } catch (...) {
+        }
+    }
+
     if (mode_ == storage_mode::reference) {
         reference_close_container();
     } else {
@@ -873,10 +1188,28 @@ void database_impl::close() {
             close_container<I>();
         });
     }
+
+    if (closing) {
+        // Best effort, like the metadata written just above: a close that could
+        // not write it costs the next open a scan and nothing else.
+        try {
+            if (auto const written = write_manifest_file(db_path_ / manifest_file_name, *closing);
+                ! written) {
+                log::warn("{}: could not record the manifest; the next open will scan",
+                          path_display(db_path_));
+            }
+        } catch (...) {
+        }
+    }
+    manifest_owned_ = false;
+
+    // The board keeps its last layout: the files it lists are all still there,
+    // and readers go on reading them.
+    readers_.reset();
 }
 
 size_t database_impl::size() const {
-    return entries_count_;
+    return entries_count_.load(std::memory_order_relaxed);
 }
 
 // =============================================================================
@@ -884,6 +1217,7 @@ size_t database_impl::size() const {
 // =============================================================================
 
 result<bool> database_impl::insert(raw_outpoint const& key, output_data_span value, uint32_t height) {
+    writing_ = counting_now();
     if (mode_ == storage_mode::reference) {
         return reference_insert(key, value, height);
     }
@@ -895,13 +1229,116 @@ result<bool> database_impl::insert(raw_outpoint const& key, output_data_span val
         return std::unexpected(error_code::value_too_large);
     }
 
-    return std::visit([&](auto ic) -> result<bool> {
+    auto const stored = std::visit([&](auto ic) -> result<bool> {
         return insert_in_index<ic>(key, value, height);
     }, make_index_variant(index));
+    publish_stats(index, index + 1);
+    return stored;
+}
+
+insertion_progress database_impl::insert_batch(std::span<insert_request const> requests) {
+    // Once for the batch, before any class thread starts: see writing_.
+    writing_ = counting_now();
+    insertion_progress progress;
+
+    // Split by class, each share in the order of the span. A value no class can
+    // hold fails here, as it would in insert(), and takes nothing else with it.
+    std::array<std::vector<size_t>, container_count> shares;
+    std::vector<size_t> too_large;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        auto const index = get_index_from_size(requests[i].value.size());
+        if (index < container_count) {
+            shares[index].push_back(i);
+        } else {
+            too_large.push_back(i);
+        }
+    }
+    if ( ! too_large.empty()) {
+        log::error("insert_batch: {} value(s) too large for any container (max capacity {})",
+                   too_large.size(), container_capacities[container_count - 1]);
+    }
+
+    struct class_outcome {
+        size_t inserted = 0;
+        std::vector<size_t> duplicates;
+        std::vector<size_t> unapplied;
+        std::optional<error_code> error;
+    };
+    std::array<class_outcome, container_count> outcomes;
+
+    auto const apply_share = [&](auto I) {
+        auto& out = outcomes[I.value];
+        auto const& share = shares[I.value];
+        for (size_t n = 0; n < share.size(); ++n) {
+            // Checked per insert, as a caller making them one by one would be
+            // refused: another class latching the instance stops this one at
+            // its next entry, not at the end of its share.
+            std::optional<error_code> stopped;
+            if (integrity_latched_) {
+                stopped = *integrity_latched_;
+            } else {
+                auto const& request = requests[share[n]];
+                auto const stored = insert_in_index<I>(request.key, request.value, request.height);
+                if (stored) {
+                    if (*stored) ++out.inserted;
+                    else out.duplicates.push_back(share[n]);
+                    continue;
+                }
+                stopped = stored.error();
+            }
+            // This one and the rest of the share: a later request could
+            // otherwise land before an earlier one for the same key.
+            out.error = stopped;
+            out.unapplied.assign(share.begin() + std::ptrdiff_t(n), share.end());
+            return;
+        }
+    };
+
+    std::array<bool, container_count> busy{};
+    size_t classes = 0;
+    for (size_t c = 0; c < container_count; ++c) {
+        busy[c] = ! shares[c].empty();
+        classes += busy[c] ? 1 : 0;
+    }
+    if (classes > 1 && requests.size() >= db_base::min_parallel_batch) {
+        for_each_busy_class(busy, apply_share);
+    } else {
+        for_each_index<container_count>([&](auto I) {
+            if (busy[I.value]) apply_share(I);
+        });
+    }
+    // Here, on this thread, once every class's worker is done with its share.
+    publish_stats();
+
+    // Back in the order of the span.
+    std::vector<size_t> duplicates;
+    std::vector<size_t> unapplied = std::move(too_large);
+    if ( ! unapplied.empty()) progress.error = error_code::value_too_large;
+    for (auto& out : outcomes) {
+        progress.inserted += out.inserted;
+        duplicates.insert(duplicates.end(), out.duplicates.begin(), out.duplicates.end());
+        unapplied.insert(unapplied.end(), out.unapplied.begin(), out.unapplied.end());
+        if ( ! progress.error && out.error) progress.error = out.error;
+    }
+    std::ranges::sort(duplicates);
+    std::ranges::sort(unapplied);
+    progress.duplicates.reserve(duplicates.size());
+    for (auto const i : duplicates) progress.duplicates.push_back(requests[i]);
+    progress.unapplied.reserve(unapplied.size());
+    for (auto const i : unapplied) progress.unapplied.push_back(requests[i]);
+    return progress;
 }
 
 template<size_t Index>
 result<> database_impl::rotate_for(rotation_cause cause) {
+    latency_scope const timing(latency_stats_, latency_op::rotation, Index, counting_now().basic);
+    // The file being sealed is the size its segment is mapped at, so it is
+    // measured here, while it still is, rather than by a stat() later.
+    size_t const sealing_bytes = segments_[Index] ? segments_[Index]->get_size() : 0;
+    trace_span span(&trace_, trace_kind::rotation, Index);
+    span.version(current_versions_[Index]);
+    span.bytes(sealing_bytes);
+    span.items(containers_[Index] ? container<Index>().size() : 0);
     try {
         new_version<Index>();
     } catch (std::exception const& e) {
@@ -921,13 +1358,27 @@ result<> database_impl::rotate_for(rotation_cause cause) {
         });
         return std::unexpected(error_code::file_open_failed);
     }
-    if (cause == rotation_cause::preventive) ++rotation_causes_[Index].preventive;
-    else                                     ++rotation_causes_[Index].capacity_exception;
+    switch (cause) {
+        case rotation_cause::preventive:         ++rotation_causes_[Index].preventive; break;
+        case rotation_cause::capacity_exception: ++rotation_causes_[Index].capacity_exception; break;
+        case rotation_cause::snapshot:           ++rotation_causes_[Index].snapshot; break;
+    }
+    auto& staged = stats_.staged(Index);
+    ++staged.sealed_generations;
+    staged.sealed_bytes += sealing_bytes;
+    ++staged.rotations;
+    restage_active(Index);
+    span.succeeded();
     return {};
 }
 
 template<size_t Index>
 result<bool> database_impl::insert_in_index(raw_outpoint const& key, output_data_span value, uint32_t height) {
+    // Here rather than in insert(), so that insert_batch() is timed per entry
+    // and in the class it lands in. A rotation this insert causes is inside it.
+    latency_scope const timing(latency_stats_, latency_op::insert, Index,
+                               writing_.basic && latency_sampled<latency_op::insert>());
+
     // The guard already reads the segment's free bytes, and that is the figure
     // the diagnostic below wants. Taking it from there rather than asking again
     // keeps the common path to one read of the segment header — a different
@@ -1006,11 +1457,17 @@ result<bool> database_impl::insert_in_index(raw_outpoint const& key, output_data
             // and the first comparison ends it.
             if (failpoints::consume_insert_failure()) {
                 if (failpoints::fail_insert_after_mutating.load(std::memory_order_relaxed)) {
+                    auto const announced = announce_write(Index);
                     map.emplace(key, val);
                 }
                 throw bip::bad_alloc();
             }
-            auto [it, inserted] = map.emplace(key, val);
+            // Announced for the emplace and no longer: what follows reads the
+            // map, and readers only ever read it too. See read_active().
+            auto [it, inserted] = [&] {
+                auto const announced = announce_write(Index);
+                return map.emplace(key, val);
+            }();
             if ( ! inserted) {
                 diagnose([&] {
                     log::warn("insert: duplicate key at height {}, outpoint={}, "
@@ -1018,7 +1475,7 @@ result<bool> database_impl::insert_in_index(raw_outpoint const& key, output_data
                 });
             }
             if (inserted) {
-                ++entries_count_;
+                entries_count_.fetch_add(1, std::memory_order_relaxed);
 
                 // The invariant, checked against the count the generation was
                 // opened with rather than against the previous insert: a growth
@@ -1030,16 +1487,33 @@ result<bool> database_impl::insert_in_index(raw_outpoint const& key, output_data
                 // success, because the entry is there.
                 bool const rehashed = note_rehash_if_grown(
                     Index, rehash_watch_[Index], map.bucket_count());
+                note_written(active_pages_[Index], map, *it, rehashed);
 
 #if UTXOZ_STATISTICS_LEVEL >= 1
-                // Update statistics
-                ++container_stats_[Index].total_inserts;
+                // The size is kept whatever is running: it is a state, not an
+                // event, and one missed while counting was off would be wrong
+                // from then on. The rest are events, and only count while on.
                 ++container_stats_[Index].current_size;
-                ++container_stats_[Index].value_size_distribution[value.size()];
-                ++height_range_stats_.ranges[height / height_range_stats::range_size].inserts[Index];
-                if (rehashed) ++container_stats_[Index].rehash_count;
+                if (writing_.basic) {
+                    ++container_stats_[Index].total_inserts;
+                    ++container_stats_[Index].value_size_distribution[value.size()];
+                    ++height_range_stats_[Index].ranges[height_range_stats::range_of(height)].inserts[Index];
+                    if (rehashed) ++container_stats_[Index].rehash_count;
+                }
 #endif
 
+                {
+                    // The guard's reading of the free bytes, from before this
+                    // entry went in: one entry behind, and no second read of
+                    // the segment header to be exact about it.
+                    auto& staged = stats_.staged(Index);
+                    ++staged.active_entries;
+                    ++staged.inserts;
+                    if (free_before != free_bytes_unavailable && free_before <= staged.active_file_bytes) {
+                        staged.active_used_bytes = staged.active_file_bytes - free_before;
+                    }
+                }
+
                 update_metadata_on_insert(Index, current_versions_[Index], key, height);
 
                 if (attempt > 1) {
@@ -1059,6 +1533,10 @@ result<bool> database_impl::insert_in_index(raw_outpoint const& key, output_data
             return inserted;
 
         } catch (bip::bad_alloc const& e) {
+            // The segment's allocator wrote its bookkeeping on the way to the
+            // failure, at addresses nothing here is told about.
+            active_pages_[Index].note_all();
+
             // Read after the throw, from the same map: under the guarantee
             // `emplace` documents these are the figures it had before. All three
             // accessors are `noexcept`, and the probe is best-effort, so reaching
@@ -1182,8 +1660,19 @@ std::optional<find_result> database_impl::find(raw_outpoint const& key, uint32_t
         return reference_find(key, height);
     }
 
+    // One reading per call: a find is the whole operation, so this is the
+    // batch it asks for.
+    auto const counted = counting_now();
+
+    // A miss stays unattributed: no class answered it.
+    latency_scope timing(latency_stats_, latency_op::find, latency_stats::unattributed,
+                         counted.basic && latency_sampled<latency_op::find>());
+
     // Try current version first
-    if (auto res = find_in_latest_version(key, height); res) {
+    if (auto res = find_in_latest_version(key, height, counted); res) {
+        // The class a value of this size is stored in, which is the one that
+        // answered: nothing else puts it anywhere.
+        timing.attribute_to(get_index_from_size(res->data.size()));
         return res;
     }
 
@@ -1192,26 +1681,29 @@ std::optional<find_result> database_impl::find(raw_outpoint const& key, uint32_t
     //
     // The counter is all that happens. The key is not kept: whoever asked keeps
     // it and hands it to resolve() (#116).
-    probe_stats_.record_deferred();
+    if (counted.basic) probe_stats_.record_deferred();
     return std::nullopt;
 }
 
 std::optional<find_result> database_impl::find_in_latest_version(raw_outpoint const& key,
-                                                                  uint32_t height) const {
+                                                                  uint32_t height,
+                                                                  [[maybe_unused]] counting counted) const {
     std::optional<find_result> result;
 
+    // Shared once for every class probed, for as long as any map is read. See
+    // active_maps_lock_.
+    std::shared_lock const reading(active_maps_lock_);
     for_each_index<container_count>([&](auto I) {
         if (!result) {
-            auto& map = container<I>();
-            if (auto it = map.find(key); it != map.end()) {
+            if (auto const copied = copy_from_active<I>(key)) {
 #if UTXOZ_STATISTICS_LEVEL >= 1
-                probe_stats_.record_answered(height, it->second.block_height);
+                if (counted.basic) probe_stats_.record_answered(height, copied->block_height);
 #endif
 #if UTXOZ_STATISTICS_LEVEL >= 2
-                lookup_stats_[I.value].record_answered_from_active();
+                if (counted.lookup) lookup_stats_[I.value].record_answered_from_active();
 #endif
-                auto data = it->second.get_data();
-                result = find_result{bytes(data.begin(), data.end()), it->second.block_height};
+                auto data = copied->get_data();
+                result = find_result{bytes(data.begin(), data.end()), copied->block_height};
             }
         }
     });
@@ -1219,6 +1711,23 @@ std::optional<find_result> database_impl::find_in_latest_version(raw_outpoint co
     return result;
 }
 
+template<size_t Index>
+std::optional<utxo_value<container_sizes[Index]>> database_impl::copy_from_active(raw_outpoint const& key) const {
+    using value_type = utxo_value<container_sizes[Index]>;
+    // Null while a rotation is between generations.
+    if (containers_[Index] == nullptr) return std::nullopt;
+    auto const& map = container<Index>();
+    // Copied as bytes and read only once the counter says they are whole.
+    return read_active(Index, [&] {
+        std::optional<value_type> copied;
+        if (auto const it = map.find(key); it != map.end()) {
+            copied.emplace();
+            std::memcpy(&*copied, &it->second, sizeof(value_type));
+        }
+        return copied;
+    });
+}
+
 // =============================================================================
 // database_impl - Erase
 // =============================================================================
@@ -1229,36 +1738,114 @@ size_t database_impl::erase_in_latest_version(raw_outpoint const& key, uint32_t
 
     for_each_index<container_count>([&](auto I) {
         if (result == 0) {
-            auto& map = container<I>();
-            if (auto it = map.find(key); it != map.end()) {
-#if UTXOZ_STATISTICS_LEVEL >= 1
-                // Track UTXO lifetime
-                uint32_t age = height - it->second.block_height;
-                ++lifetime_stats_.age_distribution[age];
-                lifetime_stats_.max_age = std::max(lifetime_stats_.max_age, age);
-                ++lifetime_stats_.total_spent;
+            if (auto const age = erase_in_active<I>(key, height)) {
+                record_spent(*age);
+                result = 1;
+            }
+        }
+    });
 
-                lifetime_stats_.average_age =
-                    (lifetime_stats_.average_age * (lifetime_stats_.total_spent - 1) + age)
-                    / lifetime_stats_.total_spent;
+    return result;
+}
+
+template<size_t Index>
+std::optional<uint32_t> database_impl::erase_in_active(raw_outpoint const& key,
+                                                        [[maybe_unused]] uint32_t height) {
+    auto& map = container<Index>();
+    auto it = map.find(key);
+    if (it == map.end()) return std::nullopt;
+
+    uint32_t const age = height - it->second.block_height;
+    note_written(active_pages_[Index], map, *it);
+    {
+        auto const announced = announce_write(Index);
+        map.erase(it);
+    }
 
+    --stats_.staged(Index).active_entries;
+    ++stats_.staged(Index).deletes;
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    // A state, kept; events, counted while on. See insert_in_index().
+    --container_stats_[Index].current_size;
+    if (writing_.basic) {
+        ++container_stats_[Index].total_deletes;
+        ++height_range_stats_[Index].ranges[height_range_stats::range_of(height)].deletes[Index];
+    }
 #endif
-                map.erase(it);
+    return age;
+}
 
+void database_impl::record_spent([[maybe_unused]] uint32_t age) {
 #if UTXOZ_STATISTICS_LEVEL >= 1
-                --container_stats_[I].current_size;
-                ++container_stats_[I].total_deletes;
-                ++height_range_stats_.ranges[height / height_range_stats::range_size].deletes[I];
+    if ( ! writing_.basic) return;
+    // Track UTXO lifetime. Nothing here allocates or divides; the average is
+    // derived from total_age when the statistics are read.
+    lifetime_stats_.age_distribution.record(age);
+    lifetime_stats_.max_age = std::max(lifetime_stats_.max_age, age);
+    ++lifetime_stats_.total_spent;
+    lifetime_stats_.total_age += age;
 #endif
+}
 
-                result = 1;
+std::array<std::vector<size_t>, container_count> database_impl::erase_in_actives_concurrently(
+        std::span<deferred_deletion_entry const> requests, std::vector<size_t> const& pending,
+        fault_count& helper_faults) {
+    // Every class looks for every key: a deletion names an outpoint, not the
+    // class its value landed in. Each class writes only its own map, its own
+    // counters and its own list here; the ages go back with the positions,
+    // because the lifetime counters are one set for the whole database.
+    std::array<std::vector<size_t>, container_count> erased;
+    std::array<std::vector<uint32_t>, container_count> ages;
+    std::array<bool, container_count> busy;
+    busy.fill(true);
+
+    // A class a helper took faulted its pages in on the helper's thread, where
+    // the batch's own reading does not look. Each brings its count back.
+    auto const caller = std::this_thread::get_id();
+    std::array<fault_count, container_count> faults{};
+
+    for_each_busy_class(busy, [&](auto I) {
+        bool const helper = writing_.basic && std::this_thread::get_id() != caller;
+        auto const faults_at_start = helper ? thread_faults() : fault_count{};
+        auto& found = erased[I.value];
+        auto& aged = ages[I.value];
+        for (size_t i = 0; i < pending.size(); ++i) {
+            auto const& request = requests[pending[i]];
+            if (auto const age = erase_in_active<I>(request.key, request.height)) {
+                found.push_back(i);
+                aged.push_back(*age);
             }
         }
+        if (helper) faults[I.value] = thread_faults_since(faults_at_start);
     });
 
-    return result;
+    for (auto const& aged : ages) {
+        for (auto const age : aged) record_spent(age);
+    }
+    for (auto const& f : faults) {
+        helper_faults.major += f.major;
+        helper_faults.minor += f.minor;
+    }
+    return erased;
 }
 
+template<typename Work>
+void database_impl::for_each_busy_class(std::array<bool, container_count> const& busy,
+                                        Work&& work) {
+    std::array<size_t, container_count> order{};
+    size_t count = 0;
+    for (size_t i = 0; i < container_count; ++i) {
+        if (busy[i]) order[count++] = i;
+    }
+
+    // One thread per class, the calling one taking the first. A thread the
+    // system will not start leaves its class to the ones that did: the batch
+    // is slower, and still applied in full.
+    spread_over_threads(count, count, "batch", [&](size_t slot) {
+        std::visit([&](auto I) { work(I); }, make_index_variant(order[slot]));
+        return true;
+    });
+}
 
 // =============================================================================
 // database_impl - Deferred deletions
@@ -1266,9 +1853,21 @@ size_t database_impl::erase_in_latest_version(raw_outpoint const& key, uint32_t
 
 
 deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry const> requests) {
+    // Once for the batch, before any class thread starts: see writing_.
+    writing_ = counting_now();
+    latency_scope const timing(latency_stats_, latency_op::apply_deletes, latency_stats::unattributed,
+                               writing_.basic);
     deletion_progress progress;
     if (requests.empty()) return progress;
 
+    // Published on every way out, a throw included: what was erased before it
+    // is erased. The allocated bytes are read again here, once per class,
+    // because an erase frees space no guard measured.
+    scope_exit const publish([&] {
+        for (size_t slot = 0; slot < container_count; ++slot) restage_active(slot);
+        publish_stats();
+    });
+
     // Indices into the caller's batch, deduplicated by key and shrinking as
     // deletions are applied. Nothing is taken: the requests stay in the caller's
     // span and are still the caller's when this returns (#119).
@@ -1294,7 +1893,10 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
 
 #if UTXOZ_STATISTICS_LEVEL >= 1
     auto const start_time = std::chrono::steady_clock::now();
+    // See full_resolve(). The helpers of the concurrent phase add theirs.
+    auto const faults_at_start = writing_.basic ? thread_faults() : fault_count{};
 #endif
+    fault_count helper_faults;
     log::debug("Applying {} deletions ({} distinct)...", requests.size(), pending.size());
 
     // Unlike a resolution, this cannot be transactional: every erase below writes
@@ -1308,7 +1910,35 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
     // Phase 0: the active versions. This is what the old single-key erase() did
     // inline before queueing, and it is the common case: an output spent soon
     // after it was created has not been rotated away yet.
-    {
+    //
+    // A large enough batch searches the classes side by side. The positions each
+    // class erased come back separately and are recorded here, on this thread,
+    // in the order of `pending` — the same lists the sequential walk would have
+    // built, in the same order.
+    if (mode_ == storage_mode::full && pending.size() >= db_base::min_parallel_batch) {
+        std::vector<uint8_t> gone(pending.size(), 0);
+        size_t applied = 0;
+        for (auto const& positions : erase_in_actives_concurrently(requests, pending, helper_faults)) {
+            for (auto const i : positions) {
+                // A key in two active maps is a database already breaking its
+                // own invariant. Both copies went, and both are counted; the
+                // request is reported once.
+                ++applied;
+                gone[i] = 1;
+            }
+        }
+        entries_count_.fetch_sub(applied, std::memory_order_relaxed);
+
+        size_t keep = 0;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (gone[i] != 0) {
+                progress.erased.push_back(requests[pending[i]]);
+                continue;
+            }
+            pending[keep++] = pending[i];
+        }
+        pending.resize(keep);
+    } else {
         size_t keep = 0;
         for (size_t i = 0; i < pending.size(); ++i) {
             auto const idx = pending[i];
@@ -1317,7 +1947,7 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
                 ? reference_erase_in_latest(request.key, request.height)
                 : erase_in_latest_version(request.key, request.height);
             if (applied > 0) {
-                entries_count_ -= applied;
+                entries_count_.fetch_sub(applied, std::memory_order_relaxed);
                 progress.erased.push_back(request);
                 continue;
             }
@@ -1355,8 +1985,10 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
     //
     // The bookkeeping is a parameter rather than a branch inside. Which catalogue
     // a deletion belongs to is a property of the file being walked, and passing it
-    // in is what keeps that decision next to the code that opened the file.
-    auto const step_over_file = [&](auto& map, auto const& record_deletion) {
+    // in is what keeps that decision next to the code that opened the file. So is
+    // the erase itself: a full file may be pinned by a snapshot, which has to be
+    // handed the entry before it goes, and a reference file never is.
+    auto const step_over_file = [&](auto const& erase, auto const& record_deletion) {
         size_t keep = 0;
         size_t i = 0;
         bool current_applied = false;
@@ -1375,14 +2007,14 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
             current_applied = false;
             auto const idx = pending[i];
 
-            if (map.erase(requests[idx].key) == 0) {
+            if (erase(requests[idx].key) == 0) {
                 pending[keep++] = idx;
                 continue;
             }
 
             // The map has changed. Record it before anything that can throw.
             progress.erased.push_back(requests[idx]);
-            --entries_count_;
+            entries_count_.fetch_sub(1, std::memory_order_relaxed);
             current_applied = true;
 
             if (failpoints::fail_delete_after_applied.load(std::memory_order_relaxed)
@@ -1417,19 +2049,21 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
 
             auto [map, cache_hit] = file_cache_->get_or_open_reference_file(version);
             (void) cache_hit;
-            step_over_file(map, [&]([[maybe_unused]] uint32_t height) {
+            auto const erase = [&](raw_outpoint const& key) { return map.erase(key); };
+            step_over_file(erase, [&]([[maybe_unused]] uint32_t height) {
                 note_dirty(reference_sentinel_index, version);
                 if (auto* meta = reference_catalog_.find_metadata(version)) meta->update_on_delete();
                 failpoints::reference_metadata_deletes.fetch_add(1, std::memory_order_relaxed);
+                ++stats_.staged(0).deletes;
 #if UTXOZ_STATISTICS_LEVEL >= 1
                 // The same counters the queue-draining path kept. Reference mode
                 // reports through container 0's slot, as it does everywhere else.
-                auto const depth =
-                    static_cast<uint32_t>(reference_current_version_ - version);
-                ++deferred_stats_.deletions_by_depth[depth];
                 --container_stats_[0].current_size;
-                ++container_stats_[0].total_deletes;
-                ++height_range_stats_.ranges[height / height_range_stats::range_size].deletes[0];
+                if (writing_.basic) {
+                    ++deletions_by_depth_[depth_slot(reference_current_version_ - version)];
+                    ++container_stats_[0].total_deletes;
+                    ++height_range_stats_[0].ranges[height_range_stats::range_of(height)].deletes[0];
+                }
 #endif
             });
         } catch (std::exception const& e) {
@@ -1449,10 +2083,15 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
 
             auto [map, cache_hit] = file_cache_->get_or_open_file<Index>(Index, version);
             (void) cache_hit;
-            step_over_file(map, [&]([[maybe_unused]] uint32_t height) {
+            auto const erase = [&](raw_outpoint const& key) {
+                auto const announced = announce_write(Index);
+                return snapshots_->erase<Index>(version, map, key);
+            };
+            step_over_file(erase, [&]([[maybe_unused]] uint32_t height) {
                 note_dirty(Index, version);
                 update_metadata_on_delete(Index, version);
                 failpoints::full_metadata_deletes.fetch_add(1, std::memory_order_relaxed);
+                ++stats_.staged(Index).deletes;
 #if UTXOZ_STATISTICS_LEVEL >= 1
                 // Restored with the rest of the historical path. Dropping these
                 // made a deletion that reached an older file invisible to every
@@ -1462,11 +2101,12 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
                 //
                 // deferred_deletes is deliberately not among them: it counted how
                 // much was sitting in the queue, and there is no queue to sit in.
-                auto const depth = static_cast<uint32_t>(current_versions_[Index] - version);
-                ++deferred_stats_.deletions_by_depth[depth];
                 --container_stats_[Index].current_size;
-                ++container_stats_[Index].total_deletes;
-                ++height_range_stats_.ranges[height / height_range_stats::range_size].deletes[Index];
+                if (writing_.basic) {
+                    ++deletions_by_depth_[depth_slot(current_versions_[Index] - version)];
+                    ++container_stats_[Index].total_deletes;
+                    ++height_range_stats_[Index].ranges[height_range_stats::range_of(height)].deletes[Index];
+                }
 #endif
             });
         } catch (std::exception const& e) {
@@ -1585,13 +2225,19 @@ deletion_progress database_impl::apply_deletes(std::span<deferred_deletion_entry
     // happened, and the entry count already reflects them. `processing_runs` is
     // not, because it means a run that completed — an incomplete batch that
     // counted one would make the averages describe work that was never done.
-    deferred_stats_.successfully_processed += progress.erased.size();
-    deferred_stats_.failed_to_delete += progress.unresolved.size();
-    if (complete) ++deferred_stats_.processing_runs;
+    if (writing_.basic) {
+        deferred_stats_.successfully_processed += progress.erased.size();
+        deferred_stats_.failed_to_delete += progress.unresolved.size();
+        if (complete) ++deferred_stats_.processing_runs;
 
-    auto const end_time = std::chrono::steady_clock::now();
-    deferred_stats_.total_processing_time +=
-        std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        auto const end_time = std::chrono::steady_clock::now();
+        deferred_stats_.total_processing_time +=
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+        auto const faults = thread_faults_since(faults_at_start);
+        deferred_stats_.major_faults += faults.major + helper_faults.major;
+        deferred_stats_.minor_faults += faults.minor + helper_faults.minor;
+    }
 #endif
 
     log::debug("Deletion batch: {} erased, {} absent, {} unresolved",
@@ -1645,6 +2291,13 @@ fs::path database_impl::metadata_path(size_t index, size_t version) const {
     return db_path_ / fmt::format("meta_{}_v{:05}.dat", index, version);
 }
 
+fs::path database_impl::census_cache_path(size_t index, size_t version) const {
+    if (index == reference_sentinel_index) {
+        return db_path_ / fmt::format("census_compact_v{:05}.dat", version);
+    }
+    return db_path_ / fmt::format("census_{}_v{:05}.dat", index, version);
+}
+
 result<> database_impl::directory_barrier(failpoints::dir_barrier stage) const {
     if (failpoints::fail_directory_barrier_at.load(std::memory_order_relaxed) == stage) {
         return std::unexpected(error_code::sync_failed);
@@ -1740,6 +2393,7 @@ result<> database_impl::recover_one(merge_plan const& plan, fs::path const& side
         }
         if (auto const r = remove_if_present(data_path(plan.container, source)); ! r) return r;
         if (auto const r = remove_if_present(metadata_path(plan.container, source)); ! r) return r;
+        if (auto const r = remove_if_present(census_cache_path(plan.container, source)); ! r) return r;
     }
 
     if (auto const synced = sync_directory(db_path_);
@@ -1763,8 +2417,20 @@ result<> database_impl::recover_one(merge_plan const& plan, fs::path const& side
  * Mandatory phase of open(). Acts only on evidence the store itself wrote, and
  * removes only files whose names are unambiguously in its reserved namespace —
  * anything it does not recognise is left alone.
+ *
+ * One pass over the directory finds every record and stray of every class,
+ * which with nothing in flight is the whole cost. The classes that have
+ * something to recover are then recovered concurrently: each touches only its
+ * own files, and each merge it finishes or abandons is idempotent on its own.
+ * The answer is the first class's failure in class order, as it was when they
+ * ran one after another — though a class after a failing one may now have been
+ * recovered too, which is the state its next open would have produced anyway.
  */
 result<> database_impl::recover_pending_merges() {
+    // Open runs this before there is a handle to start tracing on, so it is
+    // timed every time and set aside for start_tracing(): two clock reads per
+    // open.
+    trace_span span(&trace_, trace_kind::merge_recovery, trace_span::set_aside);
     struct scope { size_t index; std::string prefix; };
     std::vector<scope> scopes;
     if (mode_ == storage_mode::reference) {
@@ -1775,21 +2441,39 @@ result<> database_impl::recover_pending_merges() {
         }
     }
 
+    // Per scope, in this order: the merge records, then the two kinds of
+    // garbage a merge can leave without one.
+    static constexpr std::array<std::pair<std::string_view, char const*>, 3> kinds{{
+        {".merge", "a merge record"},
+        {".dat.building", "an unfinished build"},
+        {".merge.tmp", "an unfinished merge record"},
+    }};
+    std::vector<version_family> families;
+    families.reserve(scopes.size() * kinds.size());
     for (auto const& sc : scopes) {
-        auto listed = enumerate_versions(db_path_, sc.prefix, ".merge");
-        if ( ! listed) return std::unexpected(listed.error());
+        for (auto const& kind : kinds) families.push_back({sc.prefix, kind.first});
+    }
+    auto const listed = enumerate_version_families(db_path_, families);
+    if ( ! listed) return std::unexpected(listed.error());
+    auto const found = [&](size_t s, size_t kind) -> std::vector<size_t> const& {
+        return (*listed)[s * kinds.size() + kind];
+    };
+
+    auto recover_scope = [&](size_t s) -> result<> {
+        auto const& sc = scopes[s];
+        auto const& records = found(s, 0);
 
-        if (listed->size() > 1) {
+        if (records.size() > 1) {
             // One merge is in flight at a time, by construction. Several
             // sidecars mean something happened that this code cannot explain,
             // and choosing between them is exactly the guess that must not be
             // made.
             log::error("Recovery: {} merge records for container {}; refusing to guess",
-                       listed->size(), sc.index);
+                       records.size(), sc.index);
             return std::unexpected(error_code::recovery_failed);
         }
 
-        for (auto const target : *listed) {
+        for (auto const target : records) {
             auto const path = sidecar_path(sc.index, target);
             auto const plan = read_merge_sidecar(path);
             if ( ! plan) {
@@ -1809,23 +2493,51 @@ result<> database_impl::recover_pending_merges() {
 
         // A build with no sidecar never reached publication, and a half-written
         // sidecar never became evidence. Both are garbage, and only names that
-        // parse as ours in the reserved namespace are touched.
-        for (auto const& [suffix, describe] : std::initializer_list<std::pair<char const*, char const*>>{
-                 {".dat.building", "an unfinished build"},
-                 {".merge.tmp", "an unfinished merge record"}}) {
-            auto stray = enumerate_versions(db_path_, sc.prefix, suffix);
-            if ( ! stray) return std::unexpected(stray.error());
-            for (auto const version : *stray) {
-                log::info("Recovery: discarding {} of container {} v{}", describe, sc.index, version);
+        // parse as ours in the reserved namespace are touched. Listed before the
+        // record above was acted on, so one recover_one() already removed is
+        // simply not there to remove again.
+        for (size_t kind = 1; kind < kinds.size(); ++kind) {
+            for (auto const version : found(s, kind)) {
+                log::info("Recovery: discarding {} of container {} v{}", kinds[kind].second,
+                          sc.index, version);
                 if (auto const r = remove_if_present(
-                        db_path_ / fmt::format("{}{:05}{}", sc.prefix, version, suffix));
+                        db_path_ / fmt::format("{}{:05}{}", sc.prefix, version, kinds[kind].first));
                     ! r) {
                     return r;
                 }
             }
         }
+        return {};
+    };
+
+    std::vector<size_t> pending;
+    size_t handled = 0;
+    for (size_t s = 0; s < scopes.size(); ++s) {
+        bool any = false;
+        for (size_t kind = 0; kind < kinds.size(); ++kind) {
+            handled += found(s, kind).size();
+            any = any || ! found(s, kind).empty();
+        }
+        if (any) pending.push_back(s);
     }
+    span.items(handled);
+
+    std::vector<result<>> outcomes(pending.size());
+    spread_over_threads(pending.size(), open_threads_for(pending.size()), "recovery",
+                        [&](size_t j) {
+        try {
+            outcomes[j] = recover_scope(pending[j]);
+        } catch (std::exception const& e) {
+            log::error("Recovery: container {} failed: {}", scopes[pending[j]].index, e.what());
+            outcomes[j] = std::unexpected(error_code::recovery_failed);
+        }
+        return true;
+    });
 
+    for (auto const& outcome : outcomes) {
+        if ( ! outcome) return outcome;
+    }
+    span.succeeded();
     return {};
 }
 
@@ -1859,15 +2571,28 @@ std::string reference_merge_policy::describe(size_t version) const {
 }
 
 template<typename Policy>
-result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const& sources) {
+result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const& sources,
+                                       target_sizing sizing) {
     auto const idx = policy.index();
 
-    if (sources.size() < 2) return {};   // nothing to gain from rewriting one file
+    // One file is rewritten only to shrink it, and whether it would is known once
+    // its entries are counted, below.
+    if (sources.empty()) return {};
+
+    latency_scope const timing(latency_stats_, latency_op::merge,
+                               idx == reference_sentinel_index ? 0 : idx, counting_now().basic);
+    auto const traced_class = idx == reference_sentinel_index ? reference_class : idx;
+    trace_span span(&trace_, trace_kind::merge, traced_class);
+    span.files(sources.size());
+    // The phases are not scopes of this function, so each is ended by the
+    // next one starting, and the last explicitly.
+    std::optional<trace_span> phase;
 
     // A fresh identity, never used before. It must not name anything that
     // exists: publishing over a file would destroy it, and a collision means
     // the catalogue and the directory disagree about what is there.
     size_t const target = policy.catalogue().next_version();
+    span.version(target);
 
     auto const target_exists = path_exists(data_path(idx, target));
     if ( ! target_exists) return std::unexpected(target_exists.error());
@@ -1879,17 +2604,7 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
     // A metadata record for an identity with no data file is the second state
     // removal_failed describes. It must not survive to describe the new file.
     if (auto const r = remove_if_present(metadata_path(idx, target)); ! r) return r;
-
-    // Preventive only: a real ENOSPC during the write stays authoritative. The
-    // peak is one more file at the size this container is configured for, and
-    // containers are merged one at a time so it does not accumulate.
-    std::error_code space_ec;
-    auto const space = fs::space(db_path_, space_ec);
-    if ( ! space_ec && space.available < policy.file_size()) {
-        log::error("compaction: {} needs {} bytes for a new file and {} are available",
-                   policy.describe(target), policy.file_size(), space.available);
-        return std::unexpected(error_code::insufficient_space);
-    }
+    if (auto const r = remove_if_present(census_cache_path(idx, target)); ! r) return r;
 
     auto const building = building_path(idx, target);
     auto const sidecar = sidecar_path(idx, target);
@@ -1909,20 +2624,140 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
         fs::remove(building, ec);
     };
 
+    // Taken once the target's size is known, and held until the target is
+    // built and synced; every earlier exit gives it back on the way out.
+    merge_space_ledger::claim space_claim;
+
     size_t entries_moved = 0;
+    auto begin_phase = [&](trace_kind kind) {
+        phase.emplace(&trace_, kind, traced_class);
+        phase->version(target);
+        phase->files(sources.size());
+        phase->items(entries_moved);
+    };
+    begin_phase(trace_kind::merge_build);
     try {
         std::error_code ec;
         fs::remove(building, ec);   // a leftover from a previous attempt
 
-        auto segment = std::make_unique<bip::managed_mapped_file>(
-            bip::create_only, building.c_str(), policy.file_size());
+        // The kind this container is written as. idx is SIZE_MAX for reference
+        // mode, which is not the same number on every platform, so it never
+        // reaches the file.
+        auto const kind = idx == reference_sentinel_index ? reference_container_kind
+                                                          : uint32_t(idx);
 
-        // Every exit from here to the end of this block discards what was being
-        // built, and there are seven of them. They used to say so one by one,
-        // which is exactly how one came to be missing: a source whose map could
-        // not be reached returned without unmapping or removing the target, and
-        // the .building file survived a failed compaction. Said once, it cannot
-        // be left out of a branch added later.
+        // Every source is opened, validated and found before the target exists,
+        // so the target can be sized to what they hold and the order the entries
+        // go in can be chosen over all of them. The refusals are the ones each
+        // source always had.
+        std::vector<std::unique_ptr<bip::managed_mapped_file>> source_segments;
+        std::vector<typename Policy::map_type const*> source_maps;
+        source_segments.reserve(sources.size());
+        source_maps.reserve(sources.size());
+        for (auto const source : sources) {
+            auto const source_path = data_path(idx, source);
+
+            // Refused, not skipped. Every source is unlinked once the target is
+            // published, so a source that was passed over would have its entries
+            // dropped from the merge and the only copy of them deleted straight
+            // after. Nothing is published unless every source was read.
+            auto opened_source = open_existing_segment(source_path);
+            if ( ! opened_source) {
+                log::error("compaction: {} could not be read; nothing is published",
+                           policy.describe(source));
+                return std::unexpected(opened_source.error());
+            }
+            auto source_segment = std::move(*opened_source);
+
+            if (auto const stamped = validate_stamp(
+                    *source_segment, source_path,
+                    local_identity(database_id_, kind, uint64_t(source)));
+                ! stamped) {
+                log::error("compaction: {} is not this database's to merge; nothing is "
+                           "published", policy.describe(source));
+                return std::unexpected(stamped.error());
+            }
+
+            auto const source_map = Policy::find_map(*source_segment, source_path);
+            if ( ! source_map) {
+                log::error("compaction: {} holds no usable map; nothing is published",
+                           policy.describe(source));
+                return std::unexpected(source_map.error());
+            }
+
+            source_maps.push_back(*source_map);
+            source_segments.push_back(std::move(source_segment));
+        }
+
+        // Every source read ahead at once, before the first entry is placed. A
+        // source that is not in the page cache is otherwise read one fault at a
+        // time, in whatever order the walk touches it (see io_engine.hpp).
+        for (auto const& segment : source_segments) {
+            prefetch_mapping(segment->get_address(), segment->get_size());
+        }
+
+        // Sized to what the sources hold rather than to what the class is
+        // configured for: the smallest step that takes every entry without
+        // growing, in a file scaled to it (see fitted_capacity). A duplicate only
+        // makes the count an overestimate. A forced capacity is a test asking for
+        // exactly that map, and it gets it; a target that becomes the active
+        // generation — a rebuilt one, a group that took the active one in, or
+        // the active one carried back on top — asks for the configured segment,
+        // because it is going to be inserted into (see sizing_for and
+        // keep_active_on_top).
+        uint64_t total_entries = 0;
+        for (auto const* source_map : source_maps) total_entries += source_map->size();
+
+        capacity_entry const configured{policy.file_size(), policy.min_buckets(),
+                                        policy.min_buckets(), false};
+        bool const forced = failpoints::forced_capacity.load(std::memory_order_relaxed) != 0
+            && failpoints::forced_capacity_index.load(std::memory_order_relaxed) == kind;
+        auto const geometry = forced || sizing == target_sizing::configured
+            ? configured
+            : fitted_capacity(configured, total_entries);
+
+        // One source is only worth rewriting into a smaller file, unless the
+        // rewrite is the point. Otherwise it would move every entry to give
+        // back nothing.
+        if (sources.size() == 1 && sizing == target_sizing::fitted
+                && geometry.file_size >= source_segments.front()->get_size()) {
+            log::trace("compaction: {} is already no larger than its entries need",
+                       policy.describe(sources.front()));
+            phase->succeeded();
+            span.succeeded();
+            return {};
+        }
+
+        // Preventive only: a real ENOSPC during the write stays authoritative. The
+        // peak is one more file at the size this target is created with — per
+        // class being merged, because classes can be merged concurrently. So the
+        // file is claimed in the ledger, and whatever the other classes' targets
+        // have claimed and not yet written is counted against the free space.
+        auto claimed = merge_space_.acquire(geometry.file_size, [&]() -> std::optional<uint64_t> {
+            std::error_code space_ec;
+            auto const space = fs::space(db_path_, space_ec);
+            if (space_ec) return std::nullopt;
+            return uint64_t(space.available);
+        });
+        if ( ! claimed) {
+            log::error("compaction: {} needs {} bytes for a new file, more than is available "
+                       "once the {} bytes claimed by merges in flight are counted",
+                       policy.describe(target), geometry.file_size, merge_space_.claimed());
+            return std::unexpected(claimed.error());
+        }
+        space_claim = std::move(*claimed);
+
+        auto segment = std::make_unique<bip::managed_mapped_file>(
+            bip::create_only, building.c_str(), geometry.file_size);
+        span.bytes(geometry.file_size);
+        phase->bytes(geometry.file_size);
+
+        // Every exit from here to the end of this block discards what was being
+        // built. They used to say so one by one, which is exactly how one came
+        // to be missing: a source whose map could not be reached returned without
+        // unmapping or removing the target, and the .building file survived a
+        // failed compaction. Said once, it cannot be left out of a branch added
+        // later.
         //
         // Only up to here. Past this block the target is synced, recorded and
         // renamed, and those steps abandon it deliberately and in an order that
@@ -1934,11 +2769,6 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
             segment.reset();   // unmapped before it is unlinked
             abandon();
         });
-        // The kind this container is written as. idx is SIZE_MAX for reference
-        // mode, which is not the same number on every platform, so it never
-        // reaches the file.
-        auto const kind = idx == reference_sentinel_index ? reference_container_kind
-                                                          : uint32_t(idx);
 
         // A merge target is a file this call just created, so it is stamped
         // before it holds anything — and stamped as the version it will be
@@ -1950,7 +2780,7 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
             return std::unexpected(stamped.error());
         }
 
-        auto* target_map = Policy::construct_map(*segment, policy.min_buckets());
+        auto* target_map = Policy::construct_map(*segment, geometry.capacity);
 
         // The invariant applies here too, and this is where it was missing: a
         // merge that filled the target past its threshold would grow the map it
@@ -1966,94 +2796,94 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
         // Before the barriers, so the marker is as durable as the entries.
         segment->template construct<merge_marker>(merge_marker::object_name)(merge_id);
 
-        for (auto const source : sources) {
-            auto const source_path = data_path(idx, source);
+        // One entry into the target. The same checks whichever order the
+        // entries arrive in.
+        auto place = [&](raw_outpoint const& key,
+                         typename Policy::map_type::mapped_type const& value) -> result<> {
+            try {
+                // Below the limit, `emplace` is the only lookup: it finds
+                // the key or inserts it, and a duplicate comes back as
+                // `!inserted`. At the limit the order matters and the lookup
+                // is worth paying for — a key present in two sources means the
+                // database is locally inconsistent, which sends the caller
+                // somewhere different from "this group is too large", and a
+                // duplicate costs no capacity. So it is asked first, and only
+                // there.
+                if (target_map->size() >= target_limit) {
+                    if (target_map->find(key) != target_map->end()) {
+                        log::error("compaction: duplicate key across the sources of "
+                                   "{}: {}", policy.describe(target),
+                                   outpoint_to_string(key));
+                        return std::unexpected(error_code::duplicate_key);
+                    }
+                    log::debug("compaction: {} holds {} of the {} entries it can take "
+                               "without growing; the caller can retry with fewer "
+                               "sources", policy.describe(target), target_map->size(),
+                               target_limit);
+                    return std::unexpected(error_code::insufficient_space);
+                }
 
-            // Refused, not skipped. Every source is unlinked once the target is
-            // published, so a source that was passed over would have its entries
-            // dropped from the merge and the only copy of them deleted straight
-            // after. Nothing is published unless every source was read.
-            auto opened_source = open_existing_segment(source_path);
-            if ( ! opened_source) {
-                log::error("compaction: {} could not be read; nothing is published",
-                           policy.describe(source));
-                return std::unexpected(opened_source.error());
+                auto const [pos, inserted] = target_map->emplace(key, value);
+                if ( ! inserted) {
+                    // Two sources held the same key. A published state holds
+                    // at most one entry per key, so this is the database
+                    // being locally inconsistent, and it is reported rather
+                    // than resolved: choosing a copy would hide it. Nothing
+                    // canonical has changed at this point.
+                    log::error("compaction: duplicate key across the sources of {}: {}",
+                               policy.describe(target), outpoint_to_string(key));
+                    return std::unexpected(error_code::duplicate_key);
+                }
+                ++entries_moved;
+
+                // Whatever the guard above believed, the map must not have
+                // grown. Checked per entry rather than at the end: a merge
+                // that grew and then carried on would keep writing into a
+                // file that is no longer the one it planned.
+                if (target_map->bucket_count() != target_buckets) {
+                    rehash_watch target_watch;
+                    target_watch.reset(target_buckets);
+                    note_rehash_if_grown(kind, target_watch, target_map->bucket_count());
+                    log::error("compaction: {} grew from {} buckets to {}; nothing is "
+                               "published", policy.describe(target), target_buckets,
+                               target_map->bucket_count());
+                    return std::unexpected(error_code::insufficient_space);
+                }
+                return {};
+            } catch (boost::interprocess::bad_alloc const&) {
+                // The group was planned to fit and did not. Leave every
+                // source exactly as it is and let the caller try a smaller
+                // group; sources are only ever read here.
+                log::debug("compaction: {} filled early, {} entries in",
+                           policy.describe(target), entries_moved);
+                return std::unexpected(error_code::insufficient_space);
             }
-            auto source_segment = std::move(*opened_source);
-
-            if (auto const stamped = validate_stamp(
-                    *source_segment, source_path,
-                    local_identity(database_id_, kind, uint64_t(source)));
-                ! stamped) {
-                log::error("compaction: {} is not this database's to merge; nothing is "
-                           "published", policy.describe(source));
-                return std::unexpected(stamped.error());
+        };
+
+        // In the order the target stores them, so its pages are written front
+        // to back (see bulk_load.hpp). An order that does not fit in memory is
+        // not a reason to refuse the merge: the entries go in source order, as
+        // they always did, and only the writes are scattered.
+        std::optional<std::vector<placement<typename Policy::map_type::value_type>>> order;
+        if ( ! failpoints::streaming_merge.load(std::memory_order_relaxed)) {
+            try {
+                order = placement_order(source_maps);
+            } catch (std::bad_alloc const&) {
+                log::debug("compaction: no memory to order the entries of {}; placing them "
+                           "in source order", policy.describe(target));
             }
+        }
 
-            auto const source_map = Policy::find_map(*source_segment, source_path);
-            if ( ! source_map) {
-                log::error("compaction: {} holds no usable map; nothing is published",
-                           policy.describe(source));
-                return std::unexpected(source_map.error());
+        if (order) {
+            for (auto const& p : *order) {
+                if (auto const placed = place(p.entry->first, p.entry->second); ! placed) {
+                    return placed;
+                }
             }
-
-            for (auto const& [key, value] : **source_map) {
-                try {
-                    // Below the limit, `emplace` is the only lookup: it finds
-                    // the key or inserts it, and a duplicate comes back as
-                    // `!inserted`. At the limit the order matters and the lookup
-                    // is worth paying for — a key present in two sources means the
-                    // database is locally inconsistent, which sends the caller
-                    // somewhere different from "this group is too large", and a
-                    // duplicate costs no capacity. So it is asked first, and only
-                    // there.
-                    if (target_map->size() >= target_limit) {
-                        if (target_map->find(key) != target_map->end()) {
-                            log::error("compaction: duplicate key across the sources of "
-                                       "{}: {}", policy.describe(target),
-                                       outpoint_to_string(key));
-                            return std::unexpected(error_code::duplicate_key);
-                        }
-                        log::debug("compaction: {} holds {} of the {} entries it can take "
-                                   "without growing; the caller can retry with fewer "
-                                   "sources", policy.describe(target), target_map->size(),
-                                   target_limit);
-                        return std::unexpected(error_code::insufficient_space);
-                    }
-
-                    auto const [pos, inserted] = target_map->emplace(key, value);
-                    if ( ! inserted) {
-                        // Two sources held the same key. A published state holds
-                        // at most one entry per key, so this is the database
-                        // being locally inconsistent, and it is reported rather
-                        // than resolved: choosing a copy would hide it. Nothing
-                        // canonical has changed at this point.
-                        log::error("compaction: duplicate key across the sources of {}: {}",
-                                   policy.describe(target), outpoint_to_string(key));
-                        return std::unexpected(error_code::duplicate_key);
-                    }
-                    ++entries_moved;
-
-                    // Whatever the guard above believed, the map must not have
-                    // grown. Checked per entry rather than at the end: a merge
-                    // that grew and then carried on would keep writing into a
-                    // file that is no longer the one it planned.
-                    if (target_map->bucket_count() != target_buckets) {
-                        rehash_watch target_watch;
-                        target_watch.reset(target_buckets);
-                        note_rehash_if_grown(kind, target_watch, target_map->bucket_count());
-                        log::error("compaction: {} grew from {} buckets to {}; nothing is "
-                                   "published", policy.describe(target), target_buckets,
-                                   target_map->bucket_count());
-                        return std::unexpected(error_code::insufficient_space);
-                    }
-                } catch (boost::interprocess::bad_alloc const&) {
-                    // The group was planned to fit and did not. Leave every
-                    // source exactly as it is and let the caller try a smaller
-                    // group; sources are only ever read here.
-                    log::debug("compaction: {} filled early, {} entries in",
-                               policy.describe(target), entries_moved);
-                    return std::unexpected(error_code::insufficient_space);
+        } else {
+            for (auto const* source_map : source_maps) {
+                for (auto const& [key, value] : *source_map) {
+                    if (auto const placed = place(key, value); ! placed) return placed;
                 }
             }
         }
@@ -2080,11 +2910,20 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
 
     failpoints::maybe_crash(failpoints::crash_point::after_build);
 
+    span.items(entries_moved);
+    phase->items(entries_moved);
     if (auto const synced = sync_file(building);
         ! synced && synced.error() != error_code::sync_unsupported) {
         abandon();
         return std::unexpected(synced.error());
     }
+    // Written: the target's blocks are allocated, and the free space the next
+    // claim is checked against already leaves them out. Holding the claim
+    // through publication and retirement would count this file twice and
+    // refuse merges that fit. What is left to write is a sidecar.
+    space_claim.release();
+    phase->succeeded();
+    begin_phase(trace_kind::merge_publish);
 
     failpoints::maybe_crash(failpoints::crash_point::after_file_sync);
 
@@ -2192,17 +3031,24 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
         }
     }
 
+    phase->succeeded();
+    begin_phase(trace_kind::merge_retire);
+
     failpoints::maybe_crash(failpoints::crash_point::before_source_unlink);
 
-    // Published. From here the sources are redundant and the catalogue says so.
-    policy.catalogue().add(target);
-    for (auto const source : sources) {
-        policy.catalogue().remove(source);
-        // The obligation goes with the file. Its entries are in the target,
-        // which was made durable before it was published, so there is nothing
-        // left to flush and nothing left to flush it to.
-        dirty_versions_.erase({idx, source});
-    }
+    // Published. From here the sources are redundant and the catalogue says so,
+    // and readers move to the target before any source goes.
+    change_layout([&] {
+        policy.catalogue().add(target);
+        for (auto const source : sources) {
+            policy.catalogue().remove(source);
+            // The obligation goes with the file. Its entries are in the target,
+            // which was made durable before it was published, so there is
+            // nothing left to flush and nothing left to flush it to.
+            std::lock_guard const lock(dirty_versions_mutex_);
+            dirty_versions_.erase({idx, source});
+        }
+    });
 
     // Retire the sources. Every failure is recorded and the rest are still
     // attempted, but the operation does not report success while any of them
@@ -2228,6 +3074,11 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
             log::error("compaction: could not retire the metadata of {}", policy.describe(source));
             all_retired = false;
         }
+        if (auto const r = retire(census_cache_path(idx, source)); ! r) {
+            log::error("compaction: could not retire the census record of {}",
+                       policy.describe(source));
+            all_retired = false;
+        }
     }
     if (auto const synced = directory_barrier(failpoints::dir_barrier::after_source_retire);
         ! synced && synced.error() != error_code::sync_unsupported) {
@@ -2254,6 +3105,8 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
         log::warn("compaction: the merge record of {} was removed without a barrier",
                   policy.describe(target));
     }
+    phase->succeeded();
+    phase.reset();
 
     // Metadata last, and only now: it describes a file that exists, and it is
     // rebuilt rather than carried over from anything.
@@ -2288,6 +3141,7 @@ result<> database_impl::merge_versions(Policy policy, std::vector<size_t> const&
 
     log::debug("Merged {} files into {}: {} entries",
                sources.size(), policy.describe(target), entries_moved);
+    span.succeeded();
     return {};
 }
 
@@ -2313,7 +3167,14 @@ result<> database_impl::reopen_active_container() {
             cleanup_pending_ = true;
             return std::unexpected(opened.error());
         }
-        catalogs_[Index].add(active);
+        // Other classes may be merging and publishing while this one reopens.
+        // The layout does not change — the version was active before the merge
+        // closed it — so this takes the lock without publishing again.
+        {
+            std::lock_guard const lock(layout_mutex_);
+            catalogs_[Index].add(active);
+            current_versions_[Index] = active;
+        }
         return {};
     } catch (std::exception const& e) {
         log::error("compaction: container {} could not be reopened at v{}: {}", Index, active, e.what());
@@ -2363,9 +3224,25 @@ result<> database_impl::merge_groups(Policy policy) {
     // Groups are whole files. A source is never partially consumed, because a
     // partially consumed one would have to survive holding entries the new file
     // also holds — which is the duplicate this whole design exists to avoid.
+    //
+    // A generation a snapshot pins is neither merged nor merged across: groups
+    // are runs of the versions between pinned ones. The active version is never
+    // pinned — a snapshot seals it first.
+    auto const pinned = [&](size_t v) { return snapshots_->pinned(policy.index(), v); };
+
+    // The generation that is to be active when this is done: the one that is
+    // now, until a group takes it in and its target takes its place.
+    size_t active = policy.catalogue().active();
     size_t first = 0;
     while (first < versions.size()) {
-        size_t count = versions.size() - first;
+        if (pinned(versions[first])) {
+            ++first;
+            continue;
+        }
+        size_t end = first + 1;
+        while (end < versions.size() && ! pinned(versions[end])) ++end;
+
+        size_t count = end - first;
         result<> outcome;
 
         // Try the largest group that is left and shrink until one fits. Sources
@@ -2374,7 +3251,7 @@ result<> database_impl::merge_groups(Policy policy) {
         while (count >= 2) {
             std::vector<size_t> const group(versions.begin() + std::ptrdiff_t(first),
                                             versions.begin() + std::ptrdiff_t(first + count));
-            outcome = merge_versions(policy, group);
+            outcome = merge_versions(policy, group, sizing_for(group, active));
             if (outcome || outcome.error() != error_code::insufficient_space) break;
             --count;
         }
@@ -2384,12 +3261,91 @@ result<> database_impl::merge_groups(Policy policy) {
             ++first;
             continue;
         }
-        if ( ! outcome) return outcome;
+        if ( ! outcome) {
+            // What was published before the failure outranks the active
+            // generation all the same.
+            (void) keep_active_on_top(policy, active);
+            return outcome;
+        }
+        if ( ! policy.catalogue().contains(active)) active = policy.catalogue().active();
 
         first += count;
     }
 
-    return {};
+    return keep_active_on_top(policy, active);
+}
+
+template<typename Policy>
+result<> database_impl::merge_planned(Policy policy, uint64_t container_class,
+                                      compaction_plan const& plan, compaction_plan& merged) {
+    // See merge_groups().
+    size_t active = policy.catalogue().active();
+    for (auto const& group : plan.groups) {
+        if (group.container_class != container_class) continue;
+
+        std::vector<size_t> const sources(group.sources.begin(), group.sources.end());
+        // A plan made before a snapshot was taken can name what it now pins.
+        if (std::ranges::any_of(sources, [&](size_t v) {
+                return snapshots_->pinned(policy.index(), v);
+            })) {
+            log::info("compaction: {} planned group is pinned by a snapshot; skipped",
+                      policy.describe(sources.front()));
+            continue;
+        }
+        auto const outcome = merge_versions(policy, sources, sizing_for(sources, active));
+        if ( ! outcome) {
+            // The one refusal that leaves everything as it was and says nothing
+            // about the database: this group does not fit, on the disk or in the
+            // target. merge_groups() answers it by trying a smaller group; a plan
+            // has already chosen its groups, so it skips this one and keeps the
+            // rest. Anything else stops the operation, as it stops compact_all().
+            if (outcome.error() != error_code::insufficient_space) {
+                (void) keep_active_on_top(policy, active);
+                return outcome;
+            }
+            log::info("compaction: {} planned group of {} generations did not fit; skipped",
+                      policy.describe(sources.front()), sources.size());
+            continue;
+        }
+        if ( ! policy.catalogue().contains(active)) active = policy.catalogue().active();
+
+        merged.bytes_read += group.bytes_read;
+        merged.bytes_written += group.bytes_written;
+        merged.bytes_reclaimed += group.bytes_reclaimed;
+        merged.files_removed += group.sources.size() - 1;
+        merged.groups.push_back(group);
+    }
+    return keep_active_on_top(policy, active);
+}
+
+/**
+ * Puts the generation that is to be active back on top of what a compaction
+ * published.
+ *
+ * A merge target takes the next version, so a group of sealed generations
+ * publishes a fitted file that outranks the active one, and the reopen that
+ * follows maps whatever is highest. Left there, the fitted file would take the
+ * inserts and rotate at its small step, and the generation that was active —
+ * with all the room it had left — would be sealed early. So `active` is
+ * rewritten on its own, at the configured size, to the next version: the
+ * rebuild rebuild_active() makes, and the same merge. Nothing to do when no
+ * target outranks it, or when it is gone — a group took it in, and that
+ * target, configured, is the one `active` names by then.
+ */
+template<typename Policy>
+result<> database_impl::keep_active_on_top(Policy policy, size_t active) {
+    auto const& catalogue = policy.catalogue();
+    if ( ! catalogue.contains(active) || catalogue.active() == active) return {};
+
+    log::debug("compaction: {} is rewritten above {}, which the compaction published",
+               policy.describe(active), policy.describe(catalogue.active()));
+    auto const carried = merge_versions(policy, {active}, target_sizing::configured);
+    if ( ! carried) {
+        log::error("compaction: {} could not be rewritten above the merged generations; "
+                   "inserts go to {} until it rotates",
+                   policy.describe(active), policy.describe(catalogue.active()));
+    }
+    return carried;
 }
 
 result<> database_impl::for_each_key_impl(void(*cb)(void*, raw_outpoint const&), void* ctx) const {
@@ -2418,6 +3374,14 @@ result<> database_impl::for_each_key_impl(void(*cb)(void*, raw_outpoint const&),
                 outcome = std::unexpected(opened.error());
                 return;
             }
+            // The open may not have mapped this generation; see manifest_io.hpp.
+            // Whatever first does, checks its stamp.
+            if (auto const stamped = validate_stamp(
+                    **opened, file_name, expected_identity(uint32_t(I.value), v));
+                ! stamped) {
+                outcome = std::unexpected(stamped.error());
+                return;
+            }
             auto const found = find_single_named<utxo_map<container_sizes[I]>>(
                 **opened, map_object_name, file_name);
             if ( ! found) {
@@ -2466,6 +3430,14 @@ result<> database_impl::for_each_entry_impl(void(*cb)(void*, raw_outpoint const&
                 outcome = std::unexpected(opened.error());
                 return;
             }
+            // The open may not have mapped this generation; see manifest_io.hpp.
+            // Whatever first does, checks its stamp.
+            if (auto const stamped = validate_stamp(
+                    **opened, file_name, expected_identity(uint32_t(I.value), v));
+                ! stamped) {
+                outcome = std::unexpected(stamped.error());
+                return;
+            }
             auto const found = find_single_named<utxo_map<container_sizes[I]>>(
                 **opened, map_object_name, file_name);
             if ( ! found) {
@@ -2490,6 +3462,84 @@ result<> database_impl::for_each_entry_impl(void(*cb)(void*, raw_outpoint const&
     return outcome;
 }
 
+// =============================================================================
+// database_impl - Snapshots
+// =============================================================================
+
+template<size_t Index>
+result<> database_impl::pin_generation(size_t version, pinned_class<Index>& into) const {
+    auto const path = data_path(Index, version);
+    auto opened = open_existing_segment(path);
+    if ( ! opened) return std::unexpected(error_code::version_unreadable);
+
+    // The stamp before the map, as the file cache checks it: the snapshot is
+    // about to read this file for as long as it lives.
+    if (auto const stamped = validate_stamp(**opened, path,
+                                            expected_identity(uint32_t(Index), uint64_t(version)));
+        ! stamped) {
+        return std::unexpected(error_code::version_unreadable);
+    }
+    auto const found = find_single_named<utxo_map<container_sizes[Index]>>(
+        **opened, map_object_name, path);
+    if ( ! found) return std::unexpected(error_code::version_unreadable);
+
+    into.generations.push_back({version, std::move(*opened), *found});
+    return {};
+}
+
+/**
+ * Seals, then pins.
+ *
+ * Sealing is what makes the view fixed without copying it: after the rotation
+ * every entry is in a generation that takes no inserts, and the two things that
+ * still write to one — a deletion and compaction — both ask the registry first.
+ * The alternative, a copy of each active map, is a gigabyte and a half of class
+ * 0 alone at the production size, on the writer's thread.
+ *
+ * A class whose active generation is empty is not rotated: there is nothing in
+ * it to see, and a rotation per snapshot of a class nothing is written to would
+ * only leave empty files for compaction to clear. That is every class nothing
+ * was inserted into since the last snapshot, which sealed what it held — and
+ * such a class's generations are all pinned by that snapshot already, if it is
+ * still alive. Each one a live snapshot maps is shared rather than mapped and
+ * checked again, so back-to-back snapshots open only what was sealed between
+ * them.
+ *
+ * The generations are mapped before the snapshot is registered, so a file that
+ * will not map fails the call with nothing pinned — the rotations have happened
+ * and stay, and are harmless.
+ */
+result<full_snapshot> database_impl::snapshot() {
+    result<> sealed;
+    for_each_index<container_count>([&](auto I) {
+        if ( ! sealed || container<I>().empty()) return;
+        sealed = rotate_for<I>(rotation_cause::snapshot);
+    });
+    publish_stats();
+    if ( ! sealed) return std::unexpected(sealed.error());
+
+    auto state = std::make_unique<snapshot_state>(snapshots_);
+    result<> pinned;
+    for_each_index<container_count>([&](auto I) {
+        auto& c = state->template cls<I>();
+        auto const versions = catalogs_[I].below(current_versions_[I]);
+        c.generations.reserve(versions.size());
+        for (auto const v : versions) {
+            if ( ! pinned) return;
+            if (snapshots_->share<I>(v, c)) continue;
+            pinned = pin_generation<I>(v, c);
+            if ( ! pinned) {
+                log::error("snapshot: container {} v{} could not be mapped; nothing was pinned",
+                           I.value, v);
+            }
+        }
+    });
+    if ( ! pinned) return std::unexpected(pinned.error());
+
+    snapshots_->add(state.get());
+    return full_snapshot(std::move(state));
+}
+
 /**
  * Puts everything written so far on stable storage.
  *
@@ -2522,6 +3572,10 @@ result<> database_impl::sync() {
         return std::unexpected(error_code::sync_unsupported);
     }
 
+    trace_span span(&trace_, trace_kind::sync);
+    std::optional<trace_span> phase(std::in_place, &trace_, trace_kind::sync_pages);
+    uint64_t page_bytes = 0;
+
     // Absorbed where a platform simply has no such barrier; propagated when one
     // exists and failed. A caller that needs to know what this platform can
     // promise asks platform_sync_support() rather than inferring it from a
@@ -2531,18 +3585,34 @@ result<> database_impl::sync() {
         return outcome;
     };
 
+    // The page barrier of one active mapping. Over the pages the writer noted
+    // where the file barrier that follows covers whatever it did not (see
+    // file_barrier_covers_mappings()); over the whole mapping everywhere else.
+    // On a per-block sync the difference is a few hundred pages against every
+    // page of a multi-gigabyte file.
+    auto page_barrier = [&](bip::managed_mapped_file& segment,
+                            dirty_pages const& pages) -> result<> {
+        if constexpr ( ! file_barrier_covers_mappings()) {
+            page_bytes += segment.get_size();
+            return barrier(sync_mapped_region(segment.get_address(), segment.get_size()));
+        }
+        return pages.for_each_run([&](void* address, size_t length) {
+            page_bytes += length;
+            return barrier(sync_mapped_region(address, length));
+        });
+    };
+
+    // Every page barrier first, then every file barrier as one batch. Each
+    // mapping is still flushed before the file that backs it; what changed is
+    // that the files are handed to the engine together, so where it has a ring
+    // the device sees all of them at once (see io_engine.hpp).
+    std::vector<fs::path> files;
     if (mode_ == storage_mode::reference) {
         if (reference_segment_) {
-            if (auto const r = barrier(sync_mapped_region(reference_segment_->get_address(),
-                                                          reference_segment_->get_size()));
-                ! r) {
-                return r;
-            }
-            if (auto const r = barrier(sync_file(data_path(reference_sentinel_index,
-                                                           reference_current_version_)));
-                ! r) {
+            if (auto const r = page_barrier(*reference_segment_, reference_pages_); ! r) {
                 return r;
             }
+            files.push_back(data_path(reference_sentinel_index, reference_current_version_));
         }
     } else {
         result<> outcome;
@@ -2550,11 +3620,8 @@ result<> database_impl::sync() {
             if ( ! outcome.has_value()) return;
             if ( ! segments_[I]) return;
 
-            outcome = barrier(sync_mapped_region(segments_[I]->get_address(),
-                                                 segments_[I]->get_size()));
-            if ( ! outcome.has_value()) return;
-
-            outcome = barrier(sync_file(data_path(I, current_versions_[I])));
+            outcome = page_barrier(*segments_[I], active_pages_[I]);
+            if (outcome.has_value()) files.push_back(data_path(I, current_versions_[I]));
         });
         if ( ! outcome.has_value()) return outcome;
     }
@@ -2566,46 +3633,199 @@ result<> database_impl::sync() {
     if (file_cache_) {
         if (auto const r = barrier(file_cache_->sync_mappings()); ! r) return r;
     }
+    phase->bytes(page_bytes);
+    phase->succeeded();
+    span.bytes(page_bytes);
 
     // Every version this instance wrote to and has not yet made durable,
     // whether or not its mapping survived. A sweep that deletes from three
     // generations evicts the first two before it ends; walking the cache would
     // flush the third and call the database durable.
-    for (auto const& [container_index, version] : dirty_versions_) {
-        if (auto const r = barrier(sync_file(data_path(container_index, version))); ! r) {
-            // Nothing is discharged. An obligation half met is an obligation,
-            // and the next sync has to attempt all of them again.
-            return r;
-        }
+    for (auto const& [file, epoch] : dirty_versions_) {
+        auto const& [container_index, version] = file;
+        files.push_back(data_path(container_index, version));
     }
 
+    span.files(files.size());
+    phase.emplace(&trace_, trace_kind::sync_files);
+    phase->files(files.size());
+    if ( ! io_) io_ = std::make_unique<io_engine>();
+    if (auto const r = barrier(io_->sync_files(files)); ! r) {
+        // Nothing is discharged. An obligation half met is an obligation,
+        // and the next sync has to attempt all of them again.
+        return r;
+    }
+
+    phase->succeeded();
+
     // A rotation creates a file, and a file nothing has flushed the directory
     // for is a file that may not be there after a power cut.
+    phase.emplace(&trace_, trace_kind::sync_directory);
+    phase->files(1);
     if (auto const r = barrier(sync_directory(db_path_)); ! r) return r;
+    phase->succeeded();
+    phase.reset();
 
     // Only now, with every barrier this call owed having returned.
     dirty_versions_.clear();
+    for (auto& pages : active_pages_) pages.clear();
+    reference_pages_.clear();
+    span.succeeded();
+    return {};
+}
+
+/**
+ * The file barriers of sync(), taken on the flusher's thread.
+ *
+ * What stays here is what needs the writer: refusing a latched instance, the
+ * page barrier where the file barrier does not reach the mappings, and the list
+ * of files owed, which is read from the catalogue and the dirty register as they
+ * stand now. Everything after that is paths, and the flusher takes it.
+ *
+ * Nothing is discharged here. A round that succeeds publishes its epoch, and the
+ * obligations it met are dropped the next time this runs, or cleared by a
+ * sync() that got there first.
+ */
+std::shared_future<result<>> database_impl::sync_async() {
+    auto const answered = [](result<> outcome) {
+        std::promise<result<>> promise;
+        promise.set_value(outcome);
+        return promise.get_future().share();
+    };
+
+    if (auto const ready = refuse_if_recovery_pending(); ! ready) {
+        return answered(std::unexpected(ready.error()));
+    }
+    if constexpr (platform_sync_support() == sync_support::none) {
+        return answered(std::unexpected(error_code::sync_unsupported));
+    }
+
+    // Where the file barrier does not reach a mapping's pages, the page barrier
+    // has to be crossed while the mapping is still there to name — and a
+    // rotation before the flusher ran would have unmapped it. On Windows this
+    // is the part that starts the writes; waiting for them is the file barrier.
+    if constexpr ( ! file_barrier_covers_mappings()) {
+        auto barrier = [](result<> outcome) -> result<> {
+            if ( ! outcome && outcome.error() == error_code::sync_unsupported) return {};
+            return outcome;
+        };
+        result<> pages;
+        if (mode_ == storage_mode::reference) {
+            if (reference_segment_) {
+                pages = barrier(sync_mapped_region(reference_segment_->get_address(),
+                                                   reference_segment_->get_size()));
+            }
+        } else {
+            for_each_index<container_count>([&](auto I) {
+                if ( ! pages || ! segments_[I]) return;
+                pages = barrier(sync_mapped_region(segments_[I]->get_address(),
+                                                   segments_[I]->get_size()));
+            });
+        }
+        if (pages && file_cache_) pages = barrier(file_cache_->sync_mappings());
+        if ( ! pages) return answered(pages);
+    }
+
+    discharge_settled();
+
+    flush_request request;
+    request.directory = db_path_;
+    request.epoch = write_epoch_++;
+    if (mode_ == storage_mode::reference) {
+        if (reference_segment_) {
+            request.files.push_back(data_path(reference_sentinel_index, reference_current_version_));
+        }
+    } else {
+        for (size_t i = 0; i < container_count; ++i) {
+            if (segments_[i]) request.files.push_back(data_path(i, current_versions_[i]));
+        }
+    }
+    for (auto const& [file, epoch] : dirty_versions_) {
+        request.files.push_back(data_path(file.first, file.second));
+    }
+
+    if ( ! group_commit_) group_commit_ = std::make_unique<group_commit>(&trace_);
+    return group_commit_->submit(std::move(request));
+}
+
+void database_impl::discharge_settled() {
+    if ( ! group_commit_) return;
+    auto const durable = group_commit_->durable_epoch();
+    std::erase_if(dirty_versions_, [&](auto const& entry) { return entry.second < durable; });
+}
+
+/**
+ * Merges every class, several at once when `concurrency` allows it.
+ *
+ * The classes share nothing a merge writes: each has its own files, its own
+ * catalogue, its own sidecar namespace and its own active container, which
+ * compact_container() closes and reopens. What they do share is guarded where
+ * it is touched — the disk by the space ledger, the dirty register by its
+ * mutex, the latch by being atomic — and the file cache is cleared before the
+ * first worker starts and after the last one ends, so no worker reaches it.
+ *
+ * Largest backlog first. With fewer threads than classes, starting the class
+ * with the most to merge last is how the slowest class ends up determining the
+ * wall time twice over.
+ */
+template<typename Work>
+result<> database_impl::for_each_class_concurrently(compaction_concurrency const& concurrency,
+                                                    Work&& work) {
+    std::array<size_t, container_count> order{};
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::stable_sort(order, std::greater<>{}, [&](size_t i) {
+        auto const historical = catalogs_[i].versions().size();
+        return uint64_t(historical) * uint64_t(capacity_[i].file_size);
+    });
+
+    std::array<result<>, container_count> outcomes;
+
+    merge_space_.set_budget(concurrency.max_bytes_in_flight);
+
+    // Stops taking classes at the first failure, as the sequential walk did.
+    // A class already started is finished: its merges are crash-atomic one by
+    // one, and interrupting one in the middle would be a second failure.
+    spread_over_threads(container_count, concurrency.threads, "compaction", [&](size_t slot) {
+        auto const index = order[slot];
+        try {
+            outcomes[index] = std::visit([&](auto I) { return work(I); },
+                                         make_index_variant(index));
+        } catch (std::exception const& e) {
+            log::error("compaction: container {} failed: {}", index, e.what());
+            outcomes[index] = std::unexpected(error_code::file_open_failed);
+        }
+        return outcomes[index].has_value();
+    });
+
+    merge_space_.set_budget(0);
+
+    for (auto const& outcome : outcomes) {
+        if ( ! outcome) return outcome;
+    }
     return {};
 }
 
-result<> database_impl::compact_all() {
+result<> database_impl::compact_all(compaction_concurrency const& concurrency) {
     log::info("Starting full database compaction...");
 
     // Compaction moves entries between files and renames/removes versions, so
     // every cached (container_index, version) mapping becomes stale.
     if (file_cache_) file_cache_->clear();
 
+    // Files went and came, whichever way this ends; measured once it has.
+    scope_exit const restage([&] { restage_all_classes(); });
+
     result<> outcome;
 
     if (mode_ == storage_mode::reference) {
+        // One class, so nothing to run alongside it.
         outcome = compact_reference_container();
     } else {
-        for_each_index<container_count>([&](auto I) {
-            // Stop at the first failure. Carrying on would mutate more of the
-            // database after a condition the owner is going to treat as fatal,
-            // and destroy more of the evidence of how it got that way.
-            if ( ! outcome) return;
-            outcome = compact_container<I>();
+        // Stop at the first failure. Carrying on would mutate more of the
+        // database after a condition the owner is going to treat as fatal, and
+        // destroy more of the evidence of how it got that way.
+        outcome = for_each_class_concurrently(concurrency, [&](auto I) {
+            return compact_container<I>();
         });
     }
 
@@ -2620,68 +3840,334 @@ result<> database_impl::compact_all() {
     return {};
 }
 
+result<compaction_plan> database_impl::compact(compaction_options const& options) {
+    auto const plan = plan_compaction(options);
+
+    // Greedy is compact_all(), and runs as compact_all() does: its plan is a
+    // prediction, and the walk that shrinks a group until it fits is the thing
+    // being predicted, not something to replace with the prediction.
+    if (options.strategy == compaction_strategy::greedy) {
+        if (auto const done = compact_all(options.concurrency); ! done) {
+            return std::unexpected(done.error());
+        }
+        return plan;
+    }
+
+    compaction_plan merged;
+    merged.strategy = plan.strategy;
+    merged.generations_considered = plan.generations_considered;
+    merged.generations_too_full = plan.generations_too_full;
+    merged.generations_unknown = plan.generations_unknown;
+    merged.groups_over_budget = plan.groups_over_budget;
+
+    if (plan.groups.empty()) {
+        log::debug("compaction ({}): no group is worth merging", to_string(plan.strategy));
+        return merged;
+    }
+
+    log::info("Starting {} compaction: {} groups, {} bytes to read, {} to write",
+              to_string(plan.strategy), plan.groups.size(), plan.bytes_read, plan.bytes_written);
+
+    // See compact_all(): every cached mapping is about to be stale.
+    if (file_cache_) file_cache_->clear();
+    scope_exit const restage([&] { restage_all_classes(); });
+
+    auto const has_groups = [&](uint64_t container_class) {
+        return std::ranges::any_of(plan.groups, [&](compaction_group const& g) {
+            return g.container_class == container_class;
+        });
+    };
+
+    result<> outcome;
+
+    // Each class that has anything to merge is closed, merged and reopened
+    // exactly as compact_container() does it, and for the same reason the
+    // reopen's result is part of what comes back.
+    if (mode_ == storage_mode::reference) {
+        if (has_groups(reference_class)) {
+            reference_close_container();
+            outcome = [&]() -> result<> {
+                try {
+                    return merge_planned(reference_merge_policy{*this}, reference_class, plan, merged);
+                } catch (std::exception const& e) {
+                    log::error("compaction: the reference container failed: {}", e.what());
+                    return std::unexpected(error_code::file_open_failed);
+                }
+            }();
+            auto const reopened = reopen_active_reference_container();
+            if (outcome) outcome = reopened;
+        }
+    } else {
+        // One record per class, so the workers never share one, and folded in
+        // class order afterwards: the result reads the same whichever class
+        // finished first.
+        std::array<compaction_plan, container_count> per_class;
+        outcome = for_each_class_concurrently(options.concurrency, [&](auto I) -> result<> {
+            if ( ! has_groups(I.value)) return {};
+
+            close_container<I>();
+            auto merged_here = [&]() -> result<> {
+                try {
+                    return merge_planned(full_merge_policy<I>{*this}, I.value, plan,
+                                         per_class[I.value]);
+                } catch (std::exception const& e) {
+                    log::error("compaction: container {} failed: {}", I.value, e.what());
+                    return std::unexpected(error_code::file_open_failed);
+                }
+            }();
+            auto const reopened = reopen_active_container<I>();
+            if ( ! merged_here) return merged_here;
+            return reopened;
+        });
+        for (auto const& part : per_class) {
+            merged.bytes_read += part.bytes_read;
+            merged.bytes_written += part.bytes_written;
+            merged.bytes_reclaimed += part.bytes_reclaimed;
+            merged.files_removed += part.files_removed;
+            merged.groups.insert(merged.groups.end(), part.groups.begin(), part.groups.end());
+        }
+    }
+
+    if (file_cache_) file_cache_->clear();
+
+    if ( ! outcome) {
+        log::error("{} compaction aborted: the database is locally inconsistent",
+                   to_string(plan.strategy));
+        return std::unexpected(outcome.error());
+    }
+
+    log::info("{} compaction complete: {} groups merged, {} files removed",
+              to_string(plan.strategy), merged.groups.size(), merged.files_removed);
+    return merged;
+}
+
+namespace {
+
+/// The drift figures of one map, read through the three `noexcept` accessors
+/// the insert path already reads.
+template<typename Map>
+void describe_active(Map const& map, active_rebuild& record) {
+    record.entries = map.size();
+    record.bucket_count = map.bucket_count();
+    record.growth_point = max_size_without_rehash(record.bucket_count);
+    record.live_max_load = map.max_load();
+    record.drift = growth_point_drift(record.bucket_count, record.live_max_load);
+}
+
+} // anonymous namespace
+
+/**
+ * Rebuilds one class's active generation.
+ *
+ * The bracket is compact_container()'s, and so is the merge: the active
+ * generation is the single source, the target takes the next version and is
+ * created at the configured size rather than fitted, because it is going to
+ * keep receiving inserts. Once the merge has published it, it is the highest
+ * version, so the reopen that follows maps it as the active generation.
+ */
+template<size_t Index>
+result<> database_impl::rebuild_active_container(double min_drift, active_rebuild& record) {
+    record.container_class = Index;
+    record.version = catalogs_[Index].active();
+    describe_active(container<Index>(), record);
+
+    if (record.drift < min_drift) return {};
+
+    log::info("rebuild: container {} v{} has drifted {:.1f}% ({} of {} entries before growth)",
+              Index, record.version, record.drift * 100.0, record.live_max_load, record.growth_point);
+
+    close_container<Index>();
+    auto outcome = [&]() -> result<> {
+        try {
+            return merge_versions(full_merge_policy<Index>{*this}, {record.version},
+                                  target_sizing::configured);
+        } catch (std::exception const& e) {
+            log::error("rebuild: container {} failed: {}", Index, e.what());
+            return std::unexpected(error_code::file_open_failed);
+        }
+    }();
+    auto const reopened = reopen_active_container<Index>();
+    if ( ! outcome) return outcome;
+    if ( ! reopened) return reopened;
+
+    record.rebuilt_as = catalogs_[Index].active();
+    record.rebuilt = true;
+    return {};
+}
+
+result<> database_impl::rebuild_active_reference_container(double min_drift, active_rebuild& record) {
+    record.container_class = reference_class;
+    record.version = reference_catalog_.active();
+    describe_active(reference_map(), record);
+
+    if (record.drift < min_drift) return {};
+
+    log::info("rebuild: the reference container v{} has drifted {:.1f}% ({} of {} entries before growth)",
+              record.version, record.drift * 100.0, record.live_max_load, record.growth_point);
+
+    reference_close_container();
+    auto outcome = [&]() -> result<> {
+        try {
+            return merge_versions(reference_merge_policy{*this}, {record.version},
+                                  target_sizing::configured);
+        } catch (std::exception const& e) {
+            log::error("rebuild: the reference container failed: {}", e.what());
+            return std::unexpected(error_code::file_open_failed);
+        }
+    }();
+    auto const reopened = reopen_active_reference_container();
+    if ( ! outcome) return outcome;
+    if ( ! reopened) return reopened;
+
+    record.rebuilt_as = reference_catalog_.active();
+    record.rebuilt = true;
+    return {};
+}
+
+result<std::vector<active_rebuild>> database_impl::rebuild_active(rebuild_options const& options) {
+    // A NaN threshold compares false against every drift and would rebuild
+    // nothing while looking like it asked for everything; take it as "never".
+    double const min_drift = options.min_drift == options.min_drift ? options.min_drift : 2.0;
+
+    // See compact_all(): a rebuild retires the file every cached mapping of the
+    // active generation points into.
+    if (file_cache_) file_cache_->clear();
+
+    // A rebuilt generation is a new file of another size; see compact_all().
+    scope_exit const restage([&] { restage_all_classes(); });
+
+    std::vector<active_rebuild> records;
+    result<> outcome;
+
+    if (mode_ == storage_mode::reference) {
+        outcome = rebuild_active_reference_container(min_drift, records.emplace_back());
+    } else {
+        // In class order, one after the other: a rebuild is one file per class,
+        // and the classes that need one are rarely more than one at a time.
+        for_each_index<container_count>([&](auto I) {
+            if ( ! outcome) return;
+            outcome = rebuild_active_container<I>(min_drift, records.emplace_back());
+        });
+    }
+
+    if (file_cache_) file_cache_->clear();
+
+    if ( ! outcome) {
+        log::error("rebuild of the active generations aborted: the database is locally inconsistent");
+        return std::unexpected(outcome.error());
+    }
+    return records;
+}
+
 // =============================================================================
 // database_impl - Statistics
 // =============================================================================
 
-void database_impl::update_fragmentation_stats() {
-#if UTXOZ_STATISTICS_LEVEL >= 1
-    for_each_index<container_count>([&](auto I) {
-        if (segments_[I]) {
-            try {
-                // From the segment that is open, not from the policy. These
-                // describe a file; the policy describes what a new one is created
-                // with, and the two are only the same number by coincidence — a
-                // coincidence that ends the next time the policy moves. Asking the
-                // segment also means `total - free` cannot underflow.
-                size_t const total_size = segments_[I]->get_size();
-                size_t const free_memory = segments_[I]->get_free_memory();
-                size_t const used_memory = total_size >= free_memory
-                                         ? total_size - free_memory : 0;
-
-                fragmentation_stats_.fill_ratios[I] = double(used_memory) / double(total_size);
-
-                auto& map = container<I>();
-                size_t ideal_size = map.size() * sizeof(typename utxo_map<container_sizes[I]>::value_type);
-                fragmentation_stats_.wasted_space[I] =
-                    used_memory > ideal_size ? used_memory - ideal_size : 0;
-            } catch (...) {
-                fragmentation_stats_.fill_ratios[I] = 0.0;
-                fragmentation_stats_.wasted_space[I] = 0;
-            }
+void database_impl::restage_active(size_t slot) {
+    auto& staged = stats_.staged(slot);
+    staged.active_entries = 0;
+    staged.active_file_bytes = 0;
+    staged.active_used_bytes = 0;
+
+    // From the segment that is open, not from the policy. These describe a
+    // file; the policy describes what a new one is created with, and the two
+    // are only the same number by coincidence — a coincidence that ends the
+    // next time the policy moves. Asking the segment also means `file - free`
+    // cannot underflow.
+    auto const measure = [&](bip::managed_mapped_file const& segment) {
+        size_t const file_bytes = segment.get_size();
+        size_t const free_bytes = segment.get_free_memory();
+        staged.active_file_bytes = file_bytes;
+        staged.active_used_bytes = file_bytes >= free_bytes ? file_bytes - free_bytes : 0;
+    };
+    try {
+        if (mode_ == storage_mode::reference) {
+            if (slot != 0 || ! reference_segment_ || reference_container_ == nullptr) return;
+            measure(*reference_segment_);
+            staged.active_entries = reference_map().size();
+        } else {
+            if ( ! segments_[slot] || containers_[slot] == nullptr) return;
+            measure(*segments_[slot]);
+            std::visit([&](auto I) { staged.active_entries = container<I>().size(); },
+                       make_index_variant(slot));
         }
-    });
-#endif
+    } catch (...) {
+        // A header that cannot be read describes nothing; the class reads as
+        // having no active generation until the next restage.
+    }
 }
 
-size_t database_impl::estimate_memory_usage(size_t index) const {
-    size_t total = 0;
+void database_impl::restage_all_classes() {
+    // The sealed files, once each. A file that is not there, or will not say
+    // its size, counts as empty: this is a report, and the operations that
+    // depend on the file will say what is wrong with it.
+    auto const sealed_bytes_of = [&](size_t index, version_catalog const& catalog, size_t active) {
+        uint64_t total = 0;
+        auto const sealed = catalog.below(active);
+        for (auto const v : sealed) {
+            std::error_code ec;
+            auto const bytes = fs::file_size(data_path(index, v), ec);
+            if ( ! ec) total += bytes;
+        }
+        return std::pair{uint64_t(sealed.size()), total};
+    };
 
-    if (segments_[index]) {
-        // The open segment's own size, for the same reason: this is an
-        // observation, and an observation that reads a setting is not one.
-        total += segments_[index]->get_size();
+    if (mode_ == storage_mode::reference) {
+        auto& staged = stats_.staged(0);
+        std::tie(staged.sealed_generations, staged.sealed_bytes) =
+            sealed_bytes_of(reference_sentinel_index, reference_catalog_, reference_current_version_);
+        restage_active(0);
+    } else {
+        for (size_t i = 0; i < container_count; ++i) {
+            auto& staged = stats_.staged(i);
+            std::tie(staged.sealed_generations, staged.sealed_bytes) =
+                sealed_bytes_of(i, catalogs_[i], current_versions_[i]);
+            restage_active(i);
+        }
     }
+    publish_stats();
+}
 
-    for (auto const v : catalogs_[index].below(current_versions_[index])) {
-        auto file_name = db_path_ / fmt::format(data_file_format, index, v);
-        if (fs::exists(file_name)) {
-            total += fs::file_size(file_name);
+database_statistics database_impl::get_statistics() const {
+    auto stats = get_counter_statistics();
+
+    // What the counter view leaves out because it costs: the distributions,
+    // which are maps, and the cached file list.
+    stats.cached_files_info = get_cached_file_info();
+    for (size_t i = 0; i < stats.containers.size(); ++i) {
+        stats.containers[i].value_size_distribution = container_stats_[i].value_size_distribution;
+    }
+    for (size_t depth = 0; depth < deletions_by_depth_.size(); ++depth) {
+        if (deletions_by_depth_[depth] != 0) {
+            stats.deferred.deletions_by_depth[depth] = deletions_by_depth_[depth];
         }
     }
+    stats.not_found.depth_distribution = not_found_stats_.depth_distribution;
+
+    return stats;
+}
+
+namespace {
 
-    return total;
+/// The scalar counters of a container_stats, without its distribution.
+container_stats counters_of(container_stats const& from) {
+    container_stats to;
+    to.total_inserts = from.total_inserts;
+    to.total_deletes = from.total_deletes;
+    to.current_size = from.current_size;
+    to.failed_deletes = from.failed_deletes;
+    to.rehash_count = from.rehash_count;
+    return to;
 }
 
-database_statistics database_impl::get_statistics() {
-    update_fragmentation_stats();
+} // anonymous namespace
 
+database_statistics database_impl::get_counter_statistics() const {
     database_statistics stats;
     stats.mode = mode_;
-    stats.total_entries = entries_count_;
+    stats.total_entries = entries_count_.load(std::memory_order_relaxed);
     stats.cache_hit_rate = get_cache_hit_rate();
-    stats.cached_files_count = file_cache_ ? file_cache_->get_cached_files().size() : 0;
-    stats.cached_files_info = get_cached_file_info();
+    stats.cached_files_count = file_cache_ ? file_cache_->cached_count() : 0;
     stats.probes = probe_stats_.get_summary();
     stats.resolution = resolution_stats_.get_summary();
 
@@ -2690,13 +4176,7 @@ database_statistics database_impl::get_statistics() {
     // size, and one that is absent was refused by every class — and everything
     // else is summed from the classes rather than kept a second time.
     stats.lookups.mode = mode_;
-#if UTXOZ_STATISTICS_LEVEL >= 2
-    stats.lookups.statistics_level = "lookup";
-#elif UTXOZ_STATISTICS_LEVEL >= 1
-    stats.lookups.statistics_level = "basic";
-#else
-    stats.lookups.statistics_level = "off";
-#endif
+    stats.lookups.statistics_level = to_string(get_statistics_level());
     stats.lookups.lookups_received = stats.probes.probes;
     stats.lookups.deferred = stats.probes.deferred;
     stats.lookups.absent = stats.resolution.absent;
@@ -2732,29 +4212,58 @@ database_statistics database_impl::get_statistics() {
     stats.total_deletes = 0;
 
     if (mode_ == storage_mode::reference) {
-        stats.containers[0] = container_stats_[0];
+        stats.containers[0] = counters_of(container_stats_[0]);
         stats.total_inserts = container_stats_[0].total_inserts;
         stats.total_deletes = container_stats_[0].total_deletes;
         stats.rotations_per_container[0] = reference_current_version_;
         stats.rotations_by_cause[0] = reference_rotation_causes_;
-        // The open segment, not the setting: this reports usage.
-        stats.memory_usage_per_container[0] =
-            reference_segment_ ? reference_segment_->get_size() : reference_active_file_size_;
     } else {
         for (size_t i = 0; i < container_count; ++i) {
-            stats.containers[i] = container_stats_[i];
+            stats.containers[i] = counters_of(container_stats_[i]);
             stats.total_inserts += container_stats_[i].total_inserts;
             stats.total_deletes += container_stats_[i].total_deletes;
             stats.rotations_per_container[i] = current_versions_[i];
             stats.rotations_by_cause[i] = rotation_causes_[i];
-            stats.memory_usage_per_container[i] = estimate_memory_usage(i);
         }
     }
 
-    stats.deferred = deferred_stats_;
-    stats.not_found = not_found_stats_;
+    if (group_commit_) stats.group_commit = group_commit_->stats();
+
+    stats.deferred.successfully_processed = deferred_stats_.successfully_processed;
+    stats.deferred.failed_to_delete = deferred_stats_.failed_to_delete;
+    stats.deferred.processing_runs = deferred_stats_.processing_runs;
+    stats.deferred.total_processing_time = deferred_stats_.total_processing_time;
+    stats.deferred.major_faults = deferred_stats_.major_faults;
+    stats.deferred.minor_faults = deferred_stats_.minor_faults;
+    stats.not_found.total_not_found = not_found_stats_.total_not_found;
+    stats.not_found.total_search_depth = not_found_stats_.total_search_depth;
+    stats.not_found.max_search_depth = not_found_stats_.max_search_depth;
     stats.lifetime = lifetime_stats_;
-    stats.fragmentation = fragmentation_stats_;
+    if (stats.lifetime.total_spent > 0) {
+        stats.lifetime.average_age =
+            double(stats.lifetime.total_age) / double(stats.lifetime.total_spent);
+    }
+
+    // Sizes and fill from the published snapshot, which keeps them as they
+    // change: no stat() of every sealed file, no walk of the segments, and
+    // nothing read that a mutation is writing.
+    auto const sizes = stats_.read(mode_);
+    for (size_t i = 0; i < sizes.class_count(); ++i) {
+        stats.memory_usage_per_container[i] = sizes.classes[i].total_bytes();
+    }
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    if (mode_ == storage_mode::full) {
+        for_each_index<container_count>([&](auto I) {
+            auto const& c = sizes.classes[I];
+            if (c.active_file_bytes == 0) return;
+            stats.fragmentation.fill_ratios[I] = c.fill_ratio();
+            size_t const ideal = c.active_entries
+                * sizeof(typename utxo_map<container_sizes[I]>::value_type);
+            stats.fragmentation.wasted_space[I] =
+                c.active_used_bytes > ideal ? c.active_used_bytes - ideal : 0;
+        });
+    }
+#endif
 
     return stats;
 }
@@ -2769,6 +4278,9 @@ void log_rotation_causes(rotation_causes const& causes) {
     if (causes.capacity_exception != 0) {
         log::info("    after a failed allocation: {}", causes.capacity_exception);
     }
+    if (causes.snapshot != 0) {
+        log::info("    sealed for a snapshot: {}", causes.snapshot);
+    }
     if (causes.failed != 0) {
         log::info("    could not rotate: {} (not counted above)", causes.failed);
     }
@@ -2871,6 +4383,11 @@ void database_impl::print_statistics() {
     log::info("Avg depth: {:.2f} versions", stats.resolution.avg_depth);
     log::info("Files visited: {}  cache hit rate: {:.2f}%",
         stats.resolution.files_visited, stats.resolution.cache_hit_rate * 100);
+    if (page_faults_counted) {
+        log::info("Page faults: {} major, {} minor  (deletions: {} major, {} minor)",
+            stats.resolution.major_faults, stats.resolution.minor_faults,
+            stats.deferred.major_faults, stats.deferred.minor_faults);
+    }
 
     log::info("================================");
 }
@@ -3007,18 +4524,36 @@ void database_impl::print_sizing_report() const {
 }
 
 void database_impl::print_height_range_stats() const {
-    auto const& stats = height_range_stats_;
-    if (stats.ranges.empty()) {
-        log::info("No height range statistics collected.");
-        return;
+    // Folded here, on the one path that reads them: each class counts only in
+    // its own slots, so adding the five arrays loses and doubles nothing.
+    height_range_stats stats;
+    for (size_t c = 0; c < container_count; ++c) {
+        for (size_t r = 0; r < height_range_stats::range_count; ++r) {
+            stats.ranges[r].inserts[c] += height_range_stats_[c].ranges[r].inserts[c];
+            stats.ranges[r].deletes[c] += height_range_stats_[c].ranges[r].deletes[c];
+        }
     }
 
+    // Only the ranges something was counted in; the array has every one.
+    auto const touched = [](height_range_stats::range_data const& data) {
+        return std::ranges::any_of(data.inserts, [](size_t n) { return n != 0; })
+            || std::ranges::any_of(data.deletes, [](size_t n) { return n != 0; });
+    };
     std::vector<uint32_t> sorted_keys;
-    sorted_keys.reserve(stats.ranges.size());
-    for (auto const& [key, _] : stats.ranges) {
-        sorted_keys.push_back(key);
+    for (size_t r = 0; r < height_range_stats::range_count; ++r) {
+        if (touched(stats.ranges[r])) sorted_keys.push_back(uint32_t(r));
     }
-    std::ranges::sort(sorted_keys);
+    if (sorted_keys.empty()) {
+        log::info("No height range statistics collected.");
+        return;
+    }
+
+    // The last range also holds every height beyond it.
+    auto const label = [](uint32_t key) {
+        uint32_t const start = key * height_range_stats::range_size;
+        if (key + 1 == height_range_stats::range_count) return fmt::format("  {:>6}+{:<6}", start, "");
+        return fmt::format("  {:>6}-{:<6}", start, start + height_range_stats::range_size - 1);
+    };
 
     log::info("=== UTXO-Z Height Range Statistics (per {:L} blocks) ===", height_range_stats::range_size);
     log::info("");
@@ -3034,11 +4569,8 @@ void database_impl::print_height_range_stats() const {
     // Inserts
     log::info("--- Inserts ---");
     for (uint32_t key : sorted_keys) {
-        auto const& data = stats.ranges.at(key);
-        uint32_t start = key * height_range_stats::range_size;
-        uint32_t end = start + height_range_stats::range_size - 1;
-
-        std::string row = fmt::format("  {:>6}-{:<6}", start, end);
+        auto const& data = stats.ranges[key];
+        std::string row = label(key);
         size_t total = 0;
         for (size_t i = 0; i < container_count; ++i) {
             row += fmt::format(" | {:>9L}", data.inserts[i]);
@@ -3053,11 +4585,8 @@ void database_impl::print_height_range_stats() const {
     // Deletes
     log::info("--- Deletes ---");
     for (uint32_t key : sorted_keys) {
-        auto const& data = stats.ranges.at(key);
-        uint32_t start = key * height_range_stats::range_size;
-        uint32_t end = start + height_range_stats::range_size - 1;
-
-        std::string row = fmt::format("  {:>6}-{:<6}", start, end);
+        auto const& data = stats.ranges[key];
+        std::string row = label(key);
         size_t total = 0;
         for (size_t i = 0; i < container_count; ++i) {
             row += fmt::format(" | {:>9L}", data.deletes[i]);
@@ -3075,12 +4604,13 @@ void database_impl::reset_all_statistics() {
     for (auto& cs : container_stats_) {
         cs = container_stats{};
     }
-    height_range_stats_ = height_range_stats{};
+    height_range_stats_.fill(height_range_stats{});
     deferred_stats_ = deferred_stats{};
+    deletions_by_depth_.fill(0);
     not_found_stats_ = not_found_stats{};
     lifetime_stats_ = utxo_lifetime_stats{};
-    fragmentation_stats_ = fragmentation_stats{};
     reset_search_stats();
+    reset_latency_stats();
 }
 
 void database_impl::reset_search_stats() {
@@ -3089,6 +4619,27 @@ void database_impl::reset_search_stats() {
     for (auto& per_class : lookup_stats_) per_class.reset();
 }
 
+latency_snapshot database_impl::get_latency_snapshot() const {
+    latency_snapshot snapshot;
+    snapshot.statistics_level = to_string(get_statistics_level());
+    snapshot.mode = mode_;
+    snapshot.series = latency_stats_.get_series(mode_);
+    return snapshot;
+}
+
+void database_impl::reset_latency_stats() {
+    latency_stats_.reset();
+}
+
+statistics_level database_impl::set_statistics_level(statistics_level level) noexcept {
+    // Relaxed: nothing is published with it. An operation that reads the old
+    // value counts as it would have a moment earlier, and the counters it feeds
+    // are atomics or the writer's own, whichever level it saw.
+    auto const running = std::min(level, compiled_statistics_level);
+    statistics_level_.store(running, std::memory_order_relaxed);
+    return running;
+}
+
 float database_impl::get_cache_hit_rate() const {
     return file_cache_ ? file_cache_->get_hit_rate() : 0.0f;
 }
@@ -3126,8 +4677,9 @@ result<> database_impl::reference_open_existing(size_t version) {
     if ( ! found) return std::unexpected(found.error());
 
     reference_segment_ = std::move(*opened);
-    reference_container_ = *found;
+    publish_active_map(reference_sentinel_index, *found);
     reference_rehash_watch_.reset((*found)->bucket_count());
+    reference_pages_.attach(reference_segment_->get_address(), reference_segment_->get_size());
     reference_current_version_ = version;
     return {};
 }
@@ -3187,8 +4739,9 @@ result<> database_impl::reference_create(size_t version) {
     }
 
     reference_segment_ = std::move(segment);
-    reference_container_ = map;
+    publish_active_map(reference_sentinel_index, map);
     reference_rehash_watch_.reset(map->bucket_count());
+    reference_pages_.attach(reference_segment_->get_address(), reference_segment_->get_size());
     reference_current_version_ = version;
     published = true;
     return {};
@@ -3198,8 +4751,10 @@ void database_impl::reference_close_container() {
     if (reference_segment_) {
         reference_save_metadata(reference_current_version_);
         reference_segment_->flush();
+        // See close_container(): retired first, unmapped after.
+        publish_active_map(reference_sentinel_index, nullptr);
         reference_segment_.reset();
-        reference_container_ = nullptr;
+        reference_pages_.detach();
     }
 }
 
@@ -3219,8 +4774,10 @@ void database_impl::reference_new_version() {
                                              next));
     }
 
-    reference_catalog_.add(next);
-    reference_catalog_.metadata(next) = file_metadata{};
+    change_layout([&] {
+        reference_catalog_.add(next);
+        reference_catalog_.metadata(next) = file_metadata{};
+    });
     log::debug("Reference container rotated to version {}", reference_current_version_);
 }
 
@@ -3270,7 +4827,12 @@ result<bool> database_impl::reference_insert(raw_outpoint const& key, output_dat
 }
 
 std::optional<find_result> database_impl::reference_find(raw_outpoint const& key, uint32_t height) const {
-    if (auto res = reference_find_in_latest(key, height); res) {
+    // See find().
+    auto const counted = counting_now();
+    latency_scope timing(latency_stats_, latency_op::find, latency_stats::unattributed,
+                         counted.basic && latency_sampled<latency_op::find>());
+    if (auto res = reference_find_in_latest(key, height, counted); res) {
+        timing.attribute_to(0);
         return res;
     }
 
@@ -3279,45 +4841,63 @@ std::optional<find_result> database_impl::reference_find(raw_outpoint const& key
     //
     // The counter is all that happens. The key is not kept: whoever asked keeps
     // it and hands it to resolve() (#116).
-    probe_stats_.record_deferred();
+    if (counted.basic) probe_stats_.record_deferred();
     return std::nullopt;
 }
 
-std::optional<find_result> database_impl::reference_find_in_latest(raw_outpoint const& key, uint32_t height) const {
-    auto const& map = reference_map();
-    if (auto it = map.find(key); it != map.end()) {
+std::optional<find_result> database_impl::reference_find_in_latest(raw_outpoint const& key, uint32_t height,
+                                                                   [[maybe_unused]] counting counted) const {
+    // See find_in_latest_version().
+    std::shared_lock const reading(active_maps_lock_);
+    if (auto const copied = reference_copy_from_active(key)) {
 #if UTXOZ_STATISTICS_LEVEL >= 1
-        probe_stats_.record_answered(height, it->second.height);
+        if (counted.basic) probe_stats_.record_answered(height, copied->height);
 #endif
 #if UTXOZ_STATISTICS_LEVEL >= 2
-        lookup_stats_[0].record_answered_from_active();
+        if (counted.lookup) lookup_stats_[0].record_answered_from_active();
 #endif
         bytes data(sizeof(uint32_t) * 2);
-        std::memcpy(data.data(), &it->second.file_number, sizeof(uint32_t));
-        std::memcpy(data.data() + sizeof(uint32_t), &it->second.offset, sizeof(uint32_t));
-        return find_result{std::move(data), it->second.height};
+        std::memcpy(data.data(), &copied->file_number, sizeof(uint32_t));
+        std::memcpy(data.data() + sizeof(uint32_t), &copied->offset, sizeof(uint32_t));
+        return find_result{std::move(data), copied->height};
     }
     return std::nullopt;
 }
 
+std::optional<reference_value> database_impl::reference_copy_from_active(raw_outpoint const& key) const {
+    // See copy_from_active().
+    if (reference_container_ == nullptr) return std::nullopt;
+    auto const& map = reference_map();
+    return read_active(0, [&] {
+        std::optional<reference_value> copied;
+        if (auto const it = map.find(key); it != map.end()) {
+            copied.emplace();
+            std::memcpy(&*copied, &it->second, sizeof(reference_value));
+        }
+        return copied;
+    });
+}
+
 
 size_t database_impl::reference_erase_in_latest(raw_outpoint const& key, uint32_t height) {
     auto& map = reference_map();
     if (auto it = map.find(key); it != map.end()) {
+        --stats_.staged(0).active_entries;
+        ++stats_.staged(0).deletes;
 #if UTXOZ_STATISTICS_LEVEL >= 1
-        uint32_t age = height - it->second.height;
-        ++lifetime_stats_.age_distribution[age];
-        lifetime_stats_.max_age = std::max(lifetime_stats_.max_age, age);
-        ++lifetime_stats_.total_spent;
-        lifetime_stats_.average_age =
-            (lifetime_stats_.average_age * (lifetime_stats_.total_spent - 1) + age)
-            / lifetime_stats_.total_spent;
+        record_spent(height - it->second.height);
 
         --container_stats_[0].current_size;
-        ++container_stats_[0].total_deletes;
-        ++height_range_stats_.ranges[height / height_range_stats::range_size].deletes[0];
+        if (writing_.basic) {
+            ++container_stats_[0].total_deletes;
+            ++height_range_stats_[0].ranges[height_range_stats::range_of(height)].deletes[0];
+        }
 #endif
-        map.erase(it);
+        note_written(reference_pages_, map, *it);
+        {
+            auto const announced = announce_write(0);
+            map.erase(it);
+        }
         return 1;
     }
     return 0;
@@ -3336,6 +4916,12 @@ result<> database_impl::reference_for_each_key(void(*cb)(void*, raw_outpoint con
 
         auto opened = open_existing_segment(file_name);
         if ( ! opened) return std::unexpected(opened.error());
+        // See for_each_key_impl(): possibly the first mapping since the open.
+        if (auto const stamped = validate_stamp(
+                **opened, file_name, expected_identity(reference_container_kind, v));
+            ! stamped) {
+            return std::unexpected(stamped.error());
+        }
         auto const found = find_single_named<reference_map_t>(**opened, map_object_name, file_name);
         if ( ! found) return std::unexpected(found.error());
 
@@ -3374,6 +4960,12 @@ result<> database_impl::reference_for_each_entry(void(*cb)(void*, raw_outpoint c
 
         auto opened = open_existing_segment(file_name);
         if ( ! opened) return std::unexpected(opened.error());
+        // See for_each_key_impl(): possibly the first mapping since the open.
+        if (auto const stamped = validate_stamp(
+                **opened, file_name, expected_identity(reference_container_kind, v));
+            ! stamped) {
+            return std::unexpected(stamped.error());
+        }
         auto const found = find_single_named<reference_map_t>(**opened, map_object_name, file_name);
         if ( ! found) return std::unexpected(found.error());
 
@@ -3452,21 +5044,6 @@ void database_impl::reference_save_metadata(size_t version) noexcept {
     }
 }
 
-void database_impl::reference_load_metadata(size_t version) {
-    auto const path = db_path_ / fmt::format("meta_compact_v{:05}.dat", version);
-
-    auto record = read_metadata_file(path);
-    if ( ! record) {
-        report_metadata_read_error(record.error(), "the reference container", version);
-        return;
-    }
-
-    auto& meta = reference_catalog_.metadata(version);
-    meta = *record;
-    meta.container_index = reference_sentinel_index;
-    meta.version = version;
-}
-
 // =============================================================================
 // database_impl - Config persistence
 // =============================================================================
@@ -3538,24 +5115,30 @@ result<> database_impl::save_config_to_disk() {
 // =============================================================================
 
 std::optional<full_find_result> database_impl::full_find(raw_outpoint const& key, uint32_t height) const {
+    // See find().
+    auto const counted = counting_now();
+
     // Try current version first
     std::optional<full_find_result> result;
 
-    for_each_index<container_count>([&](auto I) {
-        if (!result) {
-            auto& map = container<I>();
-            if (auto it = map.find(key); it != map.end()) {
+    {
+        // See find_in_latest_version().
+        std::shared_lock const reading(active_maps_lock_);
+        for_each_index<container_count>([&](auto I) {
+            if (!result) {
+                if (auto const copied = copy_from_active<I>(key)) {
 #if UTXOZ_STATISTICS_LEVEL >= 1
-                probe_stats_.record_answered(height, it->second.block_height);
+                    if (counted.basic) probe_stats_.record_answered(height, copied->block_height);
 #endif
 #if UTXOZ_STATISTICS_LEVEL >= 2
-                lookup_stats_[I.value].record_answered_from_active();
+                    if (counted.lookup) lookup_stats_[I.value].record_answered_from_active();
 #endif
-                auto data = it->second.get_data();
-                result = full_find_result{bytes(data.begin(), data.end()), it->second.block_height};
+                    auto data = copied->get_data();
+                    result = full_find_result{bytes(data.begin(), data.end()), copied->block_height};
+                }
             }
-        }
-    });
+        });
+    }
 
     if (result) return result;
 
@@ -3564,12 +5147,20 @@ std::optional<full_find_result> database_impl::full_find(raw_outpoint const& key
     //
     // The counter is all that happens. The key is not kept: whoever asked keeps
     // it and hands it to resolve() (#116).
-    probe_stats_.record_deferred();
+    if (counted.basic) probe_stats_.record_deferred();
     return std::nullopt;
 }
 
 
 result<full_resolution> database_impl::full_resolve(std::span<lookup_request const> requests) const {
+    // Once for the batch: every key in it is counted or none is, and the inner
+    // loop tests a local that does not change under it.
+    auto const counted = counting_now();
+
+    // Started before the lock: what a caller waits is what is paged on.
+    latency_scope const timing(latency_stats_, latency_op::resolve, latency_stats::unattributed,
+                               counted.basic);
+
     // Taken before anything is read and held to the return, because what has
     // to be protected is not just the cache's bookkeeping but the lifetime of
     // every map reference this call obtains from it: a concurrent eviction
@@ -3578,6 +5169,13 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
 
     if (requests.empty()) return full_resolution{};
 
+    // The block-sized ones only; see trace_options::resolve_threshold.
+    trace_span span(&trace_, trace_kind::resolve, unattributed_class,
+                    requests.size() >= trace_.resolve_threshold());
+    span.items(requests.size());
+    uint64_t files_opened = 0;
+    scope_exit const opened_files([&] { span.files(files_opened); });
+
     full_resolution resolved;
 
     // Indices into the caller's batch, shrinking as keys are found so each
@@ -3657,6 +5255,10 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
         std::array<class_tally, container_count> per_class{};
 #endif
     } tally;
+    // A system call at each end of the batch, and only when counting. The
+    // faults between them are this thread's, so a concurrent find() is not
+    // charged to it.
+    auto const faults_at_start = counted.basic ? thread_faults() : fault_count{};
 #endif
 
     bool complete = true;
@@ -3672,6 +5274,7 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
                 throw std::runtime_error("failpoint: version file refused to open");
             }
             auto [map, cache_hit] = file_cache_->get_or_open_file<Index>(Index, version);
+            ++files_opened;
 
 #if UTXOZ_STATISTICS_LEVEL >= 1
             cache_hit ? ++tally.cache_hits : ++tally.cache_misses;
@@ -3714,9 +5317,11 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
                 // is not the same: compaction leaves gaps in the numbering, and
                 // the cache is searched before the catalogue, so neither the
                 // order nor the arithmetic of the versions describes the search.
-                tally.per_class[Index].answered(
-                    tally.files_probed,
-                    static_cast<uint64_t>(current_versions_[Index] - version));
+                if (counted.lookup) {
+                    tally.per_class[Index].answered(
+                        tally.files_probed,
+                        static_cast<uint64_t>(current_versions_[Index] - version));
+                }
 #endif
                 auto data = map_it->second.get_data();
                 resolved.found.emplace(requests[idx].key,
@@ -3801,18 +5406,23 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
     // Every version was read, so what is left was looked for everywhere it could
     // have been. Only now is absence a fact.
 #if UTXOZ_STATISTICS_LEVEL >= 1
-    // The resolution completed, so what it did is now a fact and can be published.
-    for (uint64_t i = 0; i < tally.cache_hits; ++i) resolution_stats_.record_file_visited(true);
-    for (uint64_t i = 0; i < tally.cache_misses; ++i) resolution_stats_.record_file_visited(false);
+    // The resolution completed, so what it did is now a fact and can be published
+    // — at the level it started with, so a switch mid-sweep splits nothing.
+    if (counted.basic) {
+        for (uint64_t i = 0; i < tally.cache_hits; ++i) resolution_stats_.record_file_visited(true);
+        for (uint64_t i = 0; i < tally.cache_misses; ++i) resolution_stats_.record_file_visited(false);
+        auto const faults = thread_faults_since(faults_at_start);
+        resolution_stats_.record_faults(faults.major, faults.minor);
+    }
     // The counter that existed before, with exactly the meaning it had: a version
     // distance summed over the keys this sweep answered. Handed over as a total
     // rather than replayed key by key from a list the read path no longer keeps —
     // which is the part of this work that stays at `basic`.
-    if (tally.resolved > 0) {
+    if (counted.basic && tally.resolved > 0) {
         resolution_stats_.record_resolved_batch(tally.resolved, tally.version_distance_total);
     }
 #if UTXOZ_STATISTICS_LEVEL >= 2
-    for (size_t index = 0; index < container_count; ++index) {
+    for (size_t index = 0; counted.lookup && index < container_count; ++index) {
         auto const& mine = tally.per_class[index];
         // A class this sweep never touched has nothing to publish. Skipping it
         // is not only tidiness: every one of these is an atomic increment, and a
@@ -3837,11 +5447,12 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
     }
     // Absence, not "unsettled". Reached only here, on the completed path, where
     // every version that could have held these was read.
-    resolution_stats_.record_absent(pending.size());
+    if (counted.basic) resolution_stats_.record_absent(pending.size());
 
     log::debug("Full resolution complete: {} found, {} absent",
                resolved.found.size(), resolved.absent.size());
 
+    span.succeeded();
     return resolved;
 }
 
@@ -3850,6 +5461,13 @@ result<full_resolution> database_impl::full_resolve(std::span<lookup_request con
 // =============================================================================
 
 result<> database_impl::reference_rotate_for(rotation_cause cause) {
+    latency_scope const timing(latency_stats_, latency_op::rotation, 0, counting_now().basic);
+    // See rotate_for().
+    size_t const sealing_bytes = reference_segment_ ? reference_segment_->get_size() : 0;
+    trace_span span(&trace_, trace_kind::rotation, reference_class);
+    span.version(reference_current_version_);
+    span.bytes(sealing_bytes);
+    span.items(reference_segment_ ? reference_map().size() : 0);
     try {
         reference_new_version();
     } catch (std::exception const& e) {
@@ -3865,13 +5483,31 @@ result<> database_impl::reference_rotate_for(rotation_cause cause) {
         });
         return std::unexpected(error_code::file_open_failed);
     }
-    if (cause == rotation_cause::preventive) ++reference_rotation_causes_.preventive;
-    else                                     ++reference_rotation_causes_.capacity_exception;
+    switch (cause) {
+        case rotation_cause::preventive:         ++reference_rotation_causes_.preventive; break;
+        case rotation_cause::capacity_exception: ++reference_rotation_causes_.capacity_exception; break;
+        case rotation_cause::snapshot:           ++reference_rotation_causes_.snapshot; break;
+    }
+    auto& staged = stats_.staged(0);
+    ++staged.sealed_generations;
+    staged.sealed_bytes += sealing_bytes;
+    ++staged.rotations;
+    restage_active(0);
+    span.succeeded();
     return {};
 }
 
 result<bool> database_impl::reference_insert_typed(raw_outpoint const& key, uint32_t height,
                                                  uint32_t file_number, uint32_t offset) {
+    // Reached from db_base directly as well as through insert(), so it takes
+    // its own reading; see writing_.
+    writing_ = counting_now();
+    latency_scope const timing(latency_stats_, latency_op::insert, 0,
+                               writing_.basic && latency_sampled<latency_op::insert>());
+    // Reference mode has no batch that splits across threads, so every insert
+    // is its own operation and publishes on the way out, whichever way out.
+    scope_exit const publish([&] { publish_stats(0, 1); });
+
     // As in full mode: the figure comes from the guard, which already read it,
     // and the sentinel distinguishes "not measured" from "nothing left".
     uint64_t free_before = free_bytes_unavailable;
@@ -3925,11 +5561,16 @@ result<bool> database_impl::reference_insert_typed(raw_outpoint const& key, uint
             // and the first comparison ends it.
             if (failpoints::consume_insert_failure()) {
                 if (failpoints::fail_insert_after_mutating.load(std::memory_order_relaxed)) {
+                    auto const announced = announce_write(0);
                     map.emplace(key, val);
                 }
                 throw bip::bad_alloc();
             }
-            auto [it, inserted] = map.emplace(key, val);
+            // See insert_in_index(): announced for the emplace only.
+            auto [it, inserted] = [&] {
+                auto const announced = announce_write(0);
+                return map.emplace(key, val);
+            }();
             if (!inserted) {
                 diagnose([&] {
                     log::warn("reference_insert_typed: duplicate key at height {}, "
@@ -3937,19 +5578,31 @@ result<bool> database_impl::reference_insert_typed(raw_outpoint const& key, uint
                 });
             }
             if (inserted) {
-                ++entries_count_;
+                entries_count_.fetch_add(1, std::memory_order_relaxed);
 
                 // As in full mode, and for the same reason.
                 bool const rehashed = note_rehash_if_grown(
                     reference_container_kind, reference_rehash_watch_, map.bucket_count());
+                note_written(reference_pages_, map, *it, rehashed);
 
 #if UTXOZ_STATISTICS_LEVEL >= 1
-                ++container_stats_[0].total_inserts;
                 ++container_stats_[0].current_size;
-                ++container_stats_[0].value_size_distribution[sizeof(uint32_t) * 2];
-                ++height_range_stats_.ranges[height / height_range_stats::range_size].inserts[0];
-                if (rehashed) ++container_stats_[0].rehash_count;
+                if (writing_.basic) {
+                    ++container_stats_[0].total_inserts;
+                    ++container_stats_[0].value_size_distribution[sizeof(uint32_t) * 2];
+                    ++height_range_stats_[0].ranges[height_range_stats::range_of(height)].inserts[0];
+                    if (rehashed) ++container_stats_[0].rehash_count;
+                }
 #endif
+                {
+                    // See insert_in_index().
+                    auto& staged = stats_.staged(0);
+                    ++staged.active_entries;
+                    ++staged.inserts;
+                    if (free_before != free_bytes_unavailable && free_before <= staged.active_file_bytes) {
+                        staged.active_used_bytes = staged.active_file_bytes - free_before;
+                    }
+                }
 
                 reference_catalog_.metadata(reference_current_version_).update_on_insert(key, height);
 
@@ -3969,6 +5622,9 @@ result<bool> database_impl::reference_insert_typed(raw_outpoint const& key, uint
             return inserted;
 
         } catch (bip::bad_alloc const& e) {
+            // See insert_in_index.
+            reference_pages_.note_all();
+
             auto& after_map = reference_map();
             auto const after = snapshot_of(after_map);
             bool const key_present_after = after_map.find(key) != after_map.end();
@@ -4047,15 +5703,26 @@ result<bool> database_impl::reference_insert_typed(raw_outpoint const& key, uint
 }
 
 std::optional<reference_find_result> database_impl::reference_find_typed(raw_outpoint const& key, uint32_t height) const {
-    auto const& map = reference_map();
-    if (auto it = map.find(key); it != map.end()) {
+    // See find().
+    auto const counted = counting_now();
+    latency_scope timing(latency_stats_, latency_op::find, latency_stats::unattributed,
+                         counted.basic && latency_sampled<latency_op::find>());
+
+    // See find_in_latest_version().
+    std::optional<reference_value> copied;
+    {
+        std::shared_lock const reading(active_maps_lock_);
+        copied = reference_copy_from_active(key);
+    }
+    if (copied) {
 #if UTXOZ_STATISTICS_LEVEL >= 1
-        probe_stats_.record_answered(height, it->second.height);
+        if (counted.basic) probe_stats_.record_answered(height, copied->height);
 #endif
 #if UTXOZ_STATISTICS_LEVEL >= 2
-        lookup_stats_[0].record_answered_from_active();
+        if (counted.lookup) lookup_stats_[0].record_answered_from_active();
 #endif
-        return reference_find_result{it->second.height, it->second.file_number, it->second.offset};
+        timing.attribute_to(0);
+        return reference_find_result{copied->height, copied->file_number, copied->offset};
     }
 
     // A probe the active map could not answer. Recording it is what makes the
@@ -4063,11 +5730,19 @@ std::optional<reference_find_result> database_impl::reference_find_typed(raw_out
     //
     // The counter is all that happens. The key is not kept: whoever asked keeps
     // it and hands it to resolve() (#116).
-    probe_stats_.record_deferred();
+    if (counted.basic) probe_stats_.record_deferred();
     return std::nullopt;
 }
 
 result<reference_resolution> database_impl::reference_resolve(std::span<lookup_request const> requests) const {
+    // Once for the batch: every key in it is counted or none is, and the inner
+    // loop tests a local that does not change under it.
+    auto const counted = counting_now();
+
+    // Started before the lock: what a caller waits is what is paged on.
+    latency_scope const timing(latency_stats_, latency_op::resolve, latency_stats::unattributed,
+                               counted.basic);
+
     // Taken before anything is read and held to the return, because what has
     // to be protected is not just the cache's bookkeeping but the lifetime of
     // every map reference this call obtains from it: a concurrent eviction
@@ -4076,6 +5751,13 @@ result<reference_resolution> database_impl::reference_resolve(std::span<lookup_r
 
     if (requests.empty()) return reference_resolution{};
 
+    // See full_resolve().
+    trace_span span(&trace_, trace_kind::resolve, reference_class,
+                    requests.size() >= trace_.resolve_threshold());
+    span.items(requests.size());
+    uint64_t files_opened = 0;
+    scope_exit const opened_files([&] { span.files(files_opened); });
+
     reference_resolution resolved;
 
     // The same contract as full_resolve(), case for case: indices into the
@@ -4113,6 +5795,7 @@ result<reference_resolution> database_impl::reference_resolve(std::span<lookup_r
         std::array<uint64_t, lookup_stats::bucket_count> distance_buckets{};
 #endif
     } tally;
+    auto const faults_at_start = counted.basic ? thread_faults() : fault_count{};
 #endif
 
     bool complete = true;
@@ -4125,6 +5808,7 @@ result<reference_resolution> database_impl::reference_resolve(std::span<lookup_r
                 throw std::runtime_error("failpoint: version file refused to open");
             }
             auto [map, cache_hit] = file_cache_->get_or_open_reference_file(version);
+            ++files_opened;
 
 #if UTXOZ_STATISTICS_LEVEL >= 1
             cache_hit ? ++tally.cache_hits : ++tally.cache_misses;
@@ -4152,7 +5836,7 @@ result<reference_resolution> database_impl::reference_resolve(std::span<lookup_r
                     static_cast<uint64_t>(reference_current_version_ - version);
 #endif
 #if UTXOZ_STATISTICS_LEVEL >= 2
-                {
+                if (counted.lookup) {
                     // Cost and age, kept apart. See the full-mode path.
                     uint64_t const ordinal = tally.files_probed;
                     uint64_t const distance = reference_current_version_ - version;
@@ -4222,18 +5906,23 @@ result<reference_resolution> database_impl::reference_resolve(std::span<lookup_r
     }
 
 #if UTXOZ_STATISTICS_LEVEL >= 1
-    // The resolution completed, so what it did is now a fact and can be published.
-    for (uint64_t i = 0; i < tally.cache_hits; ++i) resolution_stats_.record_file_visited(true);
-    for (uint64_t i = 0; i < tally.cache_misses; ++i) resolution_stats_.record_file_visited(false);
+    // The resolution completed, so what it did is now a fact and can be published
+    // — at the level it started with, so a switch mid-sweep splits nothing.
+    if (counted.basic) {
+        for (uint64_t i = 0; i < tally.cache_hits; ++i) resolution_stats_.record_file_visited(true);
+        for (uint64_t i = 0; i < tally.cache_misses; ++i) resolution_stats_.record_file_visited(false);
+        auto const faults = thread_faults_since(faults_at_start);
+        resolution_stats_.record_faults(faults.major, faults.minor);
+    }
     // One class. `lookup_stats_[0]` is where it lives; the report labels it
     // `reference_class` so nobody reads it as container 0.
     // Unchanged in meaning, and kept at `basic`: a version distance summed over
     // the keys this sweep answered.
-    if (tally.resolved > 0) {
+    if (counted.basic && tally.resolved > 0) {
         resolution_stats_.record_resolved_batch(tally.resolved, tally.version_distance_total);
     }
 #if UTXOZ_STATISTICS_LEVEL >= 2
-    if (tally.files_probed > 0 || tally.resolved > 0) {
+    if (counted.lookup && (tally.files_probed > 0 || tally.resolved > 0)) {
         auto& published = lookup_stats_[0];
         published.record_file_opened(tally.files_probed, tally.cache_hits);
         published.record_generations_probed(tally.generations_probed);
@@ -4252,11 +5941,12 @@ result<reference_resolution> database_impl::reference_resolve(std::span<lookup_r
     }
     // Absence, not "unsettled". Reached only here, on the completed path, where
     // every version that could have held these was read.
-    resolution_stats_.record_absent(pending.size());
+    if (counted.basic) resolution_stats_.record_absent(pending.size());
 
     log::debug("Reference resolution complete: {} found, {} absent",
                resolved.found.size(), resolved.absent.size());
 
+    span.succeeded();
     return resolved;
 }
 
@@ -4275,6 +5965,12 @@ result<> database_impl::reference_for_each_entry_typed(
 
         auto opened = open_existing_segment(file_name);
         if ( ! opened) return std::unexpected(opened.error());
+        // See for_each_key_impl(): possibly the first mapping since the open.
+        if (auto const stamped = validate_stamp(
+                **opened, file_name, expected_identity(reference_container_kind, v));
+            ! stamped) {
+            return std::unexpected(stamped.error());
+        }
         auto const found = find_single_named<reference_map_t>(**opened, map_object_name, file_name);
         if ( ! found) return std::unexpected(found.error());
 
@@ -4334,6 +6030,12 @@ template result<> database_impl::compact_container<2>();
 template result<> database_impl::compact_container<3>();
 template result<> database_impl::compact_container<4>();
 
+template result<> database_impl::rebuild_active_container<0>(double, active_rebuild&);
+template result<> database_impl::rebuild_active_container<1>(double, active_rebuild&);
+template result<> database_impl::rebuild_active_container<2>(double, active_rebuild&);
+template result<> database_impl::rebuild_active_container<3>(double, active_rebuild&);
+template result<> database_impl::rebuild_active_container<4>(double, active_rebuild&);
+
 template result<bool> database_impl::insert_in_index<0>(raw_outpoint const&, output_data_span, uint32_t);
 template result<> database_impl::rotate_for<0>(rotation_cause);
 template result<bool> database_impl::insert_in_index<1>(raw_outpoint const&, output_data_span, uint32_t);
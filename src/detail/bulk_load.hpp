@@ -0,0 +1,118 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file bulk_load.hpp
+ * @brief The order a merge places its entries in, so the target is written
+ *        front to back.
+ * @internal
+ *
+ * A merge target is built by emplacing every surviving entry into a map that
+ * was constructed empty. Taken in the order the sources are iterated, each
+ * entry lands wherever its hash sends it, which is anywhere in a slot array of
+ * up to four gibibytes: one dirty page per entry, scattered, and a writeback the
+ * disk sees as random.
+ *
+ * The landing place is not a mystery, though. A flat map with a power-of-two
+ * group count puts a key in the group named by the high bits of its mixed hash,
+ * so ordering the entries by that hash is ordering them by the group they go to
+ * — whatever the group count is. Emplaced in that order, the target's slots and
+ * group metadata are written in address order, and the only jumps are the few
+ * entries whose home group was already full.
+ *
+ * ## Only a performance property
+ *
+ * The order is computed here and not asked of Boost, which does not expose it,
+ * so it reproduces the mixing that `hash_epoch` pins in format_identity.hpp. If
+ * the two ever disagreed the target would still be exactly the same map — the
+ * map places every entry by its own hash — and only the writes would be
+ * scattered again. Nothing here can make a merge wrong; that is why it is
+ * allowed to be a reproduction rather than a call.
+ *
+ * ## What it costs
+ *
+ * Sixteen bytes of heap per entry for the order, and every source mapped at
+ * once rather than one after the other. The reads then follow the target rather
+ * than the sources, which moves the randomness to the side that only reads clean
+ * pages.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <utxoz/types.hpp>
+
+namespace utxoz::detail {
+
+/// The high and low halves of a 64×64-bit product, folded together. What Boost
+/// calls `mulx`, written without a 128-bit type so that it means the same on
+/// every compiler this builds with.
+[[nodiscard]]
+inline constexpr uint64_t mulx64(uint64_t x, uint64_t y) noexcept {
+    uint64_t const x_lo = uint32_t(x);
+    uint64_t const x_hi = x >> 32;
+    uint64_t const y_lo = uint32_t(y);
+    uint64_t const y_hi = y >> 32;
+
+    uint64_t const p0 = x_lo * y_lo;
+    uint64_t const p1 = x_lo * y_hi;
+    uint64_t const p2 = x_hi * y_lo;
+    uint64_t const p3 = x_hi * y_hi;
+
+    uint64_t const mid = (p0 >> 32) + uint32_t(p1) + uint32_t(p2);
+    uint64_t const lo = (mid << 32) | uint32_t(p0);
+    uint64_t const hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+    return hi ^ lo;
+}
+
+static_assert(mulx64(0, 0x9E3779B97F4A7C15ull) == 0);
+static_assert(mulx64(1, 0x9E3779B97F4A7C15ull) == 0x9E3779B97F4A7C15ull);
+static_assert(mulx64(uint64_t(1) << 32, uint64_t(1) << 32) == 1, "the high half is folded in");
+
+/// The hash a flat map probes with: `mulx_mix` over `outpoint_hash`, which is
+/// hash epoch 1. Its high bits are the group an entry goes to.
+[[nodiscard]]
+inline uint64_t placement_hash(raw_outpoint const& key) noexcept {
+    return mulx64(uint64_t(hash_outpoint(key)), 0x9E3779B97F4A7C15ull);
+}
+
+/// One entry to place: where it goes, and where to read it from.
+template <typename Entry>
+struct placement {
+    uint64_t hash;
+    Entry const* entry;
+};
+
+/**
+ * @brief Every entry of `maps`, in the order a target map would store them.
+ *
+ * Not a stable sort, which would want a second buffer as large as the first:
+ * entries with equal hashes are either a duplicate key, reported the same way in
+ * any order, or a coincidence the map resolves by probing. Throws
+ * `std::bad_alloc` when the order does not fit in memory; the caller places the
+ * entries in source order instead.
+ */
+template <typename Map>
+[[nodiscard]]
+std::vector<placement<typename Map::value_type>>
+placement_order(std::vector<Map const*> const& maps) {
+    size_t total = 0;
+    for (auto const* map : maps) total += map->size();
+
+    std::vector<placement<typename Map::value_type>> order;
+    order.reserve(total);
+    for (auto const* map : maps) {
+        for (auto const& entry : *map) {
+            order.push_back({placement_hash(entry.first), &entry});
+        }
+    }
+    std::ranges::sort(order, {}, &placement<typename Map::value_type>::hash);
+    return order;
+}
+
+} // namespace utxoz::detail
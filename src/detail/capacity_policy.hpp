@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstddef>
@@ -259,6 +260,110 @@ static_assert(next_bucket_step(production_capacity[0].bucket_count) == 31457279)
 static_assert(production_capacity[0].file_size % (2u * 1024 * 1024) == 0,
               "and it is a multiple of every page and mapping granularity in use");
 
+// =============================================================================
+// A target sized to what it holds
+// =============================================================================
+
+/// What a fitted segment keeps on top of its share of the configured one. The
+/// segment manager, the stamp, the name index and the merge marker do not shrink
+/// with the map; `tools/sizing.cpp` measures them at a few kilobytes, and a
+/// mebibyte is the unit the table above rounds to anyway.
+inline constexpr uint64_t fitted_reserve = uint64_t(1024) * 1024;
+
+/// The segment a fitted generation of `step` buckets gets: the configured
+/// file scaled by the step, as fitted_capacity() explains. `step` is below the
+/// configured bucket count.
+inline constexpr capacity_entry fitted_at_step(capacity_entry const& configured, size_t step) {
+    // Steps and bucket counts are one short of a whole number of groups, so the
+    // ratio is taken over `n + 1`. Rounded up, so the share never comes out
+    // below the part of the configured file it stands for.
+    uint64_t const total = uint64_t(configured.bucket_count) + 1;
+    uint64_t const share = (uint64_t(configured.file_size) * (uint64_t(step) + 1) + total - 1) / total;
+    uint64_t const mib = uint64_t(1024) * 1024;
+    uint64_t const size = (share + mib - 1) / mib * mib + fitted_reserve;
+
+    capacity_entry fitted = configured;
+    fitted.file_size = size_t(std::min<uint64_t>(size, configured.file_size));
+    fitted.capacity = step;
+    fitted.bucket_count = step;
+    return fitted;
+}
+
+/**
+ * @brief The smallest segment that holds `entries` without growing, held to the
+ *        same arithmetic as the configured one.
+ *
+ * A merge target is built once, from entries that are all known before it is
+ * created, and a generation that has been drained since it was sealed holds a
+ * fraction of what its file was sized for. Neither needs the configured step:
+ * this is the smallest `bucket_step` whose growth point is at or above
+ * `entries` — `max_size_without_rehash`, the same line compaction already holds a
+ * target to — and never a step at or above the configured one, which is
+ * returned unchanged.
+ *
+ * The file is the configured one scaled by the step. Both arrays a map allocates,
+ * slots and group metadata, are a fixed number of bytes per group, and a step is
+ * a power of two in groups, so whatever margin the configured size has over its
+ * floor carries over to the part that scales. What does not scale is the fixed
+ * overhead, and `fitted_reserve` is there for it. Rounded up to a whole mebibyte
+ * and never above the configured size.
+ *
+ * A fitted generation rotates sooner when it is the active one, and that is the
+ * trade: it sits between the two thresholds at most, and the insert that would
+ * take it past the operating one makes a new generation at the configured size.
+ */
+inline constexpr capacity_entry fitted_capacity(capacity_entry const& configured, uint64_t entries) {
+    for (unsigned k = 0; ; ++k) {
+        uint64_t const step = bucket_step(k);
+        if (step >= configured.bucket_count) return configured;
+        if (max_size_without_rehash(step) < entries) continue;
+        return fitted_at_step(configured, size_t(step));
+    }
+}
+
+static_assert(fitted_capacity(production_capacity[0], 6'500'000).bucket_count == bucket_step(19),
+              "a class-0 generation drained to half goes down one step");
+static_assert(fitted_capacity(production_capacity[0], 6'500'000).file_size == 671_mib,
+              "and into half the file, plus the reserve");
+static_assert(fitted_capacity(production_capacity[0], 0).bucket_count == bucket_step(0));
+static_assert(fitted_capacity(production_capacity[0], max_size_without_rehash(bucket_step(19)) + 1)
+                  == production_capacity[0],
+              "one past the growth point of every smaller step is the configured segment");
+static_assert(fitted_capacity(testing_capacity[4], 600) == testing_capacity[4],
+              "a step that is still needed is not given up");
+
+/**
+ * @brief The bucket count of a generation of this class, from the length of its
+ *        file.
+ *
+ * A generation is created either at the configured segment or at a fitted one,
+ * and the file says which: its length is one of the sizes fitted_at_step()
+ * gives, or the configured size. That is what lets a caller that has only the
+ * directory — the compaction planner — price a fitted generation by its own
+ * table rather than by the class's. Small steps can share a size, because the
+ * sizes round to a mebibyte; the largest of them is taken, the one whose limit
+ * the entries are sure to fit under, and at a few mebibytes the pricing barely
+ * differs. A length that is none of these — a file from an earlier table — is
+ * `fallback`.
+ */
+inline constexpr size_t bucket_count_of_file(capacity_entry const& configured,
+                                             uint64_t file_size, size_t fallback) {
+    if (file_size == configured.file_size) return configured.bucket_count;
+    size_t found = fallback;
+    for (unsigned k = 0; bucket_step(k) < configured.bucket_count; ++k) {
+        if (fitted_at_step(configured, bucket_step(k)).file_size == file_size) {
+            found = bucket_step(k);
+        }
+    }
+    return found;
+}
+
+static_assert(bucket_count_of_file(production_capacity[0], 671_mib, 0) == bucket_step(19),
+              "a class-0 generation merged from half a table is read back as its step");
+static_assert(bucket_count_of_file(production_capacity[0], production_capacity[0].file_size, 0)
+                  == production_capacity[0].bucket_count);
+static_assert(bucket_count_of_file(production_capacity[0], 12345, 7) == 7);
+
 // =============================================================================
 // Whether one ever happened
 // =============================================================================
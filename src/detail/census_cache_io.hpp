@@ -0,0 +1,285 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file census_cache_io.hpp
+ * @brief What a census learnt about one sealed generation, kept beside its
+ *        metadata record so the next census need not learn it again.
+ * @internal
+ *
+ * Of everything the census reports about a generation, only the payload
+ * histogram takes a walk. The entry and bucket counts, the segment's size and
+ * free memory and the file's length are in the map and segment headers; the
+ * slot and metadata figures are computed from those; the payload and unused
+ * capacity are sums over the histogram. So the histogram is what is kept, with
+ * the header figures it was counted against.
+ *
+ * Those header figures are the key, and they are what makes the record safe to
+ * believe. A sealed generation changes in one way only, by losing entries — a
+ * deletion that reaches it, or a merge that retires it — and every deletion
+ * lowers the entry count in the map header. That count is therefore the
+ * generation's deletion counter, kept by the store at no cost to the delete
+ * path: a record whose count is not the file's describes an earlier state and is
+ * ignored. A merge writes a new file under a new version, and removes the
+ * records of the ones it retires with their metadata.
+ *
+ * The same rules as metadata (file_metadata_io.hpp): derived, so absent is the
+ * ordinary state; published through an atomic replace, so a reader sees a whole
+ * record or none; and marked, versioned and checksummed, because the one thing
+ * that must not happen is a record that looks valid and is not. Here that would
+ * be a census reporting figures for a file that no longer holds them.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include <utxoz/census.hpp>
+
+#include "file_metadata_io.hpp"
+#include "record_bytes.hpp"
+#include "segment_stamp.hpp"
+
+namespace utxoz::detail {
+
+namespace fs = std::filesystem;
+
+/// What the histogram was counted against: which file, and the state of its
+/// headers when it was. Equal keys, the same generation in the same state.
+struct census_cache_key {
+    segment_identity identity;
+    uint64_t entries = 0;
+    uint64_t bucket_count = 0;
+    uint64_t segment_size_bytes = 0;
+    uint64_t segment_free_bytes = 0;
+    uint64_t logical_file_bytes = 0;
+
+    [[nodiscard]] friend bool operator==(census_cache_key const& a, census_cache_key const& b) {
+        return a.identity.geometry_id == b.identity.geometry_id
+            && a.identity.map_layout_epoch == b.identity.map_layout_epoch
+            && a.identity.hash_epoch == b.identity.hash_epoch
+            && a.identity.platform_abi_id == b.identity.platform_abi_id
+            && a.identity.database_id == b.identity.database_id
+            && a.identity.container_kind == b.identity.container_kind
+            && a.identity.version == b.identity.version
+            && a.entries == b.entries
+            && a.bucket_count == b.bucket_count
+            && a.segment_size_bytes == b.segment_size_bytes
+            && a.segment_free_bytes == b.segment_free_bytes
+            && a.logical_file_bytes == b.logical_file_bytes;
+    }
+};
+
+/// One record, decoded.
+struct census_cache_entry {
+    census_cache_key key;
+    std::vector<payload_bucket> histogram;   ///< ascending, no empty buckets
+};
+
+/**
+ * @brief On-disk layout of a census cache record.
+ *
+ * Not fixed-size, because the histogram is as long as the sizes a generation
+ * holds. The bucket count is stated before the buckets, so the length is still
+ * a statement the record makes about itself: a file of any other length is a
+ * write cut short or something appended.
+ */
+struct census_cache_record {
+    static constexpr std::array<char, 4> magic{'U', 'Z', 'C', 'C'};
+    static constexpr uint16_t current_format = 1;
+
+    /// 4 + 2 + 2, identity 4*4 + 16 + 4 + 8, key 5*8, bucket count 4, checksum 4
+    static constexpr size_t fixed_size = 100;
+    /// 4 + 8 per bucket.
+    static constexpr size_t bucket_size = 12;
+    /// Far more than any class has sizes; a count past it is damage, and is
+    /// refused before it becomes an allocation.
+    static constexpr uint32_t max_buckets = 1u << 16;
+};
+
+[[nodiscard]]
+inline std::vector<uint8_t> encode_census_cache(census_cache_entry const& entry) {
+    using namespace record_bytes;
+
+    auto const& id = entry.key.identity;
+    std::vector<uint8_t> out;
+    out.reserve(census_cache_record::fixed_size
+                + entry.histogram.size() * census_cache_record::bucket_size);
+
+    out.insert(out.end(), census_cache_record::magic.begin(), census_cache_record::magic.end());
+    put(out, census_cache_record::current_format);
+    put(out, uint16_t{0});   // reserved, must be zero
+    put(out, id.geometry_id);
+    put(out, id.map_layout_epoch);
+    put(out, id.hash_epoch);
+    put(out, id.platform_abi_id);
+    out.insert(out.end(), id.database_id.begin(), id.database_id.end());
+    put(out, id.container_kind);
+    put(out, id.version);
+    put(out, entry.key.entries);
+    put(out, entry.key.bucket_count);
+    put(out, entry.key.segment_size_bytes);
+    put(out, entry.key.segment_free_bytes);
+    put(out, entry.key.logical_file_bytes);
+    put(out, static_cast<uint32_t>(entry.histogram.size()));
+    for (auto const& b : entry.histogram) {
+        put(out, b.payload_size);
+        put(out, b.entries);
+    }
+    put(out, checksum(std::span<uint8_t const>(out)));
+
+    return out;
+}
+
+/**
+ * @brief Parses and fully validates a record.
+ *
+ * Intact is not enough, as for metadata: the buckets have to be a histogram —
+ * ascending, none empty — and account for exactly the entries the key says the
+ * file held. Whether every size fits its class is the census's to check, since
+ * the record does not know the classes.
+ */
+[[nodiscard]]
+inline std::expected<census_cache_entry, metadata_read_error>
+decode_census_cache(std::span<uint8_t const> bytes) {
+    using namespace record_bytes;
+
+    if (bytes.size() < census_cache_record::magic.size()) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+    if ( ! std::equal(census_cache_record::magic.begin(), census_cache_record::magic.end(),
+                      reinterpret_cast<char const*>(bytes.data()))) {
+        return std::unexpected(metadata_read_error::foreign);
+    }
+    if (bytes.size() < census_cache_record::fixed_size) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    auto const* cursor = bytes.data() + census_cache_record::magic.size();
+
+    uint16_t format = 0;
+    uint16_t reserved = 0;
+    get(cursor, format);
+    get(cursor, reserved);
+    if (format != census_cache_record::current_format) {
+        return std::unexpected(metadata_read_error::foreign);
+    }
+    if (reserved != 0) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    census_cache_entry entry;
+    auto& id = entry.key.identity;
+    get(cursor, id.geometry_id);
+    get(cursor, id.map_layout_epoch);
+    get(cursor, id.hash_epoch);
+    get(cursor, id.platform_abi_id);
+    std::memcpy(id.database_id.data(), cursor, id.database_id.size());
+    cursor += id.database_id.size();
+    get(cursor, id.container_kind);
+    get(cursor, id.version);
+    get(cursor, entry.key.entries);
+    get(cursor, entry.key.bucket_count);
+    get(cursor, entry.key.segment_size_bytes);
+    get(cursor, entry.key.segment_free_bytes);
+    get(cursor, entry.key.logical_file_bytes);
+
+    uint32_t buckets = 0;
+    get(cursor, buckets);
+    if (buckets > census_cache_record::max_buckets
+            || bytes.size() != census_cache_record::fixed_size
+                               + size_t(buckets) * census_cache_record::bucket_size) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    entry.histogram.resize(buckets);
+    for (auto& b : entry.histogram) {
+        get(cursor, b.payload_size);
+        get(cursor, b.entries);
+    }
+
+    uint32_t stored_checksum = 0;
+    get(cursor, stored_checksum);
+    if (checksum(bytes.subspan(0, bytes.size() - sizeof(uint32_t))) != stored_checksum) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    // Coherent, not merely intact. The sum is checked bucket by bucket so that
+    // counts chosen to wrap cannot add up to the right total.
+    uint64_t counted = 0;
+    for (size_t i = 0; i < entry.histogram.size(); ++i) {
+        auto const& b = entry.histogram[i];
+        if (b.entries == 0) return std::unexpected(metadata_read_error::malformed);
+        if (i > 0 && b.payload_size <= entry.histogram[i - 1].payload_size) {
+            return std::unexpected(metadata_read_error::malformed);
+        }
+        if (b.entries > entry.key.entries - counted) {
+            return std::unexpected(metadata_read_error::malformed);
+        }
+        counted += b.entries;
+    }
+    if (counted != entry.key.entries || entry.key.entries > entry.key.bucket_count) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    return entry;
+}
+
+/// Reads a record, or says why there is none. Never returns a partial one.
+[[nodiscard]]
+inline std::expected<census_cache_entry, metadata_read_error>
+read_census_cache_file(fs::path const& path) {
+    std::error_code ec;
+    auto const status = fs::status(path, ec);
+    if (status.type() == fs::file_type::not_found) {
+        return std::unexpected(metadata_read_error::absent);
+    }
+    if (ec || ! fs::is_regular_file(status)) {
+        return std::unexpected(metadata_read_error::unreadable);
+    }
+
+    // Bounded before it is read: the longest record this format can describe.
+    auto const size = fs::file_size(path, ec);
+    if (ec) return std::unexpected(metadata_read_error::unreadable);
+    constexpr uint64_t longest = census_cache_record::fixed_size
+        + uint64_t(census_cache_record::max_buckets) * census_cache_record::bucket_size;
+    if (size > longest) {
+        // Still identified first, so a large file of someone else's is foreign.
+        std::ifstream ifs(path, std::ios::binary);
+        std::array<char, census_cache_record::magic.size()> marker{};
+        if ( ! ifs.read(marker.data(), std::streamsize(marker.size()))) {
+            return std::unexpected(metadata_read_error::unreadable);
+        }
+        return std::ranges::equal(marker, census_cache_record::magic)
+            ? std::unexpected(metadata_read_error::malformed)
+            : std::unexpected(metadata_read_error::foreign);
+    }
+
+    std::ifstream ifs(path, std::ios::binary);
+    if ( ! ifs) return std::unexpected(metadata_read_error::unreadable);
+    std::vector<uint8_t> buffer(size, 0);
+    ifs.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(buffer.size()));
+    if (ifs.gcount() != std::streamsize(buffer.size())) {
+        return std::unexpected(metadata_read_error::unreadable);
+    }
+
+    return decode_census_cache(buffer);
+}
+
+/// Publishes a record; see publish_record_file(). Never durable: losing one
+/// costs the next census a walk of one generation.
+[[nodiscard]]
+inline result<> write_census_cache_file(fs::path const& path, census_cache_entry const& entry) {
+    return publish_record_file(path, encode_census_cache(entry));
+}
+
+} // namespace utxoz::detail
@@ -0,0 +1,157 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file census_sampling.hpp
+ * @brief The estimates a sampled census reports, and how sure it is of them.
+ * @internal
+ *
+ * A sampled census reads the first entries of a generation in table order and
+ * stops. That is a sample and not merely a prefix because of where a flat map
+ * puts an entry: in the group its key hashes to, and the keys are outpoints,
+ * whose hash says nothing about how large the payload beside them is. So the
+ * first n entries of the table are as good as n drawn at random, and they are
+ * the first n slots of one array — a small fraction of the generation's pages,
+ * read in order, rather than a page per draw. It is also the same n every time,
+ * so the same state gives the same report, sampled or not.
+ *
+ * From the sample, the usual estimators of a total from a simple random sample
+ * without replacement: the payload total is N times the sample mean, a size's
+ * count N times its share of the sample, each with its variance and the finite
+ * population correction — which is what makes a generation read whole come out
+ * exact. Across generations the samples are independent and the variances add;
+ * the interval is taken once, at whatever level is reported.
+ *
+ * The interval is then narrowed to what is certain. The entries that were read
+ * are known exactly, and each of the rest holds between nothing and the class's
+ * capacity, so an interval never claims less payload than was seen nor more
+ * than the unread entries could hold.
+ *
+ * Separate from census.cpp so the arithmetic is reached directly, as
+ * census_arithmetic.hpp is.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <utxoz/census.hpp>
+
+namespace utxoz::detail {
+
+/// The coverage of every interval a sampled census reports, and the normal
+/// quantile that gives it.
+inline constexpr double sample_confidence = 0.95;
+inline constexpr double sample_z = 1.959963984540054;
+
+/// What an estimate is uncertain by, carried beside its point while
+/// generations and classes are summed. The variance adds across independent
+/// samples, and so do the bounds the entries that were read make certain. A
+/// figure that was counted is a spread of zero around itself.
+struct estimate_spread {
+    double variance = 0.0;
+    uint64_t floor = 0;
+    uint64_t ceiling = 0;
+
+    [[nodiscard]] static estimate_spread exact(uint64_t value) noexcept {
+        return {0.0, value, value};
+    }
+
+    estimate_spread& operator+=(estimate_spread const& other) noexcept {
+        variance += other.variance;
+        floor += other.floor;
+        ceiling += other.ceiling;
+        return *this;
+    }
+};
+
+/// The interval of a point with this spread, at `sample_confidence`, within
+/// the certain bounds.
+[[nodiscard]]
+inline estimate_interval interval_of(uint64_t point, estimate_spread const& spread) noexcept {
+    double const half = sample_z * std::sqrt(std::max(spread.variance, 0.0));
+    double const low = std::floor(double(point) - half);
+    double const high = std::ceil(double(point) + half);
+    estimate_interval out;
+    out.low = low <= double(spread.floor) ? spread.floor : uint64_t(low);
+    out.high = high >= double(spread.ceiling) ? spread.ceiling : uint64_t(high);
+    return out;
+}
+
+/// How many of a generation's `entries` a census at `fraction` reads: all of
+/// them unless the fraction is strictly between 0 and 1, and never fewer than
+/// `min_entries` or than two, the fewest a spread can be computed from.
+[[nodiscard]]
+inline uint64_t sample_limit(uint64_t entries, double fraction, uint64_t min_entries) noexcept {
+    if ( ! (fraction > 0.0 && fraction < 1.0)) return entries;
+    double const wanted = std::ceil(double(entries) * fraction);
+    uint64_t const limit = std::max({uint64_t(wanted), min_entries, uint64_t(2)});
+    return std::min(limit, entries);
+}
+
+/// One generation's estimates, from the sizes of the entries that were read.
+struct generation_estimate {
+    uint64_t payload = 0;
+    estimate_spread payload_spread;
+    uint64_t unused = 0;
+    estimate_spread unused_spread;
+    /// Sizes the sample met, ascending, with estimated counts and intervals.
+    std::vector<payload_bucket> histogram;
+    std::vector<estimate_spread> bucket_spreads;   ///< beside `histogram`
+};
+
+/**
+ * @brief Estimates for a generation of `entries` from the first `read` of them.
+ *
+ * `sample[size]` is how many of those held `size` bytes, every size within
+ * `capacity` — the walk refused anything else before this is reached. `read`
+ * is at least two and at most `entries`; at `entries` every variance is zero
+ * and every point the count itself.
+ */
+[[nodiscard]]
+inline generation_estimate estimate_from_sample(std::vector<uint64_t> const& sample,
+                                                uint64_t read, uint64_t entries,
+                                                uint64_t capacity) {
+    double const n = double(read);
+    double const big_n = double(entries);
+    double const correction = 1.0 - n / big_n;
+    uint64_t const unread = entries - read;
+
+    double sum = 0.0;
+    double sum_of_squares = 0.0;
+    uint64_t seen = 0;
+    for (size_t size = 0; size < sample.size(); ++size) {
+        if (sample[size] == 0) continue;
+        sum += double(size) * double(sample[size]);
+        sum_of_squares += double(size) * double(size) * double(sample[size]);
+        seen += uint64_t(size) * sample[size];
+    }
+    double const mean = sum / n;
+    double const sample_variance = std::max(0.0, (sum_of_squares - n * mean * mean) / (n - 1.0));
+
+    generation_estimate out;
+    uint64_t const most = entries * capacity;   // the caller checked it cannot wrap
+    out.payload = std::min(uint64_t(std::llround(big_n * mean)), most);
+    out.payload_spread = {big_n * big_n * correction * sample_variance / n,
+                          seen, seen + unread * capacity};
+    out.unused = most - out.payload;
+    out.unused_spread = {out.payload_spread.variance,
+                         most - out.payload_spread.ceiling, most - out.payload_spread.floor};
+
+    for (size_t size = 0; size < sample.size(); ++size) {
+        if (sample[size] == 0) continue;
+        double const share = double(sample[size]) / n;
+        out.histogram.push_back({static_cast<uint32_t>(size),
+                                 std::min(uint64_t(std::llround(big_n * share)), entries),
+                                 {}});
+        out.bucket_spreads.push_back({big_n * big_n * correction * share * (1.0 - share) / (n - 1.0),
+                                      sample[size], sample[size] + unread});
+    }
+    return out;
+}
+
+} // namespace utxoz::detail
@@ -0,0 +1,419 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file compaction_planner.hpp
+ * @brief Grouping and pricing generations for a merge, from figures alone.
+ * @internal
+ *
+ * Separate from the database for the same reason census_arithmetic.hpp is: the
+ * interesting cases are shapes of a catalogue — a nearly full generation between
+ * two empty ones, a budget that admits the second-best group and not the best —
+ * and building each of those out of real files means filling segments to a
+ * chosen fill, which is slow and says nothing the arithmetic does not. So the
+ * planner takes a description of each class and returns groups, and the tests
+ * hand it descriptions.
+ *
+ * Everything here is a pure function of its arguments. The database fills in a
+ * `class_profile` per class from its catalogue and capacity table, and executes
+ * whatever comes back through the ordinary merge.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <utxoz/compaction.hpp>
+
+#include "capacity_policy.hpp"
+
+namespace utxoz::detail {
+
+/// One generation, as the planner sees it.
+struct generation_profile {
+    size_t version = 0;
+    /// Live entries. Absent when nothing describes the generation — which is
+    /// "unknown", never "empty": an empty-looking generation is the first one a
+    /// strategy would pick, and the planner must not pick one it cannot see.
+    std::optional<size_t> entries;
+    /// What its bucket count takes without growing.
+    size_t limit = 0;
+    uint64_t file_bytes = 0;
+    /// Slot array plus group metadata: what iterating it reads.
+    uint64_t table_bytes = 0;
+    /// Historical lookups that probed it over the recorded window.
+    uint64_t probe_reach = 0;
+    /// The one being inserted into. A group that takes it in is merged into the
+    /// configured segment rather than a fitted one (see sizing_for).
+    bool active = false;
+
+    /// Entries over limit. A generation with no limit, or none that is known,
+    /// counts as full: full is the one value no strategy acts on.
+    [[nodiscard]] double fill() const noexcept {
+        if ( ! entries || limit == 0) return 1.0;
+        return double(*entries) / double(limit);
+    }
+};
+
+/// One class, its generations ascending, and what a new target would be.
+struct class_profile {
+    uint64_t container_class = 0;
+    std::vector<generation_profile> generations;
+    size_t target_limit = 0;
+    /// What a new target is built with. Zero prices every target at the
+    /// configured size, which is what a profile built by hand usually means.
+    size_t target_buckets = 0;
+    uint64_t target_file_bytes = 0;
+    uint64_t target_table_bytes = 0;
+    /// Whether `probe_reach` was measured. Below the `lookup` statistics level it
+    /// is zero because nothing counted it, and a plan must say so.
+    bool probes_known = false;
+};
+
+/**
+ * @brief How many historical lookups probed the generation `position` files
+ *        back, from the probe-ordinal histogram.
+ *
+ * The ordinal and not the version distance, although both are recorded. A sweep
+ * visits the generations below the active one nearest first, so a key answered
+ * at ordinal k probed positions 1 through k — that is exactly the reach of a
+ * position. The version distance is the gap in numbering, and compaction leaves
+ * holes in the numbering, so it overstates how deep a sweep went by however many
+ * identities have been retired.
+ *
+ * The buckets are 1, 2, 3, 4, 5–8 and 9+. The 5–8 bucket is taken as spread
+ * evenly over its four ordinals. The 9+ bucket has no upper end, so it is
+ * counted as reaching every position past nine: that can only make a deep
+ * generation look more worth merging than it is, never less.
+ */
+[[nodiscard]]
+inline uint64_t probes_reaching(std::array<size_t, 6> const& ordinals, size_t position) noexcept {
+    if (position == 0) return 0;   // the active generation; find() probes it, not a sweep
+    uint64_t reach = 0;
+    for (size_t b = 0; b < 4; ++b) {
+        if (b + 1 >= position) reach += ordinals[b];
+    }
+    if (position <= 5) {
+        reach += ordinals[4];
+    } else if (position <= 8) {
+        reach += ordinals[4] * (8 - position + 1) / 4;
+    }
+    reach += ordinals[5];
+    return reach;
+}
+
+/// The counts a plan reports beside its groups.
+struct eligibility_counts {
+    uint64_t considered = 0;
+    uint64_t too_full = 0;
+    uint64_t unknown = 0;
+};
+
+/// What a target that holds `entries` is created with, priced.
+struct target_figures {
+    uint64_t file_bytes = 0;
+    uint64_t table_bytes = 0;
+};
+
+/// The class's target scaled to the step `fitted_capacity` picks for `entries`,
+/// which is how the merge sizes it. The table is scaled by the same ratio as the
+/// file, divided first so a saturated figure stays saturated rather than wrapping.
+[[nodiscard]]
+inline target_figures fitted_target(class_profile const& cls, uint64_t entries) noexcept {
+    if (cls.target_buckets == 0) return {cls.target_file_bytes, cls.target_table_bytes};
+    capacity_entry const configured{size_t(cls.target_file_bytes), cls.target_buckets,
+                                    cls.target_buckets, false};
+    auto const fitted = fitted_capacity(configured, entries);
+    if (fitted.bucket_count == cls.target_buckets) {
+        return {cls.target_file_bytes, cls.target_table_bytes};
+    }
+    uint64_t const total = uint64_t(cls.target_buckets) + 1;
+    return {fitted.file_size, cls.target_table_bytes / total * (uint64_t(fitted.bucket_count) + 1)};
+}
+
+namespace planner {
+
+/// Positions into `generations`, ascending.
+using member_list = std::vector<size_t>;
+
+/// The entries a generation contributes to a group. Unknown counts as full,
+/// so that the greedy prediction never plans a group the merge would refuse.
+[[nodiscard]]
+inline size_t entries_or_limit(generation_profile const& g) noexcept {
+    return g.entries ? *g.entries : g.limit;
+}
+
+/// What `merge_groups()` does: from the oldest generation, the largest run that
+/// fits, shrinking one at a time.
+[[nodiscard]]
+inline std::vector<member_list> greedy(class_profile const& cls) {
+    std::vector<member_list> out;
+    auto const& gens = cls.generations;
+    size_t first = 0;
+    while (first < gens.size()) {
+        size_t count = gens.size() - first;
+        while (count >= 2) {
+            size_t sum = 0;
+            for (size_t i = first; i < first + count; ++i) sum += entries_or_limit(gens[i]);
+            if (sum <= cls.target_limit) break;
+            --count;
+        }
+        if (count < 2) {
+            ++first;
+            continue;
+        }
+        member_list group(count);
+        for (size_t i = 0; i < count; ++i) group[i] = first + i;
+        out.push_back(std::move(group));
+        first += count;
+    }
+    return out;
+}
+
+[[nodiscard]]
+inline std::vector<member_list> tiered(class_profile const& cls, std::vector<bool> const& eligible) {
+    std::vector<member_list> out;
+    member_list run;
+    size_t sum = 0;
+    auto const close = [&] {
+        if (run.size() >= 2) out.push_back(run);
+        run.clear();
+        sum = 0;
+    };
+    for (size_t i = 0; i < cls.generations.size(); ++i) {
+        if ( ! eligible[i]) {
+            close();
+            continue;
+        }
+        size_t const e = *cls.generations[i].entries;
+        if (sum + e > cls.target_limit) close();
+        if (e > cls.target_limit) continue;
+        run.push_back(i);
+        sum += e;
+    }
+    close();
+    return out;
+}
+
+[[nodiscard]]
+inline std::vector<member_list> leveled(class_profile const& cls, std::vector<bool> const& eligible) {
+    auto const& gens = cls.generations;
+    member_list remaining;
+    for (size_t i = 0; i < gens.size(); ++i) {
+        if (eligible[i]) remaining.push_back(i);
+    }
+    // Emptiest first; the fullest is taken from the back as each group's base.
+    std::ranges::stable_sort(remaining, {}, [&](size_t i) { return *gens[i].entries; });
+
+    std::vector<member_list> out;
+    while (remaining.size() >= 2) {
+        size_t const base = remaining.back();
+        remaining.pop_back();
+        member_list group{base};
+        size_t sum = *gens[base].entries;
+
+        member_list left;
+        for (auto const i : remaining) {
+            if (sum + *gens[i].entries <= cls.target_limit) {
+                group.push_back(i);
+                sum += *gens[i].entries;
+            } else {
+                left.push_back(i);
+            }
+        }
+        remaining = std::move(left);
+        if (group.size() >= 2) {
+            std::ranges::sort(group);
+            out.push_back(std::move(group));
+        }
+    }
+    return out;
+}
+
+[[nodiscard]]
+inline std::vector<member_list> size_ratio(class_profile const& cls, std::vector<bool> const& eligible,
+                                           double ratio) {
+    auto const& gens = cls.generations;
+    member_list order;
+    for (size_t i = 0; i < gens.size(); ++i) {
+        if (eligible[i]) order.push_back(i);
+    }
+    std::ranges::stable_sort(order, {}, [&](size_t i) { return *gens[i].entries; });
+
+    std::vector<member_list> out;
+    member_list group;
+    size_t sum = 0;
+    auto const close = [&] {
+        if (group.size() >= 2) {
+            std::ranges::sort(group);
+            out.push_back(group);
+        }
+        group.clear();
+        sum = 0;
+    };
+    for (auto const i : order) {
+        size_t const e = *gens[i].entries;
+        // Against what the group holds, with an empty group counting as one
+        // entry, so that a run of empty generations still gathers.
+        bool const in_ratio = double(e) <= ratio * double(std::max<size_t>(sum, 1));
+        if ( ! group.empty() && ( ! in_ratio || sum + e > cls.target_limit)) close();
+        if (e > cls.target_limit) continue;
+        group.push_back(i);
+        sum += e;
+    }
+    close();
+    return out;
+}
+
+/// Generations no group took, drained to `below` or under, each rewritten on
+/// its own into a target sized to what it holds — when that target is smaller
+/// than the file it replaces. Never the active generation, the last one: it is
+/// still being filled, and fitting it would only make the next insert rotate.
+[[nodiscard]]
+inline std::vector<member_list> refits(class_profile const& cls, std::vector<bool> const& eligible,
+                                       std::vector<member_list> const& taken, double below) {
+    std::vector<bool> grouped(cls.generations.size(), false);
+    for (auto const& group : taken) {
+        for (auto const i : group) grouped[i] = true;
+    }
+
+    std::vector<member_list> out;
+    for (size_t i = 0; i + 1 < cls.generations.size(); ++i) {
+        auto const& gen = cls.generations[i];
+        if ( ! eligible[i] || grouped[i] || gen.fill() > below) continue;
+        if (fitted_target(cls, *gen.entries).file_bytes >= gen.file_bytes) continue;
+        out.push_back({i});
+    }
+    return out;
+}
+
+} // namespace planner
+
+/// Prices one group: the figures compaction_group carries, and its score.
+[[nodiscard]]
+inline compaction_group price_group(class_profile const& cls, planner::member_list const& members,
+                                    compaction_options const& options) {
+    compaction_group g;
+    g.container_class = cls.container_class;
+
+    double fill_total = 0.0;
+    uint64_t reach_total = 0;
+    uint64_t reach_max = 0;
+    uint64_t file_total = 0;
+    for (auto const i : members) {
+        auto const& gen = cls.generations[i];
+        g.sources.push_back(gen.version);
+        g.entries += planner::entries_or_limit(gen);
+        fill_total += gen.fill();
+        g.bytes_read += gen.table_bytes;
+        file_total += gen.file_bytes;
+        reach_total += gen.probe_reach;
+        reach_max = std::max(reach_max, gen.probe_reach);
+    }
+    g.source_fill = members.empty() ? 0.0 : fill_total / double(members.size());
+    g.target_fill = cls.target_limit == 0 ? 1.0 : double(g.entries) / double(cls.target_limit);
+    bool const takes_active = std::ranges::any_of(members, [&](size_t i) {
+        return cls.generations[i].active;
+    });
+    auto const target = takes_active
+        ? target_figures{cls.target_file_bytes, cls.target_table_bytes}
+        : fitted_target(cls, g.entries);
+    g.bytes_written = target.table_bytes;
+    g.bytes_reclaimed = file_total > target.file_bytes ? file_total - target.file_bytes : 0;
+
+    // Every member's probes, less the ones the target would have taken. The
+    // target takes the deepest reach of its members: a key that reached any of
+    // them reached the position the merged file stands in for.
+    if (cls.probes_known) {
+        g.probes_saved = reach_total - reach_max;
+        g.probes_saved_status = metric_status::measured;
+    } else {
+        g.probes_saved_status = metric_status::unavailable;
+    }
+
+    double const benefit = double(g.bytes_reclaimed)
+                         + double(options.probe_weight_bytes) * double(g.probes_saved);
+    double const cost = double(g.bytes_read) + double(g.bytes_written);
+    g.score = cost > 0.0 ? benefit / cost : 0.0;
+    return g;
+}
+
+/**
+ * @brief The whole plan: every class grouped by the strategy, priced, ranked and
+ *        held to the budget.
+ *
+ * Options outside their meaningful range are clamped rather than refused: a
+ * negative fill threshold admits nothing and a ratio below one admits only
+ * groups of equal generations, which are both answers and not errors.
+ */
+[[nodiscard]]
+inline compaction_plan plan_compaction(std::vector<class_profile> const& classes,
+                                       compaction_options const& options) {
+    compaction_plan plan;
+    plan.strategy = options.strategy;
+
+    double const max_fill = std::isnan(options.max_source_fill) ? 0.0 : options.max_source_fill;
+    double const ratio = std::isnan(options.size_ratio) ? 1.0 : std::max(options.size_ratio, 1.0);
+    double const refit_below = std::isnan(options.refit_below) ? 0.0 : options.refit_below;
+
+    std::vector<compaction_group> groups;
+    for (auto const& cls : classes) {
+        plan.generations_considered += cls.generations.size();
+
+        std::vector<planner::member_list> members;
+        if (options.strategy == compaction_strategy::greedy) {
+            members = planner::greedy(cls);
+        } else {
+            std::vector<bool> eligible(cls.generations.size(), false);
+            for (size_t i = 0; i < cls.generations.size(); ++i) {
+                auto const& gen = cls.generations[i];
+                if ( ! gen.entries) {
+                    ++plan.generations_unknown;
+                } else if (gen.fill() > max_fill) {
+                    ++plan.generations_too_full;
+                } else {
+                    eligible[i] = true;
+                }
+            }
+            switch (options.strategy) {
+                case compaction_strategy::tiered:     members = planner::tiered(cls, eligible); break;
+                case compaction_strategy::leveled:    members = planner::leveled(cls, eligible); break;
+                case compaction_strategy::size_ratio: members = planner::size_ratio(cls, eligible, ratio); break;
+                case compaction_strategy::greedy:     break;
+            }
+            if (refit_below > 0.0) {
+                auto refit = planner::refits(cls, eligible, members, refit_below);
+                members.insert(members.end(), refit.begin(), refit.end());
+            }
+        }
+        for (auto const& m : members) groups.push_back(price_group(cls, m, options));
+    }
+
+    // Greedy is a prediction of compact_all(), which merges in catalogue order
+    // and knows no budget; reordering it would predict something else.
+    if (options.strategy != compaction_strategy::greedy) {
+        std::ranges::stable_sort(groups, std::ranges::greater{}, &compaction_group::score);
+    }
+
+    for (auto& g : groups) {
+        if (options.strategy != compaction_strategy::greedy && options.max_bytes_written != 0
+                && plan.bytes_written + g.bytes_written > options.max_bytes_written) {
+            ++plan.groups_over_budget;
+            continue;
+        }
+        plan.bytes_read += g.bytes_read;
+        plan.bytes_written += g.bytes_written;
+        plan.bytes_reclaimed += g.bytes_reclaimed;
+        plan.files_removed += g.sources.size() - 1;
+        plan.groups.push_back(std::move(g));
+    }
+    return plan;
+}
+
+} // namespace utxoz::detail
@@ -10,11 +10,16 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <filesystem>
+#include <future>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <set>
+#include <shared_mutex>
+#include <thread>
 #include <utility>
 #include <variant>
 
@@ -23,11 +28,15 @@
 #include <utxoz/aliases.hpp>
 #include <utxoz/database.hpp>
 #include <utxoz/census.hpp>
+#include <utxoz/compaction.hpp>
 
 #include <optional>
 
+#include "detail/dirty_pages.hpp"
 #include "detail/distinct_keys.hpp"
+#include "detail/group_commit.hpp"
 #include "detail/insert_transition.hpp"
+#include "detail/io_engine.hpp"
 #include <utxoz/statistics.hpp>
 #include <utxoz/types.hpp>
 
@@ -35,13 +44,21 @@
 #include "file_cache.hpp"
 #include "file_metadata.hpp"
 #include "file_metadata_io.hpp"
+#include "latency_scope.hpp"
 #include "merge_policy.hpp"
+#include "merge_space.hpp"
+#include "manifest_io.hpp"
 #include "merge_sidecar.hpp"
+#include "page_faults.hpp"
+#include "reader_board.hpp"
 #include "scope_exit.hpp"
 #include "format_identity.hpp"
 #include "segment_open.hpp"
 #include "segment_stamp.hpp"
+#include "snapshot_registry.hpp"
+#include "stats_publisher.hpp"
 #include "store_config_io.hpp"
+#include "trace_ring.hpp"
 #include "capacity_policy.hpp"
 #include "version_catalog.hpp"
 #include "utxo_value.hpp"
@@ -62,6 +79,31 @@ namespace fs = std::filesystem;
 deletion_progress refuse_deletions(std::span<deferred_deletion_entry const> requests,
                                    error_code why);
 
+/**
+ * @brief `std::optional<error_code>`, set once, and read by find() while an
+ *        insert may be setting it.
+ *
+ * find() checks the latch before it reads a map, and since find() may run
+ * alongside insert() — the operation that latches — a plain optional would be
+ * read and written at once. Same spelling at every use: assigned a code, tested
+ * as a bool, dereferenced for the code.
+ */
+class integrity_latch {
+public:
+    integrity_latch& operator=(error_code code) noexcept {
+        code_.store(uint16_t(uint16_t(code) + 1), std::memory_order_release);
+        return *this;
+    }
+    explicit operator bool() const noexcept {
+        return code_.load(std::memory_order_acquire) != 0;
+    }
+    error_code operator*() const noexcept {
+        return error_code(code_.load(std::memory_order_acquire) - 1);
+    }
+private:
+    std::atomic<uint16_t> code_{0};   ///< zero is unset; otherwise the code plus one
+};
+
 /// @internal
 struct database_impl {
     database_impl() = default;
@@ -90,14 +132,34 @@ struct database_impl {
     size_t size() const;
 
     result<bool> insert(raw_outpoint const& key, output_data_span value, uint32_t height);
+    insertion_progress insert_batch(std::span<insert_request const> requests);
     std::optional<find_result> find(raw_outpoint const& key, uint32_t height) const;
 
     deletion_progress apply_deletes(std::span<deferred_deletion_entry const> requests);
 
-    result<> compact_all();
+    result<> compact_all(compaction_concurrency const& concurrency = {});
+
+    /// Groups and prices the generations without touching a file. See
+    /// compaction.hpp. Defined in src/compaction.cpp.
+    [[nodiscard]] compaction_plan plan_compaction(compaction_options const& options) const;
+
+    /// Plans, then merges the planned groups. Returns the groups it merged.
+    [[nodiscard]] result<compaction_plan> compact(compaction_options const& options);
+
+    /// Rewrites every active generation that has drifted far enough into a
+    /// fresh one. See db_base::rebuild_active().
+    [[nodiscard]] result<std::vector<active_rebuild>> rebuild_active(rebuild_options const& options);
+
+    /// Seals the active generations and pins every sealed one. See
+    /// full_db::snapshot().
+    [[nodiscard]] result<full_snapshot> snapshot();
 
     /// Puts everything written so far on stable storage. See db_base::sync().
     result<> sync();
+
+    /// The same, with the file barriers taken by a background flusher. See
+    /// db_base::sync_async().
+    std::shared_future<result<>> sync_async();
     result<> for_each_key_impl(void(*cb)(void*, raw_outpoint const&), void* ctx) const;
     result<> for_each_entry_impl(void(*cb)(void*, raw_outpoint const&, uint32_t, std::span<uint8_t const>), void* ctx) const;
 
@@ -135,7 +197,10 @@ struct database_impl {
     /// see census.hpp. Defined in src/census.cpp.
     [[nodiscard]] result<census_report> census(census_options const& options) const;
 
-    database_statistics get_statistics();
+    database_statistics get_statistics() const;
+    /// get_statistics() without what costs: no distributions and no cached
+    /// file list. Sizes and fill come from the published snapshot.
+    database_statistics get_counter_statistics() const;
     void print_statistics();
     sizing_report get_sizing_report() const;
     void print_sizing_report() const;
@@ -144,10 +209,49 @@ struct database_impl {
 
     void reset_search_stats();
 
+    /// Safe alongside any operation: it reads nothing but latency_stats_.
+    latency_snapshot get_latency_snapshot() const;
+    void reset_latency_stats();
+
+    /// Safe alongside any operation: it reads nothing but the published side
+    /// of stats_.
+    stats_snapshot get_stats_snapshot() const { return stats_.read(mode_); }
+
+    /// Capped at compiled_statistics_level; returns the level now running.
+    /// Safe alongside any operation, like the getter: see statistics_level_.
+    statistics_level set_statistics_level(statistics_level level) noexcept;
+    statistics_level get_statistics_level() const noexcept {
+        return statistics_level_.load(std::memory_order_relaxed);
+    }
+
+    /// Safe alongside any operation: the ring has its own lock, and whether it
+    /// records is one atomic. See trace_ring.
+    void start_tracing(trace_options const& options) { trace_.start(options); }
+    void stop_tracing() noexcept { trace_.stop(); }
+    trace_capture drain_trace() { return trace_.drain(); }
+
     float get_cache_hit_rate() const;
     std::vector<std::pair<size_t, size_t>> get_cached_file_info() const;
 
 private:
+    /// What one operation counts, settled once as it starts. A batch asks once
+    /// and every key in it is counted or not alike; a per-key call asks once
+    /// per key, which is one relaxed load and a branch that goes the same way
+    /// every time. Constant and empty in a build without statistics, where the
+    /// `#if` around each use has already removed the counting it would gate.
+    struct counting {
+        bool basic = false;
+        bool lookup = false;
+    };
+    [[nodiscard]] counting counting_now() const noexcept {
+        if constexpr (compiled_statistics_level == statistics_level::off) {
+            return {};
+        } else {
+            auto const level = statistics_level_.load(std::memory_order_relaxed);
+            return {level >= statistics_level::basic, level >= statistics_level::lookup};
+        }
+    }
+
     // Template helpers for compile-time dispatch
     template<size_t N, typename Func, size_t... Is>
     static constexpr void for_each_index_impl(Func&& f, std::index_sequence<Is...>);
@@ -178,11 +282,43 @@ private:
     [[nodiscard]] result<> reference_rotate_for(rotation_cause cause);
 
     // Find helpers
-    std::optional<find_result> find_in_latest_version(raw_outpoint const& key, uint32_t height) const;
+    std::optional<find_result> find_in_latest_version(raw_outpoint const& key, uint32_t height,
+                                                      counting counted) const;
+
+    /// A copy of `key`'s value in the active map of class `Index`, whole, or
+    /// nothing. The caller holds active_maps_lock_ shared.
+    template<size_t Index>
+    std::optional<utxo_value<container_sizes[Index]>> copy_from_active(raw_outpoint const& key) const;
 
     // The active-version phase of apply_deletes(); nothing else calls it.
     size_t erase_in_latest_version(raw_outpoint const& key, uint32_t height);
 
+    /// Erases `key` from one class's active map. Returns the age of the entry
+    /// it erased, for the lifetime counters, which are shared by every class
+    /// and so are left to the caller.
+    template<size_t Index>
+    std::optional<uint32_t> erase_in_active(raw_outpoint const& key, uint32_t height);
+
+    /// Counts one spent entry of `age` blocks in the lifetime statistics.
+    void record_spent(uint32_t age);
+
+    /// The active-version phase over every class at once, for a batch large
+    /// enough to be worth the threads. Erased positions of `pending` are
+    /// returned per class, in the order each class found them. The page faults
+    /// the helper threads took are added to `helper_faults` when counting; the
+    /// calling thread's own are its caller's to read.
+    std::array<std::vector<size_t>, container_count> erase_in_actives_concurrently(
+        std::span<deferred_deletion_entry const> requests, std::vector<size_t> const& pending,
+        fault_count& helper_faults);
+
+    /// Runs `work(I)` for every class whose `busy` flag is set, one thread per
+    /// class, the calling thread included. Unlike for_each_class_concurrently(),
+    /// nothing stops early: every class finishes its share. An exception is
+    /// caught at the thread's edge and the lowest class's is rethrown here,
+    /// once every class has joined.
+    template<typename Work>
+    void for_each_busy_class(std::array<bool, container_count> const& busy, Work&& work);
+
     // File management
     //
     // Opening a version that must be there and creating one that must not are
@@ -240,6 +376,9 @@ private:
     fs::path building_path(size_t index, size_t version) const;
     fs::path sidecar_path(size_t index, size_t version) const;
     fs::path metadata_path(size_t index, size_t version) const;
+    /// What census() learnt about a sealed generation; see census_cache_io.hpp.
+    /// Derived, like metadata, and retired with it.
+    fs::path census_cache_path(size_t index, size_t version) const;
 
     /// Mandatory phase of open(): finishes or abandons whatever a previous
     /// process left in flight, before any container is opened and therefore
@@ -256,13 +395,22 @@ private:
     result<merge_marker> read_target_marker(size_t index, size_t version) const;
 
     result<> recover_pending_merges();
+
+    /// The scanned open's read of every generation below each active one: its
+    /// stamp checked, its entries added to entries_count_, and the metadata
+    /// record of every generation loaded. Spread over a few threads; see the
+    /// definition.
+    [[nodiscard]]
+    result<> scan_sealed_generations();
+
     result<> recover_one(merge_plan const& plan, fs::path const& sidecar);
 
     /// Builds one new version file holding everything in `sources`, publishes
     /// it, and retires them. One implementation; the policy names the six
     /// things that differ between the storage modes.
     template<typename Policy>
-    result<> merge_versions(Policy policy, std::vector<size_t> const& sources);
+    result<> merge_versions(Policy policy, std::vector<size_t> const& sources,
+                            target_sizing sizing = target_sizing::fitted);
 
     /// The merging itself, bracketed by compact_container() so that reopening
     /// the active container is part of the typed result rather than something a
@@ -270,14 +418,49 @@ private:
     template<typename Policy>
     result<> merge_groups(Policy policy);
 
+    /// The planned groups of one class, in plan order. Bracketed the same way
+    /// merge_groups() is; appends what it merged to `merged`.
+    template<typename Policy>
+    result<> merge_planned(Policy policy, uint64_t container_class,
+                           compaction_plan const& plan, compaction_plan& merged);
+
+    /// Rewrites `active`, the generation that was active when a compaction of
+    /// the class started, to the next version if a merge target now outranks it.
+    /// See the definition.
+    template<typename Policy>
+    result<> keep_active_on_top(Policy policy, size_t active);
+
     template<size_t Index>
     result<> reopen_active_container();
     result<> reopen_active_reference_container();
 
+    /// One class of rebuild_active(): describes the active generation into
+    /// `record`, and rebuilds it if it has drifted at least `min_drift`.
+    template<size_t Index>
+    result<> rebuild_active_container(double min_drift, active_rebuild& record);
+    result<> rebuild_active_reference_container(double min_drift, active_rebuild& record);
+
+    /// Runs `work(index)` for every size class on up to `concurrency.threads`
+    /// threads, largest backlog first. Returns the failure of the lowest class
+    /// that failed; a failure stops every class not yet started.
+    template<typename Work>
+    result<> for_each_class_concurrently(compaction_concurrency const& concurrency, Work&& work);
+
+    /// The free space merge targets in flight have claimed. See merge_space.hpp.
+    merge_space_ledger merge_space_;
+
+    /// Guards `dirty_versions_` wherever classes run side by side: concurrent
+    /// merges discharge the obligations of the sources they retired, and the
+    /// classes of an insert_batch() record theirs as they rotate. The set is
+    /// shared by every class. Taken once per rotation or per historical
+    /// deletion, never per insert.
+    std::mutex dirty_versions_mutex_;
+
     /// True once a merge published its target and could not retire everything
     /// it superseded. Latches: the instance serves nothing further until it is
-    /// closed and reopened, which runs recovery.
-    bool cleanup_pending_ = false;
+    /// closed and reopened, which runs recovery. Atomic because concurrent
+    /// merges of different classes can each latch it.
+    std::atomic<bool> cleanup_pending_{false};
 
     /**
      * @brief Set once, never cleared: this instance may not be used again.
@@ -297,7 +480,7 @@ private:
      *
      * In memory only. The code says so where it is read.
      */
-    std::optional<error_code> integrity_latched_;
+    integrity_latch integrity_latched_;
 
     /// Why generations were replaced. Present in every build; see rotation_causes.
     std::array<rotation_causes, container_count> rotation_causes_{};
@@ -324,12 +507,62 @@ private:
      * discharged by a successful sync(), or by compaction retiring the file —
      * a version that no longer exists cannot owe anything. A partial sync
      * clears nothing: an obligation half met is an obligation.
+     *
+     * Each file carries the epoch of its latest write, so that a sync_async()
+     * round, which completes later and on another thread, discharges only what
+     * was written before it was asked for. See group_commit.hpp.
      */
-    std::set<std::pair<size_t, size_t>> dirty_versions_;
+    std::map<std::pair<size_t, size_t>, uint64_t> dirty_versions_;
 
     /// Records that a historical version file was written to.
     void note_dirty(size_t container_index, size_t version) {
-        dirty_versions_.emplace(container_index, version);
+        std::lock_guard const lock(dirty_versions_mutex_);
+        dirty_versions_.insert_or_assign({container_index, version}, write_epoch_);
+    }
+
+    /// The epoch writes are tagged with: the number of sync_async() requests
+    /// made before them. Read and advanced on the writer's thread only.
+    uint64_t write_epoch_ = 0;
+
+    /// The spans of trace.hpp. Declared before the flusher and the file cache,
+    /// which both record into it, so that it outlives them; mutable because
+    /// resolve() is const and records too.
+    mutable trace_ring trace_;
+
+    /// Started by the first sync_async(), drained by close().
+    std::unique_ptr<group_commit> group_commit_;
+
+    /// Takes sync()'s file barriers, on the writer's thread. Set up by the first
+    /// sync, so an instance that never syncs opens no ring.
+    std::unique_ptr<io_engine> io_;
+
+    /// Drops the obligations a completed sync_async() round has met.
+    void discharge_settled();
+
+    /**
+     * @brief The pages of each active mapping written since the last sync.
+     *
+     * The other half of the obligation: dirty_versions_ records which files owe
+     * a file barrier, these record where in the active mappings the page
+     * barrier is owed. Attached when a container is mapped, detached when it is
+     * closed, and cleared only by a sync that returned success. See
+     * dirty_pages.hpp for what they cannot see and why that is safe.
+     */
+    std::array<dirty_pages, container_count> active_pages_{};
+    dirty_pages reference_pages_;
+
+    /// Records the slot an insert filled or an erase is about to empty, and the
+    /// map object, whose size the write changed. A growth moved the table, so
+    /// after one everything is noted.
+    template<typename Map, typename Slot>
+    static void note_written(dirty_pages& pages, Map const& map, Slot const& slot,
+                             bool grew = false) noexcept {
+        if (grew) {
+            pages.note_all();
+            return;
+        }
+        pages.note(&map, sizeof(map));
+        pages.note(&slot, sizeof(slot));
     }
 
 public:
@@ -406,8 +639,6 @@ private:
 
     size_t get_index_from_size(size_t size) const;
 
-    size_t estimate_memory_usage(size_t index) const;
-
     // Internal configuration
     result<> configure_internal(fs::path path, bool remove_existing, storage_mode mode,
                                 open_intent intent);
@@ -416,15 +647,32 @@ private:
     void update_metadata_on_insert(size_t index, size_t version, raw_outpoint const& key, uint32_t height);
     void update_metadata_on_delete(size_t index, size_t version);
     void save_metadata_to_disk(size_t index, size_t version) noexcept;
-    void load_metadata_from_disk(size_t index, size_t version);
+    /// Installs a record read from disk as the metadata of `version` of class
+    /// `index` — or of the reference container, for reference_sentinel_index.
+    /// A record that could not be read is reported and leaves it unknown.
+    void adopt_metadata_record(size_t index, size_t version,
+                               std::expected<file_metadata, metadata_read_error> const& record);
 
     // Statistics
-    void update_fragmentation_stats();
+    /// Restages every class's sizes from the maps, the segments and the sealed
+    /// files, and publishes them. What open and compaction end with: the one
+    /// place a stats_snapshot stats a file, once per sealed generation.
+    void restage_all_classes();
+    /// The active generation of `slot` into its staged figures: entries, file
+    /// size, and allocated bytes, from the segment's header.
+    void restage_active(size_t slot);
+    /// Publishes staged classes [first, last) with the current entry count.
+    void publish_stats(size_t first = 0, size_t last = container_count) noexcept {
+        stats_.publish(entries_count_.load(std::memory_order_relaxed), first, last);
+    }
 
     // Reference mode operations
     result<bool> reference_insert(raw_outpoint const& key, output_data_span value, uint32_t height);
     std::optional<find_result> reference_find(raw_outpoint const& key, uint32_t height) const;
-    std::optional<find_result> reference_find_in_latest(raw_outpoint const& key, uint32_t height) const;
+    std::optional<find_result> reference_find_in_latest(raw_outpoint const& key, uint32_t height,
+                                                         counting counted) const;
+    /// See copy_from_active().
+    std::optional<reference_value> reference_copy_from_active(raw_outpoint const& key) const;
     size_t reference_erase_in_latest(raw_outpoint const& key, uint32_t height);
 
     [[nodiscard]] result<> reference_open_existing(size_t version);
@@ -445,7 +693,6 @@ private:
 
     // Reference metadata helpers
     void reference_save_metadata(size_t version) noexcept;
-    void reference_load_metadata(size_t version);
 
     // Member variables
     fs::path db_path_;
@@ -462,6 +709,36 @@ private:
     std::array<std::unique_ptr<bip::managed_mapped_file>, container_count> segments_;
     std::array<void*, container_count> containers_{};
 
+    /**
+     * @brief Keeps the active maps mapped while find() reads them, so that it
+     *        can run while insert() and apply_deletes() write. One for every
+     *        class and for reference mode.
+     *
+     * Pointers only. find() holds it shared once per lookup, across every class
+     * it probes; the writer holds it exclusively to change a pointer, which is
+     * to say once per rotation, open or close, and never for an emplace or an
+     * erase. What keeps a read of the map whole is the class's write counter;
+     * see read_active().
+     *
+     * A rotation retires the pointer under the lock and unmaps the segment only
+     * after it is released. Taking the lock exclusively is the grace period:
+     * it waits for every reader already inside the old map, and a reader that
+     * arrives later sees the pointer gone and never enters it. Between that and
+     * the new generation's publication a reader finds the class empty, which is
+     * what it would find in the new generation too — the entries it misses are
+     * historical now, and `not_resolved` sends the caller to resolve() for them.
+     */
+    mutable std::shared_mutex active_maps_lock_;
+
+    /// Sets the active map of `index` — or of the reference container, for
+    /// `reference_sentinel_index` — under active_maps_lock_. Every change of
+    /// either pointer goes through here, so no reader can see one half-made.
+    void publish_active_map(size_t index, void* map) {
+        std::unique_lock const writing(active_maps_lock_);
+        if (index == reference_sentinel_index) reference_container_ = map;
+        else                                   containers_[index] = map;
+    }
+
     /// The bucket count each open generation was created or opened with.
     ///
     /// The invariant this store rests on is that it never changes: a container
@@ -469,6 +746,9 @@ private:
     /// later. Comparing against this rather than against the previous insert
     /// catches a growth from any path, not only from the insert that saw it.
     std::array<rehash_watch, container_count> rehash_watch_{};
+
+    /// Each class's active version. Once the instance is open, written only
+    /// under layout_mutex_, together with the catalogue entry it names.
     std::array<size_t, container_count> current_versions_{};
 
     // Reference mode storage
@@ -480,7 +760,10 @@ private:
     size_t reference_active_file_size_ = 0;
     version_catalog reference_catalog_;
 
-    size_t entries_count_ = 0;
+    /// Every class's inserts and erases count here, and under insert_batch()
+    /// they do so from their own threads. Relaxed: nothing is ordered by it, and
+    /// size() is documented as a diagnostic.
+    std::atomic<size_t> entries_count_{0};
 
     /// This database's identity, made once when it is created and written into
     /// the config and into every segment it owns. Read back from the config on
@@ -499,6 +782,135 @@ private:
     std::array<version_catalog, container_count> catalogs_;
     std::unique_ptr<file_cache> file_cache_;
 
+    /// The snapshots taken from this instance and still held. Shared with
+    /// them, so one dropped after close() still has a registry to leave.
+    /// Deletions from older generations go through it; compaction asks it
+    /// which generations it may not merge.
+    std::shared_ptr<snapshot_registry> snapshots_ = std::make_shared<snapshot_registry>();
+
+    /**
+     * @brief What read-only processes follow: the generation lists and a write
+     *        counter per class. See reader_board.hpp.
+     *
+     * Mapped by a full-mode open and by nothing else — an inspection writes
+     * nothing, and reference mode has no reader. Null otherwise, and every use
+     * below is then a no-op.
+     */
+    std::unique_ptr<reader_board_writer> readers_;
+
+    /// Lists every class's generations for readers. Called whenever a
+    /// catalogue gains or loses a file, after the file it gains is complete and
+    /// before the one it loses is unlinked; see change_layout().
+    void publish_layout() {
+        if ( ! readers_) return;
+        std::array<std::vector<size_t> const*, container_count> versions{};
+        for (size_t i = 0; i < container_count; ++i) versions[i] = &catalogs_[i].versions();
+        readers_->publish(versions);
+    }
+
+    /// Each class's write counter when there is no board to keep it on:
+    /// reference mode, an inspection. See write_counter().
+    mutable std::array<uint64_t, container_count> local_writes_{};
+
+    /// The seqlock of class `index` — reference mode uses the first. The
+    /// board's, when one is mapped, so that a write is announced once to
+    /// readers in this process and in others alike.
+    [[nodiscard]] uint64_t& write_counter(size_t index) const noexcept {
+        return readers_ ? readers_->writes(index) : local_writes_[index];
+    }
+
+    /// Held around each emplace into, or erase from, a map of class `index`.
+    [[nodiscard]] reader_board_writer::write_guard announce_write(size_t index) noexcept {
+        return reader_board_writer::write_guard(write_counter(index));
+    }
+
+    /**
+     * @brief `copy()` run against an active map of class `index` until no
+     *        write to the class overlapped it, and what it returned.
+     *
+     * The in-process half of the scheme reader_board.hpp describes, and the
+     * same argument: the map never rehashes in place, so a probe racing an
+     * emplace or an erase stays inside arrays that do not move, and nothing it
+     * copied is kept unless the counter is where it was. `copy()` takes the
+     * value out whole, as bytes, and interprets nothing. The caller holds
+     * active_maps_lock_ shared, which is what keeps the map mapped.
+     *
+     * The writer never waits for this. A reader that lands on a write copies
+     * again, which costs it the length of one emplace.
+     */
+    template <typename Copy>
+    auto read_active(size_t index, Copy&& copy) const {
+        auto const word = counter(write_counter(index));
+        for (;;) {
+            auto const before = word.load(std::memory_order_acquire);
+            if (before % 2 == 0) {
+                auto copied = copy();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (word.load(std::memory_order_relaxed) == before) return copied;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief Serialises each change to a catalogue's version list with the
+     *        publications that read every class's list.
+     *
+     * Under insert_batch() classes rotate from their own threads, and under
+     * compact_all() they merge from them; a publication reads all of them. Held
+     * for the change and the publication together, never on a lookup or an
+     * insert, so it costs one uncontended lock per rotation or merge.
+     */
+    std::mutex layout_mutex_;
+
+    /// Applies `change` to the catalogues, and to current_versions_ with them,
+    /// and publishes what results — to readers, and to the manifest once this
+    /// instance owns it — as one step.
+    template <typename Change>
+    void change_layout(Change&& change) {
+        std::lock_guard const lock(layout_mutex_);
+        change();
+        publish_layout();
+        if (manifest_owned_) publish_manifest(manifest_state::open);
+    }
+
+    /// The last manifest publication's sequence, carried on from whatever
+    /// manifest the open found. See manifest_io.hpp.
+    uint64_t manifest_sequence_ = 0;
+
+    /// Set once a writer's open has rewritten the manifest as `open`. Until
+    /// then — an inspection, an open that failed — nothing here writes one, and
+    /// close() leaves the manifest as it found it.
+    bool manifest_owned_ = false;
+
+    /// The manifest as this instance would write it now. A `closed` one carries
+    /// counts and summaries and reads the active maps, so it is built only
+    /// while nothing else runs: by close().
+    [[nodiscard]] manifest build_manifest(manifest_state state) const;
+
+    /// Writes the manifest, best effort: a lost publication costs the next open
+    /// a scan and nothing else. Not for the `open` rewrite; see claim_manifest().
+    void publish_manifest(manifest_state state) noexcept;
+
+    /**
+     * @brief The manifest a clean close left, if it can stand in for the scan.
+     *
+     * Checks everything that can be checked before a file is mapped; the sizes
+     * of the active maps are held to it by the caller once they are. Nothing
+     * comes back, without an error, whenever the open should scan instead.
+     */
+    [[nodiscard]] result<std::optional<manifest>> adopt_manifest();
+
+    /// Rewrites the manifest as `open`, durably, before this writer may change
+    /// anything. A manifest that cannot be rewritten is removed instead, and
+    /// the open fails only if neither can be done: a `closed` one left behind
+    /// would be believed after a crash.
+    [[nodiscard]] result<> claim_manifest();
+
+    /// Maps one sealed generation of class `Index` into `into`, stamp first.
+    template<size_t Index>
+    [[nodiscard]] result<> pin_generation(size_t version, pinned_class<Index>& into) const;
+
     // Serialises resolutions against each other.
     //
     // Held for the whole of full_resolve() / reference_resolve(), not merely
@@ -531,12 +943,46 @@ private:
     /// doc/statistics-levels.md.
     mutable std::array<lookup_stats, container_count> lookup_stats_;
     mutable resolution_stats resolution_stats_;
+    /// Per operation and per class; see latency_stats for its size. Mutable for
+    /// the reason the read-path counters are.
+    mutable latency_stats latency_stats_;
     std::array<container_stats, container_count> container_stats_;
-    height_range_stats height_range_stats_;
+    /// One per class, so that classes running side by side never write the
+    /// same cache line. Each only ever counts in its own slot of `inserts` and
+    /// `deletes`; print_height_range_stats() folds them. Reference mode uses
+    /// the first. Dense and fixed, 20 KiB apiece: see height_range_stats.
+    std::array<height_range_stats, container_count> height_range_stats_;
     deferred_stats deferred_stats_;
+    /// deferred_stats::deletions_by_depth as the erase path counts it: a slot
+    /// per depth up to the cap, so that recording is an index and an increment.
+    /// Turned into the map only when the statistics are read. Dense and fixed,
+    /// like height_range_stats_.
+    std::array<size_t, deferred_stats::max_recorded_depth + 1> deletions_by_depth_{};
+
+    /// The slot a deletion `depth` versions below the active one is counted in.
+    [[nodiscard]] static constexpr size_t depth_slot(size_t depth) noexcept {
+        return std::min(depth, deferred_stats::max_recorded_depth);
+    }
     not_found_stats not_found_stats_;
     utxo_lifetime_stats lifetime_stats_;
-    fragmentation_stats fragmentation_stats_;
+    /// Sizes per class, staged by the writer and published at the end of each
+    /// operation for get_stats_snapshot(). Kept in every build. Reference mode
+    /// uses the first slot.
+    stats_publisher stats_;
+
+    /// The running level: how much of what the build carries is fed. Starts at
+    /// the build's, which is what every instance did before there was a
+    /// choice, and is never above it. An atomic rather than anything the
+    /// operations lock, so a monitoring thread can turn the lookup telemetry on
+    /// in the middle of a block: what is in flight finishes at the level it
+    /// started with, and the next operation reads the new one. Not reset by
+    /// open(): it is the process's setting, not the store's.
+    std::atomic<statistics_level> statistics_level_{compiled_statistics_level};
+    /// The writer's reading of it, taken by insert(), insert_batch() and
+    /// apply_deletes() as they start. The class threads of a batch read it and
+    /// are started after it is written; nothing else writes it, because there
+    /// is one writer.
+    counting writing_;
 };
 
 } // namespace utxoz::detail
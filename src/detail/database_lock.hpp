@@ -22,6 +22,9 @@
  * in flight, is unchanged. This closes the gap between instances, not the one
  * between threads.
  *
+ * A full_reader does not take the claim and is not excluded by it. It writes
+ * nothing, and follows what the holder publishes for it; see reader_board.hpp.
+ *
  * The claim is a lock on an open descriptor, not the existence of a file. The
  * distinction is the whole point: the kernel releases the claim when the last
  * copy of the descriptor closes, which includes a process dying however it
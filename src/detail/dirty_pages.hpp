@@ -0,0 +1,159 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file dirty_pages.hpp
+ * @brief The pages of one mapping this instance has stored to since it was
+ *        last made durable.
+ * @internal
+ *
+ * A per-block sync used to ask for the page barrier over every byte of every
+ * active mapping — gigabytes, for a block that wrote a few thousand entries.
+ * The kernel is quick about pages that are clean, but it still has to be asked
+ * about each of them, and on the larger classes that is most of what a sync
+ * costs.
+ *
+ * The writer knows where it wrote: an insert returns the slot it filled and an
+ * erase is given the one it empties. Those are noted here, a bit per page, and
+ * the barrier is asked for over the runs of set bits instead of the mapping.
+ *
+ * What the writer cannot see is every byte the map touched on its behalf — the
+ * group control bytes sit at an offset the map does not expose, and an insert
+ * that probed past a full group marks that group as well. So the runs are never
+ * the whole truth, and they are used only where the file barrier is known to
+ * cover the rest: see file_barrier_covers_mappings(). Everywhere else the page
+ * barrier still covers the mapping, and this is bookkeeping nobody reads.
+ *
+ * A note that lands outside the mapping, or a map that grew and moved its
+ * table, marks everything. Never fewer pages than were written; at worst the
+ * mapping, which is what every sync used to flush.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <utxoz/types.hpp>
+
+#include "durability.hpp"
+
+namespace utxoz::detail {
+
+class dirty_pages {
+public:
+    /// Starts tracking `length` bytes mapped at `base`, with nothing noted. A
+    /// fresh mapping owes nothing the tracker could know about; whatever the
+    /// previous mapping of the file owed was discharged, or recorded against
+    /// the file, before it was unmapped.
+    void attach(void* base, size_t length) {
+        base_ = static_cast<std::byte*>(base);
+        length_ = length;
+        page_ = system_page_size();
+        bits_.assign((pages_in(length) + 63) / 64, 0);
+        noted_ = 0;
+        all_ = false;
+    }
+
+    void detach() noexcept {
+        base_ = nullptr;
+        length_ = 0;
+        bits_.clear();
+        noted_ = 0;
+        all_ = false;
+    }
+
+    /// Records that `length` bytes at `address` were written.
+    void note(void const* address, size_t length) noexcept {
+        if (base_ == nullptr || all_) return;
+        auto const* p = static_cast<std::byte const*>(address);
+        if (p < base_ || length > length_ || size_t(p - base_) > length_ - length) {
+            note_all();
+            return;
+        }
+        auto const offset = size_t(p - base_);
+        auto const first = offset / page_;
+        auto const last = (offset + (length == 0 ? 0 : length - 1)) / page_;
+        for (auto page = first; page <= last; ++page) {
+            auto& word = bits_[page / 64];
+            auto const bit = uint64_t{1} << (page % 64);
+            if ((word & bit) == 0) {
+                word |= bit;
+                ++noted_;
+            }
+        }
+    }
+
+    /// Records that anything may have been written. What a growth does: the
+    /// table moved, and every byte of where it went is new.
+    void note_all() noexcept {
+        if (base_ != nullptr) all_ = true;
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return ! all_ && noted_ == 0; }
+
+    /// Pages noted, or every page of the mapping once everything is.
+    [[nodiscard]] uint64_t pages() const noexcept {
+        return all_ ? pages_in(length_) : noted_;
+    }
+
+    /**
+     * @brief Calls `flush(address, length)` for every run of noted pages, in
+     *        address order, and stops at the first one that fails.
+     *
+     * Nothing is cleared, whatever the outcome: the caller clears once every
+     * barrier it owes has returned, because an obligation half met is still an
+     * obligation.
+     */
+    template<typename Flush>
+    [[nodiscard]] result<> for_each_run(Flush&& flush) const {
+        if (base_ == nullptr) return {};
+        if (all_) return flush(static_cast<void*>(base_), length_);
+
+        size_t const total = pages_in(length_);
+        size_t page = 0;
+        while (page < total) {
+            auto word = bits_[page / 64] >> (page % 64);
+            if (word == 0) {
+                page = (page / 64 + 1) * 64;
+                continue;
+            }
+            page += size_t(std::countr_zero(word));
+            size_t end = page;
+            while (end < total && (bits_[end / 64] >> (end % 64)) & 1u) ++end;
+
+            auto const offset = page * page_;
+            auto const bytes = std::min(end * page_, length_) - offset;
+            if (auto const flushed = flush(static_cast<void*>(base_ + offset), bytes); ! flushed) {
+                return flushed;
+            }
+            page = end;
+        }
+        return {};
+    }
+
+    /// Everything noted is now durable.
+    void clear() noexcept {
+        std::fill(bits_.begin(), bits_.end(), uint64_t{0});
+        noted_ = 0;
+        all_ = false;
+    }
+
+private:
+    [[nodiscard]] size_t pages_in(size_t length) const noexcept {
+        return page_ == 0 ? 0 : (length + page_ - 1) / page_;
+    }
+
+    std::byte* base_ = nullptr;
+    size_t length_ = 0;
+    size_t page_ = 0;
+    std::vector<uint64_t> bits_;
+    uint64_t noted_ = 0;
+    bool all_ = false;
+};
+
+} // namespace utxoz::detail
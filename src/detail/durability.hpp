@@ -92,6 +92,17 @@ struct failpoints {
     /// the first one aborts the rest — so it counts instead.
     static inline std::atomic<uint64_t> sync_mapped_region_calls{0};
 
+    /// The bytes those crossings asked the platform to flush, summed. What a
+    /// test reads to tell a sync that flushed the pages it wrote from one that
+    /// flushed the whole mapping, which cross the barrier the same number of
+    /// times.
+    static inline std::atomic<uint64_t> sync_mapped_region_bytes{0};
+
+    /// Keeps the sync_async() flusher from starting a round while set. Requests
+    /// made meanwhile queue up, which is the only way a test can know they will
+    /// be served together rather than hoping a round is slow enough.
+    static inline std::atomic<bool> hold_group_commit{false};
+
     /// How many times the file barrier has been crossed, for the same reason.
     static inline std::atomic<uint64_t> sync_file_calls{0};
 
@@ -284,6 +295,15 @@ struct failpoints {
     /// logical one, which is where "never a partial report" has to be proven.
     static inline std::atomic<uint64_t> fail_segment_open_after{0};
 
+    /// Opens as if there were no manifest: every generation is listed, mapped and
+    /// counted, the way an open did before manifest_io.hpp.
+    ///
+    /// The scan is still what an open falls back to whenever the manifest cannot
+    /// be trusted, so it has to stay reachable on demand — for the cases that
+    /// compare the two paths' answers, and for the startup benchmark, whose
+    /// second row is the figure the manifest exists to beat.
+    static inline std::atomic<bool> ignore_manifest{false};
+
     /// Makes the next N inserts throw `bip::bad_alloc` at the `emplace`, as a full
     /// segment does. Zero disarms it.
     ///
@@ -324,16 +344,10 @@ struct failpoints {
     static inline std::atomic<bool> fail_insert_after_mutating{false};
 
     /// True when an insert should refuse now, consuming one of the N.
-    [[nodiscard]] static bool consume_insert_failure() {
-        auto remaining = fail_insert_emplace.load(std::memory_order_relaxed);
-        while (remaining != 0) {
-            if (fail_insert_emplace.compare_exchange_weak(
-                    remaining, remaining - 1, std::memory_order_relaxed)) {
-                return true;
-            }
-        }
-        return false;
-    }
+    [[nodiscard]] static bool consume_insert_failure() { return consume(fail_insert_emplace); }
+
+    /// Takes one armed ring failure if any is pending. See fail_ring_enter.
+    [[nodiscard]] static bool consume_ring_failure() { return consume(fail_ring_enter); }
 
     /// Fails the removal of the sidecar, and the barrier that confirms it.
     static inline std::atomic<bool> fail_sidecar_removal{false};
@@ -347,6 +361,24 @@ struct failpoints {
     /// about real randomness to know what it should find. Zero means "draw one".
     static inline std::atomic<uint64_t> forced_merge_id{0};
 
+    /// Builds merge targets by emplacing in source order, as every build did
+    /// before the placement order in bulk_load.hpp. Both paths build the same
+    /// map; this exists so that a benchmark can time the two in one binary and
+    /// a test can hold them to producing the same contents.
+    static inline std::atomic<bool> streaming_merge{false};
+
+    /// Runs the I/O every build ran before io_engine.hpp: one `fsync` per file,
+    /// and merge sources faulted in rather than read ahead. Read when an engine
+    /// is constructed and when a merge starts; for the benchmark that compares
+    /// the two paths.
+    static inline std::atomic<bool> force_posix_io{false};
+
+    /// Makes the next N calls into the io_uring fail once the kernel has taken
+    /// them: what was submitted is in flight and nothing is reaped, as when a
+    /// ring stops being serviced mid-batch. Zero disarms it. A build without
+    /// the ring never consults it.
+    static inline std::atomic<uint64_t> fail_ring_enter{0};
+
     static void run_before_target_publish() {
         if (auto* hook = before_target_publish.load(std::memory_order_relaxed)) hook();
     }
@@ -362,6 +394,8 @@ struct failpoints {
         fail_sync_file.store(false, std::memory_order_relaxed);
         fail_sync_mapped_region.store(false, std::memory_order_relaxed);
         sync_mapped_region_calls.store(0, std::memory_order_relaxed);
+        sync_mapped_region_bytes.store(0, std::memory_order_relaxed);
+        hold_group_commit.store(false, std::memory_order_relaxed);
         sync_file_calls.store(0, std::memory_order_relaxed);
         fail_sync_file_at.store(0, std::memory_order_relaxed);
         fail_sync_directory.store(false, std::memory_order_relaxed);
@@ -390,12 +424,16 @@ struct failpoints {
         fail_diagnostic_format.store(false, std::memory_order_relaxed);
         before_target_publish.store(nullptr, std::memory_order_relaxed);
         forced_merge_id.store(0, std::memory_order_relaxed);
+        streaming_merge.store(false, std::memory_order_relaxed);
+        force_posix_io.store(false, std::memory_order_relaxed);
+        fail_ring_enter.store(0, std::memory_order_relaxed);
         force_rotations.store(0, std::memory_order_relaxed);
         forced_capacity.store(0, std::memory_order_relaxed);
         forced_capacity_index.store(0, std::memory_order_relaxed);
         force_database_id.store(false, std::memory_order_relaxed);
         delete_config_after_claim.store(false, std::memory_order_relaxed);
         fail_segment_open_after.store(0, std::memory_order_relaxed);
+        ignore_manifest.store(false, std::memory_order_relaxed);
         forced_database_id.fill(0);
     }
 
@@ -424,6 +462,19 @@ struct failpoints {
         scoped_reset& operator=(scoped_reset const&) = delete;
         ~scoped_reset() { clear(); }
     };
+
+private:
+    /// Takes one from a count of armed failures, if it is not zero. Atomic as a
+    /// whole, so two threads never both take the last one.
+    [[nodiscard]] static bool consume(std::atomic<uint64_t>& armed) {
+        auto remaining = armed.load(std::memory_order_relaxed);
+        while (remaining != 0) {
+            if (armed.compare_exchange_weak(remaining, remaining - 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
 
 /**
@@ -440,6 +491,7 @@ struct failpoints {
 [[nodiscard]]
 inline result<> sync_mapped_region(void* address, size_t length) {
     failpoints::sync_mapped_region_calls.fetch_add(1, std::memory_order_relaxed);
+    failpoints::sync_mapped_region_bytes.fetch_add(length, std::memory_order_relaxed);
 
     if (failpoints::fail_sync_mapped_region.load(std::memory_order_relaxed)) {
         return std::unexpected(error_code::sync_failed);
@@ -459,6 +511,44 @@ inline result<> sync_mapped_region(void* address, size_t length) {
 #endif
 }
 
+/**
+ * @brief Whether the file barrier also reaches the pages of a shared mapping.
+ *
+ * On Linux a `MAP_SHARED` mapping *is* the page cache, so `fsync` writes back a
+ * page that was stored to through a mapping exactly as it writes back one that
+ * was `write()`n, whether or not anything called `msync` first. That is what
+ * lets a sync ask for the page barrier over only the pages it knows it wrote:
+ * whatever it cannot see — the control bytes a flat map updates in groups a
+ * lookup probed past — is still covered by the file barrier that follows.
+ *
+ * Everywhere else it is `false`, and the whole mapping gets the page barrier,
+ * because POSIX does not promise the above and Windows does not do it.
+ */
+[[nodiscard]]
+inline constexpr bool file_barrier_covers_mappings() noexcept {
+#if defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// The granularity of a mapping, and of the page barrier: `msync` wants an
+/// address on a page boundary.
+[[nodiscard]]
+inline size_t system_page_size() noexcept {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return size_t(info.dwPageSize);
+#elif defined(__EMSCRIPTEN__)
+    return 65536;
+#else
+    long const page = ::sysconf(_SC_PAGESIZE);
+    return page > 0 ? size_t(page) : 4096;
+#endif
+}
+
 /**
  * @brief Flushes a file's contents and metadata to stable storage.
  *
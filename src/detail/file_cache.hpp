@@ -27,6 +27,7 @@
 #include "path_display.hpp"
 #include "segment_open.hpp"
 #include "segment_stamp.hpp"
+#include "trace_ring.hpp"
 #include "utxo_value.hpp"
 
 namespace utxoz::detail {
@@ -104,6 +105,8 @@ struct file_cache {
 
         // Open file
         auto file_path = make_file_path(container_index, version);
+        trace_span span(trace_, trace_kind::file_map, container_index);
+        span.version(version);
 
         // The cache reports failure by throwing, which is what resolve() and
         // apply_deletes() are built to catch; the two calls below report it as a
@@ -130,6 +133,8 @@ struct file_cache {
             throw std::runtime_error("unusable version file: " + path_display(file_path));
         }
         auto* map = *found;
+        span.bytes(segment->get_size());
+        span.succeeded();
 
         cache_[file_key] = cached_file{
             std::move(segment),
@@ -161,6 +166,8 @@ struct file_cache {
         }
 
         auto file_path = make_file_path(reference_sentinel_index, version);
+        trace_span span(trace_, trace_kind::file_map, reference_class);
+        span.version(version);
 
         // See get_or_open_file(): the cache's contract is to throw.
         auto opened = open_existing_segment(file_path);
@@ -184,6 +191,8 @@ struct file_cache {
             throw std::runtime_error("unusable version file: " + path_display(file_path));
         }
         auto* map = *found;
+        span.bytes(segment->get_size());
+        span.succeeded();
 
         cache_[file_key] = cached_file{
             std::move(segment),
@@ -213,9 +222,18 @@ struct file_cache {
      * that no longer holds that version's data.
      */
     void clear() {
+        if (trace_ != nullptr && trace_->enabled()) {
+            // One span per mapping, as an eviction has: each is its own munmap.
+            for (auto& [file_key, cf] : cache_) unmap(file_key, cf);
+        }
         cache_.clear();
     }
 
+    /// Where the maps and unmaps are traced. Null, the default, traces nothing.
+    void set_trace(trace_ring* ring) noexcept {
+        trace_ = ring;
+    }
+
     /**
      * @brief Flushes the dirty pages of every mapping the cache holds.
      *
@@ -241,6 +259,10 @@ struct file_cache {
         return {};
     }
 
+    size_t cached_count() const {
+        return cache_.size();
+    }
+
     std::vector<std::pair<size_t, size_t>> get_cached_files() const {
         std::vector<std::pair<size_t, size_t>> files;
         files.reserve(cache_.size());
@@ -290,11 +312,24 @@ private:
             });
 
         if (lru != cache_.end() && !lru->second.is_pinned) {
+            unmap(lru->first, lru->second);
             cache_.erase(lru);
             ++evictions_;
         }
     }
 
+    /// Releases the mapping now rather than in the erase that follows, so that
+    /// the span is the munmap and nothing else.
+    void unmap(file_key_t const& file_key, cached_file& cf) {
+        auto const container_class = file_key.first == reference_sentinel_index
+                                   ? reference_class : file_key.first;
+        trace_span span(trace_, trace_kind::file_unmap, container_class);
+        span.version(file_key.second);
+        if (cf.segment) span.bytes(cf.segment->get_size());
+        cf.segment.reset();
+        span.succeeded();
+    }
+
     boost::unordered_flat_map<file_key_t, cached_file> cache_;
     boost::unordered_flat_map<file_key_t, size_t> access_frequency_;
     database_id_t database_id_{};
@@ -303,6 +338,7 @@ private:
     size_t gets_ = 0;
     size_t hits_ = 0;
     size_t evictions_ = 0;
+    trace_ring* trace_ = nullptr;
 };
 
 } // namespace utxoz::detail
@@ -265,6 +265,9 @@ enum class metadata_sync : uint8_t { publish_only, durable };
 /**
  * @brief Publishes a record: temp beside the target, then an atomic replace.
  *
+ * Already-encoded bytes, so the manifest (manifest_io.hpp) goes out the same way
+ * a metadata record does.
+ *
  * The temp goes in the same directory so the replace is within one filesystem.
  * Every write and the close are checked — an ofstream reports a failed write by
  * setting a bit nobody looks at, which is how a short file gets produced in the
@@ -288,10 +291,9 @@ enum class metadata_sync : uint8_t { publish_only, durable };
  * `platform_sync_support()`; it is not inferred from this returning success.
  */
 [[nodiscard]]
-inline result<> write_metadata_file(fs::path const& path, file_metadata const& meta,
+inline result<> publish_record_file(fs::path const& path, std::span<uint8_t const> encoded,
                                     metadata_sync policy = metadata_sync::publish_only) {
     auto const temp_path = fs::path(path).concat(".tmp");
-    auto const encoded = encode_metadata(meta);
 
     auto discard_temp = [&] {
         std::error_code cleanup;
@@ -343,4 +345,11 @@ inline result<> write_metadata_file(fs::path const& path, file_metadata const& m
     return {};
 }
 
+/// Publishes a metadata record; see publish_record_file().
+[[nodiscard]]
+inline result<> write_metadata_file(fs::path const& path, file_metadata const& meta,
+                                    metadata_sync policy = metadata_sync::publish_only) {
+    return publish_record_file(path, encode_metadata(meta), policy);
+}
+
 } // namespace utxoz::detail
@@ -0,0 +1,214 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file group_commit.hpp
+ * @brief The background flusher behind `sync_async()`: file barriers taken off
+ *        the writer's thread, and consecutive requests served by one round.
+ * @internal
+ *
+ * What a sync spends its time on is the file barrier — `fsync` waiting for the
+ * device — and nothing about that wait needs the writer. A request is therefore
+ * a list of paths, taken on the writer's thread at the moment it asks, and the
+ * flusher does the waiting. It never sees a mapping, a map or a catalogue, so
+ * it shares nothing with the writer except the queue it is handed work through.
+ *
+ * Requests that arrive while a round is running are not served one by one. The
+ * next round takes every request waiting, flushes the union of their files once
+ * and the directory once, and completes them all with the same outcome. That is
+ * the group commit: under a steady stream of per-block requests the number of
+ * rounds is bounded by how long a round takes, not by how many blocks arrived.
+ *
+ * ## Obligations
+ *
+ * Each request carries an epoch, and a round that succeeded publishes the epoch
+ * after the newest one it served. Every write tagged before that epoch is
+ * durable, and the writer discharges those obligations the next time it looks,
+ * on its own thread. A round that failed publishes nothing, so everything it was
+ * asked for is still owed — an obligation half met is an obligation, here as in
+ * `sync()`.
+ *
+ * A file that is gone by the time the round reaches it was retired by a merge,
+ * and a version that no longer exists cannot owe anything. It is skipped, not
+ * failed.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <utxoz/statistics.hpp>
+#include <utxoz/types.hpp>
+
+#include "durability.hpp"
+#include "io_engine.hpp"
+#include "trace_ring.hpp"
+
+namespace utxoz::detail {
+
+/// What one `sync_async()` asked for.
+struct flush_request {
+    std::vector<fs::path> files;
+    fs::path directory;
+    uint64_t epoch = 0;
+};
+
+class group_commit {
+public:
+    /// Each round is traced into `trace` when it is given and tracing is on.
+    explicit group_commit(trace_ring* trace = nullptr) : trace_(trace) {}
+    group_commit(group_commit const&) = delete;
+    group_commit& operator=(group_commit const&) = delete;
+
+    /// Completes everything queued, then stops. Nothing is abandoned: a caller
+    /// holding a future gets an answer, not a broken promise.
+    ~group_commit() { stop(); }
+
+    /// Queues a request and returns the future its round completes. The thread
+    /// starts with the first request, so an instance that never asks has none.
+    [[nodiscard]]
+    std::shared_future<result<>> submit(flush_request request) {
+        std::promise<result<>> promise;
+        auto future = promise.get_future().share();
+        {
+            std::lock_guard const lock(mutex_);
+            queue_.push_back(pending{std::move(request), std::move(promise),
+                                     std::chrono::steady_clock::now()});
+            ++stats_.requests;
+            if ( ! thread_.joinable()) thread_ = std::thread([this] { run(); });
+        }
+        wake_.notify_one();
+        return future;
+    }
+
+    /// Drains the queue and joins. Safe to call twice, and from the destructor.
+    void stop() {
+        {
+            std::lock_guard const lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+        std::lock_guard const lock(mutex_);
+        stopping_ = false;
+    }
+
+    /// Every write tagged with an epoch below this one is durable.
+    [[nodiscard]] uint64_t durable_epoch() const noexcept {
+        return durable_epoch_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] group_commit_stats stats() const {
+        std::lock_guard const lock(mutex_);
+        return stats_;
+    }
+
+private:
+    struct pending {
+        flush_request request;
+        std::promise<result<>> promise;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    void run() {
+        std::unique_lock lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&] { return stopping_ || ! queue_.empty(); });
+            if (queue_.empty()) return;   // stopping, and nothing left to serve
+
+            if (failpoints::hold_group_commit.load(std::memory_order_relaxed)) {
+                lock.unlock();
+                while (failpoints::hold_group_commit.load(std::memory_order_relaxed)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                lock.lock();
+            }
+
+            // Everything waiting is one round.
+            std::vector<pending> round;
+            round.swap(queue_);
+            lock.unlock();
+
+            std::set<fs::path> files;
+            uint64_t newest = 0;
+            for (auto const& p : round) {
+                files.insert(p.request.files.begin(), p.request.files.end());
+                newest = std::max(newest, p.request.epoch);
+            }
+            auto const started = std::chrono::steady_clock::now();
+            result<> outcome;
+            {
+                trace_span span(trace_, trace_kind::group_commit);
+                span.files(files.size());
+                span.items(round.size());
+                outcome = flush(std::vector<fs::path>(files.begin(), files.end()),
+                                round.back().request.directory);
+                if (outcome) span.succeeded();
+            }
+            auto const finished = std::chrono::steady_clock::now();
+
+            // Published before a single future is completed, so a caller that
+            // wakes on its future and syncs again already sees it discharged.
+            if (outcome) {
+                auto expected = durable_epoch_.load(std::memory_order_relaxed);
+                while (expected < newest + 1
+                       && ! durable_epoch_.compare_exchange_weak(expected, newest + 1,
+                                                                 std::memory_order_release)) {}
+            }
+
+            lock.lock();
+            ++stats_.flushes;
+            if ( ! outcome) ++stats_.failed_flushes;
+            stats_.files_synced += files.size();
+            stats_.last_barrier_time = finished - started;
+            for (auto& p : round) {
+                auto const waited = finished - p.submitted;
+                ++stats_.completed;
+                stats_.total_latency += waited;
+                stats_.max_latency = std::max<std::chrono::nanoseconds>(stats_.max_latency, waited);
+            }
+            lock.unlock();
+
+            for (auto& p : round) p.promise.set_value(outcome);
+            lock.lock();
+        }
+    }
+
+    /// The file barriers of one round, as one batch, then the directory's.
+    /// Absorbs a barrier the platform does not have, exactly as `sync()` does.
+    result<> flush(std::vector<fs::path> const& files, fs::path const& directory) {
+        auto barrier = [](result<> outcome) -> result<> {
+            if ( ! outcome && outcome.error() == error_code::sync_unsupported) return {};
+            return outcome;
+        };
+        // A file retired by a merge since the request was taken owes nothing.
+        if (auto const r = barrier(io_.sync_files(files, missing_file::skip)); ! r) return r;
+        return barrier(sync_directory(directory));
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<pending> queue_;
+    bool stopping_ = false;
+    std::thread thread_;
+    std::atomic<uint64_t> durable_epoch_{0};
+    group_commit_stats stats_;
+    trace_ring* trace_;
+
+    /// The flusher's own: a ring is driven by one thread.
+    io_engine io_;
+};
+
+} // namespace utxoz::detail
@@ -88,6 +88,29 @@ static_assert(effective_insert_limit(15728639, 12000000) == 12000000,
               "could not see");
 static_assert(effective_insert_limit(959, 839) == 797, "the fixtures' smallest class");
 
+/**
+ * @brief How far Boost has moved a map's growth point down, as a fraction of
+ *        where a fresh map of the same bucket count has it.
+ *
+ * Boost lowers `max_load()` by one for every erase that may have left an
+ * overflow bit behind, because those bits lengthen the probe sequences of every
+ * lookup that passes through the group, and a rehash is the only thing that
+ * clears them. The drift is therefore the share of the map's probe budget spent
+ * on entries that are gone — the closest thing to a probe-length figure the map
+ * exposes. A small map whose `max_load()` sits at or above the growth point has
+ * none.
+ */
+[[nodiscard]] constexpr double growth_point_drift(uint64_t bucket_count,
+                                                  uint64_t live_max_load) noexcept {
+    uint64_t const growth_point = max_size_without_rehash(bucket_count);
+    if (growth_point == 0 || live_max_load >= growth_point) return 0.0;
+    return double(growth_point - live_max_load) / double(growth_point);
+}
+
+static_assert(growth_point_drift(959, 839) == 0.0, "a fresh map has not drifted");
+static_assert(growth_point_drift(15728639, 0) == 1.0);
+static_assert(growth_point_drift(0, 0) == 0.0);
+
 /// What the map looked like at one moment. Three `noexcept` accessors, cheap
 /// enough to read on the two paths that need them: the insert that is about to
 /// rotate, and the one that has just caught an exception.
@@ -239,12 +262,17 @@ template <typename Segment>
                                            : std::to_string(bytes);
 }
 
-/// Why a rotation was asked for. Only the two that complete one; a rotation that
-/// fails is counted by its own field and has no cause to attribute.
-enum class rotation_cause : uint8_t { preventive, capacity_exception };
+/// Why a rotation was asked for. Only the ones that complete one; a rotation
+/// that fails is counted by its own field and has no cause to attribute.
+enum class rotation_cause : uint8_t { preventive, capacity_exception, snapshot };
 
 [[nodiscard]] constexpr char const* to_string(rotation_cause c) noexcept {
-    return c == rotation_cause::preventive ? "preventive" : "capacity_exception";
+    switch (c) {
+        case rotation_cause::preventive:         return "preventive";
+        case rotation_cause::capacity_exception: return "capacity_exception";
+        case rotation_cause::snapshot:           return "snapshot";
+    }
+    return "unknown";
 }
 
 /// Reads the three figures a decision needs. Every accessor is `noexcept` and
@@ -0,0 +1,339 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file io_engine.hpp
+ * @brief The file barriers of a sync submitted as one batch, and a merge's
+ *        sources read ahead instead of faulted in.
+ * @internal
+ *
+ * A sync owes a file barrier to every active generation and to every older one
+ * a batch of deletions reached: six, ten, sometimes dozens of files. Through
+ * POSIX that is one `fsync` after another, each waiting for the device before
+ * the next is asked, and on a drive with a deep queue most of that wait is the
+ * drive being handed one request at a time.
+ *
+ * Built with `UTXOZ_IO_URING` on Linux, the engine opens an io_uring and submits
+ * every barrier of a sync in one call, so the device sees them together and the
+ * caller waits once, for the slowest. The ring is driven through the kernel's
+ * own header and two system calls; there is no liburing to link against.
+ *
+ * ## What does not change
+ *
+ * The barriers themselves. Each file still gets a full `fsync`, not the
+ * data-only form: a generation's size is part of what makes it readable. The
+ * failpoints see the batch as the calls it replaces — `sync_file_calls` counts
+ * each file in order and `fail_sync_file_at` fails the one it names — so a test
+ * written against the POSIX path holds against this one. The first failure in
+ * the order the files were given is the one returned.
+ *
+ * ## When there is no ring
+ *
+ * The kernel may be too old, the sysctl may disable it, a seccomp profile may
+ * refuse the call. Any of those is found when the ring is set up, and the engine
+ * is then the POSIX path, permanently, with nothing reported: which of the two
+ * ran is a matter of speed, never of what was made durable.
+ *
+ * A ring that fails once it is running is treated the same way, from then on.
+ * It may have taken some of a batch and completed none of it, or completed some
+ * and left the rest in its queue, and a completion reaped by the next batch
+ * would be credited to the wrong file. So the ring is torn down there and then,
+ * which discards everything it still held, and the batch it failed is made
+ * durable again, file by file, through `fsync`.
+ *
+ * ## Sources, read ahead
+ *
+ * A merge reads its sources through their mappings, and a source not in the
+ * page cache is read one fault at a time, in the order the walk happens to touch
+ * it. prefetch_mapping() asks the kernel for every page of a mapping up front;
+ * the readahead is queued and the call returns, so every source of a merge is
+ * in flight before the first entry is placed. That is independent of the ring —
+ * the request is asynchronous already — and is done on every POSIX platform.
+ *
+ * `failpoints::force_posix_io` turns both off, so a benchmark can time the path
+ * every earlier build ran against this one in a single binary.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <utxoz/config.hpp>
+#include <utxoz/types.hpp>
+
+#include "durability.hpp"
+
+#if defined(UTXOZ_IO_URING) && defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define UTXOZ_DETAIL_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+namespace utxoz::detail {
+
+/// What a file that is not there means to a batch.
+enum class missing_file {
+    fail,   ///< it was owed a barrier, and is gone: the batch fails
+    skip,   ///< retired since the batch was drawn up, so it owes nothing
+};
+
+/**
+ * @brief Asks the kernel to start reading every page of a mapping.
+ *
+ * Advice, not a barrier: nothing waits, and a failure costs the faults it was
+ * meant to save and nothing else, so none is reported.
+ */
+inline void prefetch_mapping(void* address, size_t length) noexcept {
+    if (failpoints::force_posix_io.load(std::memory_order_relaxed)) return;
+    if (address == nullptr || length == 0) return;
+#if defined(_WIN32) || defined(__EMSCRIPTEN__)
+    (void)address;
+    (void)length;
+#else
+    (void)::madvise(address, length, MADV_WILLNEED);
+#endif
+}
+
+class io_engine {
+public:
+    /// Sets up the ring where the build has one and the kernel allows it.
+    io_engine() {
+#if defined(UTXOZ_DETAIL_HAS_IO_URING)
+        if ( ! failpoints::force_posix_io.load(std::memory_order_relaxed)) ring_.setup();
+#endif
+    }
+
+    io_engine(io_engine const&) = delete;
+    io_engine& operator=(io_engine const&) = delete;
+
+    ~io_engine() {
+#if defined(UTXOZ_DETAIL_HAS_IO_URING)
+        ring_.teardown();
+#endif
+    }
+
+    /// Whether barriers are submitted as a batch; false is the POSIX path.
+    [[nodiscard]] bool batched() const noexcept {
+#if defined(UTXOZ_DETAIL_HAS_IO_URING)
+        return ring_.fd >= 0;
+#else
+        return false;
+#endif
+    }
+
+    [[nodiscard]] char const* name() const noexcept {
+        return batched() ? "io_uring" : "posix";
+    }
+
+    /**
+     * @brief The file barrier of every file in `files`, stopping the accounting
+     *        at the first failure, as a loop over sync_file() would.
+     *
+     * @return empty when every barrier returned; otherwise the first failure in
+     *         the order given. `sync_unsupported` is returned as sync_file()
+     *         returns it, for the caller to absorb or not.
+     */
+    [[nodiscard]]
+    result<> sync_files(std::span<fs::path const> files, missing_file missing = missing_file::fail) {
+#if defined(UTXOZ_DETAIL_HAS_IO_URING)
+        if (batched()) return sync_batched(files, missing);
+#endif
+        for (auto const& file : files) {
+            if (auto const r = sync_file(file); ! r) {
+                std::error_code ec;
+                if (missing == missing_file::skip && ! fs::exists(file, ec) && ! ec) continue;
+                return r;
+            }
+        }
+        return {};
+    }
+
+private:
+#if defined(UTXOZ_DETAIL_HAS_IO_URING)
+    /// The submission and completion queues, mapped from the kernel, and
+    /// nothing else: one thread drives it, and it is never shared.
+    struct ring {
+        static constexpr unsigned depth = 64;
+
+        int fd = -1;
+        void* sq = nullptr;
+        size_t sq_bytes = 0;
+        void* cq = nullptr;
+        size_t cq_bytes = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqes_bytes = 0;
+
+        unsigned* sq_tail = nullptr;
+        unsigned sq_mask = 0;
+        unsigned* sq_array = nullptr;
+        unsigned entries = 0;
+        unsigned* cq_head = nullptr;
+        unsigned* cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe* cqes = nullptr;
+
+        void setup() noexcept {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            int const ring_fd = int(::syscall(__NR_io_uring_setup, depth, &params));
+            if (ring_fd < 0) return;   // ENOSYS, EPERM: the POSIX path it is
+            fd = ring_fd;
+
+            sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool const single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+
+            sq = ::mmap(nullptr, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+            if (sq == MAP_FAILED) { sq = nullptr; teardown(); return; }
+            if (single) {
+                cq = sq;
+            } else {
+                cq = ::mmap(nullptr, cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            fd, IORING_OFF_CQ_RING);
+                if (cq == MAP_FAILED) { cq = nullptr; teardown(); return; }
+            }
+            sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+            auto* const mapped = ::mmap(nullptr, sqes_bytes, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (mapped == MAP_FAILED) { teardown(); return; }
+            sqes = static_cast<io_uring_sqe*>(mapped);
+
+            auto* const s = static_cast<std::byte*>(sq);
+            auto* const c = static_cast<std::byte*>(cq);
+            sq_tail = reinterpret_cast<unsigned*>(s + params.sq_off.tail);
+            sq_mask = *reinterpret_cast<unsigned*>(s + params.sq_off.ring_mask);
+            sq_array = reinterpret_cast<unsigned*>(s + params.sq_off.array);
+            entries = params.sq_entries;
+            cq_head = reinterpret_cast<unsigned*>(c + params.cq_off.head);
+            cq_tail = reinterpret_cast<unsigned*>(c + params.cq_off.tail);
+            cq_mask = *reinterpret_cast<unsigned*>(c + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(c + params.cq_off.cqes);
+        }
+
+        void teardown() noexcept {
+            if (sqes != nullptr) ::munmap(sqes, sqes_bytes);
+            if (cq != nullptr && cq != sq) ::munmap(cq, cq_bytes);
+            if (sq != nullptr) ::munmap(sq, sq_bytes);
+            if (fd >= 0) ::close(fd);
+            *this = ring{};
+        }
+
+        /// Submits one `fsync` per descriptor and waits for all of them. Each
+        /// outcome lands in `results` at its descriptor's position. At most
+        /// `entries` at a time; the caller splits larger batches.
+        ///
+        /// False when the ring itself failed. Submissions may then still be in
+        /// flight and completions unreaped, so the ring is not to be used
+        /// again: the caller tears it down.
+        [[nodiscard]] bool fsync_all(std::span<int const> fds, std::span<int> results) noexcept {
+            unsigned tail = *sq_tail;
+            for (size_t i = 0; i < fds.size(); ++i) {
+                auto const slot = tail & sq_mask;
+                auto& sqe = sqes[slot];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_FSYNC;
+                sqe.fd = fds[i];
+                sqe.user_data = i;
+                sq_array[slot] = slot;
+                ++tail;
+            }
+            std::atomic_ref<unsigned>(*sq_tail).store(tail, std::memory_order_release);
+
+            auto to_submit = unsigned(fds.size());
+            size_t reaped = 0;
+            while (reaped < fds.size()) {
+                int rc = int(::syscall(__NR_io_uring_enter, fd, to_submit, 1u,
+                                       IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (failpoints::consume_ring_failure()) {
+                    rc = -1;
+                    errno = EIO;
+                }
+                if (rc < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                to_submit -= std::min(to_submit, unsigned(rc));
+
+                unsigned head = *cq_head;
+                unsigned const ready = std::atomic_ref<unsigned>(*cq_tail)
+                                           .load(std::memory_order_acquire);
+                for (; head != ready; ++head, ++reaped) {
+                    auto const& cqe = cqes[head & cq_mask];
+                    results[size_t(cqe.user_data)] = cqe.res;
+                }
+                std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+            }
+            return true;
+        }
+    };
+
+    /// The accounting of sync_file(), file by file, then one submission for
+    /// every file it let through.
+    result<> sync_batched(std::span<fs::path const> files, missing_file missing) {
+        // The failpoints, in order. A seam that fails the nth call leaves the
+        // files before it barriered and the ones after it untouched, exactly as
+        // the loop it replaces would.
+        size_t counted = files.size();
+        for (size_t i = 0; i < files.size(); ++i) {
+            auto const nth = failpoints::sync_file_calls.fetch_add(1, std::memory_order_relaxed) + 1;
+            auto const target = failpoints::fail_sync_file_at.load(std::memory_order_relaxed);
+            if (failpoints::fail_sync_file.load(std::memory_order_relaxed)
+                    || (target != 0 && nth == target)) {
+                counted = i;
+                break;
+            }
+        }
+
+        std::vector<int> fds;
+        fds.reserve(counted);
+        size_t opened = counted;
+        for (size_t i = 0; i < counted; ++i) {
+            int const fd = ::open(files[i].c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                if (missing == missing_file::skip && errno == ENOENT) continue;
+                opened = i;
+                break;
+            }
+            fds.push_back(fd);
+        }
+
+        bool ok = counted == files.size() && opened == counted;
+        std::vector<int> results(fds.size(), 0);
+        for (size_t first = 0; first < fds.size(); first += ring_.entries) {
+            auto const n = std::min<size_t>(ring_.entries, fds.size() - first);
+            if ( ! ring_.fsync_all(std::span(fds).subspan(first, n),
+                                   std::span(results).subspan(first, n))) {
+                // The ring failed, not a barrier. What it still holds cannot be
+                // told apart from the next batch's completions, so it goes, and
+                // with it everything in flight — which keeps its own reference to
+                // each file, so closing ours below is safe. The engine is the
+                // POSIX path from here on, starting with this whole batch: a
+                // barrier the ring did complete costs a second `fsync`, and one
+                // it did not is not left owed.
+                ring_.teardown();
+                for (size_t i = 0; i < fds.size(); ++i) {
+                    results[i] = ::fsync(fds[i]) == 0 ? 0 : -errno;
+                }
+                break;
+            }
+        }
+        for (int const fd : fds) ::close(fd);
+
+        if (std::ranges::any_of(results, [](int res) { return res < 0; })) ok = false;
+        return ok ? result<>{} : std::unexpected(error_code::sync_failed);
+    }
+
+    ring ring_;
+#endif
+};
+
+} // namespace utxoz::detail
@@ -0,0 +1,94 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file latency_scope.hpp
+ * @brief Times the scope it lives in and records it into latency_stats.
+ * @internal
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <utxoz/config.hpp>
+#include <utxoz/statistics.hpp>
+
+namespace utxoz::detail {
+
+using latency_clock = std::chrono::steady_clock;
+
+/**
+ * @brief Whether this call of `Op` is the one in `latency_sample_interval_of(Op)`
+ *        that is timed.
+ *
+ * A countdown per thread and per operation, so a thread that only inserts times
+ * exactly one insert in the interval whatever else other threads do, and the
+ * first call on a thread is always timed. Constant `false` with statistics off.
+ */
+template <latency_op Op>
+[[nodiscard]] inline bool latency_sampled() noexcept {
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    if constexpr (latency_sample_interval_of(Op) == 1) {
+        return true;
+    } else {
+        thread_local uint32_t countdown = 0;
+        if (countdown == 0) {
+            countdown = latency_sample_interval_of(Op) - 1;
+            return true;
+        }
+        --countdown;
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Records the time from construction to destruction, if asked to.
+ *
+ * Every exit records, a throw included, which is what a function with several
+ * returns needs. The class may be settled late through `attribute_to()`: a
+ * find only knows which class answered it at the end.
+ *
+ * With statistics off it holds nothing and its calls are empty, so the clock is
+ * never read: the guard lives in the type, as it does for the counters, and a
+ * call site added later cannot forget it.
+ */
+class latency_scope {
+public:
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    latency_scope(latency_stats& stats, latency_op op, size_t slot, bool timed = true) noexcept
+        : stats_(timed ? &stats : nullptr)
+        , op_(op)
+        , slot_(slot)
+        , started_(timed ? latency_clock::now() : latency_clock::time_point{})
+    {}
+
+    ~latency_scope() {
+        if (stats_ != nullptr) stats_->record(op_, slot_, latency_clock::now() - started_);
+    }
+
+    void attribute_to(size_t slot) noexcept { slot_ = slot; }
+#else
+    latency_scope(latency_stats&, latency_op, size_t, bool = true) noexcept {}
+    void attribute_to(size_t) noexcept {}
+#endif
+
+    latency_scope(latency_scope const&) = delete;
+    latency_scope& operator=(latency_scope const&) = delete;
+
+#if UTXOZ_STATISTICS_LEVEL >= 1
+private:
+    latency_stats* stats_;
+    latency_op op_;
+    size_t slot_;
+    latency_clock::time_point started_;
+#endif
+};
+
+} // namespace utxoz::detail
@@ -0,0 +1,444 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file manifest_io.hpp
+ * @brief What a clean close leaves behind so the next open need not rediscover it.
+ * @internal
+ *
+ * Without it, an open rebuilds everything it knows from the directory: it lists
+ * every class several times over (recovery looks for sidecars, strays and
+ * builds, then the catalogue looks for generations, and every listing asks the
+ * filesystem about each entry), then maps every sealed generation to validate
+ * its stamp and count its map, and reads a metadata file for each. On a
+ * directory of a few hundred generations that is most of the time between
+ * calling open() and the first insert, and all of it recomputes what the last
+ * close already knew.
+ *
+ * The manifest is that knowledge, written down: the generation list of every
+ * class, each generation's metadata summary, the digest of the stamp each one
+ * should carry, the size of each active map and the entry count.
+ *
+ * ## When it is believed
+ *
+ * Only as close() left it. A writer's open rewrites it as `open` — durably,
+ * before anything can change a file — and only close() writes `closed`. A crash
+ * anywhere in between therefore leaves a manifest that says `open`, and that
+ * open goes back to scanning. Rotations and merges republish it too, still
+ * `open`, so the file never names a generation that has gone; what they write
+ * is the layout alone, with no counts or summaries to be taken for current.
+ *
+ * A `closed` manifest is then held to the directory before it replaces the scan:
+ *
+ * - the identity and mode are the config's;
+ * - every stamp digest is the one this build would write for that generation,
+ *   which is what a geometry, layout, hash or platform change would move;
+ * - one pass over the directory's names, with nothing asked about any entry,
+ *   finds exactly the generations listed and no merge record, unfinished build
+ *   or half-written record beside them — so recovery would have had nothing to
+ *   do, and is skipped;
+ * - once the active generations are mapped, which an open does anyway, their
+ *   sizes are the ones recorded.
+ *
+ * Any of those failing is not an error: the open scans, as it always did.
+ *
+ * ## What is deferred
+ *
+ * A sealed generation is not mapped at all until something reads it. Its stamp
+ * is validated then, on every path that maps one — the file cache, a merge, a
+ * walk — exactly as it was validated at open before: the check moved, it did
+ * not go away.
+ *
+ * ## Encoding
+ *
+ * record_bytes.hpp's: fixed widths, little-endian, checksum last. Variable
+ * length, since it holds a list, and bounded by the most generations a class
+ * can plausibly have, so a damaged length cannot make a read allocate without
+ * limit. Published like a metadata record, through a temp and an atomic replace.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <utxoz/types.hpp>
+
+#include "file_cache.hpp"
+#include "file_metadata.hpp"
+#include "file_metadata_io.hpp"
+#include "format_identity.hpp"
+#include "path_display.hpp"
+#include "record_bytes.hpp"
+#include "segment_stamp.hpp"
+#include "version_catalog.hpp"
+
+namespace utxoz::detail {
+
+namespace fs = std::filesystem;
+
+inline constexpr std::string_view manifest_file_name = "utxoz_manifest.dat";
+
+/// Who wrote the manifest, which decides whether it may be believed.
+enum class manifest_state : uint16_t {
+    open = 1,     ///< A writer has the directory. The layout only; promises nothing.
+    closed = 2,   ///< close() wrote it: every count and summary is what the files hold.
+};
+
+/// One generation as the manifest records it.
+struct manifest_generation {
+    size_t version = 0;
+    /// The checksum of the stamp this build writes for the generation.
+    uint32_t stamp_digest = 0;
+    /// Absent when nothing described the generation, which is "unknown" here
+    /// exactly as it is in the catalogue — never "empty".
+    std::optional<file_metadata> metadata;
+};
+
+/// One class: a full-mode size class, or reference mode's single container.
+struct manifest_class {
+    uint32_t kind = 0;            ///< container index, or reference_container_kind
+    uint64_t active_entries = 0;  ///< the active map's size, in a `closed` manifest
+    std::vector<manifest_generation> generations;   ///< ascending
+};
+
+struct manifest {
+    static constexpr std::array<char, 4> magic{'U', 'Z', 'M', 'F'};
+    static constexpr uint16_t current_format = 1;
+
+    /// Per class. The reader board lists a thousand and compaction keeps a
+    /// class far below that; a count past this is damage, not a large database.
+    static constexpr size_t max_generations = 65536;
+
+    manifest_state state = manifest_state::open;
+    storage_mode mode = storage_mode::full;
+    database_id_t database_id{};
+    /// Bumped by every publication, so two manifests of one database can be
+    /// told apart by age.
+    uint64_t sequence = 0;
+    /// size() as close() left it. Zero in an `open` manifest.
+    uint64_t entries = 0;
+    std::vector<manifest_class> classes;
+};
+
+namespace manifest_detail {
+
+/// magic + format + state + mode + reserved + id + sequence + entries + classes
+inline constexpr size_t header_size = 4 + 2 + 2 + 1 + 3 + 16 + 8 + 8 + 4;
+/// kind + active entries + generation count
+inline constexpr size_t class_header_size = 4 + 8 + 4;
+/// version + digest + metadata flag
+inline constexpr size_t generation_size = 8 + 4 + 1;
+/// min height + max height + min key + max key + entry count
+inline constexpr size_t metadata_size = 4 + 4 + outpoint_size + outpoint_size + 8;
+
+[[nodiscard]]
+inline constexpr size_t max_encoded_size() {
+    return header_size
+         + container_count * (class_header_size
+                              + manifest::max_generations * (generation_size + metadata_size))
+         + 4;
+}
+
+/// The kind each class of a `mode` manifest must carry, in order.
+[[nodiscard]]
+inline std::vector<uint32_t> expected_kinds(storage_mode mode) {
+    if (mode == storage_mode::reference) return {reference_container_kind};
+    std::vector<uint32_t> kinds(container_count);
+    for (size_t i = 0; i < container_count; ++i) kinds[i] = uint32_t(i);
+    return kinds;
+}
+
+/// The name prefix of a kind's generation files.
+[[nodiscard]]
+inline std::string prefix_of(uint32_t kind) {
+    return kind == reference_container_kind ? std::string("compact_v")
+                                            : fmt::format("cont_{}_v", kind);
+}
+
+} // namespace manifest_detail
+
+/// The digest of the stamp a generation should carry: what a `closed` manifest
+/// is held to before its layout is taken for the directory's.
+[[nodiscard]]
+inline uint32_t stamp_digest(segment_identity const& identity) {
+    return record_bytes::checksum(encode_stamp(identity).raw);
+}
+
+[[nodiscard]]
+inline std::vector<uint8_t> encode_manifest(manifest const& m) {
+    using namespace record_bytes;
+
+    std::vector<uint8_t> out;
+    out.insert(out.end(), manifest::magic.begin(), manifest::magic.end());
+    put(out, manifest::current_format);
+    put(out, uint16_t(m.state));
+    put(out, uint8_t(m.mode));
+    put(out, uint8_t{0});    // reserved, must be zero
+    put(out, uint16_t{0});   // reserved, must be zero
+    out.insert(out.end(), m.database_id.begin(), m.database_id.end());
+    put(out, m.sequence);
+    put(out, m.entries);
+    put(out, uint32_t(m.classes.size()));
+    for (auto const& c : m.classes) {
+        put(out, c.kind);
+        put(out, c.active_entries);
+        put(out, uint32_t(c.generations.size()));
+        for (auto const& g : c.generations) {
+            put(out, uint64_t(g.version));
+            put(out, g.stamp_digest);
+            put(out, uint8_t(g.metadata ? 1 : 0));
+            if ( ! g.metadata) continue;
+            put(out, g.metadata->min_block_height);
+            put(out, g.metadata->max_block_height);
+            out.insert(out.end(), g.metadata->min_key.begin(), g.metadata->min_key.end());
+            out.insert(out.end(), g.metadata->max_key.begin(), g.metadata->max_key.end());
+            put(out, uint64_t(g.metadata->entry_count));
+        }
+    }
+    put(out, checksum(std::span<uint8_t const>(out)));
+    return out;
+}
+
+/**
+ * @brief Parses and fully validates a manifest.
+ *
+ * Every length is checked against what is left before it is read, and the
+ * checksum before anything is returned, so a short or damaged file yields an
+ * error and never a partial manifest. Coherence as well as integrity: kinds in
+ * the order the mode has them, versions strictly ascending, summaries whose
+ * ranges are ranges.
+ */
+[[nodiscard]]
+inline std::expected<manifest, metadata_read_error> decode_manifest(std::span<uint8_t const> bytes) {
+    using namespace record_bytes;
+    using namespace manifest_detail;
+
+    if (bytes.size() < manifest::magic.size()) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+    if ( ! std::equal(manifest::magic.begin(), manifest::magic.end(),
+                      reinterpret_cast<char const*>(bytes.data()))) {
+        return std::unexpected(metadata_read_error::foreign);
+    }
+    if (bytes.size() < header_size + sizeof(uint32_t)) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    // The checksum first: nothing below has to reason about bytes a torn write
+    // left, only about what a build with a bug could have written.
+    uint32_t stored = 0;
+    {
+        auto const* tail = bytes.data() + bytes.size() - sizeof(uint32_t);
+        get(tail, stored);
+    }
+    auto const covered = bytes.subspan(0, bytes.size() - sizeof(uint32_t));
+    if (checksum(covered) != stored) return std::unexpected(metadata_read_error::malformed);
+
+    auto const* cursor = covered.data() + manifest::magic.size();
+    auto const* const end = covered.data() + covered.size();
+    auto remaining = [&](size_t n) { return size_t(end - cursor) >= n; };
+
+    uint16_t format = 0;
+    uint16_t state = 0;
+    uint8_t mode = 0;
+    uint8_t reserved_byte = 0;
+    uint16_t reserved_word = 0;
+    get(cursor, format);
+    if (format != manifest::current_format) return std::unexpected(metadata_read_error::foreign);
+    get(cursor, state);
+    get(cursor, mode);
+    get(cursor, reserved_byte);
+    get(cursor, reserved_word);
+    if (reserved_byte != 0 || reserved_word != 0) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+    if (state != uint16_t(manifest_state::open) && state != uint16_t(manifest_state::closed)) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+    if (mode != uint8_t(storage_mode::full) && mode != uint8_t(storage_mode::reference)) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    manifest m;
+    m.state = manifest_state(state);
+    m.mode = storage_mode(mode);
+    std::memcpy(m.database_id.data(), cursor, m.database_id.size());
+    cursor += m.database_id.size();
+    get(cursor, m.sequence);
+    get(cursor, m.entries);
+
+    uint32_t class_count = 0;
+    get(cursor, class_count);
+    auto const kinds = expected_kinds(m.mode);
+    if (class_count != kinds.size()) return std::unexpected(metadata_read_error::malformed);
+
+    m.classes.resize(class_count);
+    for (size_t c = 0; c < class_count; ++c) {
+        auto& cls = m.classes[c];
+        if ( ! remaining(class_header_size)) return std::unexpected(metadata_read_error::malformed);
+        uint32_t count = 0;
+        get(cursor, cls.kind);
+        get(cursor, cls.active_entries);
+        get(cursor, count);
+        if (cls.kind != kinds[c] || count > manifest::max_generations) {
+            return std::unexpected(metadata_read_error::malformed);
+        }
+
+        cls.generations.reserve(count);
+        for (uint32_t n = 0; n < count; ++n) {
+            if ( ! remaining(generation_size)) return std::unexpected(metadata_read_error::malformed);
+            manifest_generation g;
+            uint64_t version = 0;
+            uint8_t described = 0;
+            get(cursor, version);
+            get(cursor, g.stamp_digest);
+            get(cursor, described);
+            if constexpr (sizeof(size_t) < sizeof(uint64_t)) {
+                if (version > uint64_t(std::numeric_limits<size_t>::max())) {
+                    return std::unexpected(metadata_read_error::malformed);
+                }
+            }
+            g.version = size_t(version);
+            if ( ! cls.generations.empty() && cls.generations.back().version >= g.version) {
+                return std::unexpected(metadata_read_error::malformed);
+            }
+            if (described > 1) return std::unexpected(metadata_read_error::malformed);
+
+            if (described == 1) {
+                if ( ! remaining(metadata_size)) return std::unexpected(metadata_read_error::malformed);
+                file_metadata meta;
+                uint64_t entry_count = 0;
+                get(cursor, meta.min_block_height);
+                get(cursor, meta.max_block_height);
+                std::memcpy(meta.min_key.data(), cursor, meta.min_key.size());
+                cursor += meta.min_key.size();
+                std::memcpy(meta.max_key.data(), cursor, meta.max_key.size());
+                cursor += meta.max_key.size();
+                get(cursor, entry_count);
+                meta.entry_count = size_t(entry_count);
+                // As decode_metadata() holds a record: a summary is consulted to
+                // skip a file, so an impossible one is refused, not believed.
+                if (meta.entry_count > 0 && (meta.min_block_height > meta.max_block_height
+                                             || meta.min_key > meta.max_key)) {
+                    return std::unexpected(metadata_read_error::malformed);
+                }
+                meta.container_index = cls.kind == reference_container_kind
+                                           ? reference_sentinel_index : size_t(cls.kind);
+                meta.version = g.version;
+                g.metadata = meta;
+            }
+            cls.generations.push_back(std::move(g));
+        }
+    }
+    if (cursor != end) return std::unexpected(metadata_read_error::malformed);
+
+    return m;
+}
+
+/// Reads a manifest, or says why there is none. Never returns a partial one.
+[[nodiscard]]
+inline std::expected<manifest, metadata_read_error> read_manifest_file(fs::path const& path) {
+    std::error_code ec;
+    auto const status = fs::status(path, ec);
+    if (status.type() == fs::file_type::not_found) {
+        return std::unexpected(metadata_read_error::absent);
+    }
+    if (ec || ! fs::is_regular_file(status)) {
+        return std::unexpected(metadata_read_error::unreadable);
+    }
+
+    auto const size = fs::file_size(path, ec);
+    if (ec) return std::unexpected(metadata_read_error::unreadable);
+    if (size > manifest_detail::max_encoded_size()) {
+        return std::unexpected(metadata_read_error::malformed);
+    }
+
+    std::ifstream ifs(path, std::ios::binary);
+    if ( ! ifs) return std::unexpected(metadata_read_error::unreadable);
+
+    std::vector<uint8_t> buffer(size_t(size), 0);
+    if (size > 0) {
+        ifs.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(size));
+        if (ifs.gcount() != std::streamsize(size)) {
+            return std::unexpected(metadata_read_error::unreadable);
+        }
+    }
+    return decode_manifest(buffer);
+}
+
+[[nodiscard]]
+inline result<> write_manifest_file(fs::path const& path, manifest const& m,
+                                    metadata_sync policy = metadata_sync::publish_only) {
+    return publish_record_file(path, encode_manifest(m), policy);
+}
+
+/**
+ * @brief Whether `dir` holds exactly the generations `m` lists, and nothing in
+ *        flight beside them.
+ *
+ * One pass over the names. Nothing is asked about any entry — no status, no
+ * size — which is the difference from enumerate_versions() and most of what
+ * this saves: a name the manifest does not expect is a reason to scan, and the
+ * scan asks properly.
+ *
+ * @return false for any difference; an error only when the directory could not
+ *         be read, which is never taken for a match.
+ */
+[[nodiscard]]
+inline result<bool> directory_matches_manifest(fs::path const& dir, manifest const& m) {
+    static constexpr std::array<std::string_view, 3> in_flight{".merge", ".merge.tmp",
+                                                                ".dat.building"};
+
+    std::vector<std::string> prefixes;
+    for (auto const& c : m.classes) prefixes.push_back(manifest_detail::prefix_of(c.kind));
+    std::vector<std::vector<size_t>> listed(m.classes.size());
+
+    std::error_code ec;
+    fs::directory_iterator it(dir, ec);
+    if (ec) return std::unexpected(error_code::catalog_unreadable);
+
+    // The increment is checked where it happens; see enumerate_versions().
+    auto const end = fs::directory_iterator{};
+    while (it != end) {
+        auto const name = path_display(it->path().filename());
+        for (size_t c = 0; c < prefixes.size(); ++c) {
+            if (auto const v = parse_canonical_version(name, prefixes[c])) {
+                listed[c].push_back(*v);
+                break;
+            }
+            for (auto const suffix : in_flight) {
+                if (parse_canonical_version(name, prefixes[c], suffix)) return false;
+            }
+        }
+        it.increment(ec);
+        if (ec) return std::unexpected(error_code::catalog_unreadable);
+    }
+
+    for (size_t c = 0; c < listed.size(); ++c) {
+        auto& names = listed[c];
+        auto const& recorded = m.classes[c].generations;
+        if (names.size() != recorded.size()) return false;
+        std::ranges::sort(names);
+        for (size_t n = 0; n < names.size(); ++n) {
+            if (names[n] != recorded[n].version) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace utxoz::detail
@@ -25,9 +25,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/interprocess/managed_mapped_file.hpp>
 
@@ -44,6 +46,28 @@ namespace bip = boost::interprocess;
 
 struct database_impl;
 
+/// What a merge target is created with.
+enum class target_sizing : uint8_t {
+    /// The smallest step that takes its entries. What compaction writes for a
+    /// group of sealed generations: the target is sealed too, and is never
+    /// inserted into.
+    fitted,
+    /// The segment the class is configured for. What a target that becomes the
+    /// active generation needs — a rebuilt one, a group that took the active
+    /// one in, or the active one carried back above what a compaction published
+    /// (see database_impl::keep_active_on_top): it goes on receiving inserts.
+    configured,
+};
+
+/// How the target of a merge of `sources` is sized, given the generation that
+/// is to be active once the compaction is done. A group that includes it
+/// publishes the new active one, and a fitted file there would rotate at its
+/// small step and leave an undersized generation behind every compaction.
+[[nodiscard]] inline target_sizing sizing_for(std::vector<size_t> const& sources, size_t active) {
+    return std::ranges::find(sources, active) != sources.end() ? target_sizing::configured
+                                                               : target_sizing::fitted;
+}
+
 /// One of the five size-tiered containers of a full-mode database.
 template <size_t Index>
 struct full_merge_policy {
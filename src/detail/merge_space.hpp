@@ -0,0 +1,135 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file merge_space.hpp
+ * @brief The disk space claimed by merges that are running at the same time.
+ * @internal
+ *
+ * A merge checks the free space before it creates its target, and the check is
+ * preventive: a real ENOSPC during the write stays authoritative. With one merge
+ * at a time the free space is the whole answer. With several it is not — two
+ * targets that each fit on their own both pass the check and then do not fit
+ * together, because neither has written anything yet when the other looks.
+ *
+ * So a merge claims its target's size here before creating it, and what the
+ * other claims hold is subtracted from what the filesystem reports. The claim
+ * stands for bytes not yet written, so it is given back once the target is
+ * built and synced: from then on the file's blocks are allocated, the
+ * filesystem's own figure already counts them, and a claim still held would
+ * count them twice. A budget on
+ * the claims, when one is set, is waited for rather than refused: it limits how
+ * much is being written at once, not what may be written at all.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include <utxoz/types.hpp>
+
+namespace utxoz::detail {
+
+struct merge_space_ledger {
+    /// Bytes claimed by one merge. Released by release() once the target is
+    /// written, or when it goes out of scope, which is every exit from the
+    /// merge, published or not.
+    class claim {
+    public:
+        claim() = default;
+        claim(merge_space_ledger& ledger, uint64_t bytes) noexcept
+            : ledger_(&ledger), bytes_(bytes) {}
+
+        claim(claim const&) = delete;
+        claim& operator=(claim const&) = delete;
+
+        claim(claim&& other) noexcept
+            : ledger_(std::exchange(other.ledger_, nullptr)), bytes_(other.bytes_) {}
+
+        claim& operator=(claim&& other) noexcept {
+            if (this != &other) {
+                release();
+                ledger_ = std::exchange(other.ledger_, nullptr);
+                bytes_ = other.bytes_;
+            }
+            return *this;
+        }
+
+        ~claim() { release(); }
+
+        [[nodiscard]] uint64_t bytes() const noexcept { return bytes_; }
+
+        /// Gives the bytes back now rather than at the end of scope. Once only;
+        /// a second call, or the destructor after it, does nothing.
+        void release() noexcept {
+            if (ledger_) std::exchange(ledger_, nullptr)->release(bytes_);
+        }
+
+    private:
+
+        merge_space_ledger* ledger_ = nullptr;
+        uint64_t bytes_ = 0;
+    };
+
+    /// The most the claims may hold at once. Zero is no budget. Set between
+    /// operations, never while a claim is held.
+    void set_budget(uint64_t bytes) noexcept {
+        std::lock_guard lock(mutex_);
+        budget_ = bytes;
+    }
+
+    /**
+     * @brief Claims `bytes` for a target about to be created.
+     *
+     * Waits until the claim fits in the budget, or until nothing else is
+     * claimed: a target larger than the whole budget still runs, alone. Then asks
+     * `available()` for the free space and refuses with `insufficient_space` if
+     * the claim does not fit in it once the other claims are counted.
+     * `available()` returning nothing means the filesystem could not say, and
+     * the claim is granted — the check was only ever preventive.
+     */
+    template <typename AvailableFn>
+    [[nodiscard]] result<claim> acquire(uint64_t bytes, AvailableFn&& available) {
+        std::unique_lock lock(mutex_);
+        released_.wait(lock, [&] {
+            return budget_ == 0 || claimed_ == 0 || claimed_ + bytes <= budget_;
+        });
+
+        if (std::optional<uint64_t> const free = available(); free) {
+            auto const others = claimed_;
+            if (*free < others || *free - others < bytes) {
+                return std::unexpected(error_code::insufficient_space);
+            }
+        }
+
+        claimed_ += bytes;
+        return claim(*this, bytes);
+    }
+
+    /// What the claims hold now. For the log line a refusal writes, and for tests.
+    [[nodiscard]] uint64_t claimed() const noexcept {
+        std::lock_guard lock(mutex_);
+        return claimed_;
+    }
+
+private:
+    void release(uint64_t bytes) noexcept {
+        {
+            std::lock_guard lock(mutex_);
+            claimed_ -= bytes;
+        }
+        released_.notify_all();
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    uint64_t claimed_ = 0;
+    uint64_t budget_ = 0;
+};
+
+} // namespace utxoz::detail
@@ -0,0 +1,62 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file page_faults.hpp
+ * @brief The page faults the calling thread has taken, for the operations that
+ *        count theirs.
+ *
+ * A major fault is a page read from disk; a minor one a page that was in the
+ * page cache and only had to be mapped. The difference between a resolve that
+ * costs microseconds and one that costs milliseconds is mostly the first kind,
+ * and a delta of the two taken around one operation says which it was.
+ *
+ * Per thread, because the operations that count are run on the caller's thread
+ * while readers run on theirs: a process-wide figure would charge a resolve
+ * with every fault a concurrent find() took. Linux is the platform that counts
+ * per thread (`RUSAGE_THREAD`). Elsewhere the reading is zero and
+ * `page_faults_counted` says the zeros are not an answer.
+ *
+ * One system call per reading, so it is taken once per batch and only at
+ * `basic` or above — never per key.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <utxoz/statistics.hpp>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace utxoz::detail {
+
+struct fault_count {
+    uint64_t major = 0;
+    uint64_t minor = 0;
+};
+
+/// What this thread has taken since it started. Zero where it is not counted,
+/// or where the call fails, which it does not for a valid argument.
+[[nodiscard]]
+inline fault_count thread_faults() noexcept {
+#if defined(__linux__)
+    rusage usage {};
+    if (::getrusage(RUSAGE_THREAD, &usage) != 0) return {};
+    return {static_cast<uint64_t>(usage.ru_majflt), static_cast<uint64_t>(usage.ru_minflt)};
+#else
+    return {};
+#endif
+}
+
+/// The faults taken since `start`, read on the same thread.
+[[nodiscard]]
+inline fault_count thread_faults_since(fault_count start) noexcept {
+    auto const now = thread_faults();
+    return {now.major - start.major, now.minor - start.minor};
+}
+
+} // namespace utxoz::detail
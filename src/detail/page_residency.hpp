@@ -0,0 +1,120 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file page_residency.hpp
+ * @brief How much of a file is in the page cache right now, where the platform
+ *        will say.
+ *
+ * A resolve that reaches a generation whose pages are resident costs a hash and
+ * a compare; one whose pages are not costs a disk read per probe. Which of the
+ * two a database gets depends on how much of its history fits in memory, and
+ * that is the question this answers for one file: map it, ask `mincore()` which
+ * of its pages are resident, count them, unmap.
+ *
+ * **Asking does not change the answer.** The mapping is never read, only
+ * queried, so no page is faulted in by the measurement. The census calls this
+ * before it opens the generation for its own walk — that walk reads every entry
+ * and would make the file resident as a side effect — so what is reported is the
+ * residency the census found, not the one it caused.
+ *
+ * The kernel answers for the page cache, not for this process: a page another
+ * process brought in counts, and so does one this process has since unmapped.
+ * That is the figure a RAM decision wants. Linux gives it only to a caller that
+ * owns the file or may write it, which a database owner does; anyone else is
+ * told only about the pages their own mappings touched, which undercounts.
+ *
+ * Windows has no equivalent that works on a file rather than on a process's
+ * working set, and reports `unavailable`.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <utxoz/census.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utxoz::detail {
+
+namespace fs = std::filesystem;
+
+/// The bytes of `path` held in the page cache, or a reason there is no such
+/// number here. Pages are counted whole, except the last, which counts only
+/// as far as the file goes.
+[[nodiscard]]
+inline optional_bytes resident_bytes_of(fs::path const& path) {
+#ifdef _WIN32
+    (void)path;
+    return {0, metric_status::unavailable,
+            "this platform cannot ask the page cache about a file it has not mapped"};
+#else
+    int const fd = ::open(path.string().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {0, metric_status::unavailable, "open() failed"};
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return {0, metric_status::unavailable, "fstat() failed"};
+    }
+    uint64_t const size = static_cast<uint64_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return {0, metric_status::measured, "mincore(): an empty file has no pages"};
+    }
+
+    long const page_size = ::sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) {
+        ::close(fd);
+        return {0, metric_status::unavailable, "the page size could not be read"};
+    }
+    uint64_t const page = static_cast<uint64_t>(page_size);
+
+    // In windows of a bounded size, so the vector is a few kilobytes whatever
+    // the file is. Generations are hundreds of megabytes and a vector of one
+    // byte per page of one of them would be an allocation sized by the data.
+    constexpr uint64_t window = uint64_t(64) << 20;
+#ifdef __APPLE__
+    std::vector<char> vec((window + page - 1) / page);
+#else
+    std::vector<unsigned char> vec((window + page - 1) / page);
+#endif
+
+    uint64_t resident = 0;
+    for (uint64_t offset = 0; offset < size; offset += window) {
+        uint64_t const length = std::min(window, size - offset);
+        void* const mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, off_t(offset));
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return {0, metric_status::unavailable, "mmap() failed"};
+        }
+        int const rc = ::mincore(mapped, length, vec.data());
+        ::munmap(mapped, length);
+        if (rc != 0) {
+            ::close(fd);
+            return {0, metric_status::unavailable, "mincore() failed"};
+        }
+        uint64_t const pages = (length + page - 1) / page;
+        for (uint64_t p = 0; p < pages; ++p) {
+            if ((vec[p] & 1) == 0) continue;
+            resident += std::min(page, length - p * page);
+        }
+    }
+    ::close(fd);
+    return {resident, metric_status::measured,
+            "mincore(): pages of the file in the page cache when the census reached it, "
+            "before it read them"};
+#endif
+}
+
+} // namespace utxoz::detail
@@ -0,0 +1,382 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file reader_board.hpp
+ * @brief What the writer publishes for read-only processes, and how they read it.
+ * @internal
+ *
+ * `utxoz_readers.dat` is a small file the writer keeps mapped and other
+ * processes map read-only. It holds no entries. It says which generation files
+ * make up the database right now, and, per class, whether the writer is in the
+ * middle of changing one of them. full_reader reads it, never the catalogue, and
+ * never takes the directory claim.
+ *
+ * ## Two sequence counters
+ *
+ * Both are seqlocks: odd while the writer is changing what they cover, even
+ * otherwise, and only ever increased.
+ *
+ *  - `layout` covers the generation lists. The writer bumps it whenever the set
+ *    of files changes — open, rotation, a published merge — and publishes a list
+ *    only once every file on it is complete: a reader that maps a listed file
+ *    never meets one still being built.
+ *  - `writes[i]` covers every map of class `i`. The writer bumps it around each
+ *    emplace and each erase, in the active generation or a sealed one, and
+ *    around nothing else. A reader copies an answer out and keeps it only if the
+ *    counter it read before is still the counter after. find() in the writer's
+ *    own process reads the same counter the same way; with no board mapped the
+ *    writer keeps it in memory instead.
+ *
+ * Neither ever makes the writer wait: it stores two integers per change, whether
+ * or not anyone is reading. A reader that lands on a change retries, which costs
+ * it the length of one emplace.
+ *
+ * ## What the reads race with
+ *
+ * A reader probes a map while the writer may be changing it, which the C++
+ * memory model calls a data race and the counters make harmless in practice: a
+ * probe of a boost flat map is bounded by its group count whatever the control
+ * bytes say, the map never rehashes in place — a class that fills rotates — so
+ * its arrays do not move, and nothing read under a counter that moved is kept.
+ * The value is copied whole, as the fixed-size bytes it is stored as, and only
+ * interpreted once the counter has been checked.
+ *
+ * ## Lifetime
+ *
+ * The board is never removed, including by `open(..., remove_existing = true)`:
+ * a reader that mapped it keeps the inode it mapped, and a replaced board would
+ * leave it watching one nobody writes. Each writer open rewrites its contents in
+ * place instead and bumps `incarnation`, which tells readers to forget every
+ * mapping they hold — a recreated database reuses version numbers.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <utxoz/types.hpp>
+
+#include "format_identity.hpp"
+#include "log.hpp"
+#include "path_display.hpp"
+
+namespace utxoz::detail {
+
+namespace bip = boost::interprocess;
+namespace fs = std::filesystem;
+
+inline constexpr char const* reader_board_file_name = "utxoz_readers.dat";
+
+/// Generations one class can list. A class with more is published as
+/// `unlisted`, and readers answer `catalog_unreadable` until compaction brings
+/// it back under — saying which files exist is the one thing the board is for.
+inline constexpr size_t max_published_generations = 1024;
+
+/// A count no list can have: the class has more generations than fit.
+inline constexpr uint64_t unlisted = ~uint64_t(0);
+
+/// The file, byte for byte. Every field is eight-byte aligned so that the
+/// counters can be read through std::atomic_ref.
+struct reader_board_layout {
+    static constexpr uint64_t magic_value = 0x44524f4241455255;   // "UREABORD", little-endian
+    static constexpr uint32_t format_value = 1;
+
+    uint64_t magic;
+    uint32_t format;
+    uint32_t listed_per_class;
+    uint64_t incarnation;
+    uint64_t layout;
+    std::array<uint64_t, container_count> writes;
+    database_id_t database_id;
+    std::array<uint64_t, container_count> counts;
+    std::array<std::array<uint64_t, max_published_generations>, container_count> versions;
+};
+
+static_assert(std::is_trivially_copyable_v<reader_board_layout>);
+static_assert(offsetof(reader_board_layout, layout) % alignof(uint64_t) == 0);
+static_assert(offsetof(reader_board_layout, writes) % alignof(uint64_t) == 0);
+
+[[nodiscard]]
+inline std::atomic_ref<uint64_t> counter(uint64_t& word) noexcept {
+    return std::atomic_ref<uint64_t>(word);
+}
+
+/**
+ * @brief The writer's side. Owned by a database_impl opened in full mode.
+ */
+class reader_board_writer {
+public:
+    /**
+     * @brief Maps the board in `dir`, creating it if it is not there.
+     *
+     * A board of the right size and format is reused in place, counters and
+     * all, so a reader that outlived the previous writer sees the next one as a
+     * new incarnation rather than a counter going backwards. Anything else is
+     * replaced through a temporary name; a reader still holding the old one sees
+     * no more changes, which is what a board from another build deserves.
+     */
+    [[nodiscard]]
+    static result<std::unique_ptr<reader_board_writer>> open(fs::path const& dir,
+                                                             database_id_t const& id) {
+        auto const path = dir / reader_board_file_name;
+
+        std::error_code ec;
+        auto const size = fs::file_size(path, ec);
+        bool const reusable = ! ec && size == sizeof(reader_board_layout) && [&] {
+            try {
+                bip::file_mapping file(path.c_str(), bip::read_only);
+                bip::mapped_region region(file, bip::read_only);
+                auto const* board = static_cast<reader_board_layout const*>(region.get_address());
+                return board->magic == reader_board_layout::magic_value
+                    && board->format == reader_board_layout::format_value;
+            } catch (std::exception const&) {
+                return false;
+            }
+        }();
+
+        if ( ! reusable) {
+            auto const temp_path = fs::path(path).concat(".tmp");
+            fs::remove(temp_path, ec);
+            if (std::ofstream created(temp_path, std::ios::binary | std::ios::trunc); ! created) {
+                log::error("{}: the reader board could not be created", path_display(temp_path));
+                return std::unexpected(error_code::file_open_failed);
+            }
+            fs::resize_file(temp_path, sizeof(reader_board_layout), ec);
+            if ( ! ec) fs::rename(temp_path, path, ec);
+            if (ec) {
+                log::error("{}: the reader board could not be published: {}",
+                           path_display(path), ec.message());
+                fs::remove(temp_path, ec);
+                return std::unexpected(error_code::file_open_failed);
+            }
+        }
+
+        auto writer = std::unique_ptr<reader_board_writer>(new reader_board_writer);
+        try {
+            writer->file_ = bip::file_mapping(path.c_str(), bip::read_write);
+            writer->region_ = bip::mapped_region(writer->file_, bip::read_write);
+        } catch (std::exception const& e) {
+            log::error("{}: the reader board could not be mapped: {}", path_display(path), e.what());
+            return std::unexpected(error_code::file_open_failed);
+        }
+        writer->board_ = static_cast<reader_board_layout*>(writer->region_.get_address());
+
+        // A fresh file reads as zeros: layout 0 is even and lists nothing, which
+        // is a consistent state for a reader that maps it before this finishes.
+        auto& b = *writer->board_;
+        writer->begin_layout();
+        b.magic = reader_board_layout::magic_value;
+        b.format = reader_board_layout::format_value;
+        b.listed_per_class = uint32_t(max_published_generations);
+        b.database_id = id;
+        ++b.incarnation;
+        b.counts.fill(0);
+        // A writer that died inside a change left its counter odd. Nothing is
+        // changing now, so it is made even — forward, never back.
+        for (auto& w : b.writes) {
+            auto ref = counter(w);
+            if (auto const v = ref.load(std::memory_order_relaxed); v % 2 != 0) {
+                ref.store(v + 1, std::memory_order_release);
+            }
+        }
+        writer->end_layout();
+        return writer;
+    }
+
+    reader_board_writer(reader_board_writer const&) = delete;
+    reader_board_writer& operator=(reader_board_writer const&) = delete;
+
+    /**
+     * @brief Lists each class's generations, ascending.
+     *
+     * Called once every file listed is complete and findable under its name,
+     * and before any file no longer listed is unlinked.
+     */
+    void publish(std::array<std::vector<size_t> const*, container_count> const& versions) {
+        begin_layout();
+        for (size_t i = 0; i < container_count; ++i) {
+            auto const& listed = *versions[i];
+            if (listed.size() > max_published_generations) {
+                log::warn("reader board: class {} has {} generations, more than the {} a "
+                          "reader can be told about; readers will refuse until it is compacted",
+                          i, listed.size(), max_published_generations);
+                board_->counts[i] = unlisted;
+                continue;
+            }
+            std::ranges::copy(listed, board_->versions[i].begin());
+            board_->counts[i] = listed.size();
+        }
+        end_layout();
+    }
+
+    /// Class `index`'s write counter, for a write_guard.
+    [[nodiscard]] uint64_t& writes(size_t index) noexcept { return board_->writes[index]; }
+
+    /// Marks the class a counter covers as changing for its lifetime. Cheap
+    /// enough for every emplace and erase: two stores and a fence.
+    class write_guard {
+    public:
+        explicit write_guard(uint64_t& word) noexcept : word_(&word) {
+            auto ref = counter(*word_);
+            start_ = ref.load(std::memory_order_relaxed);
+            ref.store(start_ + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        ~write_guard() {
+            counter(*word_).store(start_ + 2, std::memory_order_release);
+        }
+        write_guard(write_guard const&) = delete;
+        write_guard& operator=(write_guard const&) = delete;
+
+    private:
+        uint64_t* word_;
+        uint64_t start_ = 0;
+    };
+
+private:
+    reader_board_writer() = default;
+
+    void begin_layout() noexcept {
+        auto ref = counter(board_->layout);
+        layout_start_ = ref.load(std::memory_order_relaxed);
+        // Rounded up: a writer that died mid-publication left it odd.
+        layout_start_ += layout_start_ % 2;
+        ref.store(layout_start_ + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_layout() noexcept {
+        counter(board_->layout).store(layout_start_ + 2, std::memory_order_release);
+    }
+
+    bip::file_mapping file_;
+    bip::mapped_region region_;
+    reader_board_layout* board_ = nullptr;
+    uint64_t layout_start_ = 0;
+};
+
+/**
+ * @brief A reader's side: the board mapped read-only.
+ */
+class reader_board_view {
+public:
+    /// What one consistent read of the generation lists gave.
+    struct published {
+        uint64_t layout = 0;
+        uint64_t incarnation = 0;
+        database_id_t database_id{};
+        std::array<std::vector<size_t>, container_count> versions;
+        std::array<bool, container_count> unlisted{};
+    };
+
+    [[nodiscard]]
+    static result<reader_board_view> open(fs::path const& dir) {
+        auto const path = dir / reader_board_file_name;
+        std::error_code ec;
+        auto const size = fs::file_size(path, ec);
+        if (ec) {
+            log::error("{}: no reader board; this directory has not been opened by a writer "
+                       "that publishes one", path_display(path));
+            return std::unexpected(error_code::database_not_found);
+        }
+        if (size != sizeof(reader_board_layout)) {
+            log::error("{}: {} bytes is not a reader board this build knows", path_display(path), size);
+            return std::unexpected(error_code::format_unsupported);
+        }
+
+        reader_board_view view;
+        try {
+            view.file_ = bip::file_mapping(path.c_str(), bip::read_only);
+            view.region_ = bip::mapped_region(view.file_, bip::read_only);
+        } catch (std::exception const& e) {
+            log::error("{}: the reader board could not be mapped: {}", path_display(path), e.what());
+            return std::unexpected(error_code::file_open_failed);
+        }
+        view.board_ = static_cast<reader_board_layout const*>(view.region_.get_address());
+        if (view.board_->magic != reader_board_layout::magic_value
+            || view.board_->format != reader_board_layout::format_value) {
+            log::error("{}: not a reader board this build knows", path_display(path));
+            return std::unexpected(error_code::format_unsupported);
+        }
+        return view;
+    }
+
+    /// The layout counter, for comparing with the one last followed.
+    [[nodiscard]] uint64_t layout() const noexcept { return load(board_->layout); }
+
+    /**
+     * @brief One consistent copy of the lists, or nothing if the writer was
+     *        publishing. The caller retries.
+     */
+    [[nodiscard]] std::optional<published> read() const {
+        published out;
+        out.layout = load(board_->layout);
+        if (out.layout % 2 != 0) return std::nullopt;
+
+        out.incarnation = board_->incarnation;
+        out.database_id = board_->database_id;
+        for (size_t i = 0; i < container_count; ++i) {
+            auto const count = board_->counts[i];
+            if (count == unlisted) {
+                out.unlisted[i] = true;
+                continue;
+            }
+            auto const& listed = board_->versions[i];
+            out.versions[i].assign(listed.begin(),
+                                   listed.begin() + std::ptrdiff_t(std::min<uint64_t>(count, listed.size())));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (relaxed(board_->layout) != out.layout) return std::nullopt;
+        return out;
+    }
+
+    /// Class `index`'s write counter, read before a probe.
+    [[nodiscard]] uint64_t writes_before(size_t index) const noexcept {
+        return load(board_->writes[index]);
+    }
+
+    /// Whether nothing changed class `index` or the lists since `before` and
+    /// `layout` were read. Called after the answer has been copied out.
+    [[nodiscard]] bool unchanged(size_t index, uint64_t before, uint64_t layout) const noexcept {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return before % 2 == 0
+            && relaxed(board_->writes[index]) == before
+            && relaxed(board_->layout) == layout;
+    }
+
+private:
+    reader_board_view() = default;
+
+    // The mapping is read-only, and std::atomic_ref takes a non-const object;
+    // a load never writes, so the cast does not reach a store.
+    static uint64_t load(uint64_t const& word) noexcept {
+        return counter(const_cast<uint64_t&>(word)).load(std::memory_order_acquire);
+    }
+    static uint64_t relaxed(uint64_t const& word) noexcept {
+        return counter(const_cast<uint64_t&>(word)).load(std::memory_order_relaxed);
+    }
+
+    bip::file_mapping file_;
+    bip::mapped_region region_;
+    reader_board_layout const* board_ = nullptr;
+};
+
+} // namespace utxoz::detail
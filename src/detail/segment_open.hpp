@@ -122,6 +122,57 @@ inline result<std::unique_ptr<bip::managed_mapped_file>> open_existing_segment(f
     }
 }
 
+/**
+ * @brief Opens a version file that is expected to exist, mapped read-only.
+ *
+ * For full_reader, which maps the files of a database another process owns and
+ * must not be able to change one. The same checks as open_existing_segment(),
+ * for the same reasons. A segment opened this way is searched with
+ * `segment_access::read_only`.
+ */
+[[nodiscard]]
+inline result<std::unique_ptr<bip::managed_mapped_file>> open_read_only_segment(fs::path const& path) {
+    std::error_code ec;
+    auto const size = fs::file_size(path, ec);
+    if (ec) {
+        log::error("{}: cannot be sized", path_display(path));
+        return std::unexpected(error_code::file_open_failed);
+    }
+    if (size < smallest_configured_file) {
+        log::error("{}: {} bytes is too small to be a version file", path_display(path), size);
+        return std::unexpected(error_code::file_open_failed);
+    }
+
+    try {
+        auto mapped = std::make_unique<bip::managed_mapped_file>(bip::open_read_only, path.c_str());
+        failpoints::segments_mapped.fetch_add(1, std::memory_order_relaxed);
+        return mapped;
+    } catch (std::exception const& e) {
+        log::error("{}: will not open as a segment: {}", path_display(path), e.what());
+        return std::unexpected(error_code::file_open_failed);
+    }
+}
+
+/**
+ * @brief How a segment is searched for its named objects.
+ *
+ * Boost's `find()` takes a mutex that lives in the segment's header, which a
+ * read-only mapping cannot write. Such a segment is searched without it. That
+ * is safe here and only here: nothing in this library constructs a named object
+ * in a file after it has been published, so there is no writer to exclude.
+ */
+enum class segment_access : uint8_t { read_write, read_only };
+
+/// `segment.find<T>(name)`, under the header mutex or — for a read-only
+/// mapping — without it.
+template <typename T>
+[[nodiscard]]
+inline std::pair<T*, bip::managed_mapped_file::size_type>
+find_named(bip::managed_mapped_file& segment, char const* name, segment_access access) {
+    return access == segment_access::read_only ? segment.find_no_lock<T>(name)
+                                               : segment.find<T>(name);
+}
+
 /**
  * @brief The one way to reach a named object inside a segment that already exists.
  *
@@ -157,8 +208,9 @@ template <typename T>
 [[nodiscard]]
 inline result<T*> find_single_named(bip::managed_mapped_file& segment,
                                     char const* name,
-                                    fs::path const& path) {
-    auto const found = segment.find<T>(name);
+                                    fs::path const& path,
+                                    segment_access access = segment_access::read_write) {
+    auto const found = find_named<T>(segment, name, access);
 
     if (found.first == nullptr) {
         log::error("{}: holds no object named '{}'", path_display(path), name);
@@ -178,12 +178,13 @@ inline std::expected<segment_identity, stamp_error> decode_stamp(segment_stamp c
  */
 [[nodiscard]]
 inline result<> validate_stamp(bip::managed_mapped_file& segment, fs::path const& path,
-                               segment_identity const& expected) {
+                               segment_identity const& expected,
+                               segment_access access = segment_access::read_write) {
     // Asked directly rather than through find_single_named, because the two
     // answers it folds together mean different things here: no stamp at all is a
     // file this build did not write, while a stamp that does not measure one
     // instance is a file whose stamp cannot be read as a stamp.
-    auto const found = segment.find<segment_stamp>(segment_stamp::object_name);
+    auto const found = find_named<segment_stamp>(segment, segment_stamp::object_name, access);
     if (found.first == nullptr) {
         log::error("{}: carries no format stamp", path_display(path));
         return std::unexpected(error_code::segment_stamp_missing);
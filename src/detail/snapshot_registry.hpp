@@ -0,0 +1,296 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file snapshot_registry.hpp
+ * @brief The generations live snapshots pin, and what the writer owes them.
+ * @internal
+ *
+ * A snapshot is every sealed generation of every class, as it stood when the
+ * snapshot was taken, mapped again by the snapshot itself — or shared with a
+ * live snapshot that maps it already, which is the same file. Sealed generations
+ * receive no inserts, so only two things could change what a snapshot reads:
+ * compaction retiring one, and a deletion erasing from one. The first is ruled
+ * out by asking the registry before a source is merged. The second cannot be —
+ * a spend has to leave the live database — so the writer copies the entry out
+ * first, into every snapshot that still sees it, and the snapshot answers from
+ * that copy from then on.
+ *
+ * Both mappings are of the same file, so the erase is visible to the snapshot's
+ * reads the moment it happens, and a probe overlapping it would be a race on the
+ * map's control bytes. Each class therefore has a reader-writer lock: snapshot
+ * reads hold it shared, and the writer holds it exclusively around each erase
+ * from a pinned generation — not around a block, and not at all while nothing
+ * is pinned.
+ *
+ * ## The walk
+ *
+ * for_each_entry() cannot hold the lock for a whole generation without stalling
+ * every spend from it for as long as the caller's callback takes, so it copies
+ * a chunk at a time and lets go in between. The writer is then erasing under a
+ * walk in progress, and what the walk needs to know about each erased entry is
+ * whether it already handed it out. The writer decides that, because only the
+ * writer sees the erase:
+ *
+ *  - in a generation the walk has finished — handed out;
+ *  - in the one it is inside — handed out when the entry sits before the cursor.
+ *    A boost flat map visits its slots in the order they lie in its element
+ *    array, so "before" is a comparison of offsets from the map object, which
+ *    are the same in the writer's mapping and the snapshot's;
+ *  - the entry under the cursor is not handed out yet, and the cursor is moved
+ *    past it before the erase, so that the walk never holds an iterator to a
+ *    slot that has been emptied;
+ *  - anything else — not yet.
+ *
+ * The walk hands out the preserved entries that were not handed out once it
+ * leaves a class, and none of the others.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/managed_mapped_file.hpp>
+#include <boost/unordered/unordered_flat_map.hpp>
+
+#include <utxoz/types.hpp>
+
+#include "utxo_value.hpp"
+
+namespace utxoz::detail {
+
+/// An entry the writer erased from a generation a snapshot pins.
+struct preserved_entry {
+    std::vector<uint8_t> data;
+    uint32_t block_height = 0;
+    /// The walk that had already handed it out when it was erased, or zero.
+    uint64_t handed_out_by = 0;
+};
+
+/// Where `element` lies in the file, counted from the map object. The same in
+/// every mapping of that file.
+template <typename Map, typename Element>
+[[nodiscard]] std::ptrdiff_t offset_in(Map const& map, Element const& element) noexcept {
+    return reinterpret_cast<char const*>(std::addressof(element))
+         - reinterpret_cast<char const*>(std::addressof(map));
+}
+
+/// One class of one snapshot: its generations, newest first, and what the
+/// writer has erased from them since.
+template <size_t Index>
+struct pinned_class {
+    using map_type = utxo_map<container_sizes[Index]>;
+
+    struct generation {
+        size_t version = 0;
+        /// Shared by every live snapshot that pins this version; see share().
+        std::shared_ptr<bip::managed_mapped_file> segment;
+        map_type const* map = nullptr;
+    };
+
+    std::vector<generation> generations;
+    boost::unordered_flat_map<raw_outpoint, preserved_entry> preserved;
+
+    /// The walk inside this class, if any. Moved by the walk under the class
+    /// lock held shared, and by the writer under it held exclusively.
+    bool walking = false;
+    uint64_t walk = 0;
+    size_t walk_generation = 0;
+    typename map_type::const_iterator cursor{};
+
+    /// Position of `version` in `generations`, or `generations.size()`.
+    [[nodiscard]] size_t position_of(size_t version) const noexcept {
+        auto const it = std::ranges::find(generations, version, &generation::version);
+        return size_t(it - generations.begin());
+    }
+};
+
+template <typename>
+struct pinned_classes_of;
+
+template <size_t... Is>
+struct pinned_classes_of<std::index_sequence<Is...>> {
+    using type = std::tuple<pinned_class<Is>...>;
+};
+
+using pinned_classes = pinned_classes_of<std::make_index_sequence<container_count>>::type;
+
+struct snapshot_registry;
+
+/// Everything a full_snapshot holds. Registered for as long as it lives.
+struct snapshot_state {
+    explicit snapshot_state(std::shared_ptr<snapshot_registry> owner) noexcept
+        : registry(std::move(owner)) {}
+    ~snapshot_state();
+
+    snapshot_state(snapshot_state const&) = delete;
+    snapshot_state& operator=(snapshot_state const&) = delete;
+
+    template <size_t Index>
+    [[nodiscard]] pinned_class<Index>& cls() noexcept { return std::get<Index>(classes); }
+
+    template <size_t Index>
+    [[nodiscard]] pinned_class<Index> const& cls() const noexcept { return std::get<Index>(classes); }
+
+    /// Whether this snapshot reads generation `version` of class `index`.
+    [[nodiscard]] bool pins(size_t index, size_t version) const noexcept {
+        return [&]<size_t... Is>(std::index_sequence<Is...>) {
+            return ((Is == index
+                     && cls<Is>().position_of(version) < cls<Is>().generations.size()) || ...);
+        }(std::make_index_sequence<container_count>{});
+    }
+
+    std::shared_ptr<snapshot_registry> registry;
+    pinned_classes classes;
+
+    /// One walk at a time per snapshot: the cursor is the snapshot's, not the
+    /// call's. Lookups do not take it.
+    std::mutex walk_mutex;
+    uint64_t walks = 0;
+};
+
+/**
+ * @brief The live snapshots of one database, and the locks their reads take.
+ *
+ * Shared by the database and every snapshot taken from it, so that a snapshot
+ * dropped after the database closed still has somewhere to unregister.
+ */
+struct snapshot_registry {
+    /// Held shared by every snapshot read of a class, exclusively by the writer
+    /// around an erase from a pinned generation and by close().
+    mutable std::array<std::shared_mutex, container_count> class_locks;
+
+    /// Set by close(), with every class lock held; read under any one of them.
+    /// A snapshot of a closed database answers `closed`.
+    bool closed = false;
+
+    void add(snapshot_state* state) {
+        std::lock_guard const registered(mutex_);
+        live_.push_back(state);
+        live_count_.fetch_add(1, std::memory_order_release);
+    }
+
+    void remove(snapshot_state* state) {
+        std::lock_guard const registered(mutex_);
+        if (auto const it = std::ranges::find(live_, state); it != live_.end()) {
+            live_.erase(it);
+            live_count_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    /// Whether a live snapshot reads this generation. Compaction asks before it
+    /// merges one.
+    [[nodiscard]] bool pinned(size_t index, size_t version) const {
+        if (live_count_.load(std::memory_order_acquire) == 0) return false;
+        std::lock_guard const registered(mutex_);
+        return std::ranges::any_of(live_, [&](snapshot_state const* state) {
+            return state->pins(index, version);
+        });
+    }
+
+    /**
+     * @brief Adds to `into` the mapping of generation `version` of class
+     *        `Index` that a live snapshot already holds, if one does.
+     *
+     * A pinned generation stays the file it was for as long as it is pinned —
+     * compaction asks first, and merge targets are always new versions — so a
+     * second mapping of it would only repeat the first one's open and stamp
+     * check. The newest snapshot is asked first: it pins everything the one
+     * before it did that is still there. What each snapshot preserves from the
+     * generation stays its own.
+     */
+    template <size_t Index>
+    bool share(size_t version, pinned_class<Index>& into) const {
+        if (live_count_.load(std::memory_order_acquire) == 0) return false;
+        std::lock_guard const registered(mutex_);
+        for (auto it = live_.rbegin(); it != live_.rend(); ++it) {
+            auto const& c = (*it)->template cls<Index>();
+            if (auto const g = c.position_of(version); g < c.generations.size()) {
+                into.generations.push_back(c.generations[g]);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief map.erase(key), for a sealed generation of class `Index`.
+     *
+     * With no snapshot pinning the generation, exactly that. Otherwise the entry
+     * is copied into each snapshot that sees it, and each walk inside it is told
+     * whether it has already been handed out, before the erase — all under the
+     * class lock, so no snapshot read sees the generation between the two.
+     */
+    template <size_t Index, typename Map>
+    size_t erase(size_t version, Map& map, raw_outpoint const& key) {
+        if (live_count_.load(std::memory_order_acquire) == 0) return map.erase(key);
+
+        std::lock_guard const registered(mutex_);
+        std::vector<std::pair<pinned_class<Index>*, size_t>> seeing;
+        for (auto* state : live_) {
+            auto& c = state->template cls<Index>();
+            if (auto const g = c.position_of(version); g < c.generations.size()) {
+                seeing.emplace_back(&c, g);
+            }
+        }
+        if (seeing.empty()) return map.erase(key);
+
+        std::unique_lock const writing(class_locks[Index]);
+        auto const it = map.find(key);
+        if (it == map.end()) return 0;
+
+        auto const at = offset_in(map, *it);
+        auto const data = it->second.get_data();
+        for (auto const& [c, g] : seeing) {
+            uint64_t handed_out_by = 0;
+            if (c->walking) {
+                if (g < c->walk_generation) {
+                    handed_out_by = c->walk;
+                } else if (g == c->walk_generation) {
+                    auto const& walked = *c->generations[g].map;
+                    if (c->cursor != walked.end()) {
+                        auto const cursor = offset_in(walked, *c->cursor);
+                        if (at < cursor)        handed_out_by = c->walk;
+                        else if (at == cursor)  ++c->cursor;
+                    }
+                }
+            }
+            c->preserved.try_emplace(key, preserved_entry{
+                std::vector<uint8_t>(data.begin(), data.end()),
+                it->second.block_height, handed_out_by});
+        }
+        map.erase(it);
+        return 1;
+    }
+
+    /// Every later snapshot read answers `closed`. Waits for the reads in flight.
+    void close() {
+        std::array<std::unique_lock<std::shared_mutex>, container_count> held;
+        for (size_t i = 0; i < container_count; ++i) {
+            held[i] = std::unique_lock(class_locks[i]);
+        }
+        closed = true;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<snapshot_state*> live_;
+    std::atomic<size_t> live_count_{0};
+};
+
+inline snapshot_state::~snapshot_state() {
+    if (registry) registry->remove(this);
+}
+
+} // namespace utxoz::detail
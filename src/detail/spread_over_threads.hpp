@@ -0,0 +1,87 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file spread_over_threads.hpp
+ * @brief Independent pieces of work over a few threads, failing the way a loop
+ *        over them would.
+ *
+ * Used where nothing is shared between pieces: the per-file checks of an open,
+ * the recovery of interrupted merges, the census walk, the classes of a batch
+ * or of a compaction, the shards of a set. Threads are started for the call and
+ * joined before it returns; there is no pool to keep alive between calls.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "log.hpp"
+
+namespace utxoz::detail {
+
+/**
+ * Calls `work(i)` for every `i` below `count`, on up to `threads` threads with
+ * the calling one among them, and returns once every call has.
+ *
+ * Indices are handed out in order, so by the time any index is being worked on
+ * every one below it has been started — and once `work` returns false no
+ * further index is handed out. The first failure in index order is therefore
+ * always among the calls that ran, which is what lets a caller report the same
+ * error a loop would have.
+ *
+ * An exception never reaches a thread's edge, where it would end the process.
+ * It is caught there and the call that threw counts as finished, not as a
+ * failure: the other indices still run. Once every thread has joined, the
+ * exception of the lowest index that threw is rethrown, which is the one a
+ * loop that carried on past a throw would have met first. A thread the system
+ * will not start is one fewer worker, not a failure: its share is taken by the
+ * ones that did start.
+ */
+template <typename Work>
+void spread_over_threads(size_t count, size_t threads, std::string_view what, Work&& work) {
+    std::vector<std::exception_ptr> thrown(count);
+    std::atomic<size_t> next{0};
+    std::atomic<bool> stopped{false};
+    auto worker = [&] {
+        while ( ! stopped.load(std::memory_order_acquire)) {
+            auto const i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count) return;
+            try {
+                if ( ! work(i)) stopped.store(true, std::memory_order_release);
+            } catch (...) {
+                thrown[i] = std::current_exception();
+            }
+        }
+    };
+
+    threads = std::clamp<size_t>(threads, 1, std::max<size_t>(count, 1));
+    {
+        std::vector<std::jthread> helpers;
+        helpers.reserve(threads - 1);
+        for (size_t t = 1; t < threads; ++t) {
+            try {
+                helpers.emplace_back(worker);
+            } catch (std::system_error const& e) {
+                log::warn("{}: could only start {} of {} threads: {}",
+                          what, helpers.size() + 1, threads, e.what());
+                break;
+            }
+        }
+        worker();
+    }   // joined here
+
+    for (auto const& e : thrown) {
+        if (e) std::rethrow_exception(e);
+    }
+}
+
+} // namespace utxoz::detail
@@ -0,0 +1,121 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file stats_publisher.hpp
+ * @brief The stats_snapshot the writer keeps and a monitoring thread reads.
+ * @internal
+ *
+ * Two copies. The staged one is the writer's: plain integers, incremented where
+ * the thing they count happens, by whichever thread owns the class at the time
+ * — under insert_batch() and apply_deletes() that is one thread per class, each
+ * on its own cache line. The published one is a seqlock, odd while the writer is
+ * copying staged figures into it and even otherwise, the same shape as the
+ * reader board's counters.
+ *
+ * The writer publishes at the end of an operation, on the operation's own
+ * thread, never from a class's worker: one writer at a time is what a seqlock
+ * asks, and the database's threading rule already gives it. A publication copies
+ * the classes the operation touched and the total, which for an insert is a
+ * handful of stores. A reader copies everything and keeps it only if the
+ * sequence it read before is the sequence after; landing on a publication costs
+ * it a retry the length of one.
+ *
+ * Every published word is an atomic, read and written relaxed, with the fences
+ * on the sequence doing the ordering. No torn integer, and no data race for the
+ * memory model to object to.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <utxoz/statistics.hpp>
+#include <utxoz/types.hpp>
+
+namespace utxoz::detail {
+
+class stats_publisher {
+public:
+    /// The writer's copy of `slot`. Only the thread that owns the class writes
+    /// it; nothing but publish() reads it.
+    [[nodiscard]] class_snapshot& staged(size_t slot) noexcept { return staged_[slot].figures; }
+    [[nodiscard]] class_snapshot const& staged(size_t slot) const noexcept { return staged_[slot].figures; }
+
+    /// Zeroes the writer's copy, as an open starts from. The published side
+    /// keeps its sequence, which only ever climbs.
+    void clear_staged() noexcept {
+        for (auto& c : staged_) c.figures = class_snapshot{};
+    }
+
+    /// Publishes classes [first, last) and the total. Writer only.
+    void publish(uint64_t total_entries, size_t first = 0, size_t last = container_count) noexcept {
+        auto const before = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(before + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        total_entries_.store(total_entries, std::memory_order_relaxed);
+        for (size_t c = first; c < last; ++c) {
+            auto const& from = staged_[c].figures;
+            auto& to = published_[c];
+            for (size_t f = 0; f < fields.size(); ++f) {
+                to[f].store(from.*fields[f], std::memory_order_relaxed);
+            }
+        }
+
+        sequence_.store(before + 2, std::memory_order_release);
+    }
+
+    /// A consistent copy of what was last published. Any thread, any time.
+    [[nodiscard]] stats_snapshot read(storage_mode mode) const noexcept {
+        stats_snapshot out;
+        out.mode = mode;
+        for (;;) {
+            auto const before = sequence_.load(std::memory_order_acquire);
+            if ((before & 1) == 0) {
+                out.total_entries = total_entries_.load(std::memory_order_relaxed);
+                for (size_t c = 0; c < container_count; ++c) {
+                    for (size_t f = 0; f < fields.size(); ++f) {
+                        out.classes[c].*fields[f] = published_[c][f].load(std::memory_order_relaxed);
+                    }
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence_.load(std::memory_order_relaxed) == before) {
+                    out.sequence = before / 2;
+                    return out;
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr std::array<uint64_t class_snapshot::*, 8> fields{
+        &class_snapshot::active_entries,
+        &class_snapshot::active_file_bytes,
+        &class_snapshot::active_used_bytes,
+        &class_snapshot::sealed_generations,
+        &class_snapshot::sealed_bytes,
+        &class_snapshot::inserts,
+        &class_snapshot::deletes,
+        &class_snapshot::rotations,
+    };
+    static_assert(sizeof(class_snapshot) == fields.size() * sizeof(uint64_t),
+                  "a class_snapshot field that is not published");
+
+    /// One line per class, so classes counted side by side do not share one.
+    struct alignas(64) staged_class {
+        class_snapshot figures;
+    };
+
+    std::array<staged_class, container_count> staged_{};
+
+    alignas(64) std::atomic<uint64_t> sequence_{0};
+    std::atomic<uint64_t> total_entries_{0};
+    std::array<std::array<std::atomic<uint64_t>, fields.size()>, container_count> published_{};
+};
+
+} // namespace utxoz::detail
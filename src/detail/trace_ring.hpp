@@ -0,0 +1,203 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file trace_ring.hpp
+ * @brief Where the spans of trace.hpp are kept until drained, and the scope
+ *        that records one.
+ * @internal
+ *
+ * A ring behind a mutex. The spans come from the writer, the group commit's
+ * flusher and whichever thread resolves, a few per block between them, so the
+ * lock is uncontended in practice and a lock-free ring would buy nothing that
+ * could be measured. What matters is the disabled path, and that is one relaxed
+ * load in trace_span's constructor, before the clock is read.
+ *
+ * One span runs before tracing can have been started: the merge recovery of
+ * open(), which returns the handle start_tracing() is called on. It is timed
+ * anyway and set aside by hold(), and start() puts it in first.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <utxoz/trace.hpp>
+
+namespace utxoz::detail {
+
+using trace_clock = std::chrono::steady_clock;
+
+/// This thread's number in trace_event::thread.
+[[nodiscard]] inline uint32_t trace_thread_number() noexcept {
+    static std::atomic<uint32_t> next{1};
+    thread_local uint32_t const mine = next.fetch_add(1, std::memory_order_relaxed);
+    return mine;
+}
+
+class trace_ring {
+public:
+    trace_ring() = default;
+    trace_ring(trace_ring const&) = delete;
+    trace_ring& operator=(trace_ring const&) = delete;
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t resolve_threshold() const noexcept {
+        return resolve_threshold_.load(std::memory_order_relaxed);
+    }
+
+    /// Starts over: whatever was held from a previous run is dropped, and what
+    /// was set aside by hold() goes in first.
+    void start(trace_options const& options) {
+        {
+            std::lock_guard const lock(mutex_);
+            events_.assign(std::max<size_t>(options.capacity, 1), trace_event{});
+            next_ = 0;
+            held_ = 0;
+            overwritten_ = 0;
+            resolve_threshold_.store(options.resolve_threshold, std::memory_order_relaxed);
+            if (set_aside_) push(*std::exchange(set_aside_, std::nullopt));
+        }
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    /// Stops recording and keeps what is held for a last drain. A span already
+    /// open when this runs still lands.
+    void stop() noexcept {
+        enabled_.store(false, std::memory_order_relaxed);
+    }
+
+    void record(trace_event const& event) noexcept {
+        std::lock_guard const lock(mutex_);
+        push(event);
+    }
+
+    /// For what runs before there is a handle to start tracing on: kept aside,
+    /// the last one only, until start(). Recorded at once if tracing is on.
+    void hold(trace_event const& event) noexcept {
+        if (enabled()) {
+            record(event);
+            return;
+        }
+        std::lock_guard const lock(mutex_);
+        set_aside_ = event;
+    }
+
+    [[nodiscard]] trace_capture drain() {
+        std::lock_guard const lock(mutex_);
+        trace_capture capture;
+        capture.events.reserve(held_);
+        auto const oldest = (next_ + events_.size() - held_) % std::max<size_t>(events_.size(), 1);
+        for (size_t i = 0; i < held_; ++i) {
+            capture.events.push_back(events_[(oldest + i) % events_.size()]);
+        }
+        capture.overwritten = std::exchange(overwritten_, 0);
+        held_ = 0;
+        return capture;
+    }
+
+private:
+    /// Under the lock.
+    void push(trace_event const& event) noexcept {
+        if (events_.empty()) return;   // never started
+        events_[next_] = event;
+        next_ = (next_ + 1) % events_.size();
+        if (held_ < events_.size()) {
+            ++held_;
+        } else {
+            ++overwritten_;
+        }
+    }
+
+    std::mutex mutex_;
+    std::vector<trace_event> events_;
+    size_t next_ = 0;
+    size_t held_ = 0;
+    uint64_t overwritten_ = 0;
+    std::optional<trace_event> set_aside_;
+    std::atomic<bool> enabled_{false};
+    std::atomic<size_t> resolve_threshold_{trace_options{}.resolve_threshold};
+};
+
+/**
+ * @brief Records the time from construction to destruction as one event, if
+ *        tracing is on when it starts.
+ *
+ * Failed until `succeeded()` says otherwise, so that every early return and
+ * every throw is recorded as what it was without a call at each. The figures can
+ * be filled in as they become known; with tracing off the setters write into an
+ * event nobody reads, which is cheaper than a branch in each.
+ */
+class trace_span {
+public:
+    /// A null ring is tracing off, for the holders that may not have been given
+    /// one.
+    trace_span(trace_ring* ring, trace_kind kind, size_t container_class = unattributed_class,
+               bool wanted = true) noexcept
+        : ring_(wanted && ring != nullptr && ring->enabled() ? ring : nullptr)
+    {
+        event_.kind = kind;
+        event_.failed = true;
+        event_.container_class = container_class;
+        if (ring_ != nullptr) started_ = trace_clock::now();
+    }
+
+    /// Times whether or not tracing is on, and hands the event to
+    /// trace_ring::hold() rather than record().
+    struct set_aside_t {};
+    static constexpr set_aside_t set_aside{};
+    trace_span(trace_ring* ring, trace_kind kind, set_aside_t) noexcept
+        : ring_(ring)
+        , held_(true)
+    {
+        event_.kind = kind;
+        event_.failed = true;
+        if (ring_ != nullptr) started_ = trace_clock::now();
+    }
+
+    ~trace_span() {
+        if (ring_ == nullptr) return;
+        auto const finished = trace_clock::now();
+        event_.thread = trace_thread_number();
+        event_.start_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            started_.time_since_epoch()).count());
+        event_.duration_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            finished - started_).count());
+        if (held_) {
+            ring_->hold(event_);
+        } else {
+            ring_->record(event_);
+        }
+    }
+
+    trace_span(trace_span const&) = delete;
+    trace_span& operator=(trace_span const&) = delete;
+
+    [[nodiscard]] bool active() const noexcept { return ring_ != nullptr; }
+
+    void succeeded() noexcept { event_.failed = false; }
+    void version(uint64_t v) noexcept { event_.version = v; }
+    void bytes(uint64_t b) noexcept { event_.bytes = b; }
+    void items(uint64_t n) noexcept { event_.items = n; }
+    void files(uint64_t n) noexcept { event_.files = n; }
+
+private:
+    trace_ring* ring_;
+    bool held_ = false;
+    trace_clock::time_point started_{};
+    trace_event event_;
+};
+
+} // namespace utxoz::detail
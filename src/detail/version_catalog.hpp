@@ -25,7 +25,9 @@
 #include <filesystem>
 #include <string>
 #include <optional>
+#include <string_view>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #include <boost/unordered/unordered_flat_map.hpp>
@@ -196,8 +198,21 @@ inline std::optional<size_t> parse_canonical_version(std::string const& name,
     return value;
 }
 
+/// One kind of name enumerate_version_families() collects: `prefix`, five
+/// digits, `suffix`.
+struct version_family {
+    std::string prefix;
+    std::string_view suffix = ".dat";
+};
+
 /**
- * @brief Version numbers of the regular files in `dir` matching `prefix`.
+ * @brief The version numbers of every family at once, in one pass over `dir`.
+ *
+ * Element `i` of the answer is what enumerate_versions() would have returned
+ * for `families[i]`, sorted and without duplicates. Opening used to list the
+ * directory once per class and suffix — fifteen walks for merge recovery alone
+ * — and a directory of many generations makes each walk the cost of reading
+ * every name in it.
  *
  * Fail-closed: any error reading the directory is returned, never swallowed. A
  * catalogue that cannot be read is not an empty catalogue — reporting one as
@@ -207,15 +222,16 @@ inline std::optional<size_t> parse_canonical_version(std::string const& name,
  * nothing is published unless the whole directory was walked.
  */
 [[nodiscard]]
-inline result<std::vector<size_t>> enumerate_versions(fs::path const& dir, std::string const& prefix,
-                                                     std::string_view suffix = ".dat") {
+inline result<std::vector<std::vector<size_t>>>
+enumerate_version_families(fs::path const& dir, std::vector<version_family> const& families) {
     std::error_code ec;
+    std::vector<std::vector<size_t>> found(families.size());
 
     auto const status = fs::status(dir, ec);
 
     // Absent is a real answer — a database that has not been created yet has no
     // versions. Anything else that goes wrong is not an answer at all.
-    if (status.type() == fs::file_type::not_found) return std::vector<size_t>{};
+    if (status.type() == fs::file_type::not_found) return found;
     if (ec) return std::unexpected(error_code::catalog_unreadable);
     if ( ! fs::is_directory(status)) return std::unexpected(error_code::catalog_unreadable);
 
@@ -227,7 +243,6 @@ inline result<std::vector<size_t>> enumerate_versions(fs::path const& dir, std::
     // the loop simply finishes and a check placed in the body never runs — which
     // would return everything read so far as if it were the whole directory.
     // That is the partial list this function promises not to publish.
-    std::vector<size_t> versions;
     auto const end = fs::directory_iterator{};
     while (it != end) {
         // A directory or a symlink to one must not be catalogued as a version
@@ -244,8 +259,12 @@ inline result<std::vector<size_t>> enumerate_versions(fs::path const& dir, std::
             // enumeration by exception, over a file it was going to ignore.
             // The prefixes and suffixes matched below are ASCII, so comparing
             // UTF-8 answers the same question.
-            if (auto const v = parse_canonical_version(path_display(it->path().filename()), prefix, suffix)) {
-                versions.push_back(*v);
+            auto const name = path_display(it->path().filename());
+            for (size_t f = 0; f < families.size(); ++f) {
+                if (auto const v = parse_canonical_version(name, families[f].prefix,
+                                                           families[f].suffix)) {
+                    found[f].push_back(*v);
+                }
             }
         }
 
@@ -253,9 +272,21 @@ inline result<std::vector<size_t>> enumerate_versions(fs::path const& dir, std::
         if (ec) return std::unexpected(error_code::catalog_unreadable);
     }
 
-    std::ranges::sort(versions);
-    versions.erase(std::ranges::unique(versions).begin(), versions.end());
-    return versions;
+    for (auto& versions : found) {
+        std::ranges::sort(versions);
+        versions.erase(std::ranges::unique(versions).begin(), versions.end());
+    }
+    return found;
+}
+
+/// @brief Version numbers of the regular files in `dir` matching `prefix`.
+/// One family of enumerate_version_families(), with the same guarantees.
+[[nodiscard]]
+inline result<std::vector<size_t>> enumerate_versions(fs::path const& dir, std::string const& prefix,
+                                                     std::string_view suffix = ".dat") {
+    auto listed = enumerate_version_families(dir, {version_family{prefix, suffix}});
+    if ( ! listed) return std::unexpected(listed.error());
+    return std::move(listed->front());
 }
 
 } // namespace utxoz::detail
@@ -0,0 +1,360 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file reader.cpp
+ * @brief full_reader — following the board, mapping what it lists, and reading
+ *        under the writer's counters.
+ */
+
+#include <utxoz/reader.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/unordered/unordered_flat_set.hpp>
+#include <fmt/format.h>
+
+#include "detail/file_cache.hpp"
+#include "detail/log.hpp"
+#include "detail/path_display.hpp"
+#include "detail/reader_board.hpp"
+#include "detail/segment_open.hpp"
+#include "detail/segment_stamp.hpp"
+#include "detail/store_config_io.hpp"
+#include "detail/utxo_value.hpp"
+#include "detail/version_catalog.hpp"
+
+namespace utxoz {
+
+namespace detail {
+
+/// One class as the reader has it mapped, newest generation first.
+template <size_t Index>
+struct reader_class {
+    using map_type = utxo_map<container_sizes[Index]>;
+
+    struct generation {
+        size_t version = 0;
+        std::unique_ptr<bip::managed_mapped_file> segment;
+        map_type const* map = nullptr;
+    };
+
+    std::vector<generation> generations;
+    bool unlisted = false;
+};
+
+template <typename>
+struct reader_classes_of;
+
+template <size_t... Is>
+struct reader_classes_of<std::index_sequence<Is...>> {
+    using type = std::tuple<reader_class<Is>...>;
+};
+
+using reader_classes = reader_classes_of<std::make_index_sequence<container_count>>::type;
+
+struct reader_impl {
+    fs::path dir;
+    reader_board_view board;
+    reader_classes classes;
+
+    /// The layout mapped, and the writer incarnation it came from. Odd until
+    /// the first one is followed, which no published layout can be.
+    uint64_t followed_layout = 1;
+    uint64_t incarnation = 0;
+    database_id_t database_id{};
+};
+
+} // namespace detail
+
+namespace {
+
+namespace fs = std::filesystem;
+using detail::reader_impl;
+
+/// How long a reader keeps retrying while the writer is inside one change. A
+/// change is one emplace or one erase; a second of them is a writer that died.
+constexpr auto stall_limit = std::chrono::seconds(1);
+
+/// Calls `f(std::integral_constant<size_t, I>{})` for every class, in order,
+/// until one returns false.
+template <typename F>
+bool for_each_class(F&& f) {
+    return [&]<size_t... Is>(std::index_sequence<Is...>) {
+        return (f(std::integral_constant<size_t, Is>{}) && ...);
+    }(std::make_index_sequence<container_count>{});
+}
+
+/// Retries with a deadline. The first few are immediate — the change being
+/// waited out is a few hundred nanoseconds — and the rest yield.
+class retry_budget {
+public:
+    /// Whether to try again, after waiting a little.
+    [[nodiscard]] bool again() {
+        if (++tries_ <= 64) return true;
+        if (tries_ == 65) deadline_ = std::chrono::steady_clock::now() + stall_limit;
+        std::this_thread::yield();
+        return std::chrono::steady_clock::now() < deadline_;
+    }
+
+private:
+    size_t tries_ = 0;
+    std::chrono::steady_clock::time_point deadline_{};
+};
+
+/// Maps one listed generation, read-only, and checks it is the file the list
+/// says it is.
+template <size_t Index>
+result<typename detail::reader_class<Index>::generation>
+map_generation(reader_impl const& impl, size_t version) {
+    using map_type = typename detail::reader_class<Index>::map_type;
+    auto const path = impl.dir / fmt::format(detail::data_file_format, Index, version);
+
+    auto opened = detail::open_read_only_segment(path);
+    if ( ! opened) return std::unexpected(opened.error());
+    if (auto const stamped = detail::validate_stamp(
+            **opened, path, detail::local_identity(impl.database_id, uint32_t(Index), version),
+            detail::segment_access::read_only);
+        ! stamped) {
+        return std::unexpected(stamped.error());
+    }
+    auto const found = detail::find_single_named<map_type>(
+        **opened, detail::map_object_name, path, detail::segment_access::read_only);
+    if ( ! found) return std::unexpected(found.error());
+    return typename detail::reader_class<Index>::generation{version, std::move(*opened), *found};
+}
+
+/**
+ * Maps what `published` lists and nothing else. Generations already mapped are
+ * kept; the rest are mapped fresh. Nothing is changed unless every class maps:
+ * a failure leaves the reader on the layout it was already following.
+ */
+result<> follow(reader_impl& impl, detail::reader_board_view::published& published) {
+    if (published.incarnation != impl.incarnation || published.database_id != impl.database_id) {
+        // Another writer open. Version numbers may have been reused by a
+        // recreated database, so nothing mapped before can be trusted.
+        for_each_class([&](auto I) {
+            std::get<I.value>(impl.classes).generations.clear();
+            return true;
+        });
+        impl.incarnation = published.incarnation;
+        impl.database_id = published.database_id;
+    }
+
+    detail::reader_classes next;
+    result<> outcome;
+    for_each_class([&](auto I) {
+        auto& current = std::get<I.value>(impl.classes);
+        auto& wanted = std::get<I.value>(next);
+        wanted.unlisted = published.unlisted[I.value];
+        auto const& listed = published.versions[I.value];
+        for (auto v = listed.rbegin(); v != listed.rend(); ++v) {
+            auto const held = std::ranges::find(current.generations, *v,
+                                                &std::decay_t<decltype(current)>::generation::version);
+            if (held != current.generations.end() && held->segment) {
+                wanted.generations.push_back(std::move(*held));
+                continue;
+            }
+            auto mapped = map_generation<I.value>(impl, *v);
+            if ( ! mapped) {
+                outcome = std::unexpected(mapped.error());
+                return false;
+            }
+            wanted.generations.push_back(std::move(*mapped));
+        }
+        return true;
+    });
+
+    if ( ! outcome) {
+        // What was moved out of `current` goes back, so the old layout stays
+        // whole for a retry.
+        for_each_class([&](auto I) {
+            auto& current = std::get<I.value>(impl.classes).generations;
+            for (auto& gen : std::get<I.value>(next).generations) {
+                auto const slot = std::ranges::find(current, gen.version,
+                                                    &std::decay_t<decltype(gen)>::version);
+                if (slot != current.end()) *slot = std::move(gen);
+            }
+            return true;
+        });
+        return outcome;
+    }
+
+    impl.classes = std::move(next);
+    impl.followed_layout = published.layout;
+    return {};
+}
+
+result<> refresh_impl(reader_impl& impl) {
+    retry_budget budget;
+    for (;;) {
+        // The cheap case first: one load, and nothing moved.
+        if (impl.board.layout() == impl.followed_layout) return {};
+
+        auto published = impl.board.read();
+        if (published) {
+            auto const followed = follow(impl, *published);
+            if (followed) return {};
+            // A listed file may have been merged away between the list and the
+            // mapping. That is a new layout, and the next pass follows it. The
+            // same failure against a layout that did not move is the answer.
+            if (impl.board.layout() == published->layout) return followed;
+        }
+        if ( ! budget.again()) return std::unexpected(error_code::reader_stalled);
+    }
+}
+
+/// One class's answer for `key`, or nothing: one consistent read, or
+/// `std::nullopt` inside the result when the writer moved underneath it.
+template <size_t Index>
+std::optional<std::optional<full_find_result>> find_in_class(reader_impl const& impl,
+                                                             raw_outpoint const& key) {
+    using value_type = detail::utxo_value<container_sizes[Index]>;
+    auto const& cls = std::get<Index>(impl.classes);
+
+    auto const before = impl.board.writes_before(Index);
+    if (before % 2 != 0) return std::nullopt;
+
+    // Copied as bytes and read only once the counter says they are whole.
+    std::optional<value_type> copied;
+    for (auto const& gen : cls.generations) {
+        if (auto const it = gen.map->find(key); it != gen.map->end()) {
+            copied.emplace();
+            std::memcpy(&*copied, &it->second, sizeof(value_type));
+            break;
+        }
+    }
+    if ( ! impl.board.unchanged(Index, before, impl.followed_layout)) return std::nullopt;
+
+    if ( ! copied) return std::optional<full_find_result>{};
+    auto const size = std::min<size_t>(copied->actual_size, copied->data.size());
+    return std::optional<full_find_result>{
+        full_find_result{{copied->data.begin(), copied->data.begin() + std::ptrdiff_t(size)},
+                         copied->block_height}};
+}
+
+/// `key` in every class, following the writer until one pass reads cleanly.
+result<std::optional<full_find_result>> lookup(reader_impl& impl, raw_outpoint const& key) {
+    retry_budget budget;
+    for (;;) {
+        if (auto const followed = refresh_impl(impl); ! followed) {
+            return std::unexpected(followed.error());
+        }
+
+        std::optional<full_find_result> found;
+        bool clean = true;
+        bool unlisted = false;
+        for_each_class([&](auto I) {
+            if (std::get<I.value>(impl.classes).unlisted) {
+                unlisted = true;
+                return false;
+            }
+            auto const answer = find_in_class<I.value>(impl, key);
+            if ( ! answer) {
+                clean = false;
+                return false;
+            }
+            found = std::move(*answer);
+            return ! found;
+        });
+
+        if (unlisted) return std::unexpected(error_code::catalog_unreadable);
+        if (clean) return found;
+        if ( ! budget.again()) return std::unexpected(error_code::reader_stalled);
+    }
+}
+
+} // anonymous namespace
+
+full_reader::full_reader() = default;
+full_reader::~full_reader() = default;
+full_reader::full_reader(full_reader&&) noexcept = default;
+full_reader& full_reader::operator=(full_reader&&) noexcept = default;
+
+result<full_reader> full_reader::open(std::filesystem::path path) {
+    std::error_code ec;
+    auto const what = fs::status(path, ec);
+    if (ec && what.type() != fs::file_type::not_found) {
+        return std::unexpected(error_code::catalog_unreadable);
+    }
+    if ( ! fs::is_directory(what)) return std::unexpected(error_code::database_not_found);
+
+    // Held to this build exactly as a writer's open holds it.
+    auto const config_path = path / "utxoz_config.dat";
+    auto const config_exists = detail::path_exists(config_path);
+    if ( ! config_exists) return std::unexpected(config_exists.error());
+    if ( ! *config_exists) return std::unexpected(error_code::database_not_found);
+    auto const config = detail::read_config_file(config_path);
+    if ( ! config) return std::unexpected(config.error());
+    if (auto const usable = detail::check_config_compatible(*config, config_path); ! usable) {
+        return std::unexpected(usable.error());
+    }
+    if (config->mode != storage_mode::full) return std::unexpected(error_code::storage_mode_mismatch);
+
+    auto board = detail::reader_board_view::open(path);
+    if ( ! board) return std::unexpected(board.error());
+
+    full_reader reader;
+    reader.impl_ = std::make_unique<reader_impl>(reader_impl{std::move(path), std::move(*board), {}});
+    if (auto const followed = refresh_impl(*reader.impl_); ! followed) {
+        return std::unexpected(followed.error());
+    }
+    return reader;
+}
+
+void full_reader::close() {
+    impl_.reset();
+}
+
+result<full_find_result> full_reader::find(raw_outpoint const& key) {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    auto found = lookup(*impl_, key);
+    if ( ! found) return std::unexpected(found.error());
+    if ( ! *found) return std::unexpected(error_code::not_found);
+    return std::move(**found);
+}
+
+result<full_resolution> full_reader::resolve(std::span<lookup_request const> requests) {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+
+    full_resolution resolution;
+    boost::unordered_flat_set<raw_outpoint> seen;
+    seen.reserve(requests.size());
+    for (auto const& request : requests) {
+        if ( ! seen.insert(request.key).second) continue;
+        auto found = lookup(*impl_, request.key);
+        if ( ! found) return std::unexpected(found.error());
+        if (*found) resolution.found.emplace(request.key, std::move(**found));
+        else        resolution.absent.push_back(request);
+    }
+    return resolution;
+}
+
+result<> full_reader::refresh() {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    return refresh_impl(*impl_);
+}
+
+size_t full_reader::generations() const noexcept {
+    if ( ! impl_) return 0;
+    size_t count = 0;
+    for_each_class([&](auto I) {
+        count += std::get<I.value>(impl_->classes).generations.size();
+        return true;
+    });
+    return count;
+}
+
+uint64_t full_reader::layout() const noexcept {
+    return impl_ ? impl_->followed_layout : 0;
+}
+
+} // namespace utxoz
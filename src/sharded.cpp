@@ -0,0 +1,530 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file sharded.cpp
+ * @brief sharded_db — the partition, the shard-count record, and the fan-out.
+ */
+
+#include <utxoz/sharded.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "detail/database_impl.hpp"
+#include "detail/database_lock.hpp"
+#include "detail/durability.hpp"
+#include "detail/log.hpp"
+#include "detail/path_display.hpp"
+#include "detail/record_bytes.hpp"
+#include "detail/spread_over_threads.hpp"
+#include "detail/version_catalog.hpp"
+
+namespace utxoz {
+
+namespace detail {
+
+/// The claim on the set and the shards behind it. The claim is a member, not a
+/// local of open(), so it is released after the shards are closed, never before.
+struct sharded_impl {
+    fs::path root;
+    database_lock lock;
+    std::vector<full_db> shards;
+};
+
+namespace {
+
+/**
+ * `utxoz_shards.dat`, in the encoding every record here shares:
+ *
+ * ```
+ *  0   4  magic "UTXS"
+ *  4   4  format, 1
+ *  8   4  shard count
+ * 12   4  checksum
+ * ```
+ */
+constexpr std::array<char, 4> shards_magic{'U', 'T', 'X', 'S'};
+constexpr uint32_t shards_format = 1;
+constexpr size_t shards_encoded_size = 16;
+constexpr char const* shards_file_name = "utxoz_shards.dat";
+
+fs::path shard_directory(fs::path const& root, size_t index) {
+    return root / fmt::format("shard_{:02}", index);
+}
+
+[[nodiscard]]
+result<uint32_t> read_shard_count(fs::path const& path) {
+    using namespace record_bytes;
+
+    std::error_code ec;
+    auto const status = fs::status(path, ec);
+    if (ec || ! fs::is_regular_file(status)) {
+        return std::unexpected(error_code::config_file_corrupt);
+    }
+    auto const size = fs::file_size(path, ec);
+    if (ec || size != shards_encoded_size) {
+        return std::unexpected(error_code::config_file_corrupt);
+    }
+
+    std::ifstream ifs(path, std::ios::binary);
+    if ( ! ifs) return std::unexpected(error_code::config_file_corrupt);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(ifs)),
+                               std::istreambuf_iterator<char>());
+    if (ifs.bad() || bytes.size() != shards_encoded_size) {
+        return std::unexpected(error_code::config_file_corrupt);
+    }
+    if ( ! std::equal(shards_magic.begin(), shards_magic.end(), bytes.begin())) {
+        return std::unexpected(error_code::config_file_corrupt);
+    }
+
+    auto const* cursor = bytes.data() + shards_magic.size();
+    uint32_t format = 0;
+    uint32_t count = 0;
+    uint32_t stored = 0;
+    get(cursor, format);
+    get(cursor, count);
+    get(cursor, stored);
+
+    auto const covered = std::span<uint8_t const>(bytes.data(), shards_encoded_size - sizeof(stored));
+    if (stored != checksum(covered)) return std::unexpected(error_code::config_file_corrupt);
+    if (format != shards_format) {
+        log::error("{}: shard record format {} is not one this build knows",
+                   path_display(path), format);
+        return std::unexpected(error_code::format_unsupported);
+    }
+    return count;
+}
+
+/// Published the way the config is: contents made durable under a temporary
+/// name, moved onto the real one, then the directory entry. A crash anywhere
+/// before the move leaves no record, and a root with no record has no shards
+/// either, because none is created until this returns.
+[[nodiscard]]
+result<> write_shard_count(fs::path const& root, uint32_t count) {
+    using namespace record_bytes;
+
+    auto const path = root / shards_file_name;
+    auto const temp_path = fs::path(path).concat(".tmp");
+
+    std::vector<uint8_t> encoded;
+    encoded.reserve(shards_encoded_size);
+    encoded.insert(encoded.end(), shards_magic.begin(), shards_magic.end());
+    put(encoded, shards_format);
+    put(encoded, count);
+    put(encoded, checksum(std::span<uint8_t const>(encoded)));
+
+    {
+        std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<char const*>(encoded.data()),
+                  static_cast<std::streamsize>(encoded.size()));
+        ofs.close();
+        if (ofs.fail()) {
+            std::error_code cleanup;
+            fs::remove(temp_path, cleanup);
+            log::error("Failed to write the shard record: {}", path_display(temp_path));
+            return std::unexpected(error_code::config_file_corrupt);
+        }
+    }
+
+    auto barrier = [](result<> outcome) -> result<> {
+        if ( ! outcome && outcome.error() == error_code::sync_unsupported) return {};
+        return outcome;
+    };
+    if (auto const synced = barrier(sync_file(temp_path)); ! synced) {
+        std::error_code cleanup;
+        fs::remove(temp_path, cleanup);
+        return synced;
+    }
+    if (auto const replaced = replace_file_atomically(temp_path, path); ! replaced) {
+        std::error_code cleanup;
+        fs::remove(temp_path, cleanup);
+        log::error("Could not publish the shard record: {}", path_display(path));
+        return replaced;
+    }
+    return barrier(sync_directory(root));
+}
+
+/**
+ * @brief Runs `work(i)` for every i below `count`, on up to `threads` threads.
+ *
+ * spread_over_threads() with nothing that stops early: every shard gets its
+ * share. The first exception by index is rethrown once every worker has
+ * joined, which is where a single database would have thrown it.
+ */
+template <typename Work>
+void on_each_shard(size_t count, size_t threads, Work&& work) {
+    spread_over_threads(count, threads, "sharded", [&](size_t i) {
+        work(i);
+        return true;
+    });
+}
+
+/// How many of `parts` have anything in them: the threads a batch can use.
+template <typename Part>
+size_t busy(std::vector<Part> const& parts) {
+    return size_t(std::count_if(parts.begin(), parts.end(),
+                                [](Part const& p) { return ! p.empty(); }));
+}
+
+/// Indices into a span, one list per shard, each in the order of the span.
+template <typename Request>
+std::vector<std::vector<size_t>> partition(std::span<Request const> requests, size_t shards) {
+    std::vector<std::vector<size_t>> parts(shards);
+    for (auto& part : parts) part.reserve(requests.size() / shards + 1);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        parts[sharded_db::shard_of(requests[i].key, shards)].push_back(i);
+    }
+    return parts;
+}
+
+[[nodiscard]]
+result<> refuse_count(fs::path const& root, size_t asked, size_t recorded) {
+    log::error("{}: a sharded database of {} shards cannot be opened as {}; the shard of "
+               "every key depends on the count", path_display(root), recorded, asked);
+    return std::unexpected(error_code::shard_count_mismatch);
+}
+
+} // anonymous namespace
+} // namespace detail
+
+// =============================================================================
+// Opening
+// =============================================================================
+
+sharded_db::sharded_db() = default;
+
+sharded_db::~sharded_db() {
+    close();
+}
+
+sharded_db::sharded_db(sharded_db&&) noexcept = default;
+
+sharded_db& sharded_db::operator=(sharded_db&& other) noexcept {
+    if (this != &other) {
+        close();
+        impl_ = std::move(other.impl_);
+    }
+    return *this;
+}
+
+namespace {
+
+template <typename OpenShard>
+result<> open_set(std::filesystem::path path, size_t shards, bool remove_existing,
+                            OpenShard&& open_shard, std::unique_ptr<detail::sharded_impl>& out) {
+    using namespace detail;
+
+    if (shards == 0 || shards > sharded_db::max_shards) {
+        log::error("{}: {} shards asked for; a set has 1 to {}", path_display(path), shards,
+                   sharded_db::max_shards);
+        return std::unexpected(error_code::shard_count_mismatch);
+    }
+
+    std::error_code ec;
+    fs::create_directories(path, ec);
+    if (ec) return std::unexpected(error_code::file_open_failed);
+
+    auto impl = std::make_unique<sharded_impl>();
+    impl->root = path;
+
+    // The set's own claim, before the record is read or written. Every shard
+    // takes its own as well, but a claim on shard 0 would not stop a second
+    // process from writing a different count over the first one's record.
+    auto claimed = database_lock::acquire(path);
+    if ( ! claimed) return std::unexpected(claimed.error());
+    impl->lock = std::move(*claimed);
+    impl->lock.record_holder();
+
+    if (remove_existing) {
+        // The children, not the root: see database_impl::configure() — removing
+        // the directory would unlink the file the claim is held on.
+        fs::directory_iterator it(path, ec);
+        if (ec) return std::unexpected(error_code::catalog_unreadable);
+        auto const end = fs::directory_iterator{};
+        while (it != end) {
+            if (it->path().filename() != database_lock::file_name) {
+                fs::remove_all(it->path(), ec);
+                if (ec) return std::unexpected(error_code::catalog_unreadable);
+            }
+            it.increment(ec);
+            if (ec) return std::unexpected(error_code::catalog_unreadable);
+        }
+    }
+
+    auto const record = path / shards_file_name;
+    auto const recorded = path_exists(record);
+    if ( ! recorded) return std::unexpected(recorded.error());
+
+    if (*recorded) {
+        auto const count = read_shard_count(record);
+        if ( ! count) return std::unexpected(count.error());
+        if (*count != shards) return refuse_count(path, shards, *count);
+    } else {
+        // No record, and something is here anyway. A plain database at the root
+        // is a set of one nobody recorded, and shard directories with no count
+        // beside them were not made by this code, which writes the count first.
+        auto const plain = path_exists(path / "utxoz_config.dat");
+        if ( ! plain) return std::unexpected(plain.error());
+        if (*plain) {
+            log::error("{}: holds an unsharded database", path_display(path));
+            return std::unexpected(error_code::shard_count_mismatch);
+        }
+        auto const stray = path_exists(shard_directory(path, 0));
+        if ( ! stray) return std::unexpected(stray.error());
+        if (*stray) {
+            log::error("{}: holds shard directories and no record of their count",
+                       path_display(path));
+            return std::unexpected(error_code::shard_count_mismatch);
+        }
+        if (auto const written = write_shard_count(path, uint32_t(shards)); ! written) {
+            return std::unexpected(written.error());
+        }
+    }
+
+    impl->shards.reserve(shards);
+    for (size_t i = 0; i < shards; ++i) {
+        auto opened = open_shard(shard_directory(path, i));
+        if ( ! opened) {
+            log::error("{}: shard {} did not open", path_display(path), i);
+            return std::unexpected(opened.error());
+        }
+        impl->shards.push_back(std::move(*opened));
+    }
+
+    out = std::move(impl);
+    return {};
+}
+
+} // anonymous namespace
+
+result<sharded_db> sharded_db::open(std::filesystem::path path, size_t shards,
+                                    bool remove_existing) {
+    sharded_db db;
+    auto r = open_set(std::move(path), shards, remove_existing,
+                      [](std::filesystem::path const& dir) { return full_db::open(dir); }, db.impl_);
+    if ( ! r) return std::unexpected(r.error());
+    return db;
+}
+
+result<sharded_db> sharded_db::open_for_testing(std::filesystem::path path, size_t shards,
+                                                bool remove_existing) {
+    sharded_db db;
+    auto r = open_set(std::move(path), shards, remove_existing,
+                      [](std::filesystem::path const& dir) { return full_db::open_for_testing(dir); },
+                      db.impl_);
+    if ( ! r) return std::unexpected(r.error());
+    return db;
+}
+
+void sharded_db::close() {
+    if ( ! impl_) return;
+    for (auto& shard : impl_->shards) shard.close();
+    impl_.reset();
+}
+
+// =============================================================================
+// The partition
+// =============================================================================
+
+size_t sharded_db::shard_of(raw_outpoint const& key, size_t shards) noexcept {
+    // Assembled byte by byte rather than loaded, so the answer does not depend
+    // on the byte order of the machine asking.
+    uint64_t h = 0;
+    for (size_t i = 0; i < 8; ++i) h |= uint64_t(key[8 + i]) << (8 * i);
+    uint32_t idx = 0;
+    for (size_t i = 0; i < 4; ++i) idx |= uint32_t(key[32 + i]) << (8 * i);
+
+    // The finaliser from MurmurHash3, so that every input bit reaches the low
+    // bits the modulo keeps.
+    h ^= uint64_t(idx) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return size_t(h % shards);
+}
+
+size_t sharded_db::shard_count() const noexcept {
+    return impl_ ? impl_->shards.size() : 0;
+}
+
+full_db& sharded_db::shard(size_t index) {
+    return impl_->shards.at(index);
+}
+
+full_db const& sharded_db::shard(size_t index) const {
+    return impl_->shards.at(index);
+}
+
+size_t sharded_db::size() const {
+    if ( ! impl_) return 0;
+    size_t total = 0;
+    for (auto const& shard : impl_->shards) total += shard.size();
+    return total;
+}
+
+// =============================================================================
+// Single keys
+// =============================================================================
+
+result<bool> sharded_db::insert(raw_outpoint const& key, output_data_span value, uint32_t height) {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    return impl_->shards[shard_of(key, impl_->shards.size())].insert(key, value, height);
+}
+
+result<full_find_result> sharded_db::find(raw_outpoint const& key, uint32_t height) const {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    return impl_->shards[shard_of(key, impl_->shards.size())].find(key, height);
+}
+
+// =============================================================================
+// Batches
+// =============================================================================
+
+insertion_progress sharded_db::insert_batch(std::span<insert_request const> requests) {
+    insertion_progress progress;
+    if ( ! impl_) {
+        progress.unapplied.assign(requests.begin(), requests.end());
+        progress.error = error_code::closed;
+        return progress;
+    }
+
+    auto const count = impl_->shards.size();
+    auto const parts = detail::partition(requests, count);
+
+    struct shard_outcome {
+        size_t inserted = 0;
+        std::vector<size_t> duplicates;
+        std::vector<size_t> unapplied;
+        std::optional<error_code> error;
+    };
+    std::vector<shard_outcome> outcomes(count);
+
+    detail::on_each_shard(count, detail::busy(parts), [&](size_t s) {
+        auto& db = impl_->shards[s];
+        auto& out = outcomes[s];
+        auto const& part = parts[s];
+        for (size_t n = 0; n < part.size(); ++n) {
+            auto const& request = requests[part[n]];
+            auto const stored = db.insert(request.key, request.value, request.height);
+            if ( ! stored) {
+                // This one and everything after it in the shard: a later insert
+                // could otherwise land before an earlier one it depends on —
+                // the second of two requests for one key reported as inserted.
+                out.error = stored.error();
+                out.unapplied.assign(part.begin() + std::ptrdiff_t(n), part.end());
+                return;
+            }
+            if (*stored) ++out.inserted;
+            else out.duplicates.push_back(part[n]);
+        }
+    });
+
+    // Back in the order of the span: each shard's lists are, and merging by
+    // index is what makes the whole of them so.
+    std::vector<size_t> duplicates;
+    std::vector<size_t> unapplied;
+    for (auto const& out : outcomes) {
+        progress.inserted += out.inserted;
+        duplicates.insert(duplicates.end(), out.duplicates.begin(), out.duplicates.end());
+        unapplied.insert(unapplied.end(), out.unapplied.begin(), out.unapplied.end());
+        if ( ! progress.error && out.error) progress.error = out.error;
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    std::sort(unapplied.begin(), unapplied.end());
+    progress.duplicates.reserve(duplicates.size());
+    for (auto const i : duplicates) progress.duplicates.push_back(requests[i]);
+    progress.unapplied.reserve(unapplied.size());
+    for (auto const i : unapplied) progress.unapplied.push_back(requests[i]);
+    return progress;
+}
+
+result<full_resolution> sharded_db::resolve(std::span<lookup_request const> requests) const {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+
+    auto const count = impl_->shards.size();
+    std::vector<std::vector<lookup_request>> parts(count);
+    for (auto const& request : requests) {
+        parts[shard_of(request.key, count)].push_back(request);
+    }
+
+    std::vector<std::optional<result<full_resolution>>> answers(count);
+    detail::on_each_shard(count, detail::busy(parts), [&](size_t s) {
+        answers[s] = impl_->shards[s].resolve(parts[s]);
+    });
+
+    full_resolution merged;
+    size_t found = 0;
+    for (auto const& answer : answers) {
+        if ( ! *answer) return std::unexpected(answer->error());
+        found += (*answer)->found.size();
+    }
+    merged.found.reserve(found);
+    for (auto& answer : answers) {
+        auto& r = **answer;
+        for (auto& [key, value] : r.found) merged.found.emplace(key, std::move(value));
+        merged.absent.insert(merged.absent.end(), r.absent.begin(), r.absent.end());
+    }
+    return merged;
+}
+
+deletion_progress sharded_db::apply_deletes(std::span<deferred_deletion_entry const> requests) {
+    if ( ! impl_) return detail::refuse_deletions(requests, error_code::closed);
+
+    auto const count = impl_->shards.size();
+    std::vector<std::vector<deferred_deletion_entry>> parts(count);
+    for (auto const& request : requests) {
+        parts[shard_of(request.key, count)].push_back(request);
+    }
+
+    std::vector<deletion_progress> outcomes(count);
+    detail::on_each_shard(count, detail::busy(parts), [&](size_t s) {
+        outcomes[s] = impl_->shards[s].apply_deletes(parts[s]);
+    });
+
+    deletion_progress merged;
+    for (auto& out : outcomes) {
+        merged.erased.insert(merged.erased.end(), out.erased.begin(), out.erased.end());
+        merged.absent.insert(merged.absent.end(), out.absent.begin(), out.absent.end());
+        merged.unresolved.insert(merged.unresolved.end(), out.unresolved.begin(),
+                                 out.unresolved.end());
+        if ( ! merged.error && out.error) merged.error = out.error;
+    }
+    return merged;
+}
+
+// =============================================================================
+// The set as a whole
+// =============================================================================
+
+result<> sharded_db::sync() {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    std::vector<result<>> outcomes(impl_->shards.size());
+    detail::on_each_shard(outcomes.size(), outcomes.size(), [&](size_t s) {
+        outcomes[s] = impl_->shards[s].sync();
+    });
+    for (auto const& outcome : outcomes) {
+        if ( ! outcome) return outcome;
+    }
+    return {};
+}
+
+result<> sharded_db::compact_all(compaction_concurrency const& concurrency) {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+    for (auto& shard : impl_->shards) {
+        if (auto const r = shard.compact_all(concurrency); ! r) return r;
+    }
+    return {};
+}
+
+} // namespace utxoz
@@ -0,0 +1,279 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file snapshot.cpp
+ * @brief full_snapshot: lookups and walks over pinned generations.
+ *
+ * Every read here takes its class's lock shared and checks the registry's
+ * `closed` under it. The writer's side — what it preserves, and when it moves a
+ * walk's cursor — is in snapshot_registry.hpp.
+ */
+
+#include <utxoz/snapshot.hpp>
+
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/unordered/unordered_flat_set.hpp>
+
+#include "detail/log.hpp"
+#include "detail/scope_exit.hpp"
+#include "detail/snapshot_registry.hpp"
+
+namespace utxoz {
+
+namespace {
+
+using detail::scope_exit;
+using detail::snapshot_state;
+
+/// Calls `f(std::integral_constant<size_t, I>{})` for every class, in order,
+/// until one returns false.
+template <typename F>
+bool for_each_class(F&& f) {
+    return [&]<size_t... Is>(std::index_sequence<Is...>) {
+        return (f(std::integral_constant<size_t, Is>{}) && ...);
+    }(std::make_index_sequence<container_count>{});
+}
+
+/// One class's answer for `key`. Under that class's lock, held shared.
+template <size_t Index>
+std::optional<full_find_result> find_in_class(snapshot_state const& state,
+                                              raw_outpoint const& key) {
+    auto const& c = state.cls<Index>();
+    if (auto const it = c.preserved.find(key); it != c.preserved.end()) {
+        return full_find_result{it->second.data, it->second.block_height};
+    }
+    for (auto const& gen : c.generations) {
+        if (auto const it = gen.map->find(key); it != gen.map->end()) {
+            auto const data = it->second.get_data();
+            return full_find_result{{data.begin(), data.end()}, it->second.block_height};
+        }
+    }
+    return std::nullopt;
+}
+
+/// A chunk of a walk, copied out under the lock and handed out after it.
+struct walk_chunk {
+    std::vector<raw_outpoint> keys;
+    std::vector<uint32_t> heights;
+    std::vector<size_t> ends;
+    std::vector<uint8_t> bytes;
+
+    void clear() {
+        keys.clear();
+        heights.clear();
+        ends.clear();
+        bytes.clear();
+    }
+
+    void add(raw_outpoint const& key, uint32_t height, std::span<uint8_t const> data) {
+        keys.push_back(key);
+        heights.push_back(height);
+        bytes.insert(bytes.end(), data.begin(), data.end());
+        ends.push_back(bytes.size());
+    }
+
+    template <typename Callback>
+    void deliver(Callback const& cb) const {
+        size_t begin = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            cb(keys[i], heights[i],
+               std::span<uint8_t const>(bytes.data() + begin, ends[i] - begin));
+            begin = ends[i];
+        }
+    }
+};
+
+/// Entries copied per hold of the lock. Large enough that the lock is not
+/// taken per entry, small enough that a spend waits for a memcpy and not for a
+/// generation.
+constexpr size_t walk_chunk_entries = 4096;
+
+} // anonymous namespace
+
+full_snapshot::full_snapshot(std::unique_ptr<detail::snapshot_state> state) noexcept
+    : impl_(std::move(state)) {}
+
+full_snapshot::~full_snapshot() = default;
+full_snapshot::full_snapshot(full_snapshot&&) noexcept = default;
+full_snapshot& full_snapshot::operator=(full_snapshot&&) noexcept = default;
+
+size_t full_snapshot::generations() const noexcept {
+    if ( ! impl_) return 0;
+    size_t count = 0;
+    for_each_class([&](auto I) {
+        count += impl_->cls<I.value>().generations.size();
+        return true;
+    });
+    return count;
+}
+
+size_t full_snapshot::size() const {
+    if ( ! impl_) return 0;
+    size_t count = 0;
+    for_each_class([&](auto I) {
+        std::shared_lock const reading(impl_->registry->class_locks[I.value]);
+        if (impl_->registry->closed) return false;
+        auto const& c = impl_->cls<I.value>();
+        count += c.preserved.size();
+        for (auto const& gen : c.generations) count += gen.map->size();
+        return true;
+    });
+    return count;
+}
+
+result<full_find_result> full_snapshot::find(raw_outpoint const& key) const {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+
+    std::optional<full_find_result> found;
+    bool closed = false;
+    for_each_class([&](auto I) {
+        std::shared_lock const reading(impl_->registry->class_locks[I.value]);
+        if (impl_->registry->closed) {
+            closed = true;
+            return false;
+        }
+        found = find_in_class<I.value>(*impl_, key);
+        return ! found;
+    });
+
+    if (closed) return std::unexpected(error_code::closed);
+    if ( ! found) return std::unexpected(error_code::not_found);
+    return std::move(*found);
+}
+
+result<full_resolution> full_snapshot::resolve(std::span<lookup_request const> requests) const {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+
+    // The first occurrence of each key, as full_db::resolve() keeps it.
+    std::vector<size_t> pending;
+    pending.reserve(requests.size());
+    {
+        boost::unordered_flat_set<raw_outpoint> seen;
+        seen.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (seen.insert(requests[i].key).second) pending.push_back(i);
+        }
+    }
+
+    full_resolution resolution;
+    bool closed = false;
+    for_each_class([&](auto I) {
+        if (pending.empty()) return false;
+        std::shared_lock const reading(impl_->registry->class_locks[I.value]);
+        if (impl_->registry->closed) {
+            closed = true;
+            return false;
+        }
+        size_t keep = 0;
+        for (auto const idx : pending) {
+            if (auto found = find_in_class<I.value>(*impl_, requests[idx].key)) {
+                resolution.found.emplace(requests[idx].key, std::move(*found));
+                continue;
+            }
+            pending[keep++] = idx;
+        }
+        pending.resize(keep);
+        return true;
+    });
+
+    if (closed) return std::unexpected(error_code::closed);
+    resolution.absent.reserve(pending.size());
+    for (auto const idx : pending) resolution.absent.push_back(requests[idx]);
+    return resolution;
+}
+
+result<> full_snapshot::for_each_entry_impl(
+        void(*cb)(void*, raw_outpoint const&, uint32_t, std::span<uint8_t const>), void* ctx) const {
+    if ( ! impl_) return std::unexpected(error_code::closed);
+
+    auto& state = *impl_;
+    std::lock_guard const one_walk(state.walk_mutex);
+    uint64_t const walk = ++state.walks;
+
+    result<> outcome;
+    walk_chunk chunk;
+
+    for_each_class([&](auto I) {
+        auto& lock = state.registry->class_locks[I.value];
+        auto& c = state.cls<I.value>();
+
+        {
+            std::shared_lock const reading(lock);
+            if (state.registry->closed) {
+                outcome = std::unexpected(error_code::closed);
+                return false;
+            }
+            c.walking = true;
+            c.walk = walk;
+            c.walk_generation = 0;
+            if ( ! c.generations.empty()) c.cursor = c.generations.front().map->begin();
+        }
+        // Whatever ends this class — the last chunk, a closed database or the
+        // callback raising — the writer stops reporting to a walk that is gone.
+        scope_exit const left([&] {
+            std::shared_lock const reading(lock);
+            c.walking = false;
+        });
+
+        bool last = false;
+        while ( ! last) {
+            chunk.clear();
+            {
+                std::shared_lock const reading(lock);
+                if (state.registry->closed) {
+                    outcome = std::unexpected(error_code::closed);
+                    return false;
+                }
+                if (c.walk_generation == c.generations.size()) {
+                    // Every file is behind us. What deletions took out of them
+                    // and the walk had not reached is all that is left.
+                    for (auto const& [key, entry] : c.preserved) {
+                        if (entry.handed_out_by != walk) {
+                            chunk.add(key, entry.block_height, entry.data);
+                        }
+                    }
+                    c.walking = false;
+                    last = true;
+                } else {
+                    auto const& map = *c.generations[c.walk_generation].map;
+                    for (size_t n = 0; n < walk_chunk_entries && c.cursor != map.end(); ++n, ++c.cursor) {
+                        chunk.add(c.cursor->first, c.cursor->second.block_height,
+                                  c.cursor->second.get_data());
+                    }
+                    if (c.cursor == map.end()) {
+                        ++c.walk_generation;
+                        if (c.walk_generation < c.generations.size()) {
+                            c.cursor = c.generations[c.walk_generation].map->begin();
+                        }
+                    }
+                }
+            }
+
+            // The callback is the caller's code and may raise; see
+            // full_db::for_each_entry().
+            try {
+                chunk.deliver([&](raw_outpoint const& key, uint32_t height,
+                                  std::span<uint8_t const> data) {
+                    cb(ctx, key, height, data);
+                });
+            } catch (std::exception const& e) {
+                log::error("snapshot for_each_entry: the callback raised over container {}: {}",
+                           I.value, e.what());
+                outcome = std::unexpected(error_code::file_open_failed);
+                return false;
+            }
+        }
+        return true;
+    });
+
+    return outcome;
+}
+
+} // namespace utxoz
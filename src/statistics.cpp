@@ -113,6 +113,11 @@ void resolution_stats::record_file_visited(bool cache_hit) noexcept {
     if (cache_hit) counters_.add(f_cache_hits, 1);
 }
 
+void resolution_stats::record_faults(uint64_t major, uint64_t minor) noexcept {
+    if (major != 0) counters_.add(f_major_faults, major);
+    if (minor != 0) counters_.add(f_minor_faults, minor);
+}
+
 void resolution_stats::reset() noexcept {
     counters_.reset();
 }
@@ -129,6 +134,8 @@ resolution_summary resolution_stats::get_summary() const noexcept {
     summary.absent = size_t(absent);
     summary.files_visited = size_t(files);
     summary.cache_hits = size_t(std::min(cache_hits, files));
+    summary.major_faults = size_t(counters_.sum(f_major_faults));
+    summary.minor_faults = size_t(counters_.sum(f_minor_faults));
 
     if (resolved > 0) {
         summary.avg_depth = double(depth_total) / double(resolved);
@@ -140,6 +147,58 @@ resolution_summary resolution_stats::get_summary() const noexcept {
     return summary;
 }
 
+// =============================================================================
+// latency_stats
+// =============================================================================
+
+void latency_stats::record(latency_op op, size_t slot, std::chrono::nanoseconds elapsed) noexcept {
+    auto const ns = uint64_t(std::max<int64_t>(elapsed.count(), 0));
+    switch (op) {
+        case latency_op::insert:        insert_[slot].record(ns); break;
+        case latency_op::find:          find_[slot].record(ns); break;
+        case latency_op::resolve:       resolve_.record(ns); break;
+        case latency_op::apply_deletes: apply_deletes_.record(ns); break;
+        case latency_op::rotation:      rotation_[slot].record(ns); break;
+        case latency_op::merge:         merge_[slot].record(ns); break;
+    }
+}
+
+void latency_stats::reset() noexcept {
+    for (auto& h : find_) h.reset();
+    resolve_.reset();
+    for (auto& h : insert_) h.reset();
+    for (auto& h : rotation_) h.reset();
+    for (auto& h : merge_) h.reset();
+    apply_deletes_.reset();
+}
+
+std::vector<latency_series> latency_stats::get_series(storage_mode mode) const {
+    // Reference mode has one class and records it in slot zero, as lookup_stats
+    // does; it is reported under reference_class so that it cannot be read as
+    // container 0.
+    size_t const classes = mode == storage_mode::reference ? 1 : container_count;
+    auto const label = [&](size_t slot) {
+        if (slot == unattributed) return unattributed_class;
+        return mode == storage_mode::reference ? reference_class : slot;
+    };
+
+    std::vector<latency_series> out;
+    auto const add = [&](latency_op op, size_t slot, auto const& histogram) {
+        auto& series = out.emplace_back();
+        series.op = op;
+        series.container_class = label(slot);
+        histogram.add_to(series);
+    };
+
+    for (size_t c = 0; c < classes; ++c) add(latency_op::insert, c, insert_[c]);
+    for (size_t c = 0; c < classes; ++c) add(latency_op::find, c, find_[c]);
+    add(latency_op::find, unattributed, find_[unattributed]);
+    add(latency_op::resolve, unattributed, resolve_);
+    add(latency_op::apply_deletes, unattributed, apply_deletes_);
+    for (size_t c = 0; c < classes; ++c) add(latency_op::rotation, c, rotation_[c]);
+    for (size_t c = 0; c < classes; ++c) add(latency_op::merge, c, merge_[c]);
+    return out;
+}
 
 #if UTXOZ_STATISTICS_LEVEL >= 2
 
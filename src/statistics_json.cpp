@@ -4,7 +4,7 @@
 
 /**
  * @file statistics_json.cpp
- * @brief The read-path telemetry, machine-readable.
+ * @brief The read-path telemetry and the latency histograms, machine-readable.
  *
  * Its own translation unit because `statistics.cpp` is compiled only when
  * statistics are enabled, and this has to exist either way: a build without
@@ -99,4 +99,50 @@ std::string to_json(lookup_telemetry const& t) {
     return out;
 }
 
+std::string to_json(latency_snapshot const& l) {
+    std::string out = "{\n";
+    out += fmt::format("  \"schema_version\": {},\n", latency_snapshot::schema_version);
+    out += fmt::format("  \"statistics_level\": \"{}\",\n", l.statistics_level);
+    out += fmt::format("  \"storage_mode\": \"{}\",\n",
+                       l.mode == storage_mode::reference ? "reference" : "full");
+    // Said once, here, rather than left to be guessed from the magnitudes.
+    out += "  \"unit\": \"ns\",\n";
+    out += "  \"quantiles_are\": \"the ceiling of the bucket the rank falls in\",\n";
+
+    out += "  \"series\": [\n";
+    for (size_t i = 0; i < l.series.size(); ++i) {
+        auto const& s = l.series[i];
+        out += fmt::format(R"(    {{"op": "{}", )", to_string(s.op));
+        if (s.container_class == reference_class) {
+            out += R"("container_class": "reference", )";
+        } else if (s.container_class == unattributed_class) {
+            out += R"("container_class": "unattributed", )";
+        } else {
+            out += fmt::format(R"("container_class": {}, )", s.container_class);
+        }
+        out += fmt::format(R"("sample_interval": {}, "count": {}, "mean": {:.1f}, )",
+                           latency_sample_interval_of(s.op), s.count, s.mean_ns());
+        out += fmt::format(R"("p50": {}, "p90": {}, "p99": {}, "p999": {}, "max": {}, )",
+                           s.percentile_ns(0.5), s.percentile_ns(0.9), s.percentile_ns(0.99),
+                           s.percentile_ns(0.999), s.percentile_ns(1.0));
+
+        // The buckets that counted anything, as [floor, ceiling, count]: enough
+        // to recompute any quantile, without 272 zeros per series.
+        out += R"("buckets": [)";
+        bool first = true;
+        for (size_t b = 0; b < latency_histogram::bucket_count; ++b) {
+            if (s.histogram.counts[b] == 0) continue;
+            out += fmt::format("{}[{}, {}, {}]", first ? "" : ", ",
+                               latency_histogram::bucket_floor(b),
+                               latency_histogram::bucket_ceiling(b), s.histogram.counts[b]);
+            first = false;
+        }
+        out += "]}";
+        out += (i + 1 < l.series.size()) ? ",\n" : "\n";
+    }
+    out += "  ]\n";
+    out += "}\n";
+    return out;
+}
+
 } // namespace utxoz
@@ -0,0 +1,334 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file statistics_openmetrics.cpp
+ * @brief The statistics as OpenMetrics text, for a Prometheus scrape.
+ *
+ * Compiled in every build for the reason `statistics_json.cpp` is: with
+ * statistics off the exposition still exists, says `statistics_level="off"`, and
+ * carries the figures every build keeps — entries, rotations and their causes,
+ * the group commit. A scrape that failed to find the endpoint would be a worse
+ * answer than one that found zeros and was told why.
+ *
+ * The names are the interface. A dashboard or an alert is written against them,
+ * so they change only with the meaning of what they count, and never to tidy up.
+ * Every family is emitted whether or not it moved, with a `class` label from a
+ * fixed set — "0" to "4", "reference", "unattributed" — so a series that is
+ * absent is absent because the build does not have it, not because nothing has
+ * happened yet.
+ *
+ * Written by hand with fmt, as the JSON is, so that the library takes no client
+ * library as a dependency.
+ */
+
+#include <utxoz/statistics.hpp>
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+
+namespace utxoz {
+
+namespace {
+
+std::string class_label(size_t container_class) {
+    if (container_class == reference_class) return "reference";
+    if (container_class == unattributed_class) return "unattributed";
+    return fmt::format("{}", container_class);
+}
+
+/**
+ * @brief Accumulates the text. One family at a time: OpenMetrics requires the
+ *        samples of a family to be contiguous, and writing the header and then
+ *        the samples is what keeps them so.
+ */
+class exposition {
+public:
+    void family(std::string_view name, std::string_view type, std::string_view help,
+                std::string_view unit = {}) {
+        out_ += fmt::format("# TYPE {} {}\n", name, type);
+        if ( ! unit.empty()) out_ += fmt::format("# UNIT {} {}\n", name, unit);
+        out_ += fmt::format("# HELP {} {}\n", name, help);
+    }
+
+    template <typename Value>
+    void sample(std::string_view name, std::string_view labels, Value value) {
+        if (labels.empty()) {
+            out_ += fmt::format("{} {}\n", name, value);
+        } else {
+            out_ += fmt::format("{}{{{}}} {}\n", name, labels, value);
+        }
+    }
+
+    /**
+     * A log_histogram as cumulative buckets. Only at the top of each power of
+     * two: every log_histogram bucket boundary falls on one, so each is an exact
+     * count, and a fixed set of `le` from scrape to scrape is what lets the
+     * server aggregate them. `scale` turns a recorded unit into the exposed one.
+     */
+    template <unsigned ValueBits, unsigned SubBucketBits>
+    void histogram(std::string_view name, std::string_view labels,
+                   log_histogram<ValueBits, SubBucketBits> const& h, double scale, double sum) {
+        using histogram_type = log_histogram<ValueBits, SubBucketBits>;
+        auto const sep = labels.empty() ? "" : ",";
+        uint64_t seen = 0;
+        for (size_t b = 0; b < histogram_type::bucket_count; ++b) {
+            seen += h.counts[b];
+            auto const ceiling = histogram_type::bucket_ceiling(b);
+            if (ceiling + 1 < histogram_type::sub_buckets) continue;
+            if ( ! std::has_single_bit(ceiling + 1) && b + 1 != histogram_type::bucket_count) continue;
+            out_ += fmt::format("{}_bucket{{{}{}le=\"{}\"}} {}\n", name, labels, sep,
+                                double(ceiling) * scale, seen);
+        }
+        out_ += fmt::format("{}_bucket{{{}{}le=\"+Inf\"}} {}\n", name, labels, sep, seen);
+        sample(fmt::format("{}_count", name), labels, seen);
+        sample(fmt::format("{}_sum", name), labels, sum);
+    }
+
+    std::string finish() && {
+        out_ += "# EOF\n";
+        return std::move(out_);
+    }
+
+private:
+    std::string out_;
+};
+
+/// The per-class read-path buckets, 1, 2, 3, 4, 5-8 and 9+, as cumulative `le`.
+void lookup_histogram(exposition& e, std::string_view name, std::string_view labels,
+                      std::array<size_t, 6> const& buckets, double average) {
+    constexpr char const* upper[] = {"1", "2", "3", "4", "8", "+Inf"};
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        e.sample(fmt::format("{}_bucket", name), fmt::format("{},le=\"{}\"", labels, upper[i]), seen);
+    }
+    e.sample(fmt::format("{}_count", name), labels, seen);
+    e.sample(fmt::format("{}_sum", name), labels, average * double(seen));
+}
+
+} // namespace
+
+std::string to_openmetrics(database_statistics const& s, latency_snapshot const& latency) {
+    exposition e;
+    bool const reference = s.mode == storage_mode::reference;
+    size_t const classes = reference ? 1 : container_count;
+    auto const label_of = [&](size_t c) {
+        return fmt::format("class=\"{}\"", class_label(reference ? reference_class : c));
+    };
+
+    e.family("utxoz_build", "info", "What this build counts and how the database stores.");
+    e.sample("utxoz_build_info",
+             fmt::format("statistics_level=\"{}\",storage_mode=\"{}\"",
+                         s.lookups.statistics_level, reference ? "reference" : "full"),
+             1);
+
+    // ---- Entries and classes ----------------------------------------------
+
+    e.family("utxoz_entries", "gauge", "Entries stored, every class and generation.");
+    e.sample("utxoz_entries", "", s.total_entries);
+
+    e.family("utxoz_class_entries", "gauge", "Entries in the active generation of a class.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_class_entries", label_of(c), s.containers[c].current_size);
+
+    e.family("utxoz_inserts", "counter", "Entries inserted.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_inserts_total", label_of(c), s.containers[c].total_inserts);
+
+    e.family("utxoz_deletes", "counter", "Entries erased from an active generation.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_deletes_total", label_of(c), s.containers[c].total_deletes);
+
+    e.family("utxoz_failed_deletes", "counter", "Deletions a class could not apply.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_failed_deletes_total", label_of(c), s.containers[c].failed_deletes);
+
+    e.family("utxoz_rehashes", "counter", "Times an active map grew its table.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_rehashes_total", label_of(c), s.containers[c].rehash_count);
+
+    e.family("utxoz_class_bytes", "gauge", "Size of a class's files, active and sealed.", "bytes");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_class_bytes", label_of(c), s.memory_usage_per_container[c]);
+
+    // Only where it was computed: a fill of zero would read as an empty file.
+    if ( ! reference && s.lookups.statistics_level != "off") {
+        e.family("utxoz_active_fill_ratio", "gauge", "Share of the active generation's file allocated.");
+        for (size_t c = 0; c < classes; ++c) {
+            e.sample("utxoz_active_fill_ratio", label_of(c), s.fragmentation.fill_ratios[c]);
+        }
+    }
+
+    // ---- Rotations ---------------------------------------------------------
+
+    e.family("utxoz_active_generation", "gauge", "Version number of a class's active generation.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_active_generation", label_of(c), s.rotations_per_container[c]);
+
+    e.family("utxoz_rotations", "counter", "Completed rotations, by cause.");
+    for (size_t c = 0; c < classes; ++c) {
+        auto const& r = s.rotations_by_cause[c];
+        auto const l = label_of(c);
+        e.sample("utxoz_rotations_total", fmt::format("{},cause=\"preventive\"", l), r.preventive);
+        e.sample("utxoz_rotations_total", fmt::format("{},cause=\"capacity_exception\"", l), r.capacity_exception);
+        e.sample("utxoz_rotations_total", fmt::format("{},cause=\"snapshot\"", l), r.snapshot);
+    }
+
+    e.family("utxoz_rotation_failures", "counter",
+             "Rotations asked for and not made. Not part of utxoz_rotations.");
+    for (size_t c = 0; c < classes; ++c) e.sample("utxoz_rotation_failures_total", label_of(c), s.rotations_by_cause[c].failed);
+
+    e.family("utxoz_unexpected_post_exception", "counter",
+             "Maps that contradicted their guarantee after a failed allocation.");
+    for (size_t c = 0; c < classes; ++c) {
+        e.sample("utxoz_unexpected_post_exception_total", label_of(c),
+                 s.rotations_by_cause[c].unexpected_post_exception);
+    }
+
+    // ---- Read path ---------------------------------------------------------
+    //
+    // lookup_telemetry's three unattributed figures are these two families:
+    // received is answered plus deferred, and absent is the resolve outcome.
+
+    e.family("utxoz_finds", "counter", "find() calls, by whether an active map answered.");
+    e.sample("utxoz_finds_total", "outcome=\"answered\"", s.probes.answered_from_active);
+    e.sample("utxoz_finds_total", "outcome=\"deferred\"", s.probes.deferred);
+
+    e.family("utxoz_resolved_keys", "counter", "Keys a resolution settled, by outcome.");
+    e.sample("utxoz_resolved_keys_total", "outcome=\"resolved\"", s.resolution.resolved);
+    e.sample("utxoz_resolved_keys_total", "outcome=\"absent\"", s.resolution.absent);
+
+    e.family("utxoz_resolve_files", "counter", "Generation files a resolution worked against.");
+    e.sample("utxoz_resolve_files_total", "", s.resolution.files_visited);
+
+    e.family("utxoz_resolve_file_cache_hits", "counter", "Of those, served by the file cache.");
+    e.sample("utxoz_resolve_file_cache_hits_total", "", s.resolution.cache_hits);
+
+    // Only where they are counted. Zeros from a platform that cannot count
+    // per thread would read as a store that never touches the disk.
+    if (page_faults_counted) {
+        e.family("utxoz_resolve_page_faults", "counter",
+                 "Page faults completed resolutions took, by kind.");
+        e.sample("utxoz_resolve_page_faults_total", "kind=\"major\"", s.resolution.major_faults);
+        e.sample("utxoz_resolve_page_faults_total", "kind=\"minor\"", s.resolution.minor_faults);
+    }
+
+    e.family("utxoz_file_cache_hit_ratio", "gauge", "File cache hits over lookups, since open.");
+    e.sample("utxoz_file_cache_hit_ratio", "", double(s.cache_hit_rate));
+
+    e.family("utxoz_file_cache_files", "gauge", "Generation files the cache holds mapped.");
+    e.sample("utxoz_file_cache_files", "", s.cached_files_count);
+
+    // Per class only where it was collected, at `lookup`. Five families of
+    // zeros at `basic` would read as a database nobody queried.
+    if ( ! s.lookups.classes.empty()) {
+        using field = size_t class_lookup_summary::*;
+        struct counter { char const* name; char const* help; field value; };
+        constexpr counter counters[] = {
+            {"utxoz_lookup_active_probes", "Times find() asked this class's active map.",
+             &class_lookup_summary::active_maps_probed},
+            {"utxoz_lookup_answered_active", "Lookups this class's active map answered.",
+             &class_lookup_summary::answered_from_active},
+            {"utxoz_lookup_resolved_historical", "Keys a sweep answered from this class's history.",
+             &class_lookup_summary::resolved_historical},
+            {"utxoz_lookup_generations_probed", "Key-against-file probes charged to this class.",
+             &class_lookup_summary::generations_probed},
+            {"utxoz_lookup_files_opened", "Files a sweep worked against in this class.",
+             &class_lookup_summary::files_opened},
+            {"utxoz_lookup_file_cache_hits", "Of those, served by the file cache.",
+             &class_lookup_summary::cache_hits},
+        };
+        for (auto const& k : counters) {
+            e.family(k.name, "counter", k.help);
+            auto const total = fmt::format("{}_total", k.name);
+            for (auto const& c : s.lookups.classes) {
+                e.sample(total, fmt::format("class=\"{}\"", class_label(c.container_class)), c.*k.value);
+            }
+        }
+
+        e.family("utxoz_lookup_probe_ordinal", "histogram",
+                 "File probes a key answered from history took.");
+        for (auto const& c : s.lookups.classes) {
+            lookup_histogram(e, "utxoz_lookup_probe_ordinal",
+                             fmt::format("class=\"{}\"", class_label(c.container_class)),
+                             c.probe_ordinal_histogram, c.avg_probe_ordinal);
+        }
+        e.family("utxoz_lookup_version_distance", "histogram",
+                 "Generations back from the active one a key was answered.");
+        for (auto const& c : s.lookups.classes) {
+            lookup_histogram(e, "utxoz_lookup_version_distance",
+                             fmt::format("class=\"{}\"", class_label(c.container_class)),
+                             c.version_distance_histogram, c.avg_version_distance);
+        }
+    }
+
+    // ---- Deletions and lifetimes -------------------------------------------
+
+    e.family("utxoz_deletions", "counter", "Deletions apply_deletes() settled, by outcome.");
+    e.sample("utxoz_deletions_total", "outcome=\"applied\"", s.deferred.successfully_processed);
+    e.sample("utxoz_deletions_total", "outcome=\"failed\"", s.deferred.failed_to_delete);
+
+    e.family("utxoz_deletion_runs", "counter", "apply_deletes() calls that processed a batch.");
+    e.sample("utxoz_deletion_runs_total", "", s.deferred.processing_runs);
+
+    e.family("utxoz_deletion_processing_seconds", "counter",
+             "Time spent applying deletions.", "seconds");
+    e.sample("utxoz_deletion_processing_seconds_total", "",
+             std::chrono::duration<double>(s.deferred.total_processing_time).count());
+
+    if (page_faults_counted) {
+        e.family("utxoz_deletion_page_faults", "counter",
+                 "Page faults taken applying deletions, by kind.");
+        e.sample("utxoz_deletion_page_faults_total", "kind=\"major\"", s.deferred.major_faults);
+        e.sample("utxoz_deletion_page_faults_total", "kind=\"minor\"", s.deferred.minor_faults);
+    }
+
+    e.family("utxoz_spent_age_blocks", "histogram",
+             "Blocks between an entry's creation and its spend.", "blocks");
+    e.histogram("utxoz_spent_age_blocks", "", s.lifetime.age_distribution, 1.0,
+                double(s.lifetime.total_age));
+
+    // ---- Group commit ------------------------------------------------------
+
+    auto const& g = s.group_commit;
+    e.family("utxoz_group_commit_requests", "counter", "sync_async() calls handed to the flusher.");
+    e.sample("utxoz_group_commit_requests_total", "", g.requests);
+    e.family("utxoz_group_commit_completed", "counter", "Of those, answered.");
+    e.sample("utxoz_group_commit_completed_total", "", g.completed);
+    e.family("utxoz_group_commit_flushes", "counter", "Rounds of barriers that answered them.");
+    e.sample("utxoz_group_commit_flushes_total", "", g.flushes);
+    e.family("utxoz_group_commit_failed_flushes", "counter", "Rounds that failed.");
+    e.sample("utxoz_group_commit_failed_flushes_total", "", g.failed_flushes);
+    e.family("utxoz_group_commit_files_synced", "counter", "File barriers, summed over the rounds.");
+    e.sample("utxoz_group_commit_files_synced_total", "", g.files_synced);
+    e.family("utxoz_group_commit_wait_seconds", "counter",
+             "Time answered requests waited, summed.", "seconds");
+    e.sample("utxoz_group_commit_wait_seconds_total", "",
+             std::chrono::duration<double>(g.total_latency).count());
+
+    // ---- Latency -----------------------------------------------------------
+
+    if ( ! latency.series.empty()) {
+        e.family("utxoz_operation_latency_seconds", "histogram",
+                 "Time an operation took. insert and find are sampled; see "
+                 "utxoz_operation_latency_sample_interval.", "seconds");
+        for (auto const& l : latency.series) {
+            e.histogram("utxoz_operation_latency_seconds",
+                        fmt::format("class=\"{}\",op=\"{}\"", class_label(l.container_class),
+                                    to_string(l.op)),
+                        l.histogram, 1e-9, double(l.total_ns) * 1e-9);
+        }
+
+        e.family("utxoz_operation_latency_sample_interval", "gauge",
+                 "One call in this many is timed.");
+        for (size_t op = 0; op < latency_op_count; ++op) {
+            auto const which = latency_op(op);
+            e.sample("utxoz_operation_latency_sample_interval",
+                     fmt::format("op=\"{}\"", to_string(which)), latency_sample_interval_of(which));
+        }
+    }
+
+    return std::move(e).finish();
+}
+
+} // namespace utxoz
@@ -0,0 +1,55 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file trace.cpp
+ * @brief Trace events as Chrome trace-event JSON.
+ *
+ * Written by hand with fmt, as the statistics' JSON is. Every string in it is
+ * one of ours — a kind's name, a class label — so nothing needs escaping.
+ */
+
+#include <utxoz/trace.hpp>
+
+#include <string>
+
+#include <fmt/format.h>
+
+namespace utxoz {
+
+namespace {
+
+std::string class_label(size_t container_class) {
+    if (container_class == reference_class) return "reference";
+    if (container_class == unattributed_class) return "unattributed";
+    return fmt::format("{}", container_class);
+}
+
+/// Microseconds with the nanoseconds kept, which is what the format's `ts` and
+/// `dur` are.
+std::string micros(uint64_t ns) {
+    return fmt::format("{}.{:03}", ns / 1000, ns % 1000);
+}
+
+} // namespace
+
+std::string to_chrome_trace(trace_capture const& capture) {
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    for (auto const& e : capture.events) {
+        if ( ! first) out += ',';
+        first = false;
+        out += fmt::format(
+            "\n{{\"name\":\"{}\",\"cat\":\"utxoz\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+            "\"ts\":{},\"dur\":{},\"args\":{{\"class\":\"{}\",\"version\":{},"
+            "\"bytes\":{},\"items\":{},\"files\":{},\"failed\":{}}}}}",
+            to_string(e.kind), e.thread, micros(e.start_ns), micros(e.duration_ns),
+            class_label(e.container_class), e.version, e.bytes, e.items, e.files, e.failed);
+    }
+    out += fmt::format("\n],\"displayTimeUnit\":\"ms\",\"otherData\":{{\"overwritten\":{}}}}}\n",
+                       capture.overwritten);
+    return out;
+}
+
+} // namespace utxoz
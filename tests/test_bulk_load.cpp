@@ -0,0 +1,159 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_bulk_load.cpp
+ * @brief The order a merge places its entries in changes how the target is
+ *        written and nothing about what it holds.
+ *
+ * The placement order is a performance property, so what is pinned here is the
+ * absence of any other: a merge placed in target order and one placed in source
+ * order leave the same entries, and a duplicate key is still reported as one.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+#include "detail/bulk_load.hpp"
+#include "detail/durability.hpp"
+
+using utxoz::detail::failpoints;
+
+namespace {
+
+inline std::atomic<uint64_t> bl_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_bl_{}_{}_{}_{}", tag, getpid(), ts, bl_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    return key;
+}
+
+std::vector<uint8_t> make_value(size_t size, uint8_t seed) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), seed);
+    return v;
+}
+
+using entry = std::tuple<utxoz::raw_outpoint, uint32_t, std::vector<uint8_t>>;
+
+/// Three generations of class 0, each holding `per_generation` entries, then
+/// compacted. Returns every entry the database holds afterwards, sorted.
+std::vector<entry> merged_contents(size_t per_generation) {
+    auto const path = make_unique_path("merge");
+    std::filesystem::remove_all(path);
+
+    std::vector<entry> out;
+    {
+        auto r = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+
+        uint64_t next = 0;
+        for (size_t g = 0; g < 3; ++g) {
+            for (size_t i = 0; i < per_generation; ++i, ++next) {
+                REQUIRE(db.insert(make_key(next), make_value(33, uint8_t(next)),
+                                  uint32_t(100 + next)).has_value());
+            }
+            if (g < 2) failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        }
+        REQUIRE(db.compact_all().has_value());
+
+        (void)db.for_each_entry([&](utxoz::raw_outpoint const& k, uint32_t height,
+                                    std::span<uint8_t const> data) {
+            out.emplace_back(k, height, std::vector<uint8_t>(data.begin(), data.end()));
+        });
+        db.close();
+    }
+    std::filesystem::remove_all(path);
+
+    std::ranges::sort(out);
+    return out;
+}
+
+} // anonymous namespace
+
+TEST_CASE("the placement order is the order of the mixed hash", "[compaction][bulk]") {
+    std::map<utxoz::raw_outpoint, int> a;
+    std::map<utxoz::raw_outpoint, int> b;
+    for (uint64_t i = 0; i < 500; ++i) a.emplace(make_key(i), 0);
+    for (uint64_t i = 500; i < 800; ++i) b.emplace(make_key(i), 1);
+
+    auto const order = utxoz::detail::placement_order(
+        std::vector<std::map<utxoz::raw_outpoint, int> const*>{&a, &b});
+
+    REQUIRE(order.size() == 800);
+    CHECK(std::ranges::is_sorted(order, {}, [](auto const& p) { return p.hash; }));
+    CHECK(std::ranges::all_of(order, [](auto const& p) {
+        return p.hash == utxoz::detail::placement_hash(p.entry->first);
+    }));
+}
+
+TEST_CASE("placed in target order or in source order, a merge holds the same entries",
+          "[database][compaction][bulk]") {
+    failpoints::scoped_reset const disarm;
+
+    auto const ordered = merged_contents(2'000);
+
+    failpoints::streaming_merge.store(true, std::memory_order_relaxed);
+    auto const streamed = merged_contents(2'000);
+
+    REQUIRE(ordered.size() == 6'000);
+    CHECK(ordered == streamed);
+}
+
+TEST_CASE("a duplicate key is reported when the entries are placed in target order",
+          "[database][compaction][bulk]") {
+    failpoints::scoped_reset const disarm;
+    auto const path = make_unique_path("dup");
+    std::filesystem::remove_all(path);
+
+    {
+        auto r = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+
+        // Insert only checks the active map, so after a rotation the same key
+        // can be stored a second time; compaction is where that is noticed.
+        auto const key = make_key(42);
+        for (uint64_t i = 0; i < 100; ++i) {
+            REQUIRE(db.insert(make_key(1'000 + i), make_value(33, 1), 100).has_value());
+        }
+        REQUIRE(db.insert(key, make_value(33, 1), 100).has_value());
+        failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        REQUIRE(db.insert(make_key(7), make_value(33, 1), 100).has_value());
+        REQUIRE(db.insert(key, make_value(33, 2), 101).has_value());
+
+        auto const compacted = db.compact_all();
+        REQUIRE( ! compacted.has_value());
+        CHECK(compacted.error() == utxoz::error_code::duplicate_key);
+        db.close();
+    }
+
+    std::filesystem::remove_all(path);
+}
@@ -835,6 +835,171 @@ TEST_CASE("a compacted target may sit above the operating threshold, and the nex
     CHECK(rehashes_observed.load(std::memory_order_relaxed) == before);
 }
 
+// =============================================================================
+// A target sized to what it holds
+// =============================================================================
+
+TEST_CASE("a fitted target is the smallest step that does not grow, never above the "
+          "configured one", "[capacity][fitted]") {
+    for (auto const& configured : {production_capacity[0], production_capacity[3],
+                                   testing_capacity[0], production_reference}) {
+        for (unsigned k = 0; bucket_step(k) < configured.bucket_count; ++k) {
+            auto const step = bucket_step(k);
+            INFO("configured " << configured.bucket_count << ", step " << step);
+
+            // At the growth point of a step, that step; one past it, the next.
+            auto const at = fitted_capacity(configured, max_size_without_rehash(step));
+            CHECK(at.bucket_count == step);
+            CHECK(at.capacity == step);
+            CHECK(at.file_size <= configured.file_size);
+            CHECK(fitted_capacity(configured, max_size_without_rehash(step) + 1).bucket_count
+                  == std::min(next_bucket_step(step), configured.bucket_count));
+
+            // Never below its share of the configured file, which is where the
+            // measured margin lives.
+            uint64_t const share = uint64_t(configured.file_size) / (configured.bucket_count + 1)
+                                 * (step + 1);
+            CHECK(uint64_t(at.file_size) >= std::min<uint64_t>(share, configured.file_size));
+
+            // And the file says which step it was made for: this one, or one
+            // that rounds to the same length and takes at least as much.
+            auto const read_back = bucket_count_of_file(configured, at.file_size, 0);
+            CHECK(read_back >= step);
+            CHECK(fitted_at_step(configured, read_back).file_size == at.file_size);
+        }
+        CHECK(fitted_capacity(configured, max_size_without_rehash(configured.bucket_count))
+              == configured);
+    }
+}
+
+TEST_CASE("a merge that takes in the active generation keeps the configured segment",
+          "[capacity][fitted]") {
+    // compact_all() merges the whole run, active generation included, so its
+    // target is the new active one. Fitted to its 3300 entries it would be
+    // bucket_step(8), which operates only to 3191: the next insert would rotate
+    // and every compaction would leave an undersized generation behind.
+    constexpr size_t index = 0;
+    std::vector<uint8_t> const value(utxoz::container_capacities[index], 0x3C);
+    auto const before = rehashes_observed.load(std::memory_order_relaxed);
+
+    temp_db t;
+    uint64_t n = 0;
+    {
+        failpoints::scoped_reset const disarm;
+        auto opened = utxoz::full_db::open_for_testing(t.dir, true);
+        REQUIRE(opened.has_value());
+        auto db = std::move(*opened);
+        for (int generation = 0; generation < 3; ++generation) {
+            for (int i = 0; i < 1'100; ++i) {
+                REQUIRE(db.insert(key_of(++n), value, 800000).has_value());
+            }
+            if (generation < 2) failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        }
+        REQUIRE(generations(t.dir, index) == 3);
+        REQUIRE(db.compact_all().has_value());
+        CHECK(db.size() == n);
+
+        REQUIRE(db.insert(key_of(++n), value, 800001).has_value());
+        CHECK(db.size() == n);
+        db.close();
+    }
+
+    REQUIRE(generations(t.dir, index) == 1);
+    size_t merged = 0;
+    for (size_t v = 0; v < max_versions_scanned; ++v) {
+        if (fs::exists(t.dir / fmt::format(data_file_format, index, v))) merged = v;
+    }
+    auto const [buckets, entries] = generation_of<index>(t.dir, merged);
+    CHECK(entries == 3'301);
+    CHECK(buckets == testing_capacity[index].bucket_count);
+    CHECK(fs::file_size(t.dir / fmt::format(data_file_format, index, merged))
+          == testing_capacity[index].file_size);
+    CHECK(rehashes_observed.load(std::memory_order_relaxed) == before);
+}
+
+TEST_CASE("a merge of sealed generations is sized to its entries", "[capacity][fitted]") {
+    constexpr size_t index = 0;
+    std::vector<uint8_t> const value(utxoz::container_capacities[index], 0x3C);
+    auto const before = rehashes_observed.load(std::memory_order_relaxed);
+
+    temp_db t;
+    uint64_t n = 0;
+    {
+        failpoints::scoped_reset const disarm;
+        auto opened = utxoz::full_db::open_for_testing(t.dir, true);
+        REQUIRE(opened.has_value());
+        auto db = std::move(*opened);
+        // Two sealed generations of 1100 and an active one of 3000, so that a
+        // fill threshold between them offers the sealed two and not the active
+        // one: 1100 and 3000 of the 107 519 the configured step takes.
+        for (int const count : {1'100, 1'100, 3'000}) {
+            for (int i = 0; i < count; ++i) {
+                REQUIRE(db.insert(key_of(++n), value, 800000).has_value());
+            }
+            if (count == 1'100) failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        }
+        REQUIRE(generations(t.dir, index) == 3);
+
+        utxoz::compaction_options options;
+        options.strategy = utxoz::compaction_strategy::tiered;
+        options.max_source_fill = 0.02;
+        auto const merged = db.compact(options);
+        REQUIRE(merged.has_value());
+        REQUIRE(merged->groups.size() == 1);
+        CHECK(merged->groups[0].sources.size() == 2);
+        CHECK(db.size() == n);
+
+        // The planner reads the target by its own table: 2200 of the 3359 its
+        // step takes is too full to be worth rewriting, where against the
+        // configured step it would look all but empty.
+        options.max_source_fill = 0.5;
+        auto const after = db.plan_compaction(options);
+        REQUIRE(after.has_value());
+        CHECK(after->generations_too_full == 1);
+        CHECK(after->groups.empty());
+
+        // The target took the next version, above the active generation, so
+        // the active one was carried back on top of it; the insert goes there
+        // and not into the fitted file. Reopened, it is still the active one.
+        REQUIRE(db.insert(key_of(++n), value, 800001).has_value());
+        db.close();
+
+        auto reopened = utxoz::full_db::open_for_testing(t.dir, false);
+        REQUIRE(reopened.has_value());
+        REQUIRE(reopened->insert(key_of(++n), value, 800002).has_value());
+        reopened->close();
+    }
+
+    // 2200 entries: bucket_step(8) takes 3359 without growing and the step below
+    // takes 1679. The active generation keeps the configured segment, and is
+    // the highest version.
+    REQUIRE(generations(t.dir, index) == 2);
+    size_t checked = 0;
+    size_t fitted_version = 0;
+    size_t active_version = 0;
+    for (size_t v = 0; v < max_versions_scanned; ++v) {
+        auto const path = t.dir / fmt::format(data_file_format, index, v);
+        if ( ! fs::exists(path)) continue;
+        auto const [buckets, entries] = generation_of<index>(t.dir, v);
+        INFO("version " << v << ", " << entries << " entries");
+        if (entries == 2'200) {
+            CHECK(buckets == bucket_step(8));
+            CHECK(fs::file_size(path) == fitted_capacity(testing_capacity[index], 2'200).file_size);
+            CHECK(fs::file_size(path) < testing_capacity[index].file_size);
+            fitted_version = v;
+        } else {
+            CHECK(entries == 3'002);
+            CHECK(buckets == testing_capacity[index].bucket_count);
+            CHECK(fs::file_size(path) == testing_capacity[index].file_size);
+            active_version = v;
+        }
+        ++checked;
+    }
+    CHECK(checked == 2);
+    CHECK(active_version > fitted_version);
+    CHECK(rehashes_observed.load(std::memory_order_relaxed) == before);
+}
+
 // =============================================================================
 // The counter counts a growth once, not once per insert after it
 // =============================================================================
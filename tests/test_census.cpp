@@ -47,6 +47,7 @@
 
 #include "detail/durability.hpp"
 #include "detail/census_arithmetic.hpp"
+#include "detail/census_sampling.hpp"
 #include "detail/database_lock.hpp"
 #include "detail/utxo_value.hpp"
 #include "detail/file_cache.hpp"
@@ -492,6 +493,301 @@ TEST_CASE("the same state produces the same JSON", "[census]") {
     db.close();
 }
 
+TEST_CASE("the walk is the same whatever the number of threads", "[census]") {
+    // The generations are read side by side and folded in walk order, so the
+    // thread count is not allowed to show anywhere in the report.
+    failpoints::scoped_reset const disarm;
+    temp_db t;
+    populate(t.dir);
+    {
+        // More history than populate() leaves, in two classes, so that there
+        // are more generations than threads and a class with several of them.
+        auto db = std::move(*full_db::open_for_testing(t.dir, false));
+        uint64_t n = 10'000;
+        for (int round = 0; round < 3; ++round) {
+            for (size_t klass : {size_t(0), size_t(2)}) {
+                failpoints::force_rotations.store(1, std::memory_order_relaxed);
+                std::vector<uint8_t> const value(payload_for(klass), 0x3C);
+                REQUIRE(db.insert(key_of(++n), value, 800200).has_value());
+            }
+        }
+        db.close();
+    }
+
+    auto db = std::move(*full_db::open_for_testing(t.dir, false));
+    census_options sequential;
+    sequential.threads = 1;
+    auto one = db.census(sequential);
+    REQUIRE(one.has_value());
+    REQUIRE(one->files_examined > 4);
+
+    for (unsigned threads : {2u, 3u, 16u, 0u}) {
+        INFO("threads " << threads);
+        census_options options;
+        options.threads = threads;
+        auto many = db.census(options);
+        REQUIRE(many.has_value());
+        many->duration_ms = one->duration_ms;
+        CHECK(to_json(*many) == to_json(*one));
+    }
+
+    // And a failure is the one the sequential walk stops at.
+    auto const historical = t.dir / fmt::format(detail::data_file_format, 0, 0);
+    REQUIRE(fs::exists(historical));
+    fs::remove(historical);
+    auto const broken_one = db.census(sequential);
+    REQUIRE_FALSE(broken_one.has_value());
+    census_options wide;
+    wide.threads = 8;
+    auto const broken_many = db.census(wide);
+    REQUIRE_FALSE(broken_many.has_value());
+    CHECK(broken_many.error() == broken_one.error());
+    db.close();
+}
+
+namespace {
+
+/// The report with the figures that describe the walk rather than the database
+/// taken out, so that what remains can be compared byte for byte.
+std::string figures_of(census_report report) {
+    report.duration_ms = 0;
+    report.generations_reused = 0;
+    report.sampling.entries_read = 0;
+    return to_json(report);
+}
+
+uint64_t sealed_generations(census_report const& report) {
+    uint64_t sealed = 0;
+    for (auto const& c : report.classes) {
+        for (auto const& g : c.generations_detail) sealed += g.active ? 0 : 1;
+    }
+    return sealed;
+}
+
+} // namespace
+
+TEST_CASE("an incremental census reads only what changed, and reports the same figures",
+          "[census]") {
+    failpoints::scoped_reset const disarm;
+    temp_db t;
+    populate(t.dir);
+    {
+        // Several sealed generations in two classes, so that there is something
+        // to reuse beside the one a deletion will change.
+        auto db = std::move(*full_db::open_for_testing(t.dir, false));
+        uint64_t n = 10'000;
+        for (int round = 0; round < 3; ++round) {
+            for (size_t klass : {size_t(0), size_t(2)}) {
+                failpoints::force_rotations.store(1, std::memory_order_relaxed);
+                std::vector<uint8_t> const value(payload_for(klass), 0x3C);
+                REQUIRE(db.insert(key_of(++n), value, 800200).has_value());
+            }
+        }
+        db.close();
+    }
+
+    auto db = std::move(*full_db::open_for_testing(t.dir, false));
+    auto const walked = db.census();
+    REQUIRE(walked.has_value());
+    uint64_t const sealed = sealed_generations(*walked);
+    REQUIRE(sealed > 2);
+    auto const record = t.dir / fmt::format("census_{}_v{:05}.dat", 0, 0);
+    // Not asked, nothing kept.
+    CHECK_FALSE(fs::exists(record));
+
+    census_options incremental;
+    incremental.incremental = true;
+
+    // The first reads everything and leaves a record per sealed generation.
+    auto const first = db.census(incremental);
+    REQUIRE(first.has_value());
+    CHECK(first->generations_reused == 0);
+    CHECK(figures_of(*first) == figures_of(*walked));
+    CHECK(fs::exists(record));
+
+    // The second reads only the active generations.
+    auto const second = db.census(incremental);
+    REQUIRE(second.has_value());
+    CHECK(second->generations_reused == sealed);
+    CHECK(figures_of(*second) == figures_of(*walked));
+    CHECK(to_text(*second).find("unchanged since an earlier census") != std::string::npos);
+
+    // A deletion that reaches a sealed generation lowers its entry count, and
+    // that generation alone is read again.
+    std::vector<deferred_deletion_entry> batch{{key_of(1), 800300}};
+    REQUIRE(db.apply_deletes(batch).erased.size() == 1);
+    auto const after_delete = db.census();
+    REQUIRE(after_delete.has_value());
+    REQUIRE(after_delete->entries == walked->entries - 1);
+    auto const third = db.census(incremental);
+    REQUIRE(third.has_value());
+    CHECK(third->generations_reused == sealed - 1);
+    CHECK(figures_of(*third) == figures_of(*after_delete));
+
+    // A record that cannot be believed is a generation to read, and is replaced.
+    {
+        std::ofstream out(record, std::ios::binary | std::ios::trunc);
+        out << "UZCC and then nothing that a record would hold";
+        REQUIRE(out.good());
+    }
+    auto const damaged = db.census(incremental);
+    REQUIRE(damaged.has_value());
+    CHECK(damaged->generations_reused == sealed - 1);
+    CHECK(figures_of(*damaged) == figures_of(*after_delete));
+    auto const repaired = db.census(incremental);
+    REQUIRE(repaired.has_value());
+    CHECK(repaired->generations_reused == sealed);
+
+    // A merge retires the records of the generations it retires: none is left
+    // describing a file that is no longer there.
+    REQUIRE(db.compact_all().has_value());
+    for (auto const& entry : fs::directory_iterator(t.dir)) {
+        auto const name = entry.path().filename().string();
+        if ( ! name.starts_with("census_")) continue;
+        INFO(name);
+        CHECK(fs::exists(t.dir / ("cont_" + name.substr(std::string_view("census_").size()))));
+    }
+    auto const compacted = db.census();
+    REQUIRE(compacted.has_value());
+    auto const after_merge = db.census(incremental);
+    REQUIRE(after_merge.has_value());
+    CHECK(figures_of(*after_merge) == figures_of(*compacted));
+    db.close();
+}
+
+namespace {
+
+/// Whether `exact` is within an interval widened by its own width on each side.
+/// The interval is at 95%, and the sample is fixed by the hash, so asserting the
+/// interval itself would be asserting one draw; three times the half-width
+/// fails one time in millions, and a wrong variance fails it every time.
+bool near_interval(uint64_t exact, estimate_interval const& i) {
+    uint64_t const width = i.high - i.low;
+    return exact + width >= i.low && exact <= i.high + width;
+}
+
+} // namespace
+
+TEST_CASE("a sampled census estimates the payload figures, and says how well", "[census]") {
+    failpoints::scoped_reset const disarm;
+    temp_db t;
+    populate(t.dir);
+    {
+        // One class large enough to sample, sealed so that the incremental
+        // record is in question too, and five sizes so that the histogram has
+        // something to estimate.
+        auto db = std::move(*full_db::open_for_testing(t.dir, false));
+        uint64_t n = 10'000;
+        for (uint64_t i = 0; i < 4000; ++i) {
+            std::vector<uint8_t> const value(8 + (i * 7919) % 5, 0x3C);
+            REQUIRE(db.insert(key_of(++n), value, 800200).has_value());
+        }
+        failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        REQUIRE(db.insert(key_of(++n), std::vector<uint8_t>(8, 0x3C), 800201).has_value());
+        db.close();
+    }
+
+    auto db = std::move(*full_db::open_for_testing(t.dir, false));
+    auto const exact = db.census();
+    REQUIRE(exact.has_value());
+    CHECK(exact->sampling.fraction == 0.0);
+
+    census_options options;
+    options.sample_fraction = 0.1;
+    options.sample_min_entries = 200;
+    auto const sampled = db.census(options);
+    REQUIRE(sampled.has_value());
+
+    // What is in the headers is not estimated.
+    CHECK(sampled->entries == exact->entries);
+    CHECK(sampled->segment_size_bytes == exact->segment_size_bytes);
+    CHECK(sampled->occupied_slot_bytes == exact->occupied_slot_bytes);
+    CHECK(sampled->sampling.fraction == 0.1);
+    CHECK(sampled->sampling.confidence == detail::sample_confidence);
+    CHECK(sampled->sampling.entries_read < sampled->entries);
+    CHECK(sampled->sampling.entries_read >= 400);
+
+    // Class 0 was sampled: its payload is an estimate, within bounds that hold
+    // whatever the sample, and near the count.
+    auto const& counted = exact->classes[0];
+    auto const& estimated = sampled->classes[0];
+    CHECK(estimated.entry_payload_status == metric_status::estimated);
+    CHECK(estimated.unused_payload_capacity.status == metric_status::estimated);
+    CHECK(estimated.payload_histogram_status == metric_status::estimated);
+    CHECK(estimated.entry_payload_interval.low <= estimated.entry_payload_bytes);
+    CHECK(estimated.entry_payload_bytes <= estimated.entry_payload_interval.high);
+    CHECK(estimated.entry_payload_interval.low < estimated.entry_payload_interval.high);
+    CHECK(near_interval(counted.entry_payload_bytes, estimated.entry_payload_interval));
+    CHECK(near_interval(counted.unused_payload_capacity.bytes,
+                        estimated.unused_payload_capacity_interval));
+    CHECK(estimated.entry_payload_bytes + estimated.unused_payload_capacity.bytes
+          == counted.entry_payload_bytes + counted.unused_payload_capacity.bytes);
+    for (auto const& b : estimated.payload_histogram) {
+        INFO("size " << b.payload_size);
+        auto const found = std::ranges::find(counted.payload_histogram, b.payload_size,
+                                             &payload_bucket::payload_size);
+        REQUIRE(found != counted.payload_histogram.end());
+        CHECK(b.interval.low <= b.entries);
+        CHECK(b.entries <= b.interval.high);
+        CHECK(near_interval(found->entries, b.interval));
+    }
+    CHECK(sampled->entry_payload_status == metric_status::estimated);
+    CHECK(near_interval(exact->entry_payload_bytes, sampled->entry_payload_interval));
+
+    // The rest are too small to sample, and are counted.
+    for (size_t klass = 1; klass < sampled->classes.size(); ++klass) {
+        INFO("class " << klass);
+        auto const& c = sampled->classes[klass];
+        CHECK(c.entry_payload_status == metric_status::measured);
+        CHECK(c.payload_histogram_status == metric_status::measured);
+        CHECK(c.entry_payload_bytes == exact->classes[klass].entry_payload_bytes);
+    }
+
+    // The same entries every time.
+    auto const again = db.census(options);
+    REQUIRE(again.has_value());
+    auto const strip = [](census_report r) { r.duration_ms = 0; return to_json(r); };
+    CHECK(strip(*again) == strip(*sampled));
+
+    // A sample leaves no record; a generation read whole does.
+    options.incremental = true;
+    auto const recorded = db.census(options);
+    REQUIRE(recorded.has_value());
+    CHECK(figures_of(*recorded) == figures_of(*sampled));
+    CHECK_FALSE(fs::exists(t.dir / fmt::format("census_{}_v{:05}.dat", 0, 1)));
+    CHECK(fs::exists(t.dir / fmt::format("census_{}_v{:05}.dat", 0, 0)));
+
+    // The estimates are marked as such in both presentations.
+    std::error_code ec;
+    auto const json = to_json(*sampled);
+    auto const parsed = boost::json::parse(json, ec);
+    INFO(json);
+    REQUIRE_FALSE(ec);
+    auto const& root = parsed.as_object();
+    CHECK(root.at("sampling").as_object().at("fraction").as_double() == 0.1);
+    auto const& payload = root.at("totals").as_object().at("estimated").as_object()
+        .at("entry_payload_bytes").as_object();
+    CHECK(payload.at("status").as_string() == "estimated");
+    CHECK(payload.at("interval").as_array().size() == 2);
+    CHECK(to_text(*sampled).find("figures marked ~ are estimates") != std::string::npos);
+    auto const unsampled_json = boost::json::parse(to_json(*exact), ec);
+    REQUIRE_FALSE(ec);
+    CHECK(unsampled_json.as_object().at("sampling").is_null());
+
+    // A fraction that leaves nothing to sample changes nothing but the note.
+    census_options small;
+    small.sample_fraction = 0.1;
+    small.sample_min_entries = 1'000'000;
+    auto const whole = db.census(small);
+    REQUIRE(whole.has_value());
+    CHECK(whole->entry_payload_status == metric_status::measured);
+    CHECK(whole->sampling.entries_read == whole->entries);
+    auto unsampled = *whole;
+    unsampled.sampling = {};
+    CHECK(figures_of(unsampled) == figures_of(*exact));
+    db.close();
+}
+
 TEST_CASE("neither presentation contains a key or a payload", "[census]") {
     // The report goes into tickets and issues. Whatever else it carries, it does
     // not carry the chain.
@@ -607,6 +903,51 @@ TEST_CASE("physical block measurement is reported with the method that produced
     db.close();
 }
 
+TEST_CASE("page-cache residency is asked for, per generation, and within the file",
+          "[census]") {
+    failpoints::scoped_reset const disarm;
+    temp_db t;
+    populate(t.dir);
+
+    auto db = std::move(*full_db::open_for_testing(t.dir, false));
+
+    // Not asked by default: it is the one figure that would differ between two
+    // censuses of the same state.
+    auto plain = db.census();
+    REQUIRE(plain.has_value());
+    CHECK(plain->resident_bytes.status == metric_status::not_applicable);
+    CHECK_FALSE(plain->resident_bytes.detail.empty());
+
+    census_options options;
+    options.measure_residency = true;
+    auto report = db.census(options);
+    REQUIRE(report.has_value());
+#ifdef _WIN32
+    CHECK(report->resident_bytes.status == metric_status::unavailable);
+#else
+    REQUIRE(report->resident_bytes.status == metric_status::measured);
+    uint64_t total = 0;
+    for (auto const& c : report->classes) {
+        REQUIRE(c.resident_bytes.status == metric_status::measured);
+        uint64_t generations = 0;
+        for (auto const& g : c.generations_detail) {
+            REQUIRE(g.resident_bytes.status == metric_status::measured);
+            CHECK(g.resident_bytes.bytes <= g.logical_file_bytes);
+            generations += g.resident_bytes.bytes;
+        }
+        CHECK(c.resident_bytes.bytes == generations);
+        total += c.resident_bytes.bytes;
+    }
+    CHECK(report->resident_bytes.bytes == total);
+    CHECK(report->resident_bytes.bytes <= report->logical_file_bytes);
+#endif
+    // Asking changes nothing else.
+    CHECK(report->entries == plain->entries);
+    CHECK(report->files_examined == plain->files_examined);
+    CHECK(to_text(*report).find("resident in page cache") != std::string::npos);
+    db.close();
+}
+
 TEST_CASE("asking for no per-generation detail keeps every total", "[census]") {
     failpoints::scoped_reset const disarm;
     temp_db t;
@@ -896,6 +1237,60 @@ TEST_CASE("arithmetic on figures read from a file refuses rather than wraps",
     CHECK_FALSE(add.ok);
 }
 
+TEST_CASE("a sample's estimates are exact when it is everything, and bounded when not",
+          "[census]") {
+    // How many are read.
+    CHECK(detail::sample_limit(10'000, 0.0, 100) == 10'000);
+    CHECK(detail::sample_limit(10'000, 1.0, 100) == 10'000);
+    CHECK(detail::sample_limit(10'000, 0.25, 50) == 2'500);
+    CHECK(detail::sample_limit(10'000, 0.001, 50) == 50);
+    CHECK(detail::sample_limit(30, 0.01, 50) == 30);
+    CHECK(detail::sample_limit(10'000, 0.0001, 0) == 2);
+
+    // Four entries of sizes 2, 2, 4 and 8 in a class of capacity 10.
+    std::vector<uint64_t> sample(11, 0);
+    sample[2] = 2;
+    sample[4] = 1;
+    sample[8] = 1;
+
+    // Read whole: no variance, and the points are the counts.
+    auto const whole = detail::estimate_from_sample(sample, 4, 4, 10);
+    CHECK(whole.payload == 16);
+    CHECK(whole.unused == 24);
+    CHECK(whole.payload_spread.variance == 0.0);
+    auto const tight = detail::interval_of(whole.payload, whole.payload_spread);
+    CHECK(tight.low == 16);
+    CHECK(tight.high == 16);
+    REQUIRE(whole.histogram.size() == 3);
+    CHECK(whole.histogram[0].payload_size == 2);
+    CHECK(whole.histogram[0].entries == 2);
+
+    // Four of a hundred: the points scale, and the bounds are what the sample
+    // makes certain — 16 seen, at most 96 more entries of 10.
+    auto const part = detail::estimate_from_sample(sample, 4, 100, 10);
+    CHECK(part.payload == 400);
+    CHECK(part.unused == 600);
+    CHECK(part.payload_spread.floor == 16);
+    CHECK(part.payload_spread.ceiling == 16 + 96 * 10);
+    CHECK(part.unused_spread.floor == 1000 - (16 + 96 * 10));
+    CHECK(part.unused_spread.ceiling == 1000 - 16);
+    auto const wide = detail::interval_of(part.payload, part.payload_spread);
+    CHECK(wide.low < 400);
+    CHECK(wide.high > 400);
+    CHECK(wide.low >= 16);
+    CHECK(wide.high <= 976);
+    REQUIRE(part.histogram.size() == 3);
+    CHECK(part.histogram[0].entries == 50);
+    CHECK(part.bucket_spreads[0].floor == 2);
+    CHECK(part.bucket_spreads[0].ceiling == 98);
+
+    // An interval wider than the bounds is cut to them.
+    detail::estimate_spread const loose{1e12, 10, 20};
+    auto const cut = detail::interval_of(15, loose);
+    CHECK(cut.low == 10);
+    CHECK(cut.high == 20);
+}
+
 TEST_CASE("a generation claiming more entries than buckets is refused", "[census]") {
     // The ordinary case first, because a check that refuses everything passes a
     // refusal test.
@@ -0,0 +1,344 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_compaction_planner.cpp
+ * @brief Which generations a plan merges, what it says they cost, and that
+ *        executing it is the ordinary merge.
+ *
+ * Two levels. The planner is a pure function of a description of the classes, so
+ * the shapes that decide what it does — a full generation between two empty
+ * ones, a budget that admits the second-best group — are handed to it directly.
+ * Then one database, driven through the public API: a plan that declines a full
+ * generation, and the same plan merging it once it has been drained.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+#include "detail/compaction_planner.hpp"
+
+using namespace utxoz::detail;
+using utxoz::compaction_options;
+using utxoz::compaction_strategy;
+
+namespace {
+
+/// A class whose generations hold `entries`, in a target of 1000.
+class_profile profile(std::vector<std::optional<size_t>> const& entries) {
+    class_profile cls;
+    cls.container_class = 0;
+    cls.target_limit = 1000;
+    cls.target_file_bytes = 1 << 20;
+    cls.target_table_bytes = 1 << 19;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        generation_profile g;
+        g.version = i;
+        g.entries = entries[i];
+        g.limit = cls.target_limit;
+        g.file_bytes = cls.target_file_bytes;
+        g.table_bytes = cls.target_table_bytes;
+        cls.generations.push_back(g);
+    }
+    return cls;
+}
+
+std::vector<std::vector<uint64_t>> sources_of(utxoz::compaction_plan const& plan) {
+    std::vector<std::vector<uint64_t>> out;
+    for (auto const& g : plan.groups) out.push_back(g.sources);
+    return out;
+}
+
+} // anonymous namespace
+
+TEST_CASE("greedy predicts the largest run that fits, as compact_all walks it", "[compaction][plan]") {
+    compaction_options options;
+    options.strategy = compaction_strategy::greedy;
+
+    auto const plan = plan_compaction({profile({900, 50, 40, 800, 30})}, options);
+
+    // 900+50+40 fits and the next does not; 800+30 fits. Fill is not consulted.
+    CHECK(sources_of(plan) == std::vector<std::vector<uint64_t>>{{0, 1, 2}, {3, 4}});
+    CHECK(plan.files_removed == 3);
+    CHECK(plan.generations_too_full == 0);
+}
+
+TEST_CASE("tiered never rewrites a generation above the fill threshold", "[compaction][plan]") {
+    compaction_options options;
+    options.strategy = compaction_strategy::tiered;
+    options.max_source_fill = 0.80;
+
+    auto const plan = plan_compaction({profile({100, 200, 900, 300, 400, 500})}, options);
+
+    // 900 splits the runs. After it, 300+400 fits and 500 would not.
+    CHECK(sources_of(plan) == std::vector<std::vector<uint64_t>>{{0, 1}, {3, 4}});
+    CHECK(plan.generations_too_full == 1);
+    for (auto const& g : plan.groups) CHECK(g.entries <= 1000);
+}
+
+TEST_CASE("leveled fills the fullest eligible generation from the emptiest", "[compaction][plan]") {
+    compaction_options options;
+    options.strategy = compaction_strategy::leveled;
+
+    auto const plan = plan_compaction({profile({700, 100, 250, 600, 50})}, options);
+
+    // Base 700 takes 50 and 100 (850), then 250 would overflow. Base 600 takes 250.
+    CHECK(sources_of(plan) == std::vector<std::vector<uint64_t>>{{0, 1, 4}, {2, 3}});
+    CHECK(plan.groups[0].target_fill > 0.8);
+}
+
+TEST_CASE("size ratio does not absorb a small generation into a large one", "[compaction][plan]") {
+    compaction_options options;
+    options.strategy = compaction_strategy::size_ratio;
+    options.size_ratio = 2.0;
+
+    auto const plan = plan_compaction({profile({10, 15, 25, 700})}, options);
+
+    // 10, then 15 ≤ 2×10, then 25 ≤ 2×25; 700 is far more than twice 50.
+    CHECK(sources_of(plan) == std::vector<std::vector<uint64_t>>{{0, 1, 2}});
+}
+
+TEST_CASE("a generation nothing describes is never a source", "[compaction][plan]") {
+    compaction_options options;
+    options.strategy = compaction_strategy::tiered;
+
+    auto const plan = plan_compaction({profile({10, std::nullopt, 20})}, options);
+
+    // Unknown is not empty. It splits the run rather than joining it, so the two
+    // known generations have no neighbour to merge with.
+    CHECK(plan.groups.empty());
+    CHECK(plan.generations_unknown == 1);
+}
+
+TEST_CASE("the budget drops the worst groups and keeps the best", "[compaction][plan]") {
+    compaction_options options;
+    options.strategy = compaction_strategy::tiered;
+    options.max_bytes_written = 1 << 19;   // exactly one target
+
+    auto cls0 = profile({10, 20});
+    auto cls1 = profile({10, 20, 30});
+    cls1.container_class = 1;
+
+    auto const plan = plan_compaction({cls0, cls1}, options);
+
+    // Three files into one reclaims twice what two into one does, for one more
+    // source read: the better score, and the one the budget keeps.
+    REQUIRE(plan.groups.size() == 1);
+    CHECK(plan.groups[0].container_class == 1);
+    CHECK(plan.groups_over_budget == 1);
+    CHECK(plan.bytes_written == (1u << 19));
+    CHECK(plan.bytes_read == 3u * (1u << 19));
+    CHECK(plan.bytes_reclaimed == 2u * (1u << 20));
+}
+
+TEST_CASE("probe reach follows the ordinal histogram", "[compaction][plan]") {
+    // Ordinals 1, 2, 3, 4, 5-8, 9+.
+    std::array<size_t, 6> const ordinals{100, 50, 20, 10, 8, 4};
+
+    CHECK(probes_reaching(ordinals, 0) == 0);             // the active generation
+    CHECK(probes_reaching(ordinals, 1) == 192);           // every answered key
+    CHECK(probes_reaching(ordinals, 2) == 92);
+    CHECK(probes_reaching(ordinals, 5) == 12);
+    CHECK(probes_reaching(ordinals, 7) == 4 + 8 * 2 / 4);
+    CHECK(probes_reaching(ordinals, 12) == 4);             // 9+ has no upper end
+
+    auto cls = profile({10, 20, 30});
+    cls.probes_known = true;
+    cls.generations[0].probe_reach = probes_reaching(ordinals, 2);
+    cls.generations[1].probe_reach = probes_reaching(ordinals, 1);
+
+    compaction_options options;
+    options.strategy = compaction_strategy::tiered;
+    auto const plan = plan_compaction({cls}, options);
+    REQUIRE(plan.groups.size() == 1);
+    CHECK(plan.groups[0].probes_saved_status == utxoz::metric_status::measured);
+    // The deeper member's probes: every key that reached it had already
+    // reached the shallower one, and the target stands in for both.
+    CHECK(plan.groups[0].probes_saved == 92);
+}
+
+TEST_CASE("a drained generation nothing merges is refitted on its own", "[compaction][plan]") {
+    // A full generation on each side, so tiered has no run to make of the drained
+    // one. Sixty-four mebibytes at 1919 buckets, so a target fitted to ten
+    // entries is a fraction of it.
+    auto cls = profile({950, 10, 950, 5});
+    cls.target_buckets = 1919;
+    cls.target_file_bytes = uint64_t(64) << 20;
+    for (auto& g : cls.generations) g.file_bytes = cls.target_file_bytes;
+
+    compaction_options options;
+    options.strategy = compaction_strategy::tiered;
+    CHECK(plan_compaction({cls}, options).groups.empty());
+
+    options.refit_below = 0.05;
+    auto const plan = plan_compaction({cls}, options);
+
+    // The last generation is as drained, and is the active one: left alone.
+    CHECK(sources_of(plan) == std::vector<std::vector<uint64_t>>{{1}});
+    CHECK(plan.files_removed == 0);
+    auto const fitted = fitted_target(cls, 10);
+    CHECK(fitted.file_bytes < cls.target_file_bytes);
+    CHECK(plan.bytes_reclaimed == cls.target_file_bytes - fitted.file_bytes);
+    CHECK(plan.bytes_written == fitted.table_bytes);
+}
+
+TEST_CASE("a group that takes in the active generation is priced at the configured segment",
+          "[compaction][plan]") {
+    // The merge publishes it as the new active generation, which goes on taking
+    // inserts, so it is not fitted; a plan that priced it fitted would promise
+    // a reclaim the merge does not make.
+    auto cls = profile({10, 10, 10});
+    cls.target_buckets = 1919;
+    cls.target_file_bytes = uint64_t(64) << 20;
+    for (auto& g : cls.generations) g.file_bytes = cls.target_file_bytes;
+
+    compaction_options options;
+    options.strategy = compaction_strategy::tiered;
+    auto const sealed = plan_compaction({cls}, options);
+    REQUIRE(sealed.groups.size() == 1);
+    CHECK(sealed.bytes_written == fitted_target(cls, 30).table_bytes);
+
+    cls.generations.back().active = true;
+    auto const active = plan_compaction({cls}, options);
+    REQUIRE(active.groups.size() == 1);
+    CHECK(active.bytes_written == cls.target_table_bytes);
+    CHECK(active.bytes_reclaimed == 2 * cls.target_file_bytes);
+}
+
+// =============================================================================
+// Through the database
+// =============================================================================
+
+namespace {
+
+inline std::atomic<uint64_t> cp_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_cp_{}_{}_{}_{}", tag, getpid(), ts, cp_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    return key;
+}
+
+std::vector<uint8_t> make_value(size_t size, uint8_t seed) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), seed);
+    return v;
+}
+
+size_t count_files(std::string const& path, std::string const& prefix) {
+    size_t n = 0;
+    for (auto const& entry : std::filesystem::directory_iterator(path)) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0) ++n;
+    }
+    return n;
+}
+
+} // anonymous namespace
+
+TEST_CASE("a plan declines a full generation and merges it once drained",
+          "[database][compaction][plan]") {
+    auto const path = make_unique_path("drain");
+    std::filesystem::remove_all(path);
+
+    {
+        auto r = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+
+        // Filled in chunks until container 0 rotates. A chunk that straddles the
+        // rotation is dropped, so everything kept is known to live in version 0.
+        uint64_t next = 0;
+        std::vector<utxoz::raw_outpoint> v0_keys;
+        auto const rotations = [&] { return db.get_statistics().rotations_per_container[0]; };
+        while (rotations() == 0) {
+            std::vector<utxoz::raw_outpoint> chunk;
+            for (size_t i = 0; i < 1'000; ++i) {
+                auto const k = make_key(next++);
+                REQUIRE(db.insert(k, make_value(33, 1), 100).has_value());
+                chunk.push_back(k);
+            }
+            if (rotations() == 0) v0_keys.insert(v0_keys.end(), chunk.begin(), chunk.end());
+        }
+        auto const survivor = make_key(next++);
+        REQUIRE(db.insert(survivor, make_value(33, 1), 100).has_value());
+        REQUIRE(count_files(path, "cont_0_v") == 2);
+
+        // Version 0 rotated because it was full. Half is well below where any
+        // map rotates, so it is too full to be worth rewriting.
+        compaction_options options;
+        options.strategy = compaction_strategy::tiered;
+        options.max_source_fill = 0.5;
+
+        auto const before = db.plan_compaction(options);
+        REQUIRE(before.has_value());
+        CHECK(before->groups.empty());
+        CHECK(before->generations_too_full >= 1);
+
+        // Greedy would merge it anyway — that is the difference.
+        options.strategy = compaction_strategy::greedy;
+        auto const greedy = db.plan_compaction(options);
+        REQUIRE(greedy.has_value());
+        CHECK(greedy->groups.size() == 1);
+        options.strategy = compaction_strategy::tiered;
+
+        // Drain all but the last hundred entries of version 0.
+        std::vector<utxoz::deferred_deletion_entry> batch;
+        for (size_t i = 0; i + 100 < v0_keys.size(); ++i) batch.emplace_back(v0_keys[i], 200);
+        auto const progress = db.apply_deletes(batch);
+        REQUIRE(progress.erased.size() == batch.size());
+
+        auto const planned = db.plan_compaction(options);
+        REQUIRE(planned.has_value());
+        REQUIRE(planned->groups.size() == 1);
+        CHECK(planned->groups[0].sources.size() == 2);
+        CHECK(planned->bytes_read > 0);
+        CHECK(planned->bytes_written > 0);
+
+        // The dry run touched nothing.
+        CHECK(count_files(path, "cont_0_v") == 2);
+
+        auto const size_before = db.size();
+        auto const merged = db.compact(options);
+        REQUIRE(merged.has_value());
+        CHECK(merged->groups.size() == 1);
+        CHECK(merged->files_removed == 1);
+        CHECK(count_files(path, "cont_0_v") == 1);
+        CHECK(db.size() == size_before);
+
+        size_t seen = 0;
+        (void)db.for_each_key([&](utxoz::raw_outpoint const& k) {
+            if (k == survivor || k == v0_keys.back()) ++seen;
+        });
+        CHECK(seen == 2);
+
+        // And the active container is back.
+        REQUIRE(db.insert(make_key(next + 1), make_value(33, 2), 300).has_value());
+
+        db.close();
+    }
+
+    std::filesystem::remove_all(path);
+}
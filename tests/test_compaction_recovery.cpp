@@ -1950,3 +1950,29 @@ TEST_CASE("a crash at any barrier of a reference-mode merge leaves a state reope
 }
 
 #endif // _WIN32
+
+TEST_CASE("recovery settles every class an open finds work in, not just the first",
+          "[database][recovery]") {
+    // The classes are recovered side by side now, from one listing. What is
+    // pinned is that none is missed: garbage left in three classes is gone after
+    // one open, and the data beside it is untouched.
+    auto const path = unique_path("classes");
+    fs::remove_all(path);
+    scope_exit const cleanup([&] { std::error_code ec; fs::remove_all(path, ec); });
+
+    auto const expected = build_mergeable(path, 3);
+    REQUIRE_FALSE(expected.empty());
+
+    for (auto const* name : {"cont_0_v00040.dat.building", "cont_2_v00007.merge.tmp",
+                             "cont_4_v00003.dat.building"}) {
+        std::ofstream ofs(fs::path(path) / name, std::ios::binary);
+        ofs << "left by a merge that never published";
+    }
+    REQUIRE(count_reserved(path) == 3);
+
+    auto opened = utxoz::full_db::open_for_testing(path);
+    REQUIRE(opened);
+    CHECK(count_reserved(path) == 0);
+    CHECK(all_keys(*opened) == expected);
+    opened->close();
+}
@@ -0,0 +1,230 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_concurrent_find.cpp
+ * @brief find() running while insert() rotates and apply_deletes() erases.
+ *
+ * The writer is one thread, as the contract still requires, and it does the
+ * three things that used to make a concurrent lookup unsafe: emplaces into the
+ * map being read, erases from it, and rotates it — which unmaps the segment the
+ * map lived in. The readers hold no lock of their own.
+ *
+ * What a reader may see is narrow. A key the writer has published is either
+ * answered with exactly the bytes it was given, or `not_resolved`: it was erased,
+ * or a rotation took it below the active version. Never other bytes, and never
+ * a crash. A key in a class the writer does not touch is always answered —
+ * and a torn copy, one the write counter failed to catch, would show up here as
+ * other bytes. Under ThreadSanitizer the same cases check everything but the
+ * probe itself, which races by design and is excused in tsan.supp.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> cf_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_cf_{}_{}_{}_{}", tag, getpid(), ts, cf_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0xCF;
+    return key;
+}
+
+/// A value whose bytes are a function of its key, so a reader can tell a torn
+/// or misplaced answer from the right one without asking the writer.
+std::vector<uint8_t> value_for(uint64_t n, size_t size) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), uint8_t(n * 31));
+    return v;
+}
+
+constexpr uint64_t stable_base = 1'000'000;   ///< keys in a class nobody writes to
+constexpr size_t stable_count = 64;
+constexpr size_t written_size = 33;           ///< class 0, the one being rotated
+constexpr size_t stable_size = 80;            ///< class 1
+
+} // anonymous namespace
+
+TEST_CASE("full: find() may run while insert() rotates and apply_deletes() erases",
+          "[concurrency][find][full]") {
+    auto const path = make_unique_path("full");
+    std::filesystem::remove_all(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    for (uint64_t n = stable_base; n < stable_base + stable_count; ++n) {
+        REQUIRE(db.insert(make_key(n), value_for(n, stable_size), 1).value());
+    }
+
+    constexpr uint64_t total = 20'000;
+    constexpr uint64_t rotate_every = 2'500;
+    std::atomic<uint64_t> published{0};
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> wrong{0};
+    std::atomic<uint64_t> answered{0};
+
+    auto const& reader_db = db;
+    auto const read = [&](uint64_t seed) {
+        uint64_t x = seed;
+        while ( ! done.load(std::memory_order_acquire)) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+
+            // A class the writer never touches: always there, always intact.
+            auto const s = stable_base + (x >> 33) % stable_count;
+            auto const stable = reader_db.find(make_key(s), 10);
+            if ( ! stable || stable->data != value_for(s, stable_size)) ++wrong;
+
+            // The class being written, erased and rotated.
+            auto const limit = published.load(std::memory_order_acquire);
+            if (limit == 0) continue;
+            auto const n = (x >> 17) % limit;
+            auto const got = reader_db.find(make_key(n), 10);
+            if (got) {
+                if (got->data != value_for(n, written_size)) ++wrong;
+                ++answered;
+            } else if (got.error() != utxoz::error_code::not_resolved) {
+                ++wrong;
+            }
+        }
+    };
+
+    std::thread first(read, 1);
+    std::thread second(read, 2);
+    // A failed REQUIRE below leaves by throwing, and a joinable thread
+    // destroyed on the way out is a terminate, not a failure.
+    scope_exit const stop_readers([&] {
+        done.store(true, std::memory_order_release);
+        if (first.joinable()) first.join();
+        if (second.joinable()) second.join();
+    });
+
+    std::vector<utxoz::deferred_deletion_entry> batch;
+    for (uint64_t n = 0; n < total; ++n) {
+        if (n > 0 && n % rotate_every == 0) {
+            failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        }
+        REQUIRE(db.insert(make_key(n), value_for(n, written_size), 2).value());
+        published.store(n + 1, std::memory_order_release);
+
+        // Every so often, a block's worth of spends from the recent past —
+        // recent enough that most are still in the active map.
+        if (n % 500 == 499) {
+            batch.clear();
+            for (uint64_t k = n - 400; k < n - 300; ++k) batch.emplace_back(make_key(k), 3);
+            auto const progress = db.apply_deletes(batch);
+            REQUIRE_FALSE(progress.error);
+        }
+    }
+    done.store(true, std::memory_order_release);
+    first.join();
+    second.join();
+
+    CHECK(wrong.load() == 0);
+    CHECK(answered.load() > 0);
+    CHECK(db.get_statistics().rotations_per_container[0] >= total / rotate_every - 1);
+    db.close();
+}
+
+TEST_CASE("reference: find() may run while insert() rotates and apply_deletes() erases",
+          "[concurrency][find][reference]") {
+    auto const path = make_unique_path("reference");
+    std::filesystem::remove_all(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::reference_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 12'000;
+    constexpr uint64_t rotate_every = 3'000;
+    std::atomic<uint64_t> published{0};
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> wrong{0};
+    std::atomic<uint64_t> answered{0};
+
+    auto const& reader_db = db;
+    std::thread reader([&] {
+        uint64_t x = 7;
+        while ( ! done.load(std::memory_order_acquire)) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            auto const limit = published.load(std::memory_order_acquire);
+            if (limit == 0) continue;
+            auto const n = (x >> 17) % limit;
+            auto const got = reader_db.find(make_key(n), 10);
+            if (got) {
+                if (got->file_number != uint32_t(n) || got->offset != uint32_t(n * 3)) ++wrong;
+                ++answered;
+            } else if (got.error() != utxoz::error_code::not_resolved) {
+                ++wrong;
+            }
+        }
+    });
+    scope_exit const stop_reader([&] {
+        done.store(true, std::memory_order_release);
+        if (reader.joinable()) reader.join();
+    });
+
+    std::vector<utxoz::deferred_deletion_entry> batch;
+    for (uint64_t n = 0; n < total; ++n) {
+        if (n > 0 && n % rotate_every == 0) {
+            failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        }
+        REQUIRE(db.insert(make_key(n), uint32_t(n), uint32_t(n * 3), 2).value());
+        published.store(n + 1, std::memory_order_release);
+
+        if (n % 500 == 499) {
+            batch.clear();
+            for (uint64_t k = n - 400; k < n - 300; ++k) batch.emplace_back(make_key(k), 3);
+            REQUIRE_FALSE(db.apply_deletes(batch).error);
+        }
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    CHECK(wrong.load() == 0);
+    CHECK(answered.load() > 0);
+    db.close();
+}
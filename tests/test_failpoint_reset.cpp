@@ -45,6 +45,8 @@ using utxoz::detail::failpoints;
     X(fail_sync_file,                 true,                            false)      \
     X(fail_sync_mapped_region,        true,                            false)      \
     X(sync_mapped_region_calls,       11u,                             0u)         \
+    X(sync_mapped_region_bytes,       4096u,                           0u)         \
+    X(hold_group_commit,              true,                            false)      \
     X(sync_file_calls,                12u,                             0u)         \
     X(fail_sync_file_at,              13u,                             0u)         \
     X(fail_sync_directory,            true,                            false)      \
@@ -70,12 +72,16 @@ using utxoz::detail::failpoints;
     X(fail_free_memory_probe,         true,                            false)      \
     X(fail_diagnostic_format,         true,                            false)      \
     X(forced_merge_id,                77u,                             0u)         \
+    X(streaming_merge,                true,                            false)      \
+    X(force_posix_io,                 true,                            false)      \
+    X(fail_ring_enter,                2u,                              0u)         \
     X(force_rotations,                3u,                              0u)         \
     X(forced_capacity,                959u,                            0u)         \
     X(forced_capacity_index,          2u,                              0u)         \
     X(force_database_id,              true,                            false)      \
     X(delete_config_after_claim,      true,                            false)      \
-    X(fail_segment_open_after,        41u,                             0u)
+    X(fail_segment_open_after,        41u,                             0u)         \
+    X(ignore_manifest,                true,                            false)
 
 namespace {
 /// Something for `before_target_publish` to hold that is not null.
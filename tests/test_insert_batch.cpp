@@ -0,0 +1,225 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_insert_batch.cpp
+ * @brief The size classes of one database written side by side.
+ *
+ * insert_batch() gives each class its share of a batch on a thread of its own,
+ * and apply_deletes() does the same for the active versions of a large batch.
+ * Neither is allowed to show: the cases here check every answer against what
+ * the same requests made one at a time are documented to give. Class 0 is
+ * built small so that it rotates during the batch while the other four are
+ * still writing — the rotation is the one step that touches state every class
+ * shares. Run under ThreadSanitizer, the same cases show there is nothing to be
+ * lucky about.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> ib_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_ib_{}_{}_{}_{}", tag, getpid(), ts, ib_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x1B;
+    return key;
+}
+
+/// One payload size per class, each well inside it.
+constexpr std::array<size_t, utxoz::container_count> class_value_size{30, 70, 110, 200, 600};
+
+std::vector<uint8_t> value_for(uint64_t n) {
+    std::vector<uint8_t> v(class_value_size[n % utxoz::container_count]);
+    std::iota(v.begin(), v.end(), uint8_t(n * 7));
+    return v;
+}
+
+} // anonymous namespace
+
+TEST_CASE("insert_batch: every class at once, answering as insert() would",
+          "[insert_batch][concurrency]") {
+    auto const path = make_unique_path("insert");
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    // Class 0 is built with sixty-four groups: it fills after a few hundred of
+    // its thousand entries and rotates mid-batch.
+    constexpr size_t small = 959;
+    failpoints::forced_capacity_index.store(0, std::memory_order_relaxed);
+    failpoints::forced_capacity.store(small, std::memory_order_relaxed);
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 5000;
+    std::vector<std::vector<uint8_t>> values;
+    values.reserve(total);
+    std::vector<utxoz::insert_request> batch;
+    for (uint64_t n = 0; n < total; ++n) {
+        values.push_back(value_for(n));
+        batch.push_back({make_key(n), values.back(), 3});
+    }
+    // Two duplicates, in two different classes, and a value no class can hold.
+    std::vector<uint8_t> const oversized(20'000, 0xEE);
+    batch.push_back({make_key(3), values[3], 4});
+    batch.push_back({make_key(total + 1), oversized, 4});
+    batch.push_back({make_key(1), values[1], 4});
+    REQUIRE(batch.size() >= utxoz::db_base::min_parallel_batch);
+
+    auto const progress = db.insert_batch(batch);
+    CHECK(progress.inserted == total);
+    REQUIRE(progress.duplicates.size() == 2);
+    CHECK(progress.duplicates[0].key == make_key(3));
+    CHECK(progress.duplicates[1].key == make_key(1));
+    REQUIRE(progress.unapplied.size() == 1);
+    CHECK(progress.unapplied[0].key == make_key(total + 1));
+    REQUIRE(progress.error);
+    CHECK(*progress.error == utxoz::error_code::value_too_large);
+    CHECK(db.size() == total);
+
+    auto const stats = db.get_statistics();
+    CHECK(stats.rotations_per_container[0] > 0);
+
+    // Everything is where it was put: in an active map, or — for class 0's
+    // earlier generations — where resolve() reaches.
+    std::vector<utxoz::lookup_request> rotated;
+    for (uint64_t n = 0; n < total; ++n) {
+        auto const found = db.find(make_key(n), 5);
+        if (found) {
+            CHECK(found->data == values[n]);
+            continue;
+        }
+        REQUIRE(found.error() == utxoz::error_code::not_resolved);
+        CHECK(n % utxoz::container_count == 0);
+        rotated.emplace_back(make_key(n), 5);
+    }
+    CHECK_FALSE(rotated.empty());
+    auto const resolved = db.resolve(rotated);
+    REQUIRE(resolved);
+    CHECK(resolved->found.size() == rotated.size());
+    CHECK(resolved->absent.empty());
+
+    db.close();
+}
+
+TEST_CASE("insert_batch: a small batch gives the same answers on one thread",
+          "[insert_batch]") {
+    auto const path = make_unique_path("small");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    std::vector<std::vector<uint8_t>> values;
+    std::vector<utxoz::insert_request> batch;
+    values.reserve(20);
+    for (uint64_t n = 0; n < 20; ++n) {
+        values.push_back(value_for(n));
+        batch.push_back({make_key(n), values.back(), 1});
+    }
+    batch.push_back({make_key(7), values[7], 2});
+
+    auto const progress = db.insert_batch(batch);
+    CHECK_FALSE(progress.error);
+    CHECK(progress.inserted == 20);
+    REQUIRE(progress.duplicates.size() == 1);
+    CHECK(progress.duplicates[0].height == 2);
+    CHECK(db.size() == 20);
+
+    db.close();
+    auto const refused = db.insert_batch(batch);
+    CHECK(refused.inserted == 0);
+    CHECK(refused.unapplied.size() == batch.size());
+    REQUIRE(refused.error);
+    CHECK(*refused.error == utxoz::error_code::closed);
+}
+
+TEST_CASE("apply_deletes: a large batch searches the active classes side by side",
+          "[insert_batch][deletion][concurrency]") {
+    auto const path = make_unique_path("delete");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 2500;
+    std::vector<std::vector<uint8_t>> values;
+    values.reserve(total);
+    std::vector<utxoz::insert_request> batch;
+    for (uint64_t n = 0; n < total; ++n) {
+        values.push_back(value_for(n));
+        batch.push_back({make_key(n), values.back(), 3});
+    }
+    REQUIRE(db.insert_batch(batch).inserted == total);
+
+    // Every stored key, a key named twice, and keys never stored.
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = 0; n < total; ++n) spends.emplace_back(make_key(n), 9);
+    spends.emplace_back(make_key(17), 10);
+    for (uint64_t n = total; n < total + 200; ++n) spends.emplace_back(make_key(n), 9);
+    REQUIRE(spends.size() >= utxoz::db_base::min_parallel_batch);
+
+    auto const progress = db.apply_deletes(spends);
+    REQUIRE_FALSE(progress.error);
+    CHECK(progress.erased.size() == total);
+    CHECK(progress.absent.size() == 200);
+    CHECK(progress.unresolved.empty());
+    CHECK(db.size() == 0);
+
+    // The first occurrence of the repeated key is the one reported.
+    auto const repeated = std::ranges::find_if(progress.erased, [](auto const& e) {
+        return e.key == make_key(17);
+    });
+    REQUIRE(repeated != progress.erased.end());
+    CHECK(repeated->height == 9);
+
+    for (uint64_t n = 0; n < total; n += 97) {
+        CHECK(db.find(make_key(n), 11).error() == utxoz::error_code::not_resolved);
+    }
+    db.close();
+}
@@ -0,0 +1,244 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_latency.cpp
+ * @brief The latency histograms: which series exist, what lands in each, how
+ *        often a sampled operation is timed, and the JSON.
+ *
+ * Nothing here asserts a duration. A test that said a find takes under some
+ * number of nanoseconds would be a test of the machine; what is pinned is where
+ * each timed call is counted and how many are.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <boost/json.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/config.hpp>
+#include <utxoz/database.hpp>
+#include <utxoz/statistics.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+namespace fs = std::filesystem;
+
+using utxoz::latency_op;
+using utxoz::latency_series;
+using utxoz::latency_snapshot;
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> latency_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_latency_{}_{}_{}_{}", tag, getpid(), ts, latency_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x1A;
+    return key;
+}
+
+/// Class 0 at 20 bytes, class 1 at 80.
+std::vector<uint8_t> make_value(size_t size) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), uint8_t(3));
+    return v;
+}
+
+latency_series const& series_of(latency_snapshot const& snapshot, latency_op op, size_t cls) {
+    for (auto const& s : snapshot.series) {
+        if (s.op == op && s.container_class == cls) return s;
+    }
+    FAIL("no series for " << utxoz::to_string(op) << " in class " << cls);
+    return snapshot.series.front();
+}
+
+} // anonymous namespace
+
+TEST_CASE("latency: every series a mode can record is there, empty or not", "[latency]") {
+    auto const path = make_unique_path("shape");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    SECTION("full") {
+        auto opened = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(opened);
+        auto const snapshot = opened->get_latency_snapshot();
+        CHECK(snapshot.mode == utxoz::storage_mode::full);
+#if UTXOZ_STATISTICS_LEVEL >= 1
+        // insert, find, rotation and merge per class; find once more for the
+        // misses; resolve and apply_deletes once.
+        CHECK(snapshot.series.size() == 4 * utxoz::container_count + 3);
+        for (auto const& s : snapshot.series) CHECK(s.count == 0);
+        CHECK(series_of(snapshot, latency_op::find, utxoz::unattributed_class).count == 0);
+#else
+        CHECK(snapshot.statistics_level == "off");
+        CHECK(snapshot.series.empty());
+#endif
+        opened->close();
+    }
+
+    SECTION("reference") {
+        auto opened = utxoz::reference_db::open_for_testing(path, true);
+        REQUIRE(opened);
+        auto const snapshot = opened->get_latency_snapshot();
+#if UTXOZ_STATISTICS_LEVEL >= 1
+        CHECK(snapshot.series.size() == 7);
+        for (auto const& s : snapshot.series) {
+            CHECK((s.container_class == utxoz::reference_class
+                   || s.container_class == utxoz::unattributed_class));
+        }
+#else
+        CHECK(snapshot.series.empty());
+#endif
+        opened->close();
+    }
+}
+
+#if UTXOZ_STATISTICS_LEVEL >= 1
+TEST_CASE("latency: each call is counted in its operation and class, sampled ones one in the interval",
+          "[latency]") {
+    auto const path = make_unique_path("counts");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Any run of `interval` consecutive calls on one thread holds exactly one
+    // timed call, wherever the countdown stood when it began.
+    constexpr uint64_t interval = utxoz::latency_sample_interval;
+    constexpr uint64_t runs = 10;
+
+    for (uint64_t n = 0; n < interval * runs; ++n) {
+        REQUIRE(db.insert(make_key(n), make_value(20), 100).value());
+    }
+    for (uint64_t n = 0; n < interval * runs; ++n) {
+        REQUIRE(db.insert(make_key(1'000'000 + n), make_value(80), 100).value());
+    }
+    for (uint64_t n = 0; n < interval * runs; ++n) {
+        REQUIRE(db.find(make_key(n), 200).has_value());
+    }
+    for (uint64_t n = 0; n < interval * runs; ++n) {
+        REQUIRE_FALSE(db.find(make_key(5'000'000 + n), 200).has_value());
+    }
+
+    std::vector<utxoz::lookup_request> lookups{{make_key(5'000'000), 200}};
+    REQUIRE(db.resolve(lookups).has_value());
+    REQUIRE(db.resolve(lookups).has_value());
+    std::vector<utxoz::deferred_deletion_entry> spends{{make_key(0), 300}};
+    REQUIRE(db.apply_deletes(spends).erased.size() == 1);
+
+    auto snapshot = db.get_latency_snapshot();
+    CHECK(snapshot.statistics_level != "off");
+    CHECK(series_of(snapshot, latency_op::insert, 0).count == runs);
+    CHECK(series_of(snapshot, latency_op::insert, 1).count == runs);
+    CHECK(series_of(snapshot, latency_op::insert, 2).count == 0);
+    CHECK(series_of(snapshot, latency_op::find, 0).count == runs);
+    CHECK(series_of(snapshot, latency_op::find, 1).count == 0);
+    CHECK(series_of(snapshot, latency_op::find, utxoz::unattributed_class).count == runs);
+    CHECK(series_of(snapshot, latency_op::resolve, utxoz::unattributed_class).count == 2);
+    CHECK(series_of(snapshot, latency_op::apply_deletes, utxoz::unattributed_class).count == 1);
+    CHECK(series_of(snapshot, latency_op::rotation, 0).count == 0);
+
+    // Rare operations are timed every time, in the class they happened in.
+    failpoints::force_rotations.store(1, std::memory_order_relaxed);
+    REQUIRE(db.insert(make_key(9'000'000), make_value(20), 101).value());
+    REQUIRE(db.compact_all().has_value());
+
+    snapshot = db.get_latency_snapshot();
+    CHECK(series_of(snapshot, latency_op::rotation, 0).count == 1);
+    CHECK(series_of(snapshot, latency_op::rotation, 1).count == 0);
+    CHECK(series_of(snapshot, latency_op::merge, 0).count >= 1);
+    CHECK(series_of(snapshot, latency_op::merge, 1).count == 0);
+
+    // A series agrees with itself: the count is its buckets, and no quantile is
+    // below the one before it.
+    auto const& rotation = series_of(snapshot, latency_op::rotation, 0);
+    CHECK(rotation.histogram.total() == rotation.count);
+    CHECK(rotation.total_ns > 0);
+    auto const& found = series_of(snapshot, latency_op::find, 0);
+    CHECK(found.percentile_ns(0.5) <= found.percentile_ns(0.99));
+    CHECK(found.percentile_ns(0.99) <= found.percentile_ns(1.0));
+
+    db.reset_latency_stats();
+    for (auto const& s : db.get_latency_snapshot().series) CHECK(s.count == 0);
+
+    db.close();
+}
+#endif
+
+TEST_CASE("latency: the JSON parses and names every series", "[latency]") {
+    auto const path = make_unique_path("json");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    REQUIRE(opened->insert(make_key(1), make_value(20), 100).value());
+    REQUIRE(opened->find(make_key(1), 200).has_value());
+
+    auto const snapshot = opened->get_latency_snapshot();
+    auto const json = to_json(snapshot);
+    INFO(json);
+    std::error_code ec;
+    auto const parsed = boost::json::parse(json, ec);
+    REQUIRE_FALSE(ec);
+    auto const& root = parsed.as_object();
+
+    CHECK(root.at("schema_version").as_int64() == latency_snapshot::schema_version);
+    CHECK(root.at("statistics_level").as_string() == snapshot.statistics_level);
+    CHECK(root.at("unit").as_string() == "ns");
+    auto const& series = root.at("series").as_array();
+    REQUIRE(series.size() == snapshot.series.size());
+
+    for (size_t i = 0; i < series.size(); ++i) {
+        auto const& s = series[i].as_object();
+        CHECK(s.at("op").as_string() == utxoz::to_string(snapshot.series[i].op));
+        CHECK(uint64_t(s.at("count").as_int64()) == snapshot.series[i].count);
+        CHECK(int64_t(s.at("sample_interval").as_int64())
+              == utxoz::latency_sample_interval_of(snapshot.series[i].op));
+
+        // The buckets listed add up to the count: none dropped, none invented.
+        uint64_t listed = 0;
+        for (auto const& b : s.at("buckets").as_array()) listed += uint64_t(b.as_array()[2].as_int64());
+        CHECK(listed == snapshot.series[i].count);
+    }
+
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    CHECK(json.find(R"("container_class": "unattributed")") != std::string::npos);
+#endif
+    opened->close();
+}
@@ -0,0 +1,276 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_manifest.cpp
+ * @brief The manifest: what an open skips when it believes one, and every way
+ *        of not believing it.
+ *
+ * The observable for "skipped" is the segment counter: an open that takes the
+ * manifest maps the active generations and nothing else, where a scan maps every
+ * sealed one too. Each case that makes the manifest wrong checks the open fell
+ * back to the scan and still came out with the right size, because a manifest
+ * believed when it should not be is a wrong size() for the life of the instance.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/manifest_io.hpp"
+#include "detail/scope_exit.hpp"
+
+namespace fs = std::filesystem;
+
+using utxoz::detail::failpoints;
+using utxoz::detail::manifest_file_name;
+using utxoz::detail::manifest_state;
+using utxoz::detail::read_manifest_file;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> mf_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_mf_{}_{}_{}_{}", tag, getpid(), ts, mf_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x4D;
+    return key;
+}
+
+/// Every value in class 0, which is the class the cases rotate.
+std::vector<uint8_t> value_for(uint64_t n) {
+    std::vector<uint8_t> v(20);
+    std::iota(v.begin(), v.end(), uint8_t(n * 7));
+    return v;
+}
+
+std::vector<uint8_t> read_bytes(fs::path const& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+}
+
+void write_bytes(fs::path const& path, std::vector<uint8_t> const& bytes) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    REQUIRE(ofs);
+    ofs.write(reinterpret_cast<char const*>(bytes.data()), std::streamsize(bytes.size()));
+}
+
+uint64_t mapped() {
+    return failpoints::segments_mapped.load(std::memory_order_relaxed);
+}
+
+/**
+ * Class 0 with `sealed` generations behind its active one, some of their
+ * entries spent, closed cleanly. Returns the size the database closed at.
+ */
+size_t build_sealed(std::string const& path, size_t sealed) {
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t per_round = 200;
+    for (uint64_t round = 0; round <= sealed; ++round) {
+        if (round > 0) failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        for (uint64_t n = round * per_round; n < (round + 1) * per_round; ++n) {
+            REQUIRE(db.insert(make_key(n), value_for(n), 100 + uint32_t(round)).value());
+        }
+    }
+    REQUIRE(db.get_statistics().rotations_per_container[0] == sealed);
+
+    // Spent out of the sealed generations, so the count the manifest records
+    // is not simply what was inserted.
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = 0; n < sealed * per_round; n += 3) spends.emplace_back(make_key(n), 900);
+    REQUIRE(db.apply_deletes(spends).erased.size() == spends.size());
+
+    auto const size = db.size();
+    db.close();
+    return size;
+}
+
+} // anonymous namespace
+
+TEST_CASE("manifest: a clean close lets the next open map only the active generations",
+          "[manifest]") {
+    auto const path = make_unique_path("trusted");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    constexpr size_t sealed = 4;
+    auto const size = build_sealed(path, sealed);
+
+    auto const recorded = read_manifest_file(fs::path(path) / manifest_file_name);
+    REQUIRE(recorded);
+    CHECK(recorded->state == manifest_state::closed);
+    CHECK(recorded->entries == size);
+    CHECK(recorded->classes[0].generations.size() == sealed + 1);
+
+    {
+        auto const before = mapped();
+        auto opened = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE(opened);
+        CHECK(mapped() - before == utxoz::container_count);
+        CHECK(opened->size() == size);
+
+        // The sealed generations are still there to be read when asked for.
+        size_t walked = 0;
+        REQUIRE(opened->for_each_key([&](utxoz::raw_outpoint const&) { ++walked; }));
+        CHECK(walked == size);
+        opened->close();
+    }
+
+    // The control: the same directory scanned maps every sealed generation too,
+    // and arrives at the same size.
+    failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
+    auto const before = mapped();
+    auto opened = utxoz::full_db::open_for_testing(path, false);
+    REQUIRE(opened);
+    CHECK(mapped() - before == utxoz::container_count + sealed);
+    CHECK(opened->size() == size);
+    opened->close();
+}
+
+TEST_CASE("manifest: an open writer, a stale record and a damaged one are all scanned past",
+          "[manifest]") {
+    auto const path = make_unique_path("distrust");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    constexpr size_t sealed = 2;
+    auto size = build_sealed(path, sealed);
+    auto const manifest_path = fs::path(path) / manifest_file_name;
+    auto const stale = read_bytes(manifest_path);
+
+    {
+        auto opened = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE(opened);
+
+        // From the open on, what is on disk says a writer has it.
+        auto const during = read_manifest_file(manifest_path);
+        REQUIRE(during);
+        CHECK(during->state == manifest_state::open);
+
+        for (uint64_t n = 10000; n < 10050; ++n) {
+            REQUIRE(opened->insert(make_key(n), value_for(n), 300).value());
+        }
+        size = opened->size();
+        opened->close();
+    }
+
+    SECTION("a writer that never closed") {
+        // What a crash leaves: the `open` record the claim wrote.
+        {
+            auto opened = utxoz::full_db::open_for_testing(path, false);
+            REQUIRE(opened);
+            auto const claimed = read_bytes(manifest_path);
+            opened->close();
+            write_bytes(manifest_path, claimed);
+        }
+        auto const before = mapped();
+        auto opened = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE(opened);
+        CHECK(mapped() - before == utxoz::container_count + sealed);
+        CHECK(opened->size() == size);
+        opened->close();
+    }
+
+    SECTION("a closed record from before the last writer") {
+        // Same generations, same names: only the active sizes give it away.
+        write_bytes(manifest_path, stale);
+        auto opened = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE(opened);
+        CHECK(opened->size() == size);
+        opened->close();
+    }
+
+    SECTION("a record damaged in place") {
+        auto bytes = read_bytes(manifest_path);
+        REQUIRE(bytes.size() > 40);
+        bytes[40] ^= 0xFF;
+        write_bytes(manifest_path, bytes);
+        auto const before = mapped();
+        auto opened = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE(opened);
+        CHECK(mapped() - before == utxoz::container_count + sealed);
+        CHECK(opened->size() == size);
+        opened->close();
+    }
+
+    SECTION("a generation the record does not list") {
+        fs::copy_file(fs::path(path) / "cont_0_v00000.dat", fs::path(path) / "cont_0_v00099.dat");
+        // Believed, the record would open without it. Scanned, the stray is
+        // the newest generation, so it is opened as the active one and
+        // refused by its stamp for being version 0 under another name.
+        auto const opened = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE_FALSE(opened);
+        CHECK(opened.error() == utxoz::error_code::segment_misplaced);
+    }
+}
+
+TEST_CASE("manifest: a sealed generation swapped in after the close is refused where it is mapped",
+          "[manifest][format]") {
+    auto const a = make_unique_path("swap_a");
+    auto const b = make_unique_path("swap_b");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(a, ec);
+        fs::remove_all(b, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    build_sealed(a, 2);
+    build_sealed(b, 2);
+
+    // Same name, same shape, another database's. Nothing the trusted open
+    // looks at can tell; the stamp can, the first time the file is mapped.
+    auto const victim = fs::path(a) / "cont_0_v00000.dat";
+    fs::remove(victim);
+    fs::copy_file(fs::path(b) / "cont_0_v00000.dat", victim);
+
+    {
+        auto opened = utxoz::full_db::open_for_testing(a, false);
+        REQUIRE(opened);
+        auto const walked = opened->for_each_key([](utxoz::raw_outpoint const&) {});
+        REQUIRE_FALSE(walked);
+        CHECK(walked.error() == utxoz::error_code::database_identity_mismatch);
+        opened->close();
+    }
+
+    // A scan refuses it at open, as before the manifest.
+    failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
+    auto const scanned = utxoz::full_db::open_for_testing(a, false);
+    REQUIRE_FALSE(scanned);
+    CHECK(scanned.error() == utxoz::error_code::database_identity_mismatch);
+}
@@ -50,7 +50,9 @@
 
 #include <utxoz/database.hpp>
 
+#include "detail/durability.hpp"
 #include "detail/segment_open.hpp"
+#include "detail/scope_exit.hpp"
 #include "detail/segment_stamp.hpp"
 #include "detail/store_config_io.hpp"
 
@@ -58,6 +60,7 @@ namespace bip = boost::interprocess;
 namespace fs = std::filesystem;
 
 using utxoz::detail::find_single_named;
+using utxoz::detail::scope_exit;
 
 namespace {
 
@@ -278,6 +281,11 @@ TEST_CASE("full: open refuses a catalogued version whose map cannot be reached",
     // would publish a size() short by whatever it held, and that count is a
     // running total for the life of the instance.
     two_versions f("open_full");
+    // The scan's refusal. After a clean close the open believes the manifest
+    // and leaves this file unmapped; test_manifest.cpp pins where it is
+    // refused then.
+    utxoz::detail::failpoints::scoped_reset const disarm;
+    utxoz::detail::failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
     // The stamp is kept, so what is missing is the map and only the map. Without
     // that the file would be refused one check earlier and this case would be
     // pinning the stamp rather than what it says it pins.
@@ -290,6 +298,11 @@ TEST_CASE("full: open refuses a catalogued version whose map cannot be reached",
 
 TEST_CASE("reference: open refuses a catalogued version whose map cannot be reached", "[guard]") {
     two_reference_versions f("open_ref");
+    // The scan's refusal. After a clean close the open believes the manifest
+    // and leaves this file unmapped; test_manifest.cpp pins where it is
+    // refused then.
+    utxoz::detail::failpoints::scoped_reset const disarm;
+    utxoz::detail::failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
     blank_the_map_keeping_the_stamp(f.dir, f.historical(),
                                     utxoz::detail::reference_container_kind, 0);
 
@@ -304,6 +317,11 @@ TEST_CASE("open tells a version it cannot open from one it cannot read", "[guard
     // blanking the map leaves a segment that opens perfectly and holds nothing
     // usable. Collapsing them would send an operator looking in the wrong place.
     two_versions f("open_kinds");
+    // The scan's refusal. After a clean close the open believes the manifest
+    // and leaves this file unmapped; test_manifest.cpp pins where it is
+    // refused then.
+    utxoz::detail::failpoints::scoped_reset const disarm;
+    utxoz::detail::failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
     {
         std::ofstream ofs(f.historical(), std::ios::binary | std::ios::trunc);
         ofs << "far too small to be a segment";
@@ -314,6 +332,50 @@ TEST_CASE("open tells a version it cannot open from one it cannot read", "[guard
     CHECK(db.error() == utxoz::error_code::file_open_failed);
 }
 
+TEST_CASE("open reports the first unreadable version in class order, however it reads them",
+          "[guard]") {
+    // The sealed generations of every class are read side by side now. Two
+    // damaged ones, in two classes, with two different faults: the answer is
+    // class 0's, as it was when the classes were read one after another, and
+    // not whichever thread happened to finish first.
+    utxoz::detail::failpoints::scoped_reset const disarm;
+    utxoz::detail::failpoints::ignore_manifest.store(true, std::memory_order_relaxed);
+
+    auto const dir = make_unique_path("open_order");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    });
+    {
+        auto opened = utxoz::full_db::open_for_testing(dir, true);
+        REQUIRE(opened.has_value());
+        auto db = std::move(*opened);
+        for (uint64_t n = 0; n < 40; ++n) {
+            // Class 0 and class 2, each rotated once half way.
+            if (n == 20 || n == 21) {
+                utxoz::detail::failpoints::force_rotations.store(1, std::memory_order_relaxed);
+            }
+            std::vector<uint8_t> const value(n % 2 == 0 ? 8 : 100, 0xCD);
+            REQUIRE(db.insert(outpoint_of(n), value, 700000).has_value());
+        }
+        db.close();
+    }
+    REQUIRE(count_files(dir, "cont_0_v") == 2);
+    REQUIRE(count_files(dir, "cont_2_v") == 2);
+
+    blank_the_map_keeping_the_stamp(dir, dir / "cont_0_v00000.dat", 0, 0);
+    {
+        std::ofstream ofs(dir / "cont_2_v00000.dat", std::ios::binary | std::ios::trunc);
+        ofs << "far too small to be a segment";
+    }
+
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        auto const db = utxoz::full_db::open_for_testing(dir, false);
+        REQUIRE_FALSE(db.has_value());
+        CHECK(db.error() == utxoz::error_code::version_unreadable);
+    }
+}
+
 TEST_CASE("an intact history opens and counts everything", "[guard]") {
     // The control for the three above. Without it they would equally be pinning
     // "any database with a historical version fails to open".
@@ -0,0 +1,280 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_openmetrics.cpp
+ * @brief The OpenMetrics exposition: well formed, stable, and fed by the
+ *        counter view rather than by get_statistics().
+ *
+ * Checked line by line against the parts of the format a scraper rejects a
+ * document for — a sample with no family, a family split in two, a counter
+ * without `_total`, a histogram whose buckets go down or whose `+Inf` is not its
+ * count, no `# EOF` — and then for the values, because a well-formed document of
+ * wrong numbers is the worse failure.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/config.hpp>
+#include <utxoz/database.hpp>
+#include <utxoz/statistics.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+namespace fs = std::filesystem;
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> om_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_om_{}_{}_{}_{}", tag, getpid(), ts, om_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x0E;
+    return key;
+}
+
+std::vector<uint8_t> make_value(size_t size) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), uint8_t(5));
+    return v;
+}
+
+/// The name of a sample line: everything before `{` or the first space.
+std::string sample_name(std::string const& line) {
+    return line.substr(0, line.find_first_of("{ "));
+}
+
+/// The family a sample belongs to, given the families declared so far.
+std::string family_of(std::string const& name, std::map<std::string, std::string> const& types) {
+    for (auto const* suffix : {"_total", "_bucket", "_count", "_sum", "_info"}) {
+        std::string_view const s(suffix);
+        if (name.size() > s.size() && name.ends_with(s)) {
+            auto const stem = name.substr(0, name.size() - s.size());
+            if (types.contains(stem)) return stem;
+        }
+    }
+    return name;
+}
+
+/// The value of the one sample `line_prefix` starts, as text.
+std::string value_of(std::string const& text, std::string const& line_prefix) {
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line); ) {
+        if (line.starts_with(line_prefix + " ")) return line.substr(line_prefix.size() + 1);
+    }
+    FAIL("no sample " << line_prefix);
+    return {};
+}
+
+/// Checks the structure; returns the families in order.
+std::vector<std::string> check_well_formed(std::string const& text) {
+    REQUIRE(text.ends_with("# EOF\n"));
+
+    std::map<std::string, std::string> types;
+    std::vector<std::string> order;
+    std::set<std::string> closed;
+    std::string current;
+    std::map<std::string, double> last_bucket;
+
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line); ) {
+        INFO(line);
+        if (line == "# EOF") continue;
+        if (line.starts_with("# TYPE ")) {
+            std::istringstream fields(line.substr(7));
+            std::string name, type;
+            fields >> name >> type;
+            // Declared once, and only after the previous family is finished.
+            REQUIRE_FALSE(types.contains(name));
+            if ( ! current.empty()) closed.insert(current);
+            types[name] = type;
+            order.push_back(name);
+            current = name;
+            continue;
+        }
+        if (line.starts_with("# ")) continue;
+
+        auto const name = sample_name(line);
+        auto const family = family_of(name, types);
+        REQUIRE(types.contains(family));
+        CHECK(family == current);
+        CHECK_FALSE(closed.contains(family));
+
+        auto const& type = types[family];
+        if (type == "counter") CHECK(name.ends_with("_total"));
+        if (type == "histogram" && name.ends_with("_bucket")) {
+            // Cumulative within a series: the series is the label set without `le`.
+            auto const series = line.substr(0, line.find("le=\""));
+            auto const value = std::stod(line.substr(line.rfind(' ') + 1));
+            if (last_bucket.contains(series)) CHECK(value >= last_bucket[series]);
+            last_bucket[series] = value;
+        }
+    }
+    return order;
+}
+
+} // anonymous namespace
+
+TEST_CASE("openmetrics: the exposition is well formed and names what it counts",
+          "[openmetrics]") {
+    auto const path = make_unique_path("shape");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    for (uint64_t n = 0; n < 300; ++n) REQUIRE(db.insert(make_key(n), make_value(20), 100).value());
+    for (uint64_t n = 0; n < 7; ++n) REQUIRE(db.insert(make_key(1000 + n), make_value(80), 100).value());
+    failpoints::force_rotations.store(1, std::memory_order_relaxed);
+    REQUIRE(db.insert(make_key(2000), make_value(20), 101).value());
+    for (uint64_t n = 0; n < 50; ++n) REQUIRE(db.find(make_key(n), 200).has_value());
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = 0; n < 10; ++n) spends.emplace_back(make_key(n), 150);
+    REQUIRE(db.apply_deletes(spends).erased.size() == 10);
+
+    auto const text = db.to_openmetrics();
+    INFO(text);
+    auto const families = check_well_formed(text);
+
+    // Every build, whatever its level.
+    for (auto const* name : {"utxoz_build", "utxoz_entries", "utxoz_class_entries",
+                             "utxoz_inserts", "utxoz_rotations", "utxoz_rotation_failures",
+                             "utxoz_finds", "utxoz_resolved_keys", "utxoz_file_cache_hit_ratio",
+                             "utxoz_spent_age_blocks", "utxoz_group_commit_requests",
+                             "utxoz_class_bytes"}) {
+        CHECK(std::ranges::find(families, name) != families.end());
+    }
+    CHECK(value_of(text, "utxoz_entries") == fmt::format("{}", db.size()));
+    CHECK(value_of(text, R"(utxoz_rotations_total{class="0",cause="preventive"})") == "1");
+    CHECK(value_of(text, R"(utxoz_rotations_total{class="1",cause="preventive"})") == "0");
+
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    CHECK(value_of(text, R"(utxoz_inserts_total{class="0"})") == "301");
+    CHECK(value_of(text, R"(utxoz_inserts_total{class="1"})") == "7");
+    CHECK(value_of(text, R"(utxoz_finds_total{outcome="answered"})") == "50");
+    CHECK(value_of(text, "utxoz_spent_age_blocks_count") == "10");
+    CHECK(value_of(text, R"(utxoz_spent_age_blocks_bucket{le="+Inf"})") == "10");
+    CHECK(value_of(text, "utxoz_spent_age_blocks_sum") == "500");
+
+    // The latency histograms, one series per operation and class.
+    CHECK(std::ranges::find(families, "utxoz_operation_latency_seconds") != families.end());
+    CHECK(value_of(text, R"(utxoz_operation_latency_seconds_count{class="0",op="rotation"})") == "1");
+    CHECK(value_of(text, R"(utxoz_operation_latency_seconds_count{class="unattributed",op="apply_deletes"})") == "1");
+    CHECK(value_of(text, R"(utxoz_operation_latency_sample_interval{op="find"})")
+          == fmt::format("{}", utxoz::latency_sample_interval));
+#else
+    CHECK(value_of(text, R"(utxoz_build_info{statistics_level="off",storage_mode="full"})") == "1");
+    CHECK(std::ranges::find(families, "utxoz_operation_latency_seconds") == families.end());
+#endif
+
+    // The per-class read path only where it was collected.
+#if UTXOZ_STATISTICS_LEVEL >= 2
+    CHECK(value_of(text, R"(utxoz_lookup_answered_active_total{class="0"})") == "50");
+#else
+    CHECK(std::ranges::find(families, "utxoz_lookup_answered_active") == families.end());
+#endif
+
+    db.close();
+}
+
+TEST_CASE("openmetrics: reference mode labels its one class as reference", "[openmetrics]") {
+    auto const path = make_unique_path("reference");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::reference_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    REQUIRE(opened->insert(make_key(1), 7, 64, 100).value());
+
+    auto const text = opened->to_openmetrics();
+    INFO(text);
+    check_well_formed(text);
+    CHECK(text.find(R"(class="0")") == std::string::npos);
+    CHECK(text.find(R"(utxoz_class_entries{class="reference"})") != std::string::npos);
+    CHECK(text.find(R"(storage_mode="reference")") != std::string::npos);
+    opened->close();
+}
+
+TEST_CASE("openmetrics: the counter view agrees with get_statistics on every counter",
+          "[openmetrics]") {
+    auto const path = make_unique_path("agree");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    for (uint64_t n = 0; n < 100; ++n) REQUIRE(db.insert(make_key(n), make_value(20 + n % 3 * 40), 100).value());
+    for (uint64_t n = 0; n < 40; ++n) (void) db.find(make_key(n * 3), 200);
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = 0; n < 20; ++n) spends.emplace_back(make_key(n), 180);
+    REQUIRE(db.apply_deletes(spends).erased.size() == 20);
+
+    auto const cheap = db.get_counter_statistics();
+    auto const full = db.get_statistics();
+
+    CHECK(cheap.total_entries == full.total_entries);
+    CHECK(cheap.total_inserts == full.total_inserts);
+    CHECK(cheap.total_deletes == full.total_deletes);
+    for (size_t c = 0; c < utxoz::container_count; ++c) {
+        CHECK(cheap.containers[c].total_inserts == full.containers[c].total_inserts);
+        CHECK(cheap.containers[c].current_size == full.containers[c].current_size);
+        CHECK(cheap.rotations_per_container[c] == full.rotations_per_container[c]);
+        CHECK(cheap.rotations_by_cause[c].completed() == full.rotations_by_cause[c].completed());
+        // Sizes come from the published snapshot in both.
+        CHECK(cheap.memory_usage_per_container[c] == full.memory_usage_per_container[c]);
+        CHECK(cheap.memory_usage_per_container[c] > 0);
+        CHECK(cheap.fragmentation.fill_ratios[c] == full.fragmentation.fill_ratios[c]);
+        // What the counter view leaves out, it leaves empty.
+        CHECK(cheap.containers[c].value_size_distribution.empty());
+    }
+    CHECK(cheap.probes.probes == full.probes.probes);
+    CHECK(cheap.resolution.resolved == full.resolution.resolved);
+    CHECK(cheap.lifetime.total_spent == full.lifetime.total_spent);
+    CHECK(cheap.lifetime.average_age == full.lifetime.average_age);
+    CHECK(cheap.deferred.successfully_processed == full.deferred.successfully_processed);
+    CHECK(cheap.lookups.statistics_level == full.lookups.statistics_level);
+    CHECK(cheap.cached_files_info.empty());
+
+    db.close();
+}
@@ -0,0 +1,212 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_parallel_compaction.cpp
+ * @brief Merging several classes at once: the space they claim together, and
+ *        that the database they leave is the one the sequential walk leaves.
+ *
+ * The ledger is exercised directly, because the cases that matter — two targets
+ * that fit only one at a time, a budget that makes the second wait — need a
+ * filesystem that is nearly full, and no test should have to make one. Then one
+ * database with two classes to merge, compacted on two threads.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+#include "detail/merge_space.hpp"
+
+using utxoz::detail::merge_space_ledger;
+
+namespace {
+
+auto free_space(uint64_t bytes) {
+    return [bytes]() -> std::optional<uint64_t> { return bytes; };
+}
+
+} // anonymous namespace
+
+TEST_CASE("claims in flight count against the free space", "[compaction][parallel]") {
+    merge_space_ledger ledger;
+
+    auto first = ledger.acquire(600, free_space(1000));
+    REQUIRE(first.has_value());
+    CHECK(ledger.claimed() == 600);
+
+    // Each fits on its own; together they do not.
+    auto second = ledger.acquire(600, free_space(1000));
+    REQUIRE( ! second.has_value());
+    CHECK(second.error() == utxoz::error_code::insufficient_space);
+    CHECK(ledger.claimed() == 600);
+
+    // A filesystem that cannot say is not a refusal.
+    auto unknown = ledger.acquire(600, []() -> std::optional<uint64_t> { return std::nullopt; });
+    CHECK(unknown.has_value());
+
+    *first = {};
+    *unknown = {};
+    CHECK(ledger.claimed() == 0);
+    CHECK(ledger.acquire(600, free_space(1000)).has_value());
+}
+
+TEST_CASE("a claim released early is released once", "[compaction][parallel]") {
+    merge_space_ledger ledger;
+
+    auto written = ledger.acquire(600, free_space(1000));
+    REQUIRE(written.has_value());
+    auto held = ledger.acquire(300, free_space(1000));
+    REQUIRE(held.has_value());
+
+    // A target that has been written is counted by the filesystem, not here.
+    written->release();
+    CHECK(ledger.claimed() == 300);
+    written->release();
+    CHECK(ledger.claimed() == 300);
+
+    *written = {};
+    CHECK(ledger.claimed() == 300);
+    *held = {};
+    CHECK(ledger.claimed() == 0);
+}
+
+TEST_CASE("a budget is waited for, and a target larger than it runs alone",
+          "[compaction][parallel]") {
+    merge_space_ledger ledger;
+    ledger.set_budget(1000);
+
+    // Alone, a claim over the budget is granted rather than refused forever.
+    {
+        auto large = ledger.acquire(5000, free_space(1u << 20));
+        CHECK(large.has_value());
+    }
+    CHECK(ledger.claimed() == 0);
+
+    auto held = ledger.acquire(800, free_space(1u << 20));
+    REQUIRE(held.has_value());
+
+    std::atomic<bool> granted{false};
+    std::thread waiter([&] {
+        auto second = ledger.acquire(800, free_space(1u << 20));
+        granted.store(second.has_value());
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK( ! granted.load());
+
+    *held = {};
+    waiter.join();
+    CHECK(granted.load());
+    CHECK(ledger.claimed() == 0);
+}
+
+// =============================================================================
+// Through the database
+// =============================================================================
+
+namespace {
+
+inline std::atomic<uint64_t> pc_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_pc_{}_{}_{}_{}", tag, getpid(), ts, pc_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    return key;
+}
+
+std::vector<uint8_t> make_value(size_t size, uint8_t seed) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), seed);
+    return v;
+}
+
+size_t count_files(std::string const& path, std::string const& prefix) {
+    size_t n = 0;
+    for (auto const& entry : std::filesystem::directory_iterator(path)) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0) ++n;
+    }
+    return n;
+}
+
+} // anonymous namespace
+
+TEST_CASE("two classes merged on two threads leave what one thread leaves",
+          "[database][compaction][parallel]") {
+    auto const path = make_unique_path("two");
+    std::filesystem::remove_all(path);
+
+    {
+        auto r = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+
+        // Class 0 takes values of up to 43 bytes and class 1 up to 91. Each is
+        // filled until it rotates, so both have a sealed generation and an
+        // active one to merge it with.
+        uint64_t next = 0;
+        auto const fill_until_rotated = [&](size_t cls, size_t value_size) {
+            auto const rotations = [&] { return db.get_statistics().rotations_per_container[cls]; };
+            while (rotations() == 0) {
+                for (size_t i = 0; i < 1'000; ++i) {
+                    REQUIRE(db.insert(make_key(next++), make_value(value_size, 1), 100).has_value());
+                }
+            }
+        };
+        fill_until_rotated(0, 33);
+        fill_until_rotated(1, 80);
+        REQUIRE(count_files(path, "cont_0_v") == 2);
+        REQUIRE(count_files(path, "cont_1_v") == 2);
+
+        auto const size_before = db.size();
+
+        utxoz::compaction_concurrency concurrency;
+        concurrency.threads = 2;
+        REQUIRE(db.compact_all(concurrency).has_value());
+
+        CHECK(count_files(path, "cont_0_v") == 1);
+        CHECK(count_files(path, "cont_1_v") == 1);
+        CHECK(db.size() == size_before);
+
+        // Every key, once.
+        std::vector<uint8_t> seen(next, 0);
+        (void)db.for_each_key([&](utxoz::raw_outpoint const& k) {
+            uint64_t n = 0;
+            std::memcpy(&n, k.data(), sizeof(n));
+            if (n < seen.size()) ++seen[n];
+        });
+        CHECK(std::ranges::all_of(seen, [](uint8_t c) { return c == 1; }));
+
+        // Both active containers are back.
+        REQUIRE(db.insert(make_key(next++), make_value(33, 2), 300).has_value());
+        REQUIRE(db.insert(make_key(next++), make_value(80, 2), 300).has_value());
+
+        db.close();
+    }
+
+    std::filesystem::remove_all(path);
+}
@@ -0,0 +1,272 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_reader.cpp
+ * @brief full_reader: following a writer it shares nothing with but a directory.
+ *
+ * The writer and the reader are in one process here, which changes nothing the
+ * reader relies on: it takes no claim, maps its own read-only copies of the
+ * files, and learns about rotations, merges and reopens only from the board.
+ * Each case makes the writer change one of those and checks the reader's next
+ * answer is the writer's.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+#include <utxoz/reader.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> rd_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_rd_{}_{}_{}_{}", tag, getpid(), ts, rd_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x3C;
+    return key;
+}
+
+/// One payload size per class, each well inside it.
+constexpr std::array<size_t, utxoz::container_count> class_value_size{30, 70, 110, 200, 600};
+
+std::vector<uint8_t> value_for(uint64_t n) {
+    std::vector<uint8_t> v(class_value_size[n % utxoz::container_count]);
+    std::iota(v.begin(), v.end(), uint8_t(n * 11));
+    return v;
+}
+
+void insert_range(utxoz::full_db& db, uint64_t first, uint64_t last, uint32_t height) {
+    for (uint64_t n = first; n < last; ++n) {
+        REQUIRE(db.insert(make_key(n), value_for(n), height).value());
+    }
+}
+
+std::vector<utxoz::deferred_deletion_entry> spends_of(uint64_t first, uint64_t last) {
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = first; n < last; ++n) spends.emplace_back(make_key(n), 9);
+    return spends;
+}
+
+} // anonymous namespace
+
+TEST_CASE("reader: sees the writer's inserts and deletes as they happen", "[reader]") {
+    auto const path = make_unique_path("live");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    insert_range(db, 0, 200, 3);
+
+    // No claim taken: the writer is still open.
+    auto reader = utxoz::full_reader::open(path);
+    REQUIRE(reader);
+    CHECK(reader->generations() == utxoz::container_count);
+
+    auto const first = reader->find(make_key(7));
+    REQUIRE(first);
+    CHECK(first->data == value_for(7));
+    CHECK(first->block_height == 3);
+    CHECK(reader->find(make_key(500)).error() == utxoz::error_code::not_found);
+
+    insert_range(db, 200, 300, 4);
+    REQUIRE(db.apply_deletes(spends_of(0, 50)).erased.size() == 50);
+
+    CHECK(reader->find(make_key(10)).error() == utxoz::error_code::not_found);
+    auto const later = reader->find(make_key(250));
+    REQUIRE(later);
+    CHECK(later->block_height == 4);
+
+    std::vector<utxoz::lookup_request> requests;
+    for (uint64_t n = 0; n < 300; ++n) requests.emplace_back(make_key(n), 10);
+    requests.emplace_back(make_key(299), 10);
+    auto const resolved = reader->resolve(requests);
+    REQUIRE(resolved);
+    CHECK(resolved->found.size() == 250);
+    CHECK(resolved->absent.size() == 50);
+
+    // The files stay as the writer left them.
+    db.close();
+    CHECK(reader->find(make_key(250)));
+
+    reader->close();
+    CHECK(reader->find(make_key(250)).error() == utxoz::error_code::closed);
+}
+
+TEST_CASE("reader: follows rotations and merges through the board", "[reader][compaction]") {
+    auto const path = make_unique_path("layout");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    // Class 0 small enough to rotate several times.
+    failpoints::scoped_reset const disarm;
+    failpoints::forced_capacity_index.store(0, std::memory_order_relaxed);
+    failpoints::forced_capacity.store(959, std::memory_order_relaxed);
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    auto reader = utxoz::full_reader::open(path);
+    REQUIRE(reader);
+    auto const opened_layout = reader->layout();
+
+    constexpr uint64_t total = 6000;
+    insert_range(db, 0, total, 3);
+    REQUIRE(db.get_statistics().rotations_per_container[0] > 0);
+
+    // Keys in class 0's sealed generations are where the reader now looks.
+    for (uint64_t n = 0; n < total; n += 5) {
+        auto const found = reader->find(make_key(n));
+        REQUIRE(found);
+        CHECK(found->data == value_for(n));
+    }
+    CHECK(reader->layout() > opened_layout);
+    auto const rotated = reader->generations();
+    CHECK(rotated > utxoz::container_count);
+
+    // Half of class 0 spent, then merged: the reader drops the sources.
+    REQUIRE(db.apply_deletes(spends_of(0, total / 2)).erased.size() == total / 2);
+    REQUIRE(db.compact_all());
+    REQUIRE(reader->refresh());
+    CHECK(reader->generations() < rotated);
+    for (uint64_t n = 0; n < total; n += 5) {
+        auto const found = reader->find(make_key(n));
+        if (n < total / 2) {
+            CHECK(found.error() == utxoz::error_code::not_found);
+        } else {
+            REQUIRE(found);
+            CHECK(found->data == value_for(n));
+        }
+    }
+    db.close();
+}
+
+TEST_CASE("reader: a writer reopening over a new database starts it over", "[reader]") {
+    auto const path = make_unique_path("reopen");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    {
+        auto opened = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(opened);
+        insert_range(*opened, 0, 100, 3);
+        opened->close();
+    }
+
+    auto reader = utxoz::full_reader::open(path);
+    REQUIRE(reader);
+    REQUIRE(reader->find(make_key(42)));
+
+    // Same version numbers, different database: nothing mapped survives.
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    REQUIRE(opened->insert(make_key(1000), value_for(1000), 5).value());
+
+    CHECK(reader->find(make_key(42)).error() == utxoz::error_code::not_found);
+    REQUIRE(reader->find(make_key(1000)));
+    opened->close();
+}
+
+TEST_CASE("reader: refusals", "[reader]") {
+    auto const path = make_unique_path("refuse");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    CHECK(utxoz::full_reader::open(path).error() == utxoz::error_code::database_not_found);
+    std::filesystem::create_directories(path);
+    CHECK(utxoz::full_reader::open(path).error() == utxoz::error_code::database_not_found);
+
+    {
+        auto opened = utxoz::reference_db::open_for_testing(path, true);
+        REQUIRE(opened);
+        opened->close();
+    }
+    CHECK(utxoz::full_reader::open(path).error() == utxoz::error_code::storage_mode_mismatch);
+}
+
+TEST_CASE("reader: another thread reads while the writer inserts and spends",
+          "[reader][concurrency]") {
+    auto const path = make_unique_path("thread");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Keys below `stable` are never touched again.
+    constexpr uint64_t stable = 1000;
+    insert_range(db, 0, stable, 3);
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> wrong{0};
+    std::atomic<size_t> reads{0};
+    std::thread reading([&] {
+        auto reader = utxoz::full_reader::open(path);
+        if ( ! reader) {
+            ++wrong;
+            return;
+        }
+        uint64_t n = 0;
+        while ( ! done.load(std::memory_order_acquire)) {
+            auto const found = reader->find(make_key(n));
+            if ( ! found || found->data != value_for(n)) ++wrong;
+            n = (n + 7) % stable;
+            ++reads;
+        }
+    });
+
+    for (uint64_t round = 0; round < 20; ++round) {
+        uint64_t const first = stable + round * 200;
+        insert_range(db, first, first + 200, 4);
+        REQUIRE(db.apply_deletes(spends_of(first, first + 150)).erased.size() == 150);
+    }
+    done.store(true, std::memory_order_release);
+    reading.join();
+
+    CHECK(wrong.load() == 0);
+    CHECK(reads.load() > 0);
+    db.close();
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_rebuild_active.cpp
+ * @brief Rebuilding an active generation whose growth point has drifted.
+ *
+ * The drift is produced the only way it can be: by filling a map well past the
+ * point where its groups overflow and then erasing most of it. The smallest
+ * class is used, because 959 buckets get there in under a thousand inserts.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+
+namespace {
+
+inline std::atomic<uint64_t> ra_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_ra_{}_{}_{}_{}", tag, getpid(), ts, ra_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    return key;
+}
+
+size_t count_files(std::string const& path, std::string const& prefix) {
+    size_t n = 0;
+    for (auto const& entry : std::filesystem::directory_iterator(path)) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0) ++n;
+    }
+    return n;
+}
+
+} // anonymous namespace
+
+TEST_CASE("a drifted active generation is rebuilt, and the rebuilt one has not drifted",
+          "[database][rebuild]") {
+    constexpr size_t cls = 4;
+    auto const path = make_unique_path("drift");
+    std::filesystem::remove_all(path);
+
+    std::vector<uint8_t> value(utxoz::container_capacities[cls]);
+    std::iota(value.begin(), value.end(), uint8_t(7));
+
+    {
+        auto r = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+
+        // 780 of the 797 the class operates to: full enough that groups have
+        // overflowed, short of rotating.
+        constexpr uint64_t inserted = 780;
+        constexpr uint64_t erased = 700;
+        for (uint64_t n = 0; n < inserted; ++n) {
+            REQUIRE(db.insert(make_key(n), value, 100).has_value());
+        }
+        REQUIRE(db.get_statistics().rotations_per_container[cls] == 0);
+
+        std::vector<utxoz::deferred_deletion_entry> batch;
+        for (uint64_t n = 0; n < erased; ++n) batch.emplace_back(make_key(n), 200);
+        REQUIRE(db.apply_deletes(batch).erased.size() == erased);
+
+        // Described, and left alone.
+        utxoz::rebuild_options never;
+        never.min_drift = 1.0;
+        auto const described = db.rebuild_active(never);
+        REQUIRE(described.has_value());
+        REQUIRE(described->size() == utxoz::container_count);
+        auto const before = (*described)[cls];
+        CHECK(before.container_class == cls);
+        CHECK(before.entries == inserted - erased);
+        CHECK(before.live_max_load < before.growth_point);
+        REQUIRE(before.drift > 0.0);
+        CHECK(std::ranges::none_of(*described, [](auto const& r) { return r.rebuilt; }));
+
+        // At exactly its own drift, so the empty classes — which have none — stay.
+        utxoz::rebuild_options options;
+        options.min_drift = before.drift;
+        auto const rebuilt = db.rebuild_active(options);
+        REQUIRE(rebuilt.has_value());
+        for (auto const& record : *rebuilt) {
+            CHECK(record.rebuilt == (record.container_class == cls));
+        }
+        auto const after = (*rebuilt)[cls];
+        CHECK(after.version == before.version);
+        CHECK(after.rebuilt_as > before.version);
+        CHECK(count_files(path, fmt::format("cont_{}_v", cls)) == 1);
+        CHECK(db.size() == inserted - erased);
+
+        // The same bucket count, and Boost's growth point back where a fresh map
+        // of that size has it.
+        auto const again = db.rebuild_active(never);
+        REQUIRE(again.has_value());
+        CHECK((*again)[cls].version == after.rebuilt_as);
+        CHECK((*again)[cls].bucket_count == before.bucket_count);
+        CHECK((*again)[cls].drift == 0.0);
+        CHECK((*again)[cls].live_max_load >= (*again)[cls].growth_point);
+
+        for (uint64_t n = 0; n < inserted; ++n) {
+            CHECK(db.find(make_key(n), 300).has_value() == (n >= erased));
+        }
+
+        // The rebuilt generation is the active one, and takes inserts.
+        REQUIRE(db.insert(make_key(inserted), value, 300).has_value());
+        CHECK(db.size() == inserted - erased + 1);
+        db.close();
+    }
+
+    {
+        auto r = utxoz::full_db::open_for_testing(path, false);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+        CHECK(db.size() == 780 - 700 + 1);
+        CHECK(db.find(make_key(779), 400).has_value());
+        db.close();
+    }
+
+    std::filesystem::remove_all(path);
+}
@@ -0,0 +1,261 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_sharded.cpp
+ * @brief sharded_db answers what one database would, and keeps its shard count.
+ *
+ * The set is several databases, each fed its share of a batch on a thread of
+ * its own, and none of that is supposed to show. So most of these cases ask the
+ * set a question and check the answer against what a single database is
+ * documented to give: every key findable where it was put, each distinct key in
+ * exactly one list, duplicates and resends reported in the order they were
+ * asked. The rest are about the one thing the set adds to the disk, the count,
+ * and that a reopen under another one is refused rather than followed.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/sharded.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> sh_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_sh_{}_{}_{}_{}", tag, getpid(), ts, sh_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    std::memcpy(key.data() + 8, &n, sizeof(n));
+    key[24] = 0x5D;
+    return key;
+}
+
+std::vector<uint8_t> value_for(uint64_t n) {
+    std::vector<uint8_t> v(40);
+    for (size_t i = 0; i < v.size(); ++i) v[i] = uint8_t(n + i);
+    return v;
+}
+
+constexpr size_t shards = 4;
+
+} // anonymous namespace
+
+TEST_CASE("sharded: the partition is stable and reaches every shard", "[sharded]") {
+    std::vector<size_t> hits(shards);
+    for (uint64_t n = 0; n < 4000; ++n) {
+        auto const s = utxoz::sharded_db::shard_of(make_key(n), shards);
+        REQUIRE(s < shards);
+        REQUIRE(s == utxoz::sharded_db::shard_of(make_key(n), shards));
+        ++hits[s];
+    }
+    // Not a uniformity test, only a guard against a partition that sends
+    // everything to one place.
+    for (auto const h : hits) CHECK(h > 4000 / shards / 2);
+
+    // The output index takes part: one transaction's outputs are spread too.
+    std::set<size_t> spread;
+    auto key = make_key(7);
+    for (uint32_t idx = 0; idx < 64; ++idx) {
+        std::memcpy(key.data() + 32, &idx, sizeof(idx));
+        spread.insert(utxoz::sharded_db::shard_of(key, shards));
+    }
+    CHECK(spread.size() == shards);
+}
+
+TEST_CASE("sharded: a batch is inserted, found and deleted as one database would",
+          "[sharded]") {
+    auto const path = make_unique_path("batch");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::sharded_db::open_for_testing(path, shards, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    REQUIRE(db.shard_count() == shards);
+
+    constexpr uint64_t total = 3000;
+    std::vector<std::vector<uint8_t>> values;
+    values.reserve(total);
+    std::vector<utxoz::insert_request> batch;
+    for (uint64_t n = 0; n < total; ++n) {
+        values.push_back(value_for(n));
+        batch.push_back({make_key(n), values.back(), 10});
+    }
+    // Named twice within the batch, and once more at the end: the second and
+    // third are the duplicates, in that order.
+    batch.push_back({make_key(5), values[5], 11});
+    batch.push_back({make_key(9), values[9], 12});
+
+    auto const progress = db.insert_batch(batch);
+    REQUIRE_FALSE(progress.error);
+    CHECK(progress.inserted == total);
+    CHECK(progress.unapplied.empty());
+    REQUIRE(progress.duplicates.size() == 2);
+    CHECK(progress.duplicates[0].key == make_key(5));
+    CHECK(progress.duplicates[1].key == make_key(9));
+
+    CHECK(db.size() == total);
+    for (size_t s = 0; s < shards; ++s) CHECK(db.shard(s).size() > 0);
+    for (uint64_t n = 0; n < total; ++n) {
+        auto const found = db.find(make_key(n), 20);
+        REQUIRE(found);
+        CHECK(found->data == value_for(n));
+        CHECK(found->block_height == 10);
+    }
+
+    // Half of them, a key never stored, and one named twice.
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = 0; n < total; n += 2) spends.emplace_back(make_key(n), 30);
+    spends.emplace_back(make_key(total + 1), 30);
+    spends.emplace_back(make_key(0), 31);
+
+    auto const deleted = db.apply_deletes(spends);
+    REQUIRE_FALSE(deleted.error);
+    CHECK(deleted.erased.size() == total / 2);
+    CHECK(deleted.absent.size() == 1);
+    CHECK(deleted.unresolved.empty());
+    CHECK(db.size() == total / 2);
+    CHECK_FALSE(db.find(make_key(0), 40));
+    CHECK(db.find(make_key(1), 40));
+
+    REQUIRE(db.sync());
+    db.close();
+    CHECK(db.size() == 0);
+    CHECK(db.insert(make_key(1), values[1], 1).error() == utxoz::error_code::closed);
+}
+
+TEST_CASE("sharded: resolve() reaches every shard's older versions", "[sharded]") {
+    auto const path = make_unique_path("resolve");
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::sharded_db::open_for_testing(path, shards, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 400;
+    auto const value = value_for(1);
+    for (uint64_t n = 0; n < total; ++n) REQUIRE(db.insert(make_key(n), value, 5).value());
+
+    // Rotate every shard's class, one insert routed to each.
+    std::vector<bool> rotated(shards);
+    for (uint64_t n = total; std::count(rotated.begin(), rotated.end(), true) < long(shards); ++n) {
+        auto const s = utxoz::sharded_db::shard_of(make_key(n), shards);
+        if (rotated[s]) continue;
+        failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        REQUIRE(db.insert(make_key(n), value, 6).value());
+        rotated[s] = true;
+    }
+    CHECK(db.find(make_key(0), 7).error() == utxoz::error_code::not_resolved);
+
+    std::vector<utxoz::lookup_request> requests;
+    for (uint64_t n = 0; n < total; ++n) requests.emplace_back(make_key(n), 7);
+    requests.emplace_back(make_key(0), 8);                  // a duplicate
+    requests.emplace_back(make_key(1'000'000), 7);          // never stored
+
+    auto const resolved = db.resolve(requests);
+    REQUIRE(resolved);
+    CHECK(resolved->found.size() == total);
+    REQUIRE(resolved->absent.size() == 1);
+    CHECK(resolved->absent[0].key == make_key(1'000'000));
+}
+
+TEST_CASE("sharded: the shard count is fixed at creation", "[sharded]") {
+    auto const path = make_unique_path("count");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto const value = value_for(3);
+    {
+        auto opened = utxoz::sharded_db::open_for_testing(path, shards, true);
+        REQUIRE(opened);
+        REQUIRE(opened->insert(make_key(3), value, 1).value());
+    }
+
+    // Another count is refused, not followed.
+    auto wrong = utxoz::sharded_db::open_for_testing(path, shards + 1);
+    REQUIRE_FALSE(wrong);
+    CHECK(wrong.error() == utxoz::error_code::shard_count_mismatch);
+
+    CHECK(utxoz::sharded_db::open_for_testing(path, 0).error()
+          == utxoz::error_code::shard_count_mismatch);
+    CHECK(utxoz::sharded_db::open_for_testing(path, utxoz::sharded_db::max_shards + 1).error()
+          == utxoz::error_code::shard_count_mismatch);
+
+    // The one it was made with opens, and what it held is where it was.
+    {
+        auto reopened = utxoz::sharded_db::open_for_testing(path, shards);
+        REQUIRE(reopened);
+        auto const found = reopened->find(make_key(3), 2);
+        REQUIRE(found);
+        CHECK(found->data == value);
+
+        // The set holds its root: a second opener is turned away there, before
+        // it reads a record the first one may be about to write.
+        auto second = utxoz::sharded_db::open_for_testing(path, shards);
+        REQUIRE_FALSE(second);
+        CHECK(second.error() == utxoz::error_code::database_in_use);
+    }
+
+    // A damaged record is reported as one, not read as some other count.
+    {
+        std::fstream f(std::filesystem::path(path) / "utxoz_shards.dat",
+                       std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(8);
+        f.put(char(9));
+    }
+    CHECK(utxoz::sharded_db::open_for_testing(path, shards).error()
+          == utxoz::error_code::config_file_corrupt);
+}
+
+TEST_CASE("sharded: a plain database is not a set of one", "[sharded]") {
+    auto const path = make_unique_path("plain");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    {
+        auto plain = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(plain);
+    }
+    auto opened = utxoz::sharded_db::open_for_testing(path, 1);
+    REQUIRE_FALSE(opened);
+    CHECK(opened.error() == utxoz::error_code::shard_count_mismatch);
+}
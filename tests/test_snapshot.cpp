@@ -0,0 +1,374 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_snapshot.cpp
+ * @brief full_snapshot: the set as it stood, while the writer carries on.
+ *
+ * Every case here changes the database after the snapshot is taken — deletions
+ * that reach the generations it pins, inserts, compaction — and checks that the
+ * snapshot's answers are the ones it gave before any of it. The walk case
+ * deletes from inside the callback, between chunks, which is the interleaving
+ * the cursor bookkeeping in snapshot_registry.hpp exists for; the threaded case
+ * is the one to run under ThreadSanitizer.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+#include <utxoz/snapshot.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> snap_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_snap_{}_{}_{}_{}", tag, getpid(), ts, snap_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x5A;
+    return key;
+}
+
+/// One payload size per class, each well inside it.
+constexpr std::array<size_t, utxoz::container_count> class_value_size{30, 70, 110, 200, 600};
+
+std::vector<uint8_t> value_for(uint64_t n) {
+    std::vector<uint8_t> v(class_value_size[n % utxoz::container_count]);
+    std::iota(v.begin(), v.end(), uint8_t(n * 13));
+    return v;
+}
+
+/// A value of class 1 only, for the cases that count one class's files.
+std::vector<uint8_t> class_1_value(uint64_t n) {
+    std::vector<uint8_t> v(class_value_size[1]);
+    std::iota(v.begin(), v.end(), uint8_t(n * 13));
+    return v;
+}
+
+void insert_range(utxoz::full_db& db, uint64_t first, uint64_t last, uint32_t height,
+                  std::vector<uint8_t> (*value)(uint64_t) = value_for) {
+    for (uint64_t n = first; n < last; ++n) {
+        REQUIRE(db.insert(make_key(n), value(n), height).value());
+    }
+}
+
+std::vector<utxoz::deferred_deletion_entry> spends_of(uint64_t first, uint64_t last, uint32_t height) {
+    std::vector<utxoz::deferred_deletion_entry> spends;
+    for (uint64_t n = first; n < last; ++n) spends.emplace_back(make_key(n), height);
+    return spends;
+}
+
+size_t data_files_of_class(std::string const& path, size_t index) {
+    auto const prefix = fmt::format("cont_{}_v", index);
+    size_t n = 0;
+    for (auto const& entry : std::filesystem::directory_iterator(path)) {
+        auto const name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) == 0 && name.ends_with(".dat")) ++n;
+    }
+    return n;
+}
+
+} // anonymous namespace
+
+TEST_CASE("snapshot: answers as of the call while deletes and inserts continue",
+          "[snapshot]") {
+    auto const path = make_unique_path("fixed");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 1000;
+    insert_range(db, 0, total, 3);
+
+    auto snap = db.snapshot();
+    REQUIRE(snap);
+    CHECK(snap->size() == total);
+    CHECK(snap->generations() >= utxoz::container_count);
+
+    auto const stats = db.get_statistics();
+    for (size_t i = 0; i < utxoz::container_count; ++i) {
+        CHECK(stats.rotations_by_cause[i].snapshot == 1);
+    }
+
+    // Half of what the snapshot holds leaves the database; new keys arrive.
+    auto const progress = db.apply_deletes(spends_of(0, total / 2, 9));
+    REQUIRE_FALSE(progress.error);
+    CHECK(progress.erased.size() == total / 2);
+    insert_range(db, total, total + 500, 9);
+    CHECK(db.size() == total / 2 + 500);
+
+    // The snapshot still holds the spent half, with its data, and not the new keys.
+    for (uint64_t n = 0; n < total; n += 7) {
+        auto const found = snap->find(make_key(n));
+        REQUIRE(found);
+        CHECK(found->data == value_for(n));
+        CHECK(found->block_height == 3);
+    }
+    CHECK(snap->find(make_key(total + 3)).error() == utxoz::error_code::not_found);
+    CHECK(snap->size() == total);
+
+    std::vector<utxoz::lookup_request> requests;
+    for (uint64_t n = 0; n < total + 500; ++n) requests.emplace_back(make_key(n), 10);
+    requests.emplace_back(make_key(5), 10);
+    auto const resolved = snap->resolve(requests);
+    REQUIRE(resolved);
+    CHECK(resolved->found.size() == total);
+    CHECK(resolved->absent.size() == 500);
+
+    boost::unordered_flat_map<utxoz::raw_outpoint, size_t> visits;
+    auto const walked = snap->for_each_entry([&](utxoz::raw_outpoint const& key, uint32_t height,
+                                                 std::span<uint8_t const>) {
+        CHECK(height == 3);
+        ++visits[key];
+    });
+    REQUIRE(walked);
+    CHECK(visits.size() == total);
+    CHECK(std::ranges::all_of(visits, [](auto const& v) { return v.second == 1; }));
+
+    // The database itself has moved on.
+    auto const live = db.resolve(std::vector<utxoz::lookup_request>{{make_key(1), 10}});
+    REQUIRE(live);
+    CHECK(live->absent.size() == 1);
+    db.close();
+}
+
+TEST_CASE("snapshot: a snapshot with nothing inserted since the last shares what it pinned",
+          "[snapshot]") {
+    auto const path = make_unique_path("share");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 1000;
+    insert_range(db, 0, total, 3);
+
+    auto first = db.snapshot();
+    REQUIRE(first);
+
+    // Nothing inserted: no class is sealed again, and no file is mapped again.
+    auto const mapped_before = failpoints::segments_mapped.load(std::memory_order_relaxed);
+    auto second = db.snapshot();
+    REQUIRE(second);
+    CHECK(failpoints::segments_mapped.load(std::memory_order_relaxed) == mapped_before);
+    CHECK(second->generations() == first->generations());
+    CHECK(second->size() == total);
+    auto stats = db.get_statistics();
+    for (size_t i = 0; i < utxoz::container_count; ++i) {
+        CHECK(stats.rotations_by_cause[i].snapshot == 1);
+    }
+
+    // Each keeps what it saw through a spend, and outlives the one it shares with.
+    REQUIRE(db.apply_deletes(spends_of(0, 10, 9)).erased.size() == 10);
+    CHECK(first->find(make_key(0)));
+    first = std::unexpected(utxoz::error_code::closed);
+    auto const kept = second->find(make_key(5));
+    REQUIRE(kept);
+    CHECK(kept->data == value_for(5));
+    CHECK(second->size() == total);
+
+    // Only the generation sealed since is mapped.
+    insert_range(db, total, total + 100, 10, class_1_value);
+    auto const mapped_then = failpoints::segments_mapped.load(std::memory_order_relaxed);
+    auto third = db.snapshot();
+    REQUIRE(third);
+    CHECK(failpoints::segments_mapped.load(std::memory_order_relaxed) == mapped_then + 1);
+    CHECK(third->generations() == second->generations() + 1);
+    CHECK(third->size() == total - 10 + 100);
+    CHECK(third->find(make_key(0)).error() == utxoz::error_code::not_found);
+    CHECK(second->find(make_key(0)));
+
+    stats = db.get_statistics();
+    CHECK(stats.rotations_by_cause[1].snapshot == 2);
+    CHECK(stats.rotations_by_cause[0].snapshot == 1);
+    db.close();
+}
+
+TEST_CASE("snapshot: a walk hands out every entry once while its generations are spent",
+          "[snapshot][deletion]") {
+    auto const path = make_unique_path("walk");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Class 1 well past one chunk, so the spends land on both sides of the
+    // cursor inside the generation being walked.
+    constexpr uint64_t total = 10'000;
+    insert_range(db, 0, total, 3, class_1_value);
+    insert_range(db, total, total + 500, 3);
+
+    auto snap = db.snapshot();
+    REQUIRE(snap);
+    REQUIRE(snap->size() == total + 500);
+
+    boost::unordered_flat_map<utxoz::raw_outpoint, size_t> visits;
+    size_t handed_out = 0;
+    bool spent = false;
+    auto const walked = snap->for_each_entry([&](utxoz::raw_outpoint const& key, uint32_t,
+                                                 std::span<uint8_t const>) {
+        ++visits[key];
+        // Class 0 holds a hundred entries and goes first; a hundred more is
+        // inside class 1's first chunk. Everything, walked or not, is spent.
+        if (++handed_out == 200 && ! spent) {
+            spent = true;
+            auto const progress = db.apply_deletes(spends_of(0, total + 500, 9));
+            CHECK_FALSE(progress.error);
+            CHECK(progress.erased.size() == total + 500);
+        }
+    });
+    REQUIRE(walked);
+    CHECK(spent);
+    CHECK(db.size() == 0);
+    CHECK(visits.size() == total + 500);
+    CHECK(std::ranges::all_of(visits, [](auto const& v) { return v.second == 1; }));
+
+    // And a second walk, over what is now entirely preserved copies.
+    size_t second = 0;
+    REQUIRE(snap->for_each_entry([&](auto const&, uint32_t, auto) { ++second; }));
+    CHECK(second == total + 500);
+    db.close();
+}
+
+TEST_CASE("snapshot: compaction leaves pinned generations until the snapshot is dropped",
+          "[snapshot][compaction]") {
+    auto const path = make_unique_path("compact");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Three generations of class 1: one sealed and released, one sealed and
+    // pinned, and the active one.
+    insert_range(db, 0, 100, 3, class_1_value);
+    REQUIRE(db.snapshot());
+    insert_range(db, 100, 200, 4, class_1_value);
+    auto snap = db.snapshot();
+    REQUIRE(snap);
+    insert_range(db, 200, 300, 5, class_1_value);
+    REQUIRE(data_files_of_class(path, 1) == 3);
+
+    // Both sealed generations are pinned by the live snapshot; the active one
+    // has nothing it may be merged with.
+    REQUIRE(db.compact_all());
+    CHECK(data_files_of_class(path, 1) == 3);
+    auto const plan = db.plan_compaction();
+    REQUIRE(plan);
+    CHECK(std::ranges::none_of(plan->groups, [](auto const& g) { return g.container_class == 1; }));
+
+    // A spend from a pinned generation, after the attempt.
+    REQUIRE(db.apply_deletes(spends_of(150, 151, 9)).erased.size() == 1);
+    CHECK(snap->size() == 200);
+    REQUIRE(snap->find(make_key(150)));
+
+    snap = std::unexpected(utxoz::error_code::closed);
+    REQUIRE(db.compact_all());
+    CHECK(data_files_of_class(path, 1) == 1);
+
+    std::vector<utxoz::lookup_request> requests;
+    for (uint64_t n = 0; n < 300; ++n) requests.emplace_back(make_key(n), 10);
+    auto const resolved = db.resolve(requests);
+    REQUIRE(resolved);
+    CHECK(resolved->found.size() == 299);
+    CHECK(resolved->absent.size() == 1);
+    db.close();
+}
+
+TEST_CASE("snapshot: read from another thread while the writer spends and inserts",
+          "[snapshot][concurrency]") {
+    auto const path = make_unique_path("thread");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    constexpr uint64_t total = 3000;
+    insert_range(db, 0, total, 3);
+    auto snap = db.snapshot();
+    REQUIRE(snap);
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> wrong{0};
+    std::thread reader([&] {
+        std::vector<utxoz::lookup_request> requests;
+        for (uint64_t n = 0; n < total; ++n) requests.emplace_back(make_key(n), 10);
+        while ( ! done.load(std::memory_order_acquire)) {
+            auto const resolved = snap->resolve(requests);
+            if ( ! resolved || resolved->found.size() != total) ++wrong;
+            size_t walked = 0;
+            auto const ok = snap->for_each_entry([&](auto const&, uint32_t, auto) { ++walked; });
+            if ( ! ok || walked != total) ++wrong;
+        }
+    });
+
+    for (uint64_t first = 0; first < total; first += 100) {
+        auto const progress = db.apply_deletes(spends_of(first, first + 100, 9));
+        CHECK_FALSE(progress.error);
+        insert_range(db, total + first, total + first + 100, 9);
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    CHECK(wrong.load() == 0);
+    CHECK(db.size() == total);
+    CHECK(snap->size() == total);
+
+    // A snapshot that outlives close() answers `closed`.
+    db.close();
+    CHECK(snap->find(make_key(1)).error() == utxoz::error_code::closed);
+    CHECK(snap->for_each_entry([](auto const&, uint32_t, auto) {}).error()
+          == utxoz::error_code::closed);
+    CHECK(db.snapshot().error() == utxoz::error_code::closed);
+}
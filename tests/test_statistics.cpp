@@ -33,6 +33,9 @@
 
 #include <utxoz/config.hpp>
 #include <utxoz/database.hpp>
+#include <utxoz/statistics.hpp>
+
+#include "detail/durability.hpp"
 
 namespace {
 
@@ -471,3 +474,152 @@ TEST_CASE("statistics compile out cleanly", "[statistics]") {
 
     std::filesystem::remove_all(path);
 }
+
+/**
+ * The age histogram replaced an exact per-age map so that a spend never
+ * allocates. What it gives up is exactness above its linear range, and only by
+ * a bounded amount: these pin the bound, and that every value has a bucket.
+ */
+TEST_CASE("the age histogram buckets every value within its stated error", "[statistics]") {
+    using histogram = utxoz::age_histogram;
+
+    // Exact below the sub-bucket count.
+    for (uint64_t v = 0; v < histogram::sub_buckets; ++v) {
+        CHECK(histogram::bucket_of(v) == v);
+        CHECK(histogram::bucket_floor(v) == v);
+        CHECK(histogram::bucket_ceiling(v) == v);
+    }
+
+    // Every value lies inside its bucket, and no bucket is wider than a
+    // sixteenth of its floor.
+    for (uint64_t v : {16ull, 17ull, 31ull, 32ull, 33ull, 1000ull, 52'561ull,
+                       999'999ull, (1ull << 31) + 5, (1ull << 32) - 1}) {
+        auto const b = histogram::bucket_of(v);
+        REQUIRE(b < histogram::bucket_count);
+        CHECK(histogram::bucket_floor(b) <= v);
+        CHECK(v <= histogram::bucket_ceiling(b));
+        CHECK((histogram::bucket_ceiling(b) - histogram::bucket_floor(b) + 1) * 16
+              <= histogram::bucket_floor(b));
+    }
+    CHECK(histogram::bucket_of((1ull << 32) - 1) == histogram::bucket_count - 1);
+
+    // Buckets tile the values: each starts where the last ended.
+    for (size_t b = 1; b < histogram::bucket_count; ++b) {
+        CHECK(histogram::bucket_floor(b) == histogram::bucket_ceiling(b - 1) + 1);
+    }
+
+    histogram h;
+    CHECK(h.percentile(0.5) == 0);
+    for (uint64_t v = 1; v <= 100; ++v) h.record(v);
+    CHECK(h.total() == 100);
+    auto const median = h.percentile(0.5);
+    CHECK(median >= 50);
+    CHECK(median <= 50 + 50 / 16);
+    CHECK(h.percentile(1.0) >= 100);
+}
+
+// Counter values only exist when recording is compiled in.
+#if UTXOZ_STATISTICS_LEVEL >= 1
+TEST_CASE("spends are counted by age without an exact map", "[statistics]") {
+    auto const path = make_unique_path("lifetime");
+    std::filesystem::remove_all(path);
+
+    {
+        auto r = utxoz::full_db::open_for_testing(path, true);
+        REQUIRE(r.has_value());
+        auto db = std::move(*r);
+
+        for (size_t i = 0; i < 40; ++i) {
+            REQUIRE(db.insert(make_key(i), make_value(33), 1'000).value());
+        }
+
+        // Twenty spent ten blocks on, twenty a hundred thousand on: an average
+        // that a running division would have to get right, and two heights in
+        // ranges far apart.
+        std::vector<utxoz::deferred_deletion_entry> batch;
+        for (size_t i = 0; i < 20; ++i) batch.emplace_back(make_key(i), 1'010);
+        for (size_t i = 20; i < 40; ++i) batch.emplace_back(make_key(i), 101'000);
+        REQUIRE(db.apply_deletes(batch).erased.size() == 40);
+
+        auto const lifetime = db.get_statistics().lifetime;
+        CHECK(lifetime.total_spent == 40);
+        CHECK(lifetime.total_age == 20 * 10 + 20 * 100'000);
+        CHECK(lifetime.max_age == 100'000);
+        CHECK(lifetime.average_age == (20.0 * 10 + 20.0 * 100'000) / 40);
+        CHECK(lifetime.age_distribution.total() == 40);
+        CHECK(lifetime.age_distribution.counts[utxoz::age_histogram::bucket_of(10)] == 20);
+        CHECK(lifetime.age_distribution.counts[utxoz::age_histogram::bucket_of(100'000)] == 20);
+
+        db.reset_all_statistics();
+        auto const reset = db.get_statistics().lifetime;
+        CHECK(reset.total_spent == 0);
+        CHECK(reset.average_age == 0.0);
+        CHECK(reset.age_distribution.total() == 0);
+
+        db.close();
+    }
+
+    std::filesystem::remove_all(path);
+}
+#endif
+
+/**
+ * A resolve or a deletion batch that has to map a generation faults at least
+ * once doing it: the first touch of a fresh mapping does, whether or not the
+ * page cache already held the page. Each reopen empties the file cache, so each
+ * operation below maps the sealed generation afresh. Where the platform cannot
+ * count per thread the figures stay at zero rather than inventing a number.
+ */
+#if UTXOZ_STATISTICS_LEVEL >= 1
+TEST_CASE("resolves and deletion batches count the page faults they take", "[statistics]") {
+    using utxoz::detail::failpoints;
+    failpoints::scoped_reset const disarm;
+    auto const path = make_unique_path("faults");
+    std::filesystem::remove_all(path);
+
+    {
+        auto db = std::move(*utxoz::full_db::open_for_testing(path, true));
+        for (size_t i = 0; i < 20; ++i) {
+            REQUIRE(db.insert(make_key(i), make_value(33), 100).value());
+        }
+        failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        REQUIRE(db.insert(make_key(1'000), make_value(33), 101).value());
+        db.close();
+    }
+
+    {
+        auto db = std::move(*utxoz::full_db::open_for_testing(path, false));
+        std::vector<utxoz::deferred_deletion_entry> const spends{{make_key(1), 150}};
+        REQUIRE(db.apply_deletes(spends).erased.size() == 1);
+        auto const deferred = db.get_statistics().deferred;
+        if constexpr (utxoz::page_faults_counted) {
+            CHECK(deferred.major_faults + deferred.minor_faults > 0);
+        } else {
+            CHECK(deferred.major_faults + deferred.minor_faults == 0);
+        }
+        // Nothing a deletion did lands on the resolution side.
+        CHECK(db.get_statistics().resolution.minor_faults == 0);
+        db.close();
+    }
+
+    {
+        auto db = std::move(*utxoz::full_db::open_for_testing(path, false));
+        std::vector<utxoz::lookup_request> const lookups{{make_key(2), 200}};
+        auto const swept = db.resolve(lookups);
+        REQUIRE(swept.has_value());
+        REQUIRE(swept->found.size() == 1);
+        auto const resolution = db.get_statistics().resolution;
+        if constexpr (utxoz::page_faults_counted) {
+            CHECK(resolution.major_faults + resolution.minor_faults > 0);
+        } else {
+            CHECK(resolution.major_faults + resolution.minor_faults == 0);
+        }
+
+        db.reset_search_stats();
+        CHECK(db.get_statistics().resolution.minor_faults == 0);
+        db.close();
+    }
+
+    std::filesystem::remove_all(path);
+}
+#endif
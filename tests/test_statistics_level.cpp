@@ -0,0 +1,241 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_statistics_level.cpp
+ * @brief set_statistics_level(): capped at the build, honoured by every path
+ *        that counts, and harmless to switch while other threads look things up.
+ *
+ * The claims are per level of the build, as in test_lookup_telemetry.cpp. What
+ * runs everywhere is the cap and the sizes: an `off` build reports `off`
+ * whatever it is asked for, and the sizes are exact at every level.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/config.hpp>
+#include <utxoz/database.hpp>
+#include <utxoz/statistics.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+namespace fs = std::filesystem;
+
+using utxoz::statistics_level;
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> level_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_level_{}_{}_{}_{}", tag, getpid(), ts, level_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x4C;
+    return key;
+}
+
+std::vector<uint8_t> make_value(size_t size) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), uint8_t(11));
+    return v;
+}
+
+uint64_t latency_calls(utxoz::latency_snapshot const& snapshot) {
+    uint64_t calls = 0;
+    for (auto const& s : snapshot.series) calls += s.count;
+    return calls;
+}
+
+} // anonymous namespace
+
+TEST_CASE("statistics level: starts at the build's and never goes above it",
+          "[statistics_level]") {
+    auto const path = make_unique_path("cap");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    CHECK(db.get_statistics_level() == utxoz::compiled_statistics_level);
+    CHECK(db.set_statistics_level(statistics_level::lookup) == utxoz::compiled_statistics_level);
+    CHECK(db.get_statistics_level() == utxoz::compiled_statistics_level);
+
+    CHECK(db.set_statistics_level(statistics_level::off) == statistics_level::off);
+    CHECK(db.get_statistics().lookups.statistics_level == "off");
+    CHECK(db.get_latency_snapshot().statistics_level == "off");
+
+    auto const basic = db.set_statistics_level(statistics_level::basic);
+    CHECK(basic == std::min(statistics_level::basic, utxoz::compiled_statistics_level));
+    CHECK(db.get_statistics().lookups.statistics_level == std::string(utxoz::to_string(basic)));
+    db.close();
+}
+
+TEST_CASE("statistics level: switched off, nothing counts and the sizes stay exact",
+          "[statistics_level]") {
+    auto const path = make_unique_path("off");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Some history to resolve from, counted while on.
+    for (uint64_t n = 0; n < 50; ++n) REQUIRE(db.insert(make_key(n), make_value(20), 100).value());
+    failpoints::force_rotations.store(1, std::memory_order_relaxed);
+    REQUIRE(db.insert(make_key(50), make_value(20), 101).value());
+
+    auto const before = db.get_statistics();
+    auto const timed_before = latency_calls(db.get_latency_snapshot());
+    auto const sizes_before = db.get_stats_snapshot();
+
+    REQUIRE(db.set_statistics_level(statistics_level::off) == statistics_level::off);
+
+    for (uint64_t n = 100; n < 140; ++n) REQUIRE(db.insert(make_key(n), make_value(20), 102).value());
+    std::vector<utxoz::insert_request> batch;
+    for (uint64_t n = 200; n < 210; ++n) batch.push_back({make_key(n), make_value(80), 102});
+    REQUIRE(db.insert_batch(batch).inserted == batch.size());
+    for (uint64_t n = 100; n < 120; ++n) REQUIRE(db.find(make_key(n), 200).has_value());
+    CHECK_FALSE(db.find(make_key(5), 200).has_value());
+    std::vector<utxoz::lookup_request> const lookups{{make_key(5), 200}, {make_key(9999), 200}};
+    REQUIRE(db.resolve(lookups).has_value());
+    std::vector<utxoz::deferred_deletion_entry> spends{{make_key(100), 150}, {make_key(6), 150}};
+    REQUIRE(db.apply_deletes(spends).erased.size() == 2);
+
+    auto const after = db.get_statistics();
+    CHECK(after.total_inserts == before.total_inserts);
+    CHECK(after.total_deletes == before.total_deletes);
+    CHECK(after.probes.probes == before.probes.probes);
+    CHECK(after.resolution.resolved == before.resolution.resolved);
+    CHECK(after.resolution.absent == before.resolution.absent);
+    CHECK(after.lifetime.total_spent == before.lifetime.total_spent);
+    CHECK(after.deferred.successfully_processed == before.deferred.successfully_processed);
+    CHECK(latency_calls(db.get_latency_snapshot()) == timed_before);
+    for (size_t c = 0; c < utxoz::container_count; ++c) {
+        CHECK(after.containers[c].total_inserts == before.containers[c].total_inserts);
+    }
+
+    // Sizes are states, not events: exact whatever is running.
+    auto const sizes = db.get_stats_snapshot();
+    CHECK(sizes.sequence > sizes_before.sequence);
+    CHECK(sizes.total_entries == db.size());
+    CHECK(sizes.classes[1].active_entries == 10);
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    CHECK(after.containers[0].current_size == sizes.classes[0].active_entries + 50 - 1);
+    CHECK(after.containers[1].current_size == 10);
+#endif
+
+    // Back on, the counters carry on from where they stopped.
+    db.set_statistics_level(statistics_level::lookup);
+    REQUIRE(db.find(make_key(101), 200).has_value());
+    REQUIRE(db.insert(make_key(300), make_value(20), 103).value());
+    auto const resumed = db.get_statistics();
+#if UTXOZ_STATISTICS_LEVEL >= 1
+    CHECK(resumed.probes.probes == before.probes.probes + 1);
+    CHECK(resumed.total_inserts == before.total_inserts + 1);
+#else
+    CHECK(resumed.probes.probes == 0);
+#endif
+#if UTXOZ_STATISTICS_LEVEL >= 2
+    uint64_t answered = 0;
+    for (auto const& c : resumed.lookups.classes) answered += c.answered_from_active;
+    uint64_t answered_before = 0;
+    for (auto const& c : before.lookups.classes) answered_before += c.answered_from_active;
+    CHECK(answered == answered_before + 1);
+#endif
+    db.close();
+}
+
+#if UTXOZ_STATISTICS_LEVEL >= 2
+TEST_CASE("statistics level: basic leaves the per-class telemetry still", "[statistics_level]") {
+    auto const path = make_unique_path("basic");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    for (uint64_t n = 0; n < 20; ++n) REQUIRE(db.insert(make_key(n), make_value(20), 100).value());
+
+    REQUIRE(db.set_statistics_level(statistics_level::basic) == statistics_level::basic);
+    for (uint64_t n = 0; n < 20; ++n) REQUIRE(db.find(make_key(n), 200).has_value());
+
+    auto const stats = db.get_statistics();
+    CHECK(stats.probes.answered_from_active == 20);
+    for (auto const& c : stats.lookups.classes) CHECK(c.answered_from_active == 0);
+    db.close();
+}
+#endif
+
+TEST_CASE("statistics level: switching while other threads look things up",
+          "[statistics_level]") {
+    auto const path = make_unique_path("switch");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    for (uint64_t n = 0; n < 1000; ++n) REQUIRE(db.insert(make_key(n), make_value(20), 100).value());
+
+    // Written for ThreadSanitizer: the switch is one atomic and every read of
+    // it is a load of that atomic, so there is nothing here for it to report.
+    std::atomic<bool> done{false};
+    std::thread switcher([&] {
+        auto level = statistics_level::off;
+        while ( ! done.load(std::memory_order_acquire)) {
+            db.set_statistics_level(level);
+            level = level == statistics_level::off ? statistics_level::lookup : statistics_level::off;
+        }
+    });
+
+    uint64_t found = 0;
+    for (int round = 0; round < 20; ++round) {
+        for (uint64_t n = 0; n < 1000; ++n) found += db.find(make_key(n), 200).has_value() ? 1 : 0;
+    }
+    done.store(true, std::memory_order_release);
+    switcher.join();
+
+    CHECK(found == 20'000);
+    // However the finds fell, none counted twice.
+    CHECK(db.get_statistics().probes.probes <= 20'000);
+    db.close();
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_stats_snapshot.cpp
+ * @brief get_stats_snapshot(): what each operation moves, what a reopen
+ *        measures, and that a reader on another thread only ever sees a state
+ *        some operation ended in.
+ *
+ * The concurrent case is the point of the feature and is written for
+ * ThreadSanitizer as much as for the assertions: every snapshot it takes is
+ * checked against an invariant that holds between operations and not inside
+ * one, so a torn read fails it even where the sanitizer is not running.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+#include <utxoz/statistics.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+namespace fs = std::filesystem;
+
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> snapshot_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_sizes_{}_{}_{}_{}", tag, getpid(), ts, snapshot_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x5B;
+    return key;
+}
+
+/// Class 0 at 20 bytes, class 1 at 80.
+std::vector<uint8_t> make_value(size_t size) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), uint8_t(9));
+    return v;
+}
+
+} // anonymous namespace
+
+TEST_CASE("stats snapshot: each operation moves the class it touched", "[stats_snapshot]") {
+    auto const path = make_unique_path("moves");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    auto const fresh = db.get_stats_snapshot();
+    CHECK(fresh.mode == utxoz::storage_mode::full);
+    CHECK(fresh.class_count() == utxoz::container_count);
+    CHECK(fresh.total_entries == 0);
+    for (auto const& c : fresh.classes) {
+        CHECK(c.active_entries == 0);
+        CHECK(c.active_file_bytes > 0);
+        CHECK(c.sealed_generations == 0);
+    }
+
+    for (uint64_t n = 0; n < 100; ++n) REQUIRE(db.insert(make_key(n), make_value(20), 100).value());
+    for (uint64_t n = 0; n < 5; ++n) REQUIRE(db.insert(make_key(1000 + n), make_value(80), 100).value());
+
+    auto after_inserts = db.get_stats_snapshot();
+    CHECK(after_inserts.sequence > fresh.sequence);
+    CHECK(after_inserts.total_entries == db.size());
+    CHECK(after_inserts.classes[0].active_entries == 100);
+    CHECK(after_inserts.classes[0].inserts == 100);
+    CHECK(after_inserts.classes[1].active_entries == 5);
+    CHECK(after_inserts.classes[2].inserts == 0);
+    CHECK(after_inserts.classes[0].active_used_bytes > 0);
+    CHECK(after_inserts.classes[0].active_used_bytes <= after_inserts.classes[0].active_file_bytes);
+
+    // A rotation seals the file at the size it is mapped at.
+    auto const sealed_size = after_inserts.classes[0].active_file_bytes;
+    failpoints::force_rotations.store(1, std::memory_order_relaxed);
+    REQUIRE(db.insert(make_key(2000), make_value(20), 101).value());
+
+    auto const rotated = db.get_stats_snapshot();
+    CHECK(rotated.classes[0].rotations == 1);
+    CHECK(rotated.classes[0].sealed_generations == 1);
+    CHECK(rotated.classes[0].sealed_bytes == sealed_size);
+    CHECK(rotated.classes[0].active_entries == 1);
+    CHECK(rotated.classes[0].inserts == 101);
+    CHECK(rotated.classes[1].rotations == 0);
+    CHECK(rotated.total_bytes() > after_inserts.total_bytes());
+
+    // One from the active generation, ten from the sealed one.
+    std::vector<utxoz::deferred_deletion_entry> spends{{make_key(2000), 150}};
+    for (uint64_t n = 0; n < 10; ++n) spends.emplace_back(make_key(n), 150);
+    REQUIRE(db.apply_deletes(spends).erased.size() == 11);
+
+    auto const spent = db.get_stats_snapshot();
+    CHECK(spent.classes[0].deletes == 11);
+    CHECK(spent.classes[0].active_entries == 0);
+    CHECK(spent.total_entries == db.size());
+
+    db.close();
+
+    // A reopen measures what is there and counts from zero.
+    auto reopened = utxoz::full_db::open_for_testing(path, false);
+    REQUIRE(reopened);
+    auto const measured = reopened->get_stats_snapshot();
+    CHECK(measured.total_entries == reopened->size());
+    CHECK(measured.classes[0].sealed_generations == 1);
+    CHECK(measured.classes[0].sealed_bytes == sealed_size);
+    CHECK(measured.classes[0].inserts == 0);
+    CHECK(measured.classes[0].rotations == 0);
+    CHECK(measured.classes[1].active_entries == 5);
+    reopened->close();
+}
+
+TEST_CASE("stats snapshot: reference mode reports one class", "[stats_snapshot]") {
+    auto const path = make_unique_path("reference");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::reference_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    for (uint64_t n = 0; n < 20; ++n) REQUIRE(opened->insert(make_key(n), 7, 64, 100).value());
+
+    auto const snapshot = opened->get_stats_snapshot();
+    CHECK(snapshot.mode == utxoz::storage_mode::reference);
+    CHECK(snapshot.class_count() == 1);
+    CHECK(snapshot.total_entries == 20);
+    CHECK(snapshot.classes[0].active_entries == 20);
+    CHECK(snapshot.classes[0].active_file_bytes > 0);
+    for (size_t c = 1; c < utxoz::container_count; ++c) {
+        CHECK(snapshot.classes[c].active_file_bytes == 0);
+        CHECK(snapshot.classes[c].inserts == 0);
+    }
+    opened->close();
+}
+
+TEST_CASE("stats snapshot: a reader on another thread sees only whole operations",
+          "[stats_snapshot]") {
+    auto const path = make_unique_path("concurrent");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Nothing rotates, so between operations every entry is in an active map and
+    // each class's entries are its inserts less its deletes. Inside an operation
+    // the total and the classes are published together or not at all.
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> taken{0};
+    std::atomic<uint64_t> torn{0};
+    std::atomic<uint64_t> backwards{0};
+    std::thread monitor([&] {
+        uint64_t last = 0;
+        while ( ! done.load(std::memory_order_acquire)) {
+            auto const s = db.get_stats_snapshot();
+            uint64_t active = 0;
+            bool whole = true;
+            for (auto const& c : s.classes) {
+                active += c.active_entries;
+                whole = whole && c.active_entries == c.inserts - c.deletes;
+            }
+            if (active != s.total_entries || ! whole) torn.fetch_add(1, std::memory_order_relaxed);
+            if (s.sequence < last) backwards.fetch_add(1, std::memory_order_relaxed);
+            last = s.sequence;
+            taken.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    constexpr uint64_t rounds = 8;
+    constexpr uint64_t per_round = 2 * utxoz::full_db::min_parallel_batch;
+    auto const small = make_value(20);
+    auto const large = make_value(80);
+    for (uint64_t r = 0; r < rounds; ++r) {
+        std::vector<utxoz::insert_request> batch;
+        for (uint64_t n = 0; n < per_round; ++n) {
+            auto const id = r * per_round + n;
+            batch.push_back({make_key(id), n % 2 == 0 ? small : large, 100});
+        }
+        REQUIRE(db.insert_batch(batch).inserted == per_round);
+        for (uint64_t n = 0; n < 16; ++n) {
+            REQUIRE(db.insert(make_key(1'000'000 + r * 16 + n), small, 100).value());
+        }
+
+        std::vector<utxoz::deferred_deletion_entry> spends;
+        for (uint64_t n = 0; n < per_round; n += 3) spends.emplace_back(make_key(r * per_round + n), 150);
+        REQUIRE(db.apply_deletes(spends).erased.size() == spends.size());
+    }
+
+    done.store(true, std::memory_order_release);
+    monitor.join();
+
+    CHECK(taken.load() > 0);
+    CHECK(torn.load() == 0);
+    CHECK(backwards.load() == 0);
+
+    auto const last = db.get_stats_snapshot();
+    CHECK(last.total_entries == db.size());
+    CHECK(last.classes[0].rotations == 0);
+    db.close();
+}
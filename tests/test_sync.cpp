@@ -25,6 +25,7 @@
 #include <chrono>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <numeric>
 #include <string>
 #include <vector>
@@ -41,7 +42,9 @@
 
 #include <utxoz/database.hpp>
 
+#include "detail/dirty_pages.hpp"
 #include "detail/durability.hpp"
+#include "detail/io_engine.hpp"
 #include "detail/scope_exit.hpp"
 
 namespace fs = std::filesystem;
@@ -526,3 +529,350 @@ TEST_CASE("a config that cannot be made durable stops the open", "[database][syn
         CHECK(opened.error() == utxoz::error_code::sync_failed);
     }
 }
+
+// =============================================================================
+// The page barrier covers the pages written, not the mapping
+// =============================================================================
+
+TEST_CASE("noted pages are flushed as runs, and anything unaccountable as the mapping",
+          "[sync][dirty_pages]") {
+    using utxoz::detail::dirty_pages;
+
+    auto const page = utxoz::detail::system_page_size();
+    std::vector<std::byte> mapping(page * 200);
+
+    dirty_pages pages;
+    pages.attach(mapping.data(), mapping.size());
+    CHECK(pages.empty());
+
+    std::vector<std::pair<size_t, size_t>> runs;
+    auto const collect = [&](void* address, size_t length) -> utxoz::result<> {
+        runs.emplace_back(size_t(static_cast<std::byte*>(address) - mapping.data()), length);
+        return {};
+    };
+
+    // Straddling a boundary notes both pages; a second note on either adds
+    // nothing; pages 63 and 64 sit in different words and still make one run.
+    pages.note(mapping.data() + page * 3 - 4, 8);
+    pages.note(mapping.data() + page * 3, 1);
+    pages.note(mapping.data() + page * 63, 1);
+    pages.note(mapping.data() + page * 64, 1);
+    pages.note(mapping.data() + page * 199 + 5, 1);
+    CHECK(pages.pages() == 5);
+
+    REQUIRE(pages.for_each_run(collect));
+    REQUIRE(runs.size() == 3);
+    CHECK(runs[0] == std::pair{page * 2, page * 2});
+    CHECK(runs[1] == std::pair{page * 63, page * 2});
+    CHECK(runs[2] == std::pair{page * 199, page});
+
+    // Flushing clears nothing; clearing does.
+    CHECK(pages.pages() == 5);
+    pages.clear();
+    CHECK(pages.empty());
+
+    // A note it cannot place is everything.
+    int outside = 0;
+    pages.note(&outside, sizeof(outside));
+    runs.clear();
+    REQUIRE(pages.for_each_run(collect));
+    REQUIRE(runs.size() == 1);
+    CHECK(runs[0] == std::pair{size_t{0}, mapping.size()});
+}
+
+TEST_CASE("a sync flushes the pages it wrote, and a failed one keeps them",
+          "[database][sync][dirty_pages][failpoint]") {
+    // Only where the file barrier covers what the runs cannot see. Elsewhere the
+    // whole mapping is flushed, as it always was, and there is nothing to show.
+    if constexpr ( ! utxoz::detail::file_barrier_covers_mappings()) return;
+
+    auto const path = unique_path("dirtypages");
+    fs::remove_all(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    REQUIRE(db.sync());
+
+    auto const page = utxoz::detail::system_page_size();
+    auto const flushed = [] {
+        return failpoints::sync_mapped_region_bytes.load(std::memory_order_relaxed);
+    };
+
+    // Ten entries: at most a page for each slot and one for the map object.
+    failpoints::sync_mapped_region_bytes.store(0, std::memory_order_relaxed);
+    for (uint64_t i = 0; i < 10; ++i) {
+        REQUIRE(db.insert(make_key(i), make_value(33, 1), 100).value());
+    }
+    REQUIRE(db.sync());
+    CHECK(flushed() > 0);
+    CHECK(flushed() <= 11 * page);
+
+    // Nothing written since: nothing to flush.
+    failpoints::sync_mapped_region_bytes.store(0, std::memory_order_relaxed);
+    REQUIRE(db.sync());
+    CHECK(flushed() == 0);
+
+    // A delete is a write. And a sync that failed has discharged nothing, so the
+    // one after it flushes the same pages again.
+    std::vector<utxoz::deferred_deletion_entry> batch;
+    batch.emplace_back(make_key(3), 200);
+    REQUIRE(db.apply_deletes(batch).erased.size() == 1);
+
+    failpoints::fail_sync_mapped_region.store(true, std::memory_order_relaxed);
+    REQUIRE_FALSE(db.sync());
+    failpoints::clear();
+
+    REQUIRE(db.sync());
+    CHECK(flushed() > 0);
+    CHECK(flushed() <= 2 * page);
+
+    db.close();
+}
+
+// =============================================================================
+// The I/O engine: one batch, accounted for as the calls it replaces
+// =============================================================================
+
+TEST_CASE("a batch of file barriers fails where the loop it replaces would",
+          "[sync][io_engine][failpoint]") {
+    if constexpr (platform_sync_support() == sync_support::none) return;
+
+    auto const path = unique_path("ioengine");
+    fs::remove_all(path);
+    fs::create_directories(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    std::vector<fs::path> files;
+    for (int i = 0; i < 80; ++i) {
+        files.push_back(fs::path(path) / fmt::format("f{}", i));
+        std::ofstream(files.back()) << i;
+    }
+
+    // Both engines this build can have, whichever that is: the ring where there
+    // is one, and the path every earlier build ran. Eighty files is more than
+    // the ring takes in one submission.
+    for (bool const posix : {false, true}) {
+        failpoints::force_posix_io.store(posix, std::memory_order_relaxed);
+        utxoz::detail::io_engine engine;
+        INFO("engine: " << engine.name());
+        if (posix) CHECK_FALSE(engine.batched());
+
+        failpoints::sync_file_calls.store(0, std::memory_order_relaxed);
+        REQUIRE(engine.sync_files(files));
+        CHECK(failpoints::sync_file_calls.load(std::memory_order_relaxed) == files.size());
+
+        // The seventh fails, and nothing after it was attempted.
+        failpoints::sync_file_calls.store(0, std::memory_order_relaxed);
+        failpoints::fail_sync_file_at.store(7, std::memory_order_relaxed);
+        auto const failed = engine.sync_files(files);
+        REQUIRE_FALSE(failed);
+        CHECK(failed.error() == utxoz::error_code::sync_failed);
+        CHECK(failpoints::sync_file_calls.load(std::memory_order_relaxed) == 7);
+        failpoints::fail_sync_file_at.store(0, std::memory_order_relaxed);
+
+        // A file that is not there fails the batch, unless it was retired.
+        auto with_missing = files;
+        with_missing.insert(with_missing.begin() + 3, fs::path(path) / "retired");
+        CHECK_FALSE(engine.sync_files(with_missing));
+        CHECK(engine.sync_files(with_missing, utxoz::detail::missing_file::skip));
+    }
+}
+
+TEST_CASE("a ring that fails mid-batch is dropped, and the batch is still made durable",
+          "[sync][io_engine][failpoint]") {
+    if constexpr (platform_sync_support() == sync_support::none) return;
+
+    auto const path = unique_path("ioring_fail");
+    fs::remove_all(path);
+    fs::create_directories(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    std::vector<fs::path> files;
+    for (int i = 0; i < 80; ++i) {
+        files.push_back(fs::path(path) / fmt::format("f{}", i));
+        std::ofstream(files.back()) << i;
+    }
+
+    utxoz::detail::io_engine engine;
+    // Only a build with the ring, on a kernel that gave it one, has a ring to
+    // fail. The POSIX path never consults the seam.
+    if ( ! engine.batched()) return;
+
+    // The first call into the ring fails once the kernel has taken it: the
+    // first sixty-four barriers are submitted, at least one has completed, and
+    // none is reaped. The sixteen after them were never submitted.
+    failpoints::fail_ring_enter.store(1, std::memory_order_relaxed);
+    failpoints::sync_file_calls.store(0, std::memory_order_relaxed);
+    CHECK(engine.sync_files(files));
+    CHECK(failpoints::sync_file_calls.load(std::memory_order_relaxed) == files.size());
+    CHECK_FALSE(engine.batched());
+    CHECK(std::string_view(engine.name()) == "posix");
+
+    // What the ring left behind is gone with it: the next batch is accounted
+    // for exactly, and fails exactly where it is told to.
+    failpoints::fail_ring_enter.store(0, std::memory_order_relaxed);
+    failpoints::sync_file_calls.store(0, std::memory_order_relaxed);
+    REQUIRE(engine.sync_files(files));
+    CHECK(failpoints::sync_file_calls.load(std::memory_order_relaxed) == files.size());
+
+    failpoints::sync_file_calls.store(0, std::memory_order_relaxed);
+    failpoints::fail_sync_file_at.store(7, std::memory_order_relaxed);
+    auto const failed = engine.sync_files(files);
+    REQUIRE_FALSE(failed);
+    CHECK(failed.error() == utxoz::error_code::sync_failed);
+    CHECK(failpoints::sync_file_calls.load(std::memory_order_relaxed) == 7);
+}
+
+// =============================================================================
+// sync_async(): the same obligations, met on another thread
+// =============================================================================
+
+TEST_CASE("sync_async() completes with what sync() would have", "[database][sync][async]") {
+    if constexpr (platform_sync_support() == sync_support::none) return;
+
+    auto const path = unique_path("async");
+    fs::remove_all(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    for (uint64_t i = 0; i < 1000; ++i) {
+        REQUIRE(db.insert(make_key(i), make_value(33, 1), 100).value());
+    }
+    auto const done = db.sync_async();
+    REQUIRE(done.get());
+
+    auto const stats = db.get_statistics().group_commit;
+    CHECK(stats.requests == 1);
+    CHECK(stats.completed == 1);
+    CHECK(stats.flushes == 1);
+    CHECK(stats.failed_flushes == 0);
+    CHECK(stats.files_synced >= 1);
+    CHECK(stats.max_latency >= stats.last_barrier_time);
+
+    db.close();
+}
+
+TEST_CASE("requests made while a round is pending are served by one round",
+          "[database][sync][async][failpoint]") {
+    if constexpr (platform_sync_support() == sync_support::none) return;
+
+    auto const path = unique_path("groupcommit");
+    fs::remove_all(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    failpoints::hold_group_commit.store(true, std::memory_order_relaxed);
+    std::vector<std::shared_future<utxoz::result<>>> blocks;
+    for (uint64_t block = 0; block < 8; ++block) {
+        for (uint64_t i = 0; i < 100; ++i) {
+            REQUIRE(db.insert(make_key(block * 100 + i), make_value(33, 1), 100).value());
+        }
+        blocks.push_back(db.sync_async());
+    }
+    failpoints::hold_group_commit.store(false, std::memory_order_relaxed);
+
+    for (auto const& block : blocks) CHECK(block.get());
+
+    auto const stats = db.get_statistics().group_commit;
+    CHECK(stats.requests == 8);
+    CHECK(stats.completed == 8);
+    CHECK(stats.flushes == 1);
+    CHECK(stats.coalescing_factor() == 8.0);
+
+    db.close();
+}
+
+TEST_CASE("a failed round discharges nothing, and every request it served gets the failure",
+          "[database][sync][async][failpoint]") {
+    if (utxoz::platform_durability() == utxoz::durability_level::none) return;
+
+    auto const path = unique_path("asyncfails");
+    fs::remove_all(path);
+    scope_exit const cleanup([&] {
+        failpoints::clear();
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    // Three generations, so there are historical files to owe a barrier.
+    uint64_t next = 0;
+    while (count_data_files(path) < 3) {
+        REQUIRE(db.insert(make_key(next++), make_value(8, 1), 100).value());
+        REQUIRE(next < 2'000'000);
+    }
+    REQUIRE(db.sync());
+
+    std::vector<utxoz::deferred_deletion_entry> batch;
+    for (uint64_t i = 0; i < next; i += 2) batch.emplace_back(make_key(i), 400);
+    REQUIRE_FALSE(db.apply_deletes(batch).erased.empty());
+
+    failpoints::hold_group_commit.store(true, std::memory_order_relaxed);
+    failpoints::fail_sync_file.store(true, std::memory_order_relaxed);
+    auto const first = db.sync_async();
+    auto const second = db.sync_async();
+    failpoints::hold_group_commit.store(false, std::memory_order_relaxed);
+
+    REQUIRE_FALSE(first.get());
+    CHECK(first.get().error() == utxoz::error_code::sync_failed);
+    REQUIRE_FALSE(second.get());
+    failpoints::clear();
+
+    auto const stats = db.get_statistics().group_commit;
+    CHECK(stats.flushes == 1);
+    CHECK(stats.failed_flushes == 1);
+
+    // Still owed: the next request carries the historical files again, along
+    // with the active one.
+    REQUIRE(db.sync_async().get());
+    CHECK(failpoints::sync_file_calls.load(std::memory_order_relaxed) >= 3);
+
+    db.close();
+}
+
+TEST_CASE("sync_async() on a closed database says so", "[database][sync][async]") {
+    auto const path = unique_path("asyncclosed");
+    fs::remove_all(path);
+    scope_exit const cleanup([&] { std::error_code ec; fs::remove_all(path, ec); });
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    db.close();
+
+    auto const done = db.sync_async();
+    REQUIRE(done.valid());
+    REQUIRE_FALSE(done.get());
+    CHECK(done.get().error() == utxoz::error_code::closed);
+}
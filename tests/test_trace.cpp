@@ -0,0 +1,254 @@
+// Copyright (c) 2016-present Knuth Project developers.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * @file test_trace.cpp
+ * @brief Tracing: nothing until started, a span per rare operation with its
+ *        phases inside it, a bounded ring that says what it lost, and the
+ *        recovery of open() kept for whoever starts tracing afterwards.
+ *
+ * Unlike the statistics these run the same in every build: tracing does not
+ * depend on the statistics level.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+
+#include <utxoz/database.hpp>
+#include <utxoz/trace.hpp>
+
+#include "detail/durability.hpp"
+#include "detail/scope_exit.hpp"
+
+namespace fs = std::filesystem;
+
+using utxoz::trace_event;
+using utxoz::trace_kind;
+using utxoz::detail::failpoints;
+using utxoz::detail::scope_exit;
+
+namespace {
+
+inline std::atomic<uint64_t> trace_counter{0};
+
+std::string make_unique_path(std::string_view tag) {
+    auto ts = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return fmt::format("./test_trace_{}_{}_{}_{}", tag, getpid(), ts, trace_counter.fetch_add(1));
+}
+
+utxoz::raw_outpoint make_key(uint64_t n) {
+    utxoz::raw_outpoint key{};
+    std::memcpy(key.data(), &n, sizeof(n));
+    key[24] = 0x7A;
+    return key;
+}
+
+std::vector<uint8_t> make_value(size_t size) {
+    std::vector<uint8_t> v(size);
+    std::iota(v.begin(), v.end(), uint8_t(5));
+    return v;
+}
+
+std::vector<trace_event> of_kind(std::vector<trace_event> const& events, trace_kind kind) {
+    std::vector<trace_event> matching;
+    std::ranges::copy_if(events, std::back_inserter(matching),
+                         [&](auto const& e) { return e.kind == kind; });
+    return matching;
+}
+
+/// `inner` lies within `outer`, on the same thread.
+bool nested_in(trace_event const& inner, trace_event const& outer) {
+    return inner.thread == outer.thread
+        && inner.start_ns >= outer.start_ns
+        && inner.start_ns + inner.duration_ns <= outer.start_ns + outer.duration_ns;
+}
+
+/// Three sealed generations of class 0, each made by a forced rotation.
+void make_generations(utxoz::full_db& db) {
+    uint64_t n = 0;
+    for (int generation = 0; generation < 3; ++generation) {
+        for (int i = 0; i < 20; ++i) REQUIRE(db.insert(make_key(n++), make_value(20), 100).value());
+        failpoints::force_rotations.store(1, std::memory_order_relaxed);
+        REQUIRE(db.insert(make_key(n++), make_value(20), 100).value());
+    }
+}
+
+} // anonymous namespace
+
+TEST_CASE("trace: nothing is recorded until tracing starts", "[trace]") {
+    auto const path = make_unique_path("off");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+
+    make_generations(db);
+    REQUIRE(db.sync());
+    auto const capture = db.drain_trace();
+    CHECK(capture.events.empty());
+    CHECK(capture.overwritten == 0);
+    db.close();
+}
+
+TEST_CASE("trace: rotations, merges and syncs, with their phases inside them", "[trace]") {
+    auto const path = make_unique_path("spans");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    db.start_tracing({.capacity = 1024, .resolve_threshold = 2});
+
+    make_generations(db);
+
+    // One key from the first generation: the cache maps it. Two keys is the
+    // threshold; one is below it.
+    std::vector<utxoz::lookup_request> const small{{make_key(0), 200}};
+    REQUIRE(db.resolve(small).has_value());
+    std::vector<utxoz::lookup_request> const large{{make_key(1), 200}, {make_key(2), 200}};
+    REQUIRE(db.resolve(large).has_value());
+
+    REQUIRE(db.compact_all().has_value());
+    REQUIRE(db.sync());
+
+    auto const capture = db.drain_trace();
+    CHECK(capture.overwritten == 0);
+    auto const& events = capture.events;
+
+    // The recovery open() ran comes first, and found nothing to recover.
+    REQUIRE_FALSE(events.empty());
+    CHECK(events.front().kind == trace_kind::merge_recovery);
+    CHECK(events.front().items == 0);
+    CHECK_FALSE(events.front().failed);
+
+    auto const rotations = of_kind(events, trace_kind::rotation);
+    REQUIRE(rotations.size() >= 3);
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(rotations[i].container_class == 0);
+        CHECK(rotations[i].version == rotations[0].version + i);
+        CHECK(rotations[i].bytes > 0);
+        CHECK(rotations[i].items >= 20);
+        CHECK_FALSE(rotations[i].failed);
+    }
+
+    auto const maps = of_kind(events, trace_kind::file_map);
+    REQUIRE_FALSE(maps.empty());
+    CHECK(maps.front().container_class == 0);
+    CHECK(maps.front().bytes > 0);
+
+    auto const resolves = of_kind(events, trace_kind::resolve);
+    REQUIRE(resolves.size() == 1);
+    CHECK(resolves.front().items == 2);
+    CHECK(resolves.front().files >= 1);
+
+    // Every phase inside a merge of its own class and target.
+    auto const merges = of_kind(events, trace_kind::merge);
+    REQUIRE_FALSE(merges.empty());
+    for (auto const kind : {trace_kind::merge_build, trace_kind::merge_publish,
+                            trace_kind::merge_retire}) {
+        for (auto const& phase : of_kind(events, kind)) {
+            INFO(utxoz::to_string(kind));
+            CHECK(std::ranges::any_of(merges, [&](auto const& m) {
+                return m.version == phase.version && m.container_class == phase.container_class
+                    && nested_in(phase, m);
+            }));
+        }
+    }
+    for (auto const& m : merges) {
+        CHECK_FALSE(m.failed);
+        if (m.files >= 2) {
+            CHECK(m.items > 0);
+            CHECK(std::ranges::any_of(of_kind(events, trace_kind::merge_retire),
+                                      [&](auto const& p) { return nested_in(p, m); }));
+        }
+    }
+
+    // The cache was cleared for the compaction, and traced doing it.
+    CHECK_FALSE(of_kind(events, trace_kind::file_unmap).empty());
+
+    auto const syncs = of_kind(events, trace_kind::sync);
+    REQUIRE(syncs.size() == 1);
+    CHECK_FALSE(syncs.front().failed);
+    CHECK(syncs.front().files >= 1);
+    for (auto const kind : {trace_kind::sync_pages, trace_kind::sync_files,
+                            trace_kind::sync_directory}) {
+        auto const phases = of_kind(events, kind);
+        INFO(utxoz::to_string(kind));
+        REQUIRE(phases.size() == 1);
+        CHECK(nested_in(phases.front(), syncs.front()));
+    }
+
+    auto const json = utxoz::to_chrome_trace(capture);
+    CHECK(json.starts_with("{\"traceEvents\":["));
+    CHECK(json.find("\"name\":\"rotation\"") != std::string::npos);
+    CHECK(json.find("\"ph\":\"X\"") != std::string::npos);
+    CHECK(json.find("\"overwritten\":0") != std::string::npos);
+
+    // Drained is drained.
+    CHECK(db.drain_trace().events.empty());
+    db.close();
+}
+
+TEST_CASE("trace: a full ring keeps the newest and counts the rest", "[trace]") {
+    auto const path = make_unique_path("ring");
+    scope_exit const cleanup([&] {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    });
+    failpoints::scoped_reset const disarm;
+
+    auto opened = utxoz::full_db::open_for_testing(path, true);
+    REQUIRE(opened);
+    auto db = std::move(*opened);
+    db.start_tracing({.capacity = 2});
+
+    make_generations(db);
+
+    // The recovery and three rotations into two slots.
+    auto const capture = db.drain_trace();
+    REQUIRE(capture.events.size() == 2);
+    CHECK(capture.overwritten == 2);
+    CHECK(capture.events[0].kind == trace_kind::rotation);
+    CHECK(capture.events[1].kind == trace_kind::rotation);
+    CHECK(capture.events[1].version == capture.events[0].version + 1);
+    CHECK(utxoz::to_chrome_trace(capture).find("\"overwritten\":2") != std::string::npos);
+
+    // Stopped, what was recorded stays to be drained and nothing more lands.
+    failpoints::force_rotations.store(1, std::memory_order_relaxed);
+    REQUIRE(db.insert(make_key(1000), make_value(20), 101).value());
+    db.stop_tracing();
+    failpoints::force_rotations.store(1, std::memory_order_relaxed);
+    REQUIRE(db.insert(make_key(1001), make_value(20), 101).value());
+    auto const after = db.drain_trace();
+    REQUIRE(after.events.size() == 1);
+    CHECK(after.events.front().kind == trace_kind::rotation);
+    CHECK(after.events.front().version == capture.events[1].version + 1);
+    CHECK(after.overwritten == 0);
+    db.close();
+}
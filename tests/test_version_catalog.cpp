@@ -25,6 +25,7 @@
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #ifdef _WIN32
 #include <process.h>
@@ -43,6 +44,7 @@
 
 namespace fs = std::filesystem;
 using utxoz::detail::version_catalog;
+using utxoz::detail::enumerate_version_families;
 using utxoz::detail::enumerate_versions;
 using utxoz::detail::parse_canonical_version;
 using utxoz::detail::scope_exit;
@@ -97,6 +99,45 @@ TEST_CASE("only canonically named regular files are catalogued", "[catalog]") {
     fs::remove_all(dir);
 }
 
+TEST_CASE("one pass answers every family as its own listing would", "[catalog]") {
+    auto const dir = unique_dir("families");
+    fs::create_directories(dir);
+
+    touch(fs::path(dir) / "cont_0_v00000.dat");
+    touch(fs::path(dir) / "cont_0_v00004.dat");
+    touch(fs::path(dir) / "cont_0_v00004.dat.building");
+    touch(fs::path(dir) / "cont_2_v00001.dat");
+    touch(fs::path(dir) / "cont_2_v00003.merge");
+    touch(fs::path(dir) / "cont_2_v00003.merge.tmp");
+    touch(fs::path(dir) / "cont_2_v3.merge");          // not canonical
+    touch(fs::path(dir) / "compact_v00002.dat");
+    fs::create_directories(fs::path(dir) / "cont_2_v00009.dat");
+
+    std::vector<utxoz::detail::version_family> const families{
+        {"cont_0_v"}, {"cont_0_v", ".dat.building"}, {"cont_1_v"}, {"cont_2_v"},
+        {"cont_2_v", ".merge"}, {"cont_2_v", ".merge.tmp"}, {"compact_v"},
+    };
+    auto const listed = enumerate_version_families(dir, families);
+    REQUIRE(listed);
+    REQUIRE(listed->size() == families.size());
+    for (size_t f = 0; f < families.size(); ++f) {
+        INFO("family " << families[f].prefix << families[f].suffix);
+        auto const alone = enumerate_versions(dir, families[f].prefix, families[f].suffix);
+        REQUIRE(alone);
+        CHECK((*listed)[f] == *alone);
+    }
+    CHECK((*listed)[0] == std::vector<size_t>{0, 4});
+    CHECK((*listed)[2].empty());
+    CHECK((*listed)[4] == std::vector<size_t>{3});
+
+    // A directory that is not there is no versions in any family.
+    auto const missing = enumerate_version_families(unique_dir("families_missing"), families);
+    REQUIRE(missing);
+    for (auto const& versions : *missing) CHECK(versions.empty());
+
+    fs::remove_all(dir);
+}
+
 TEST_CASE("canonical parsing round-trips", "[catalog]") {
     CHECK(parse_canonical_version("cont_0_v00000.dat", "cont_0_v") == 0);
     CHECK(parse_canonical_version("cont_0_v00042.dat", "cont_0_v") == 42);
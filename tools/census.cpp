@@ -25,13 +25,16 @@
  *  - `open_for_inspection()` may write. It does not create a database, which is the
  *    promise it makes; it does take the lock file, and it does settle an
  *    interrupted merge in a database that is there. It is not a read-only
- *    inspection and is not offered as one.
+ *    inspection and is not offered as one. With --incremental it also writes
+ *    the census's own records, one per sealed generation, beside the metadata.
  */
 
+#include <charconv>
 #include <cstdio>
 #include <filesystem>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <vector>
 
 #include <utxoz/census.hpp>
@@ -54,6 +57,16 @@ void usage() {
         "  --no-physical-blocks    skip the per-file stat that asks the filesystem\n"
         "                          how many blocks it actually gave the file\n"
         "  --no-generation-detail  per-class totals only\n"
+        "  --threads=N             walk N generations at a time (default: one per\n"
+        "                          hardware thread; 1 for a sequential walk)\n"
+        "  --residency             ask the page cache how much of each file it holds\n"
+        "                          now; differs from run to run, so off by default\n"
+        "  --incremental           count sealed generations that have not changed\n"
+        "                          since an earlier --incremental run from the records\n"
+        "                          it left, and leave records for the next one\n"
+        "  --sample=F              read a fraction F (0 < F < 1) of each generation's\n"
+        "                          entries and estimate the payload figures, with\n"
+        "                          intervals; entry counts stay exact\n"
         "  --snapshot              record that this is a copy whose consistency\n"
         "                          depends on how it was taken\n"
         "\n"
@@ -116,6 +129,33 @@ int main(int argc, char** argv) {
         else if (arg == "--mode=reference") reference = true;
         else if (arg == "--no-physical-blocks") options.measure_physical_blocks = false;
         else if (arg == "--no-generation-detail") options.per_generation_detail = false;
+        else if (arg == "--residency") options.measure_residency = true;
+        else if (arg == "--incremental") options.incremental = true;
+        else if (arg.starts_with("--threads=")) {
+            auto const digits = arg.substr(std::string_view("--threads=").size());
+            unsigned threads = 0;
+            auto const [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(),
+                                                   threads);
+            if (ec != std::errc{} || end != digits.data() + digits.size() || threads == 0) {
+                std::fprintf(stderr, "census: --threads wants a positive number, not %.*s\n",
+                             int(digits.size()), digits.data());
+                return 1;
+            }
+            options.threads = threads;
+        }
+        else if (arg.starts_with("--sample=")) {
+            auto const digits = arg.substr(std::string_view("--sample=").size());
+            double fraction = 0.0;
+            auto const [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(),
+                                                   fraction);
+            if (ec != std::errc{} || end != digits.data() + digits.size()
+                    || ! (fraction > 0.0 && fraction < 1.0)) {
+                std::fprintf(stderr, "census: --sample wants a fraction between 0 and 1, "
+                                     "not %.*s\n", int(digits.size()), digits.data());
+                return 1;
+            }
+            options.sample_fraction = fraction;
+        }
         else if (arg == "--snapshot") options.declared_external_snapshot = true;
         else if (arg == "--help" || arg == "-h") { usage(); return 0; }
         else if (arg.starts_with("--")) {